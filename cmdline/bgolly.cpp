@@ -5,6 +5,7 @@
 #include "hlifealgo.h"
 #include "generationsalgo.h"
 #include "ltlalgo.h"
+#include "hltlalgo.h"
 #include "jvnalgo.h"
 #include "superalgo.h"
 #include "ruleloaderalgo.h"
@@ -133,7 +134,26 @@ char *liferule = 0 ;
 char *outfilename = 0 ;
 char *renderscale = (char *)"1" ;
 char *testscript = 0 ;
-int outputgzip, outputismc ;
+int outputgzip ;
+pattern_format outputformat = RLE_format ;
+int outputresults ;
+int convertonly ;
+int slowrle ;
+int numthreads = 1 ;
+int pardepth ;
+int openhash ;
+int gengc ;
+int evictcache ;
+char *cachefile = 0 ;
+int savecache ;
+int leafbench ;
+int brickbench ;
+int brickkernel = -1 ;
+int ltlkernel = -1 ;
+int rulebench ;
+int denselimit = -1 ;
+int leafsize ;
+int hugepages ;
 int numberoffset ; // where to insert file name numbers
 options options[] = {
   { "-m", "--generation", "How far to run", 'I', &maxgen },
@@ -147,8 +167,8 @@ options options[] = {
   { "-s", "--search", "Search directory for .rule files", 's', &user_rules },
   { "-h", "--hashlife", "Use Hashlife algorithm", 'b', &hashlife },
   { "-a", "--algorithm", "Select algorithm by name", 's', &algoName },
-  { "-o", "--output", "Output file (*.rle, *.mc, *.rle.gz, *.mc.gz)", 's',
-                                                               &outfilename },
+  { "-o", "--output", "Output file (*.rle, *.mc, *.mcb, *.rle.gz, *.mc.gz, *.mcb.gz)",
+                                                          's', &outfilename },
   { "-v", "--verbose", "Verbose", 'b', &verbose },
   { "-t", "--timeline", "Use timeline", 'b', &timeline },
   { "",   "--render", "Render (benchmarking)", 'b', &render },
@@ -160,6 +180,24 @@ options options[] = {
 //{ "",   "--stepfactor", "How much to scale step by (default 2)",
 //                                                        'i', &stepfactor },
   { "",   "--autofit", "Autofit before each render", 'b', &autofit },
+  { "",   "--threads", "Number of threads to use", 'i', &numthreads },
+  { "",   "--pardepth", "Min HashLife depth to run in parallel", 'i', &pardepth },
+  { "",   "--openhash", "Use open-addressing HashLife node table", 'b', &openhash },
+  { "",   "--gengc", "Use generational HashLife garbage collection", 'b', &gengc },
+  { "",   "--evict", "Evict HashLife results when memory is full", 'b', &evictcache },
+  { "",   "--cache", "Load HashLife results from this file", 's', &cachefile },
+  { "",   "--savecache", "Add this run's HashLife results to the --cache file", 'b', &savecache },
+  { "",   "--results", "Include HashLife results in *.mcb output", 'b', &outputresults },
+  { "",   "--convert", "Just write the pattern to the output file", 'b', &convertonly },
+  { "",   "--slowrle", "Read RLE files line by line", 'b', &slowrle },
+  { "",   "--leafsize", "HashLife leaf or block size: 8, 16 or 32", 'i', &leafsize },
+  { "",   "--hugepages", "Back HashLife nodes with huge pages", 'b', &hugepages },
+  { "",   "--leafbench", "Time HashLife leaf evaluation on this many leaves", 'i', &leafbench },
+  { "",   "--brickbench", "Time QuickLife brick evaluation on this many bricks", 'i', &brickbench },
+  { "",   "--brickkernel", "QuickLife brick kernel: 0 table, 1 vector, 2 avx2", 'i', &brickkernel },
+  { "",   "--ltlkernel", "Larger than Life count kernel: 0 scalar, 1 vector, 2 avx2", 'i', &ltlkernel },
+  { "",   "--rulebench", "Time multi-state transitions on this many cells", 'i', &rulebench },
+  { "",   "--denselimit", "Max bytes for a dense transition table (0 = none)", 'i', &denselimit },
   { "",   "--exec", "Run testing script", 's', &testscript },
   { 0, 0, 0, 0, 0 }
 } ;
@@ -204,10 +242,10 @@ void writepat(int fc) {
    cerr << "(->" << thisfilename << flush ;
    bigint t, l, b, r ;
    imp->findedges(&t, &l, &b, &r) ;
-   if (!outputismc && (t < -MAXRLE || l < -MAXRLE || b > MAXRLE || r > MAXRLE))
+   if (outputformat == RLE_format && (t < -MAXRLE || l < -MAXRLE || b > MAXRLE || r > MAXRLE))
       lifefatal("Pattern too large to write in RLE format") ;
    const char *err = writepattern(thisfilename, *imp,
-                                  outputismc ? MC_format : RLE_format,
+                                  outputformat,
                                   outputgzip ? gzip_compression : no_compression,
                                   t.toint(), l.toint(), b.toint(), r.toint()) ;
    if (err != 0)
@@ -230,28 +268,28 @@ struct cmdbase {
    bigint barg ;
    virtual void doit() {}
    // for convenience, we put the generic loop here that takes a
-   // 4x bounding box and runs getnext on all y values until
-   // they are done.  Input is assumed to be a bounding box in the
-   // form minx miny maxx maxy
+   // 4x bounding box and visits all the live cells in it in one
+   // walk.  Input is assumed to be a bounding box in the form
+   // minx miny maxx maxy
+   struct loopvisitor : public cellvisitor {
+      loopvisitor(cmdbase *c) : cmd(c) {}
+      virtual bool visit(int x, int y, int n, const unsigned char *states) {
+         for (int i=0; i<n; i++)
+            if (states[i])
+               cmd->nextloopinner(x + i, y) ;
+         return true ;
+      }
+      cmdbase *cmd ;
+   } ;
    void runnextloop() {
       int minx = iargs[0] ;
       int miny = iargs[1] ;
       int maxx = iargs[2] ;
       int maxy = iargs[3] ;
-      int v ;
-      for (int y=miny; y<=maxy; y++) {
-         for (int x=minx; x<=maxx; x++) {
-            int dx = imp->nextcell(x, y, v) ;
-            if (dx < 0)
-               break ;
-            if (x > 0 && (x + dx) < 0)
-               break ;
-            x += dx ;
-            if (x > maxx)
-               break ;
-            nextloopinner(x, y) ;
-         }
-      }
+      if (minx > maxx || miny > maxy)
+         return ;
+      loopvisitor v(this) ;
+      imp->visitcells(minx, miny, maxx - minx + 1, maxy - miny + 1, v) ;
    }
    virtual void nextloopinner(int, int) {}
    int parseargs(const char *cmdargs) {
@@ -340,6 +378,36 @@ struct stepcmd : public cmdbase {
       cout << imp->getPopulation().tostring() << endl ;
    }
 } step_inst ;
+struct recordcmd : public cmdbase {
+   recordcmd() : cmdbase("record", "") {}
+   virtual void doit() {
+      timeline = 1 ;
+      imp->setIncrement(1) ;
+      cout << imp->startrecording(2, 0) << " frames." << endl ;
+   }
+} record_inst ;
+struct stoprecordcmd : public cmdbase {
+   stoprecordcmd() : cmdbase("stoprecord", "") {}
+   virtual void doit() {
+      imp->stoprecording() ;
+   }
+} stoprecord_inst ;
+struct gotoframecmd : public cmdbase {
+   gotoframecmd() : cmdbase("gotoframe", "i") {}
+   virtual void doit() {
+      if (imp->gotoframe(iargs[0]) == 0)
+         lifewarning("No such frame") ;
+      cout << imp->getGeneration().tostring() << ": " ;
+      cout << imp->getPopulation().tostring() << endl ;
+   }
+} gotoframe_inst ;
+struct destroytimelinecmd : public cmdbase {
+   destroytimelinecmd() : cmdbase("destroytimeline", "") {}
+   virtual void doit() {
+      imp->destroytimeline() ;
+      timeline = 0 ;
+   }
+} destroytimeline_inst ;
 struct showcmd : public cmdbase {
    showcmd() : cmdbase("show", "") {}
    virtual void doit() {
@@ -404,11 +472,13 @@ struct cutcmd : public cmdbase {
    cutcmd() : cmdbase("cut", "iiii") {}
    virtual void nextloopinner(int x, int y) {
       cutbuf.push_back(make_pair(x-iargs[0], y-iargs[1])) ;
-      imp->setcell(x, y, 0) ;
    }
    virtual void doit() {
       cutbuf.clear() ;
       runnextloop() ;
+      // clear the cells once the walk is done
+      for (unsigned int i=0; i<cutbuf.size(); i++)
+         imp->setcell(cutbuf[i].first+iargs[0], cutbuf[i].second+iargs[1], 0) ;
       cout << cutbuf.size() << " pixels cut." << endl ;
    }
 } cut_inst ;
@@ -416,8 +486,13 @@ struct cutcmd : public cmdbase {
 struct pastecmd : public cmdbase {
    pastecmd() : cmdbase("paste", "ii") {}
    virtual void doit() {
-      for (unsigned int i=0; i<cutbuf.size(); i++)
-         imp->setcell(cutbuf[i].first, cutbuf[i].second, 1) ;
+      vector<int> cells ;
+      for (unsigned int i=0; i<cutbuf.size(); i++) {
+         cells.push_back(cutbuf[i].first) ;
+         cells.push_back(cutbuf[i].second) ;
+      }
+      if (cells.size() > 0)
+         imp->putcells(&cells[0], (int)cutbuf.size(), false) ;
       cout << cutbuf.size() << " pixels pasted." << endl ;
    }
 } paste_inst ;
@@ -449,6 +524,7 @@ lifealgo *createUniverse() {
    if (imp == 0)
       lifefatal("Could not create universe") ;
    imp->setMaxMemory(maxmem) ;
+   imp->setNumThreads(numthreads) ;
    return imp ;
 }
 
@@ -523,6 +599,7 @@ int main(int argc, char *argv[]) {
    hlifealgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    generationsalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    ltlalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
+   hltlalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    jvnalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    superalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    ruleloaderalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
@@ -574,22 +651,55 @@ case 's':
    if (outfilename) {
       if (endswith(outfilename, ".rle")) {
       } else if (endswith(outfilename, ".mc")) {
-         outputismc = 1 ;
+         outputformat = MC_format ;
+      } else if (endswith(outfilename, ".mcb")) {
+         outputformat = outputresults ? MCBR_format : MCB_format ;
 #ifdef ZLIB
       } else if (endswith(outfilename, ".rle.gz")) {
          outputgzip = 1 ;
       } else if (endswith(outfilename, ".mc.gz")) {
-         outputismc = 1 ;
+         outputformat = MC_format ;
+         outputgzip = 1 ;
+      } else if (endswith(outfilename, ".mcb.gz")) {
+         outputformat = outputresults ? MCBR_format : MCB_format ;
          outputgzip = 1 ;
 #endif
       } else {
-         lifefatal("Output filename must end with .rle or .mc.") ;
+         lifefatal("Output filename must end with .rle, .mc or .mcb.") ;
       }
       if (strlen(outfilename) > 200)
          lifefatal("Output filename too long") ;
    }
+   if (convertonly && !outfilename)
+      lifefatal("Nothing to convert to; give an output file") ;
    if (timeline && hyperxxx)
       lifefatal("Cannot use both timeline and exponentially increasing steps") ;
+   if (pardepth)
+      hlifealgo::setParallelDepth(pardepth) ;
+   if (openhash)
+      hlifealgo::setOpenHash(1) ;
+   if (gengc)
+      hlifealgo::setGenerationalGC(1) ;
+   if (evictcache)
+      hlifealgo::setEvictCache(1) ;
+   if (slowrle)
+      setfastrle(false) ;
+   if (leafsize) {
+      if (leafsize != 8 && leafsize != 16 && leafsize != 32)
+         lifefatal("Leaf size must be 8, 16 or 32") ;
+      hlifealgo::setLeafSize(leafsize) ;
+      ghashbase::setLeafSize(leafsize) ;
+   }
+   if (hugepages) {
+      hlifealgo::setHugePages(1) ;
+      ghashbase::setHugePages(1) ;
+   }
+   if (denselimit >= 0)
+      ghashbase::setDenseLimit(denselimit) ;
+   if (brickkernel >= 0)
+      qlifealgo::setBrickKernel(brickkernel) ;
+   if (ltlkernel >= 0)
+      ltlalgo::setKernel(ltlkernel) ;
    imp = createUniverse() ;
    if (progress)
       lifeerrors::seterrorhandler(&progerrors_instance) ;
@@ -611,10 +721,42 @@ case 's':
    filename = argv[1] ;
    const char *err = readpattern(argv[1], *imp) ;
    if (err) lifefatal(err) ;
+   if (convertonly) {
+      if (benchmark)
+         cout << timestamp() << " read" << endl ;
+      writepat(-1) ;
+      if (benchmark)
+         cout << timestamp() << " written" << endl ;
+      exit(0) ;
+   }
    if (liferule) {
       err = imp->setrule(liferule) ;
       if (err) lifefatal(err) ;
    }
+   if (leafbench > 0) {
+      hlifealgo *h = dynamic_cast<hlifealgo *>(imp) ;
+      if (h == 0)
+         lifefatal("Leaf benchmark needs the HashLife algorithm") ;
+      cout << h->benchmarkLeaves(leafbench) << endl ;
+      exit(0) ;
+   }
+   if (brickbench > 0) {
+      qlifealgo *q = dynamic_cast<qlifealgo *>(imp) ;
+      if (q == 0)
+         lifefatal("Brick benchmark needs the QuickLife algorithm") ;
+      cout << q->benchmarkBricks(brickbench) << endl ;
+      exit(0) ;
+   }
+   if (rulebench > 0) {
+      ghashbase *g = dynamic_cast<ghashbase *>(imp) ;
+      if (g == 0)
+         lifefatal("Rule benchmark needs a multi-state algorithm") ;
+      const char *s = g->benchmarkRule(rulebench) ;
+      if (s == 0)
+         lifefatal("Rule benchmark isn't supported by this algorithm") ;
+      cout << s << endl ;
+      exit(0) ;
+   }
    bool boundedgrid = imp->unbounded && (imp->gridwd > 0 || imp->gridht > 0) ;
    if (boundedgrid) {
       if (hyperxxx || inc > 1)
@@ -624,6 +766,21 @@ case 's':
    }
    if (inc != 0)
       imp->setIncrement(inc) ;
+   // load the results after setting the increment so the ones for our
+   // step size are the ones we get
+   hlifealgo *hlimp = 0 ;
+   if (savecache && cachefile == 0)
+      lifefatal("--savecache needs a --cache file") ;
+   if (cachefile) {
+      hlimp = dynamic_cast<hlifealgo *>(imp) ;
+      if (hlimp == 0)
+         lifewarning("Result cache needs the HashLife algorithm") ;
+      else if (FILE *f = fopen(cachefile, "rb")) {
+         fclose(f) ;   // a missing file is fine; --savecache will create it
+         err = hlimp->loadResultCache(cachefile) ;
+         if (err) lifewarning(err) ;
+      }
+   }
    if (timeline) {
       int lowbit = inc.lowbitset() ;
       bigint t = 1 ;
@@ -681,5 +838,17 @@ case 's':
    }
    if (maxgen >= 0 && outfilename != 0)
       writepat(-1) ;
+   if (benchmark) {
+      hlifealgo *h = dynamic_cast<hlifealgo *>(imp) ;
+      if (h)
+         cout << timestamp() << " " << h->hashStats() << endl ;
+      ghashbase *g = dynamic_cast<ghashbase *>(imp) ;
+      if (g && g->transitionStats())
+         cout << timestamp() << " " << g->transitionStats() << endl ;
+   }
+   if (hlimp && savecache) {
+      err = hlimp->saveResultCache(cachefile) ;
+      if (err) lifewarning(err) ;
+   }
    exit(0) ;
 }
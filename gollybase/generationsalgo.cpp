@@ -51,6 +51,29 @@ state generationsalgo::slowcalc(state nw, state n, state ne, state w, state c,
    return result ;
 }
 
+/*
+ *   Along a row the 3x3 index slides one column at a time, so each
+ *   cell only has to add the bits of its right-hand column.
+ */
+void generationsalgo::steprow(const state *above, const state *here,
+                              const state *below, state *out, int count) {
+   const char *lookup = rule3x3 ;
+   int index = ((above[-1] == 1) ? 128 : 0) | ((here[-1] == 1) ? 16 : 0)
+      | ((below[-1] == 1) ? 2 : 0) | ((above[0] == 1) ? 64 : 0)
+      | ((here[0] == 1) ? 8 : 0) | ((below[0] == 1) ? 1 : 0) ;
+   for (int i=0; i<count; i++) {
+      index = ((index << 1) & 0x1b6) | ((above[i+1] == 1) ? 64 : 0)
+         | ((here[i+1] == 1) ? 8 : 0) | ((below[i+1] == 1) ? 1 : 0) ;
+      state c = here[i] ;
+      if (c <= 1 && lookup[index])
+         out[i] = 1 ;
+      else if (c > 0 && c + 1 < maxCellStates)
+         out[i] = c + 1 ;
+      else
+         out[i] = 0 ;
+   }
+}
+
 static lifealgo *creator() { return new generationsalgo() ; }
 
 void generationsalgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
@@ -17,6 +17,7 @@
 #include "util.h"
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 using namespace std ;
 /*
  *   Power of two hash sizes work fine.
@@ -73,6 +74,9 @@ g_uintptr_t ghnode_hash(void *a, void *b, void *c, void *d) {
  *   handles a large load factor fairly well.
  */
 double ghashbase::maxloadfactor = 0.7 ;
+int ghashbase::usehugepages = 0 ;
+int ghashbase::leafsize = 2 ;
+int ghashbase::denselimit = 1 << 20 ;
 void ghashbase::resize() {
 #ifndef NOGCBEFORERESIZE
    if (okaytogc) {
@@ -93,6 +97,8 @@ void ghashbase::resize() {
      lifestatus(statusline) ;
    }
    nhashtab = (ghnode **)calloc(nhashprime, sizeof(ghnode *)) ;
+   if (nhashtab && hugepages)
+      blockpool::hugehint(nhashtab, nhashprime * sizeof(ghnode *)) ;
    if (nhashtab == 0) {
      lifewarning("Out of memory; running in a somewhat slower mode; "
                  "try reducing the hash memory limit after restarting.") ;
@@ -222,10 +228,12 @@ ghnode *ghashbase::getres(ghnode *n, int depth) {
     */
    if (poller->poll() || softinterrupt) return zeroghnode(depth-1) ;
    int sp = gsp ;
-   if (running_hperf.fastinc(depth, ngens < depth))
+   if (running_hperf.fastinc(depth, ngens + rangebits < depth))
       running_hperf.report(inc_hperf, verbose) ;
    depth-- ;
-   if (ngens >= depth) {
+   if (depth + 1 <= widedepth) {
+     res = widestep(n, depth + 1) ;
+   } else if (ngens + rangebits >= depth) {
      if (is_ghnode(n->nw)) {
        res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
      } else {
@@ -243,7 +251,7 @@ ghnode *ghashbase::getres(ghnode *n, int depth) {
    if (softinterrupt || poller->isInterrupted()) // don't assign this to the cache field!
      res = zeroghnode(depth) ;
    else {
-     if (ngens < depth && halvesdone < 1000)
+     if (ngens + rangebits < depth && halvesdone < 1000)
        halvesdone++ ;
      n->res = res ;
    }
@@ -413,29 +421,278 @@ ghnode *ghashbase::dorecurs_half(ghnode *n, ghnode *ne, ghnode *t,
  */
 ghleaf *ghashbase::dorecurs_ghleaf(ghleaf *nw, ghleaf *ne, ghleaf *sw,
                                    ghleaf *se) {
-   return find_ghleaf(
-             slowcalc(nw->nw, nw->ne, ne->nw,
-                      nw->sw, nw->se, ne->sw,
-                      sw->nw, sw->ne, se->nw),
-             slowcalc(nw->ne, ne->nw, ne->ne,
-                      nw->se, ne->sw, ne->se,
-                      sw->ne, se->nw, se->ne),
-             slowcalc(nw->sw, nw->se, ne->sw,
-                      sw->nw, sw->ne, se->nw,
-                      sw->sw, sw->se, se->sw),
-             slowcalc(nw->se, ne->sw, ne->se,
-                      sw->ne, se->nw, se->ne,
-                      sw->se, se->sw, se->se)) ;
+   state rows[4][4] = {
+      { nw->nw, nw->ne, ne->nw, ne->ne },
+      { nw->sw, nw->se, ne->sw, ne->se },
+      { sw->nw, sw->ne, se->nw, se->ne },
+      { sw->sw, sw->se, se->sw, se->se } } ;
+   state out[2][2] ;
+   steprow(rows[0] + 1, rows[1] + 1, rows[2] + 1, out[0], 2) ;
+   steprow(rows[1] + 1, rows[2] + 1, rows[3] + 1, out[1], 2) ;
+   return find_ghleaf(out[0][0], out[0][1], out[1][0], out[1][1]) ;
+}
+/*
+ *   By default a row is just slowcalc() a cell at a time.
+ */
+void ghashbase::steprow(const state *above, const state *here,
+                        const state *below, state *out, int count) {
+   for (int i=0; i<count; i++)
+      out[i] = slowcalc(above[i-1], above[i], above[i+1],
+                        here[i-1], here[i], here[i+1],
+                        below[i-1], below[i], below[i+1]) ;
+}
+/*
+ *   Build the dense table by asking slowcalc() about every
+ *   neighborhood.  Moore rules with up to 4 states take 256KB and
+ *   von Neumann rules with up to 16 states 1MB; anything bigger than
+ *   denselimit gets a memo instead.
+ */
+void ghashbase::makedense(int vonneumann) {
+   freedense() ;
+   int cells = vonneumann ? 5 : 9 ;
+   int b = 1 ;
+   while ((1 << b) < maxCellStates)
+      b++ ;
+   densebits = b ;
+   densevn = vonneumann ;
+   if (cells * b > 30 || (1 << (cells * b)) > denselimit) {
+      makememo() ;
+      return ;
+   }
+   int size = 1 << (cells * b) ;
+   state *t = (state *)calloc(size, sizeof(state)) ;
+   if (t == 0) {
+      makememo() ;
+      return ;
+   }
+   int m = (1 << b) - 1 ;
+   state v[9] ;
+   for (int index=0; index<size; index++) {
+      int valid = 1 ;
+      for (int i=0; i<cells; i++) {
+         v[i] = (state)((index >> (b * (cells - 1 - i))) & m) ;
+         if (v[i] >= maxCellStates)
+            valid = 0 ;
+      }
+      if (!valid)
+         continue ;
+      if (vonneumann)      // n w c e s
+         t[index] = slowcalc(0, v[0], 0, v[1], v[2], v[3], 0, v[4], 0) ;
+      else                 // nw w sw n c s ne e se
+         t[index] = slowcalc(v[0], v[3], v[6], v[1], v[4], v[7],
+                             v[2], v[5], v[8]) ;
+   }
+   dense = t ;
+}
+/*
+ *   The memo gets 1/32 of the memory limit, as a power of two between
+ *   64KB and 32MB.  Keys never have the top bit set (at most 63 bits
+ *   are used), so all ones marks an empty slot.  256-state Moore
+ *   rules don't fit in the key and go without.
+ */
+void ghashbase::makememo() {
+   if (memo)
+      free(memo) ;
+   memo = 0 ;
+   memolookups = memomisses = 0 ;
+   if ((densevn ? 5 : 9) * densebits > 63)
+      return ;
+   int logsize = 12 ;
+   while (logsize < 21 && ((sizeof(memoentry) << (logsize + 1)) << 5) <= maxmem)
+      logsize++ ;
+   memoentry *m = (memoentry *)malloc(sizeof(memoentry) << logsize) ;
+   if (m == 0)
+      return ;
+   for (int i=0; i<(1<<logsize); i++) {
+      m[i].key = ~0ULL ;
+      m[i].res = 0 ;
+   }
+   memo = m ;
+   memoshift = 64 - logsize ;
+}
+void ghashbase::freedense() {
+   if (dense)
+      free(dense) ;
+   dense = 0 ;
+   if (memo)
+      free(memo) ;
+   memo = 0 ;
+}
+const char *ghashbase::transitionStats() {
+   if (memo == 0)
+      return 0 ;
+   sprintf(statusline, "Transition memo: %dKB, %g%% hits of %g lookups.",
+           (int)((sizeof(memoentry) << (64 - memoshift)) >> 10),
+           memolookups > 0 ? 100.0 * (1.0 - memomisses / memolookups) : 0.0,
+           memolookups) ;
+   return statusline ;
+}
+const char *ghashbase::benchmarkRule(int count) {
+   if (count < 1)
+      count = 1 ;
+   int n = maxCellStates ;
+   std::vector<state> rows(3 * ((size_t)count + 2)), out1(count), out2(count) ;
+   unsigned int x = 2463534242U ;
+   for (size_t i=0; i<rows.size(); i++) {
+      x ^= x << 13 ;
+      x ^= x >> 17 ;
+      x ^= x << 5 ;
+      // mostly empty, like real patterns
+      rows[i] = (state)((x & 3) ? 0 : (x >> 8) % n) ;
+   }
+   const state *above = &rows[1] ;
+   const state *here = above + count + 2 ;
+   const state *below = here + count + 2 ;
+   state *t = dense ;
+   memoentry *mt = memo ;
+   dense = 0 ;
+   memo = 0 ;
+   double start = gollySecondCount() ;
+   steprow(above, here, below, &out1[0], count) ;
+   double slowsecs = gollySecondCount() - start ;
+   dense = t ;
+   memo = mt ;
+   memolookups = memomisses = 0 ;
+   if (dense == 0 && memo == 0) {
+      sprintf(statusline, "Transitions: rule %g ns; no dense table or memo.",
+              1e9 * slowsecs / count) ;
+      return statusline ;
+   }
+   start = gollySecondCount() ;
+   steprow(above, here, below, &out2[0], count) ;
+   double fastsecs = gollySecondCount() - start ;
+   int mismatches = 0 ;
+   for (int i=0; i<count; i++)
+      if (out1[i] != out2[i])
+         mismatches++ ;
+   if (dense)
+      sprintf(statusline,
+        "Transitions: rule %g ns, dense (%d bytes) %g ns; %d mismatches.",
+              1e9 * slowsecs / count, 1 << ((densevn ? 5 : 9) * densebits),
+              1e9 * fastsecs / count, mismatches) ;
+   else
+      sprintf(statusline,
+ "Transitions: rule %g ns, memo %g ns (%.1f%% hits); %d mismatches.",
+              1e9 * slowsecs / count, 1e9 * fastsecs / count,
+              100.0 * (1.0 - memomisses / memolookups), mismatches) ;
+   return statusline ;
+}
+/*
+ *   Bigger blocks.  With setLeafSize(8), (16) or (32) we compute the
+ *   results of squares that size and smaller directly:  we unpack the
+ *   square's states into an array, step the array as many generations
+ *   as we need in one go, and pack the middle back up.  So none of the
+ *   little ghnodes and ghleaves in between get built, hashed or given
+ *   results, and most of the work is a plain loop over an array.  The
+ *   tree itself still ends in 2x2 ghleaves, so drawing, reading and
+ *   writing patterns are unchanged, as are the algorithms built on us.
+ *
+ *   Depths here are as in ghnode_depth(); a square of depth d is
+ *   2^(d+1) cells on a side, and cells are stored row by row.
+ */
+void ghashbase::unpackblock(ghnode *n, int depth, state *cells, int stride) {
+   if (depth == 0) {
+      ghleaf *l = (ghleaf *)n ;
+      cells[0] = l->nw ;
+      cells[1] = l->ne ;
+      cells[stride] = l->sw ;
+      cells[stride+1] = l->se ;
+   } else {
+      int half = 1 << depth ;
+      unpackblock(n->nw, depth-1, cells, stride) ;
+      unpackblock(n->ne, depth-1, cells + half, stride) ;
+      unpackblock(n->sw, depth-1, cells + half * stride, stride) ;
+      unpackblock(n->se, depth-1, cells + half * stride + half, stride) ;
+   }
+}
+ghnode *ghashbase::packblock(const state *cells, int depth, int stride) {
+   if (depth == 0)
+      return (ghnode *)find_ghleaf(cells[0], cells[1],
+                                   cells[stride], cells[stride+1]) ;
+   int sp = gsp ;
+   int half = 1 << depth ;
+   ghnode *nw = packblock(cells, depth-1, stride) ;
+   ghnode *ne = packblock(cells + half, depth-1, stride) ;
+   ghnode *sw = packblock(cells + half * stride, depth-1, stride) ;
+   ghnode *se = packblock(cells + half * stride + half, depth-1, stride) ;
+   ghnode *n = find_ghnode(nw, ne, sw, se) ;
+   pop(sp) ;
+   return save(n) ;
+}
+/*
+ *   Step a square of states, width cells on a side, gens generations,
+ *   for the cells at least margin in from the edge.  Each generation
+ *   we only do the cells that later ones (or the answer) need.
+ */
+void ghashbase::stepblock(state *cells, int width, int gens, int margin) {
+   state above[MAXBLOCK], here[MAXBLOCK] ;
+   for (int g=0; g<gens; g++) {
+      int lo = margin - (gens - 1 - g) ;
+      if (lo < g + 1)
+         lo = g + 1 ;
+      int hi = width - lo ;
+      memcpy(above, cells + (lo - 1) * width, width) ;
+      for (int r=lo; r<hi; r++) {
+         state *row = cells + r * width ;
+         memcpy(here, row, width) ;
+         steprow(above + lo, here + lo, row + width + lo, row + lo, hi - lo) ;
+         memcpy(above, here, width) ;
+      }
+   }
+}
+/*
+ *   The result of a square no bigger than the block size, 2^ngens
+ *   generations on, or as far as the square allows.
+ */
+ghnode *ghashbase::widestep(ghnode *n, int depth) {
+   state small[MAXBLOCK * MAXBLOCK] ;
+   int width = 1 << (depth + 1) ;
+   int most = depth - 1 - rangebits ;
+   int gens = 1 << (ngens < most ? ngens : most) ;
+   state *cells = (width <= MAXBLOCK ? small : blockcells) ;
+   int q = width >> 2 ;
+   unpackblock(n, depth, cells, width) ;
+   stepblock(cells, width, gens, q) ;
+   return packblock(cells + q * width + q, depth - 1, width) ;
+}
+/*
+ *   A square 2^(d+1) cells on a side can be stepped 2^(d-1) generations
+ *   of a rule whose neighborhood reaches one cell; with a reach of up
+ *   to 2^rangebits cells it only goes 2^(d-1-rangebits).  So the
+ *   results are those of a rule with a neighborhood one cell wide
+ *   whose cells are 2^rangebits cells on a side, and the squares with
+ *   the least depth that have results, 2^(rangebits+2) cells across,
+ *   are given to stepblock() whole.  Returns their width.
+ */
+int ghashbase::setrange(int range) {
+   rangebits = 0 ;
+   while ((1 << rangebits) < range)
+      rangebits++ ;
+   widedepth = (leafsize >= MAXBLOCK ? 4 : leafsize >= 16 ? 3 :
+                leafsize >= 8 ? 2 : 0) ;
+   if (widedepth < rangebits + 1)
+      widedepth = rangebits + 1 ;
+   int width = 1 << (widedepth + 1) ;
+   if (blockcells)
+      free(blockcells) ;
+   blockcells = 0 ;
+   if (width > MAXBLOCK) {
+      blockcells = (state *)malloc((size_t)width * width) ;
+      if (blockcells == 0)
+         lifefatal("Out of memory (5).") ;
+   }
+   clearcache() ;
+   return width ;
 }
 /*
  *   We keep free ghnodes in a linked list for allocation, and we allocate
- *   them 1000 at a time.
+ *   them 1000 at a time, from a blockpool that frees them all when we go.
  */
 ghnode *ghashbase::newghnode() {
    ghnode *r ;
    if (freeghnodes == 0) {
       int i ;
-      freeghnodes = (ghnode *)calloc(1001, sizeof(ghnode)) ;
+      freeghnodes = (ghnode *)ghblocks.alloc(1001 * sizeof(ghnode)) ;
       if (freeghnodes == 0)
          lifefatal("Out of memory; try reducing the hash memory limit.") ;
       alloced += 1001 * sizeof(ghnode) ;
@@ -497,6 +754,18 @@ ghashbase::ghashbase() {
    okaytogc = 0 ;
    totalthings = 0 ;
    ghnodeblocks = 0 ;
+   hugepages = usehugepages ;
+   ghblocks.usehugepages(hugepages) ;
+   widedepth = (leafsize >= MAXBLOCK ? 4 : leafsize >= 16 ? 3 :
+                leafsize >= 8 ? 2 : 0) ;
+   rangebits = 0 ;
+   blockcells = 0 ;
+   dense = 0 ;
+   densebits = 0 ;
+   densevn = 0 ;
+   memo = 0 ;
+   memoshift = 0 ;
+   memolookups = memomisses = 0 ;
    zeroghnodea = 0 ;
 /*
  *   We initialize our universe to be a 16-square.  We are in drawing
@@ -528,11 +797,8 @@ ghashbase::ghashbase() {
  */
 ghashbase::~ghashbase() {
    free(hashtab) ;
-   while (ghnodeblocks) {
-      ghnode *r = ghnodeblocks ;
-      ghnodeblocks = ghnodeblocks->next ;
-      free(r) ;
-   }
+   ghnodeblocks = 0 ;
+   ghblocks.clear() ;
    if (zeroghnodea)
       free(zeroghnodea) ;
    if (stack)
@@ -541,6 +807,9 @@ ghashbase::~ghashbase() {
       delete [] llxb ;
       delete [] llyb ;
    }
+   freedense() ;
+   if (blockcells)
+      free(blockcells) ;
 }
 /**
  *   Set increment.
@@ -597,6 +866,9 @@ void ghashbase::step() {
          depth = ghnode_depth(root) ;
       }
       running_hperf.reportStep(step_hperf, inc_hperf, generation.todouble(), verbose) ;
+      const char *memostats = verbose ? transitionStats() : 0 ;
+      if (memostats)
+         lifestatus(memostats) ;
       if (poller->isInterrupted() || !softinterrupt)
          break ;
    }
@@ -625,6 +897,8 @@ void ghashbase::setMaxMemory(int newmemlimit) {
    }
    maxmem = newlimit ;
    hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   if (memo)
+      makememo() ;
 }
 /*
  *   This routine expands our universe by a factor of two, maintaining
@@ -907,22 +1181,88 @@ int ghashbase::nextbit(ghnode *n, int x, int y, int depth, int &v) {
    }
 }
 /*
- *   Our nonrecurse top-level bit setting routine simply expands the
- *   universe as necessary to encompass the passed-in coordinates, and
- *   then invokes the recursive setbit.  Right now it works hashed or
- *   unhashed (but it's faster when unhashed).  We also turn on the inGC
- *   flag to inhibit popcount.
+ *   Set the live cells of a block of states under n, visiting each
+ *   leaf once rather than walking down to it for every cell.  As in
+ *   gsetbit, coordinates are relative to the center of n with y up;
+ *   the block has been clipped to x0..x1-1 by y0..y1-1, and the cell
+ *   at x,y is cells[(top - y) * stride + x - left].  In an unhashed
+ *   universe n can be null, and we only allocate where cells are set;
+ *   in a hashed one we build new ghnodes bottom up.
  */
-int ghashbase::setcell(int x, int y, int newstate) {
-   if (newstate < 0 || newstate >= maxCellStates)
-     return -1 ;
-   if (hashed) {
-      clearstack() ;
-      save(root) ;
-      okaytogc = 1 ;
+ghnode *ghashbase::setrect(ghnode *n, int x0, int y0, int x1, int y1,
+                           const state *cells, int left, int top,
+                           int stride, int depth) {
+   if (depth == 0) {
+      state q[4] = { 0, 0, 0, 0 } ;   // nw, ne, sw, se
+      int any = 0 ;
+      for (int y=y0; y<y1; y++) {
+         const state *row = cells + (size_t)(top - y) * stride ;
+         for (int x=x0; x<x1; x++) {
+            q[(x >= 0) + 2 * (y < 0)] = row[x - left] ;
+            any |= row[x - left] ;
+         }
+      }
+      if (any == 0)
+         return n ;
+      ghleaf *l = (ghleaf *)n ;
+      if (hashed)
+         return save((ghnode *)find_ghleaf(q[0] ? q[0] : l->nw,
+                                           q[1] ? q[1] : l->ne,
+                                           q[2] ? q[2] : l->sw,
+                                           q[3] ? q[3] : l->se)) ;
+      if (l == 0)
+         l = newclearedghleaf() ;
+      if (q[0]) l->nw = q[0] ;
+      if (q[1]) l->ne = q[1] ;
+      if (q[2]) l->sw = q[2] ;
+      if (q[3]) l->se = q[3] ;
+      return (ghnode *)l ;
    }
-   inGC = 1 ;
-   y = - y ;
+   int half = 1 << (depth - 1) ;
+   ghnode *c[4] = { 0, 0, 0, 0 } ;   // nw, ne, sw, se
+   if (n) {
+      c[0] = n->nw ;
+      c[1] = n->ne ;
+      c[2] = n->sw ;
+      c[3] = n->se ;
+   }
+   int sp = gsp ;
+   int changed = 0 ;
+   for (int i=0; i<4; i++) {
+      int cx = (i & 1) ? half : -half ;
+      int cy = (i & 2) ? -half : half ;
+      int qx0 = x0 > cx - half ? x0 : cx - half ;
+      int qx1 = x1 < cx + half ? x1 : cx + half ;
+      int qy0 = y0 > cy - half ? y0 : cy - half ;
+      int qy1 = y1 < cy + half ? y1 : cy + half ;
+      if (qx0 >= qx1 || qy0 >= qy1)
+         continue ;
+      ghnode *s = setrect(c[i], qx0 - cx, qy0 - cy, qx1 - cx, qy1 - cy,
+                          cells, left - cx, top - cy, stride, depth - 1) ;
+      if (s != c[i]) {
+         c[i] = s ;
+         changed = 1 ;
+      }
+   }
+   if (!changed)
+      return n ;
+   if (hashed) {
+      ghnode *r = find_ghnode(c[0], c[1], c[2], c[3]) ;
+      pop(sp) ;
+      return save(r) ;
+   }
+   if (n == 0)
+      n = newclearedghnode() ;
+   n->nw = c[0] ;
+   n->ne = c[1] ;
+   n->sw = c[2] ;
+   n->se = c[3] ;
+   return n ;
+}
+/*
+ *   Expand the universe until it holds x,y (with y already flipped).
+ */
+void ghashbase::growroot(int x, int y) {
    int sx = x ;
    int sy = y ;
    if (depth <= 31) {
@@ -942,6 +1282,52 @@ int ghashbase::setcell(int x, int y, int newstate) {
       sx >>= 1 ;
       sy >>= 1 ;
    }
+}
+/*
+ *   Set a block of cells through setrect.  Universes too big for int
+ *   coordinates to reach the center of the root are left to setcell.
+ */
+int ghashbase::setcells(int x, int y, int w, int h, const unsigned char *states) {
+   if (w <= 0 || h <= 0)
+      return 0 ;
+   for (size_t i=0; i<(size_t)w*h; i++)
+      if (states[i] >= maxCellStates)
+         return -1 ;
+   if (hashed) {
+      clearstack() ;
+      save(root) ;
+      okaytogc = 1 ;
+   }
+   inGC = 1 ;
+   growroot(x, -y) ;
+   growroot(x + w - 1, -(y + h - 1)) ;
+   if (depth <= 30)
+      root = setrect(root, x, 1 - y - h, x + w, 1 - y, states, x, -y, w, depth) ;
+   if (hashed) {
+      okaytogc = 0 ;
+   }
+   if (depth > 30)
+      return lifealgo::setcells(x, y, w, h, states) ;
+   return 0 ;
+}
+/*
+ *   Our nonrecurse top-level bit setting routine simply expands the
+ *   universe as necessary to encompass the passed-in coordinates, and
+ *   then invokes the recursive setbit.  Right now it works hashed or
+ *   unhashed (but it's faster when unhashed).  We also turn on the inGC
+ *   flag to inhibit popcount.
+ */
+int ghashbase::setcell(int x, int y, int newstate) {
+   if (newstate < 0 || newstate >= maxCellStates)
+     return -1 ;
+   if (hashed) {
+      clearstack() ;
+      save(root) ;
+      okaytogc = 1 ;
+   }
+   inGC = 1 ;
+   y = - y ;
+   growroot(x, y) ;
    root = gsetbit(root, x, y, newstate, depth) ;
    if (hashed) {
       okaytogc = 0 ;
@@ -974,25 +1360,7 @@ int ghashbase::getcell(int x, int y) {
  */
 int ghashbase::nextcell(int x, int y, int &v) {
    y = - y ;
-   int sx = x ;
-   int sy = y ;
-   if (depth <= 31) {
-     sx >>= depth ;
-     sy >>= depth ;
-   } else {
-     sx >>= 31 ;
-     sy >>= 31 ;
-   }
-   while (sx > 0 || sx < -1 || sy > 0 || sy < -1) {
-      if (hashed) {
-         root = save(pushroot(root)) ;
-         depth++ ;
-      } else {
-         pushroot_1() ;
-      }
-      sx >>= 1 ;
-      sy >>= 1 ;
-   }
+   growroot(x, y) ;
    if (depth > 30) {
       struct ghnode tghnode = *root ;
       int mdepth = depth ;
@@ -1007,6 +1375,88 @@ int ghashbase::nextcell(int x, int y, int &v) {
    }
    return nextbit(root, x, y, depth, v) ;
 }
+/*
+ *   Walk the universe a band of rows at a time, as hlifealgo does:
+ *   bands[depth] holds the ghnodes (with their left edges) that lie
+ *   side by side from row top, and the live children of their north
+ *   and then south halves go in bands[depth-1], down to the leaves.
+ *   Empty ghnodes and those outside x0..x1-1 by y0..y1-1 are left out.
+ */
+bool ghashbase::visitband(vector<vector<pair<ghnode *, long long> > > &bands,
+                          int depth, long long top, long long x0,
+                          long long y0, long long x1, long long y1,
+                          cellrow &row) {
+   vector<pair<ghnode *, long long> > &band = bands[depth] ;
+   if (depth == 0) {
+      for (int r=0; r<2; r++) {
+         long long y = top + r ;
+         if (y < y0 || y >= y1)
+            continue ;
+         for (size_t i=0; i<band.size(); i++) {
+            ghleaf *l = (ghleaf *)band[i].first ;
+            long long x = band[i].second ;
+            state w = r ? l->sw : l->nw ;
+            state e = r ? l->se : l->ne ;
+            if (w && x >= x0 && x < x1)
+               row.add((int)x, (int)y, w) ;
+            if (e && x + 1 >= x0 && x + 1 < x1)
+               row.add((int)(x + 1), (int)y, e) ;
+         }
+         if (!row.flush())
+            return false ;
+      }
+      return true ;
+   }
+   long long half = 1LL << depth ;
+   ghnode *z = zeroghnode(depth - 1) ;
+   vector<pair<ghnode *, long long> > &sub = bands[depth - 1] ;
+   for (int south=0; south<2; south++) {
+      long long subtop = top + south * half ;
+      if (subtop + half <= y0 || subtop >= y1)
+         continue ;
+      sub.clear() ;
+      for (size_t i=0; i<band.size(); i++) {
+         ghnode *n = band[i].first ;
+         ghnode *w = south ? n->sw : n->nw ;
+         ghnode *e = south ? n->se : n->ne ;
+         long long x = band[i].second ;
+         if (w != 0 && w != z && x + half > x0 && x < x1)
+            sub.push_back(make_pair(w, x)) ;
+         if (e != 0 && e != z && x + 2 * half > x0 && x + half < x1)
+            sub.push_back(make_pair(e, x + half)) ;
+      }
+      if (!sub.empty() &&
+          !visitband(bands, depth - 1, subtop, x0, y0, x1, y1, row))
+         return false ;
+   }
+   return true ;
+}
+/*
+ *   As in nextcell, only the middle of a universe too big for int
+ *   coordinates is walked.
+ */
+bool ghashbase::visitcells(int x, int y, int w, int h, cellvisitor &v) {
+   if (w <= 0 || h <= 0 || root == 0 || root == zeroghnode(depth))
+      return true ;
+   struct ghnode tghnode = *root ;
+   ghnode *n = root ;
+   int mdepth = depth ;
+   if (depth > 30) {
+      while (mdepth > 30) {
+         tghnode.nw = tghnode.nw->se ;
+         tghnode.ne = tghnode.ne->sw ;
+         tghnode.sw = tghnode.sw->ne ;
+         tghnode.se = tghnode.se->nw ;
+         mdepth-- ;
+      }
+      n = &tghnode ;
+   }
+   vector<vector<pair<ghnode *, long long> > > bands(mdepth + 1) ;
+   bands[mdepth].push_back(make_pair(n, -(1LL << mdepth))) ;
+   cellrow row(v) ;
+   return visitband(bands, mdepth, 1 - (1LL << mdepth), x, y,
+                    (long long)x + w, (long long)y + h, row) ;
+}
 /*
  *   Canonicalize a universe by filling in the null pointers and then
  *   invoking find_ghnode on each ghnode.  Drops the original universe on
@@ -1422,7 +1872,7 @@ void ghashbase::new_ngens(int newval) {
    }
    if (newval < clearto)
       clearto = newval ;
-   clearto++ ; /* clear this depth and above */
+   clearto += rangebits + 1 ; /* clear this depth and above */
    if (clearto < 1)
       clearto = 1 ;
    ngens = newval ;
@@ -1504,7 +1954,7 @@ ghnode *ghashbase::runpattern() {
    depth++ ;
    n = pushroot(n) ;
    depth++ ;
-   while (ngens + 2 > depth) {
+   while (ngens + rangebits + 2 > depth) {
       n = pushroot(n) ;
       depth++ ;
    }
@@ -1884,6 +2334,155 @@ const char *ghashbase::writeNativeFormat(std::ostream &os, char *comments) {
    inGC = 0 ;
    return 0 ;
 }
+/*
+ *   The binary macrocell format (see mcbhead in lifealgo.h).  A leaf
+ *   is its four states; results aren't written, and are skipped if a
+ *   file has them.  The timeline and any comments are not saved.  The
+ *   writer numbers the ghnodes in a little open-addressed table of its
+ *   own, since the next fields are busy holding the hash chains.
+ */
+struct mcbwriter {
+   vector<ghnode *> keys ;
+   vector<unsigned int> ids ;
+   g_uintptr_t mask ;
+   vector<state> leaves ;
+   vector<unsigned int> ghnodes ;
+   mcbwriter(g_uintptr_t n) {
+      for (mask=1023; mask < n + (n >> 1); mask += mask + 1) ;
+      keys.resize(mask + 1) ;
+      ids.resize(mask + 1) ;
+   }
+   g_uintptr_t slot(ghnode *n) {
+      g_uintptr_t h = (g_uintptr_t)n ;
+      h = (h ^ (h >> 17)) * 0x9e3779b1U ;
+      h = (h ^ (h >> 15)) & mask ;
+      while (keys[h] && keys[h] != n)
+         h = (h + 1) & mask ;
+      return h ;
+   }
+} ;
+static unsigned int mcbref(mcbwriter &w, ghnode *n) {
+   g_uintptr_t h = w.slot(n) ;
+   if (w.keys[h])
+      return w.ids[h] ;
+   unsigned int id ;
+   if (!is_ghnode(n)) {
+      ghleaf *l = (ghleaf *)n ;
+      w.leaves.push_back(l->nw) ;
+      w.leaves.push_back(l->ne) ;
+      w.leaves.push_back(l->sw) ;
+      w.leaves.push_back(l->se) ;
+      id = MCBLEAF | (unsigned int)(w.leaves.size() / 4) ;
+   } else {
+      unsigned int c[4] ;
+      c[0] = mcbref(w, n->nw) ;
+      c[1] = mcbref(w, n->ne) ;
+      c[2] = mcbref(w, n->sw) ;
+      c[3] = mcbref(w, n->se) ;
+      w.ghnodes.insert(w.ghnodes.end(), c, c+4) ;
+      id = (unsigned int)(w.ghnodes.size() / 4) ;
+      h = w.slot(n) ; // the children may have taken our old slot
+   }
+   w.keys[h] = n ;
+   w.ids[h] = id ;
+   return id ;
+}
+const char *ghashbase::writeBinaryFormat(std::ostream &os, int) {
+   ensure_hashed() ;
+   mcbwriter w(hashpop) ;
+   mcbhead h ;
+   h.root = mcbref(w, root) ;
+   h.leafsize = 4 * sizeof(state) ;
+   h.noderefs = 4 ;
+   h.nleaves = (unsigned int)(w.leaves.size() / 4) ;
+   h.nnodes = (unsigned int)(w.ghnodes.size() / 4) ;
+   h.ngens = ngens ;
+   writemcbhead(os, h, getrule(), generation.tostring('\0')) ;
+   if (w.leaves.size())
+      os.write((const char *)&w.leaves[0], w.leaves.size() * sizeof(state)) ;
+   if (w.ghnodes.size())
+      os.write((const char *)&w.ghnodes[0],
+               w.ghnodes.size() * sizeof(unsigned int)) ;
+   return 0 ;
+}
+/*
+ *   The records are canonicalized in the order they lie; depths holds
+ *   the depth of each ghnode.  If the user aborts we keep the last
+ *   ghnode, as readmacrocell() does.
+ */
+const char *ghashbase::readbinarymacrocell(const char *data, size_t len) {
+   const char *rule, *gen, *lp ;
+   const unsigned int *np ;
+   const char *err = checkmcb(data, len, 4 * sizeof(state),
+                              rule, gen, lp, np) ;
+   if (err)
+      return err ;
+   const mcbhead *h = (const mcbhead *)data ;
+   err = setrule(rule) ;
+   if (err)
+      return err ;
+   if (*gen)
+      generation = bigint(gen) ;
+   root = 0 ;
+   clearstack() ;
+   vector<ghnode *> leaves(1), ghnodes(1) ;
+   vector<unsigned char> depths(1) ;
+   leaves.reserve(h->nleaves + 1) ;
+   ghnodes.reserve(h->nnodes + 1) ;
+   depths.reserve(h->nnodes + 1) ;
+   const state *sp = (const state *)lp ;
+   unsigned int i ;
+   for (i=0; i<h->nleaves; i++, sp += 4) {
+      if (sp[0] >= maxCellStates || sp[1] >= maxCellStates ||
+          sp[2] >= maxCellStates || sp[3] >= maxCellStates)
+         return "Cell state values too high for this algorithm." ;
+      leaves.push_back((ghnode *)find_ghleaf(sp[0], sp[1], sp[2], sp[3])) ;
+   }
+   ghnode *c[4] ;
+   int d[4] ;
+   for (i=0; i<h->nnodes; i++, np += h->noderefs) {
+      if ((i & 4095) == 0 && lifeabortprogress(i / (double)h->nnodes, ""))
+         break ;
+      for (int j=0; j<4; j++) {
+         unsigned int r = np[j] ;
+         c[j] = 0 ;
+         d[j] = 0 ;
+         if (r & MCBLEAF) {
+            r &= ~MCBLEAF ;
+            if (r < leaves.size())
+               c[j] = leaves[r] ;
+         } else if (r < ghnodes.size()) {
+            c[j] = ghnodes[r] ;
+            d[j] = depths[r] ;
+         }
+      }
+      if (c[0] == 0 || c[1] == 0 || c[2] == 0 || c[3] == 0 ||
+          d[1] != d[0] || d[2] != d[0] || d[3] != d[0])
+         return "Binary macrocell file is corrupt." ;
+      depths.push_back((unsigned char)(d[0] + 1)) ;
+      ghnodes.push_back(find_ghnode(c[0], c[1], c[2], c[3])) ;
+   }
+   unsigned int r = h->root ;
+   if (ghnodes.size() <= h->nnodes) // aborted; keep what we have
+      r = ghnodes.size() > 1 ? (unsigned int)ghnodes.size() - 1
+                             : MCBLEAF | (unsigned int)(leaves.size() - 1) ;
+   if (r & MCBLEAF) {
+      r &= ~MCBLEAF ;
+      if (r >= leaves.size())
+         return "Binary macrocell file is corrupt." ;
+      root = leaves[r] ;
+      depth = 0 ;
+   } else {
+      if (r >= ghnodes.size())
+         return "Binary macrocell file is corrupt." ;
+      root = ghnodes[r] ;
+      depth = depths[r] ;
+   }
+   if (root == 0) // empty, as with readmacrocell()
+      return 0 ;
+   hashed = 1 ;
+   return 0 ;
+}
 char ghashbase::statusline[120] ;
 void ghashbase::doInitializeAlgoInfo(staticAlgoInfo &ai) {
    ai.setDefaultBaseStep(8) ;
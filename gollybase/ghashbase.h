@@ -16,6 +16,10 @@
  *   The size of a state.  Unsigned char works for now.
  */
 typedef unsigned char state ;
+/**
+ *   The largest block (see setLeafSize) we step in one go.
+ */
+const int MAXBLOCK = 32 ;
 /**
  *   Nodes, like the standard hlifealgo nodes.
  */
@@ -42,6 +46,19 @@ struct ghleaf {
  *   For explicit prefetching we retain some state for our lookup
  *   routines.
  */
+/*
+ *   A steprow() that just loops over slowcalc(); naming the class
+ *   makes the call direct, so a deriving class whose slowcalc() is
+ *   in the same source file gets it inlined into the loop.
+ */
+template <class T> inline void steprowof(T *algo, const state *above,
+                    const state *here, const state *below, state *out,
+                    int count) {
+   for (int i=0; i<count; i++)
+      out[i] = algo->T::slowcalc(above[i-1], above[i], above[i+1],
+                                 here[i-1], here[i], here[i+1],
+                                 below[i-1], below[i], below[i+1]) ;
+}
 #ifdef USEPREFETCH
 struct ghsetup_t { 
    g_uintptr_t h ;
@@ -63,9 +80,20 @@ public:
    //  This should be overridden by a deriving class.
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
                           state e, state sw, state s, state se) = 0 ;
+   //  The same for a row of cells:  out[i] is the next state of the
+   //  cell at here[i], so all three rows must be readable from [-1]
+   //  to [count].  The default calls slowcalc per cell; a deriving
+   //  class can override it with a loop the compiler can inline.
+   virtual void steprow(const state *above, const state *here,
+                        const state *below, state *out, int count) ;
    virtual int setcell(int x, int y, int newstate) ;
+   virtual int putrow(int x, int y, int n, const unsigned char *states) {
+      return setcells(x, y, n, 1, states) ;
+   }
+   virtual int setcells(int x, int y, int w, int h, const unsigned char *states) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &v) ;
+   virtual bool visitcells(int x, int y, int w, int h, cellvisitor &v) ;
    virtual void endofpattern() ;
    virtual void setIncrement(bigint inc) ;
    virtual void setIncrement(int inc) { setIncrement(bigint(inc)) ; }
@@ -91,8 +119,147 @@ public:
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) ;
    virtual const char *readmacrocell(char *line) ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) ;
+   virtual const char *readbinarymacrocell(const char *data, size_t len) ;
+   virtual const char *writeBinaryFormat(std::ostream &os, int results) ;
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
-   
+   /*
+    *   Ask for the nodes (and the hash table) to be backed by 2MB huge
+    *   pages where the system allows it.  Applies to universes created
+    *   after the call.
+    */
+   static void setHugePages(int v) { usehugepages = v ; }
+   static int getHugePages() { return usehugepages ; }
+   /*
+    *   Compute the results of 8x8, 16x16 or 32x32 blocks directly, a
+    *   block at a time, rather than memoizing everything down to the
+    *   2x2 leaves.  2 (the default) turns it off.  Applies to
+    *   universes created after the call.
+    */
+   static void setLeafSize(int v) { leafsize = v ; }
+   static int getLeafSize() { return leafsize ; }
+   /*
+    *   Rules that can compile themselves into a dense table (see
+    *   makedense) do so only if the table takes at most this many
+    *   bytes; 0 turns it off.  Applies to rules set after the call.
+    */
+   static void setDenseLimit(int v) { denselimit = v ; }
+   static int getDenseLimit() { return denselimit ; }
+   /*
+    *   Time steprow() on random rows with and without the dense
+    *   table (or memo) and check that they agree; returns a line
+    *   describing the timings, or 0 if the algorithm has no
+    *   transition function to time.
+    */
+   virtual const char *benchmarkRule(int count) ;
+   /*
+    *   How well the transition memo is doing, or 0 if there isn't
+    *   one.  Also shown after each step when verbose.
+    */
+   virtual const char *transitionStats() ;
+
+protected:
+/*
+ *   The dense table holds the next state for every packed
+ *   neighborhood:  each cell takes densebits bits, and the index is
+ *   either the three columns of the 3x3 (left column highest, each
+ *   column top to bottom) or n, w, c, e, s for von Neumann rules.
+ *   A deriving class calls makedense() once its rule is in place,
+ *   and uses densestep() in steprow() whenever dense is set.
+ */
+   state *dense ;
+   int densebits, densevn ;
+   static int denselimit ;
+   void makedense(int vonneumann) ;
+   void freedense() ;
+/*
+ *   Rules whose dense table would be too big get a memo instead:  a
+ *   direct-mapped cache from the packed neighborhood (the same
+ *   packing as the dense index, in 64 bits) to the next state.  Its
+ *   size is a share of setMaxMemory().  Real patterns only ever see a
+ *   small fraction of the neighborhoods, so nearly every lookup
+ *   hits.  memostep() calls the deriving class's slowcalc() directly
+ *   on a miss.
+ */
+   struct memoentry {
+      unsigned long long key ;
+      state res ;
+   } ;
+   memoentry *memo ;
+   int memoshift ;
+   double memolookups, memomisses ;
+   void makememo() ;
+   template <class T> void memostep(T *algo, const state *above,
+                    const state *here, const state *below, state *out,
+                    int count) {
+      memoentry *m = memo ;
+      int b = densebits ;
+      int sh = memoshift ;
+      unsigned long long key ;
+      if (densevn) {
+         for (int i=0; i<count; i++) {
+            key = ((((unsigned long long)above[i] << b | here[i-1]) << b
+                    | here[i]) << b | here[i+1]) << b | below[i] ;
+            memoentry &e = m[(key * 0x9E3779B97F4A7C15ULL) >> sh] ;
+            if (e.key != key) {
+               e.key = key ;
+               e.res = algo->T::slowcalc(0, above[i], 0, here[i-1], here[i],
+                                         here[i+1], 0, below[i], 0) ;
+               memomisses++ ;
+            }
+            out[i] = e.res ;
+         }
+      } else {
+         int b3 = 3 * b ;
+         unsigned long long mask = (1ULL << (3 * b3)) - 1 ;
+         key = (unsigned long long)(above[-1] << (b + b)
+                   | here[-1] << b | below[-1]) << b3
+             | (above[0] << (b + b) | here[0] << b | below[0]) ;
+         for (int i=0; i<count; i++) {
+            key = ((key << b3) | (above[i+1] << (b + b)
+                                  | here[i+1] << b | below[i+1])) & mask ;
+            memoentry &e = m[(key * 0x9E3779B97F4A7C15ULL) >> sh] ;
+            if (e.key != key) {
+               e.key = key ;
+               e.res = algo->T::slowcalc(above[i-1], above[i], above[i+1],
+                                         here[i-1], here[i], here[i+1],
+                                         below[i-1], below[i], below[i+1]) ;
+               memomisses++ ;
+            }
+            out[i] = e.res ;
+         }
+      }
+      memolookups += count ;
+   }
+   void densestep(const state *above, const state *here,
+                  const state *below, state *out, int count) {
+      const state *t = dense ;
+      int b = densebits ;
+      if (densevn) {
+         for (int i=0; i<count; i++)
+            out[i] = t[((((above[i] << b | here[i-1]) << b | here[i])
+                          << b | here[i+1]) << b) | below[i]] ;
+      } else {
+         int b3 = 3 * b ;
+         int mask = (1 << (3 * b3)) - 1 ;
+         int index = (above[-1] << (b + b3 + b) | here[-1] << (b + b3)
+                      | below[-1] << b3 | above[0] << (b + b)
+                      | here[0] << b | below[0]) ;
+         for (int i=0; i<count; i++) {
+            index = ((index << b3) | above[i+1] << (b + b)
+                     | here[i+1] << b | below[i+1]) & mask ;
+            out[i] = t[index] ;
+         }
+      }
+   }
+/*
+ *   Rules whose neighborhood reaches further than one cell call
+ *   setrange() from setrule() and override stepblock() to step a
+ *   square of states gens generations; the cells at least margin in
+ *   from the edge must be right, the rest don't matter.
+ */
+   int setrange(int range) ;
+   virtual void stepblock(state *cells, int width, int gens, int margin) ;
+
 private:
 /*
  *   Some globals representing our universe.  The root is the
@@ -130,6 +297,13 @@ private:
    int okaytogc ;
    g_uintptr_t totalthings ;
    ghnode *ghnodeblocks ;
+   blockpool ghblocks ;
+   int hugepages ;
+   static int usehugepages ;
+   int widedepth ; // compute results of ghnodes this deep and less directly
+   int rangebits ; // log2 of the neighborhood reach (see setrange)
+   state *blockcells ; // for widestep() when wider than MAXBLOCK
+   static int leafsize ;
    bigint population ;
    bigint setincrement ;
    bigint pow2step ; // greatest power of two in increment
@@ -169,6 +343,9 @@ private:
    ghnode *dorecurs(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) ;
    ghnode *dorecurs_half(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) ;
    ghleaf *dorecurs_ghleaf(ghleaf *n, ghleaf *ne, ghleaf *t, ghleaf *e) ;
+   void unpackblock(ghnode *n, int depth, state *cells, int stride) ;
+   ghnode *packblock(const state *cells, int depth, int stride) ;
+   ghnode *widestep(ghnode *n, int depth) ;
    ghnode *newghnode() ;
    ghleaf *newghleaf() ;
    ghnode *newclearedghnode() ;
@@ -178,6 +355,13 @@ private:
    ghnode *zeroghnode(int depth) ;
    ghnode *pushroot(ghnode *n) ;
    ghnode *gsetbit(ghnode *n, int x, int y, int newstate, int depth) ;
+   ghnode *setrect(ghnode *n, int x0, int y0, int x1, int y1,
+                   const state *cells, int left, int top, int stride,
+                   int depth) ;
+   void growroot(int x, int y) ;
+   bool visitband(vector<vector<pair<ghnode *, long long> > > &bands, int depth,
+                  long long top, long long x0, long long y0, long long x1,
+                  long long y1, cellrow &row) ;
    int getbit(ghnode *n, int x, int y, int depth) ;
    int nextbit(ghnode *n, int x, int y, int depth, int &v) ;
    ghnode *hashpattern(ghnode *root, int depth) ;
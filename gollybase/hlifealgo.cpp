@@ -18,12 +18,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <iostream>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#ifdef _WIN32
+#ifdef COMPACTNODES
+#include <windows.h>
+#endif
+#else
+#include <sys/mman.h>
+#endif
 using namespace std ;
 /*
  *   Power of two hash sizes work fine.
  */
 #ifdef PRIMEMOD
 #define HASHMOD(a) ((a)%hashprime)
+#define TABMOD(a,size) ((a)%(size))
+#define TABNEXT(i,size) ((i)+1 == (size) ? 0 : (i)+1)
 static g_uintptr_t nexthashsize(g_uintptr_t i) {
    g_uintptr_t j ;
    i |= 1 ;
@@ -37,6 +53,8 @@ static g_uintptr_t nexthashsize(g_uintptr_t i) {
 }
 #else
 #define HASHMOD(a) ((a)&(hashmask))
+#define TABMOD(a,size) ((a)&((size)-1))
+#define TABNEXT(i,size) (((i)+1)&((size)-1))
 static g_uintptr_t nexthashsize(g_uintptr_t i) {
    while ((i & (i - 1)))
       i += (i & (1 + ~i)) ; // i & - i is more idiomatic but generates warning
@@ -48,6 +66,14 @@ static g_uintptr_t nexthashsize(g_uintptr_t i) {
  *   unsigned shorts; this is so we can directly index into these arrays.
  */
 static unsigned char shortpop[65536] ;
+typedef unsigned long long leafbits ;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SLICEAVX2
+#include <immintrin.h>
+#endif
+#ifdef COMPACTNODES
+static bigint leafpops[65] ; // compact leaves only keep a short count
+#endif
 /*
  *   The cached result of an 8-square is a new 4-square representing
  *   two generations into the future.  This subroutine calculates that
@@ -81,41 +107,483 @@ static unsigned char shortpop[65536] ;
        ((t00) << 15) | ((t01) << 13) | (((t02) << 11) & 0x1000) | \
        (((t10) << 7) & 0x880) | ((t11) << 5) | (((t12) << 3) & 0x110) | \
        (((t20) >> 1) & 0x8) | ((t21) >> 3) | ((t22) >> 5)
-void hlifealgo::leafres(leaf *n) {
+/*
+ *   For totalistic rules on the Moore neighborhood we can also step
+ *   the whole 8-square at once, bit-sliced in a 64-bit word (row 0 in
+ *   the top byte, column 0 in the top bit of each byte).  The eight
+ *   neighbor words are summed with full adders into a four-bit count
+ *   per cell; then for each count the rule cares about we pick out the
+ *   cells with that count, and keep the ones the rule's birth and
+ *   survival masks (each all ones or all zeros) say to.  Cells on the
+ *   edge get a wrong answer, but we only keep the middle.
+ *
+ *   One leaf at a time this is no faster than the table, but it uses
+ *   no memory, so with AVX2 we can do four leaves at once for a good
+ *   deal less than four table lookups.  That's what leafbatch() uses
+ *   when it has a lot of leaves to do, and what dorecurs_leaf_sliced()
+ *   uses in place of looking up intermediate leaves; everything else
+ *   goes through the table.
+ */
+#define NOTWEST 0x7f7f7f7f7f7f7f7fULL
+#define NOTEAST 0xfefefefefefefefeULL
+static inline leafbits slicerule(leafbits b, leafbits n, leafbits s,
+                                 leafbits w, leafbits e, leafbits nw,
+                                 leafbits ne, leafbits sw, leafbits se,
+                                 const unsigned char *counts, int ncounts,
+                                 const leafbits *bmask, const leafbits *smask) {
+   leafbits s1 = n ^ s ^ w, c1 = (n & s) | (w & (n ^ s)),
+            s2 = e ^ nw ^ ne, c2 = (e & nw) | (ne & (e ^ nw)),
+            s3 = sw ^ se, c3 = sw & se ;
+   leafbits ones = s1 ^ s2 ^ s3, c4 = (s1 & s2) | (s3 & (s1 ^ s2)) ;
+   leafbits t = c1 ^ c2 ^ c3, u = (c1 & c2) | (c3 & (c1 ^ c2)) ;
+   leafbits twos = t ^ c4, v = t & c4 ;
+   leafbits fours = u ^ v, eights = u & v ;
+   leafbits low[4] ; // the four combinations of the ones and twos bits
+   low[0] = ~(ones | twos) ;
+   low[1] = ones & ~twos ;
+   low[2] = twos & ~ones ;
+   low[3] = ones & twos ;
+   leafbits nb = ~b, r = 0 ;
+   for (int i=0; i<ncounts; i++) {
+      int k = counts[i] ;
+      leafbits eq ;
+      if (k == 8)
+         eq = eights ;
+      else if (k & 4)
+         eq = low[k & 3] & fours ;
+      else
+         eq = low[k] & ~(fours | eights) ;
+      r |= eq & ((b & smask[k]) | (nb & bmask[k])) ;
+   }
+   return r ;
+}
+static inline leafbits slicestep(leafbits b, const unsigned char *counts,
+                                 int ncounts, const leafbits *bmask,
+                                 const leafbits *smask) {
+   leafbits n = b >> 8, s = b << 8 ;
+   return slicerule(b, n, s, (b >> 1) & NOTWEST, (b << 1) & NOTEAST,
+                    (n >> 1) & NOTWEST, (n << 1) & NOTEAST,
+                    (s >> 1) & NOTWEST, (s << 1) & NOTEAST,
+                    counts, ncounts, bmask, smask) ;
+}
+#ifdef SLICEAVX2
+/*
+ *   The same, four leaves at a time.
+ */
+#define AND4 _mm256_and_si256
+#define OR4 _mm256_or_si256
+#define XOR4 _mm256_xor_si256
+__attribute__((target("avx2")))
+static inline __m256i slicestep4(__m256i b, const unsigned char *counts,
+                                 int ncounts, const leafbits *bmask,
+                                 const leafbits *smask) {
+   const __m256i notw = _mm256_set1_epi64x((long long)NOTWEST),
+                 note = _mm256_set1_epi64x((long long)NOTEAST) ;
+   __m256i n = _mm256_srli_epi64(b, 8), s = _mm256_slli_epi64(b, 8),
+           w = AND4(_mm256_srli_epi64(b, 1), notw),
+           e = AND4(_mm256_slli_epi64(b, 1), note),
+           nw = AND4(_mm256_srli_epi64(n, 1), notw),
+           ne = AND4(_mm256_slli_epi64(n, 1), note),
+           sw = AND4(_mm256_srli_epi64(s, 1), notw),
+           se = AND4(_mm256_slli_epi64(s, 1), note) ;
+   __m256i s1 = XOR4(XOR4(n, s), w), c1 = OR4(AND4(n, s), AND4(w, XOR4(n, s))),
+           s2 = XOR4(XOR4(e, nw), ne), c2 = OR4(AND4(e, nw), AND4(ne, XOR4(e, nw))),
+           s3 = XOR4(sw, se), c3 = AND4(sw, se) ;
+   __m256i ones = XOR4(XOR4(s1, s2), s3),
+           c4 = OR4(AND4(s1, s2), AND4(s3, XOR4(s1, s2))) ;
+   __m256i t = XOR4(XOR4(c1, c2), c3), u = OR4(AND4(c1, c2), AND4(c3, XOR4(c1, c2))) ;
+   __m256i twos = XOR4(t, c4), v = AND4(t, c4) ;
+   __m256i fours = XOR4(u, v), eights = AND4(u, v) ;
+   __m256i low[4] ;
+   low[0] = _mm256_andnot_si256(OR4(ones, twos), _mm256_set1_epi64x(-1)) ;
+   low[1] = _mm256_andnot_si256(twos, ones) ;
+   low[2] = _mm256_andnot_si256(ones, twos) ;
+   low[3] = AND4(ones, twos) ;
+   __m256i r = _mm256_setzero_si256() ;
+   for (int i=0; i<ncounts; i++) {
+      int k = counts[i] ;
+      __m256i eq ;
+      if (k == 8)
+         eq = eights ;
+      else if (k & 4)
+         eq = AND4(low[k & 3], fours) ;
+      else
+         eq = _mm256_andnot_si256(OR4(fours, eights), low[k]) ;
+      __m256i bm = _mm256_set1_epi64x((long long)bmask[k]),
+              sm = _mm256_set1_epi64x((long long)smask[k]) ;
+      r = OR4(r, AND4(eq, OR4(AND4(b, sm), _mm256_andnot_si256(b, bm)))) ;
+   }
+   return r ;
+}
+__attribute__((target("avx2")))
+static int slicedres4(const leafbits *in, leafbits *gen1, leafbits *gen2,
+                      int n, const unsigned char *counts, int ncounts,
+                      const leafbits *bmask, const leafbits *smask) {
+   int i ;
+   for (i=0; i+4<=n; i+=4) {
+      __m256i b = _mm256_loadu_si256((const __m256i *)(in + i)) ;
+      b = slicestep4(b, counts, ncounts, bmask, smask) ;
+      _mm256_storeu_si256((__m256i *)(gen1 + i), b) ;
+      b = slicestep4(b, counts, ncounts, bmask, smask) ;
+      _mm256_storeu_si256((__m256i *)(gen2 + i), b) ;
+   }
+   return i ;
+}
+static int hasavx2() {
+   static int avx2 = -1 ;
+   if (avx2 < 0)
+      avx2 = __builtin_cpu_supports("avx2") ? 1 : 0 ;
+   return avx2 ;
+}
+#else
+static int hasavx2() { return 0 ; }
+#endif
+/*
+ *   Going between four 4-squares and a bit-sliced 8-square.  The
+ *   middle 4-square is rows and columns 2 through 5.
+ */
+static inline leafbits spreadrows(unsigned short q) {
+   leafbits r = ((q & 0xff00) << 8) | (q & 0xff) ;
+   return ((r << 4) | r) & 0x0f0f0f0f ;
+}
+static inline leafbits slicepack(unsigned short nw, unsigned short ne,
+                                 unsigned short sw, unsigned short se) {
+   return (((spreadrows(nw) << 4) | spreadrows(ne)) << 32) |
+          (spreadrows(sw) << 4) | spreadrows(se) ;
+}
+static inline unsigned short slicemiddle(leafbits b) {
+   return (unsigned short)((((b >> 42) & 0xf) << 12) |
+                           (((b >> 34) & 0xf) << 8) |
+                           (((b >> 26) & 0xf) << 4) | ((b >> 18) & 0xf)) ;
+}
+/*
+ *   Step n packed leaves one generation and then another, leaving the
+ *   first generation in gen1 and the second in gen2 (which may be the
+ *   same as in).
+ */
+void hlifealgo::slicedres(const leafbits *in, leafbits *gen1, leafbits *gen2,
+                          int n, int avx2) {
+   int i = 0 ;
+#ifdef SLICEAVX2
+   if (avx2)
+      i = slicedres4(in, gen1, gen2, n, slicecounts, nslicecounts,
+                     birthmask, survivemask) ;
+#endif
+   for (; i<n; i++) {
+      gen1[i] = slicestep(in[i], slicecounts, nslicecounts,
+                          birthmask, survivemask) ;
+      gen2[i] = slicestep(gen1[i], slicecounts, nslicecounts,
+                          birthmask, survivemask) ;
+   }
+}
+/*
+ *   See whether the current rule table is a totalistic Moore rule, and
+ *   if so set up the masks for slicedres().  We read the masks off the
+ *   table for the middle cell of a 3-square, then check them against
+ *   every entry.
+ */
+void hlifealgo::setslicedrule() {
+   static const int around[8] = { 15, 14, 13, 11, 9, 7, 6, 5 } ;
+   int i, k ;
+   slicedrule = 0 ;
+   slicedleaves = 0 ;
+   nslicecounts = 0 ;
+   for (k=0; k<9; k++) {
+      int nbhd = 0 ;
+      for (i=0; i<k; i++)
+         nbhd |= 1 << around[i] ;
+      birthmask[k] = (ruletable[nbhd] & 0x20) ? ~(leafbits)0 : 0 ;
+      survivemask[k] = (ruletable[nbhd | (1 << 10)] & 0x20) ? ~(leafbits)0 : 0 ;
+      if (birthmask[k] | survivemask[k])
+         slicecounts[nslicecounts++] = (unsigned char)k ;
+   }
+   for (i=0; i<65536; i++) {
+      leafbits b = slicepack((unsigned short)i, 0, 0, 0) ;
+      b = slicestep(b, slicecounts, nslicecounts, birthmask, survivemask) ;
+      int v = (int)(((b >> 49) & 0x30) | ((b >> 45) & 0x3)) ;
+      if (v != ruletable[i])
+         return ;
+   }
+   slicedrule = 1 ;
+   slicedleaves = hasavx2() ;
+}
+void hlifealgo::tableres(unsigned short nw, unsigned short ne,
+                         unsigned short sw, unsigned short se,
+                         unsigned short &res1, unsigned short &res2) {
    unsigned short
-   t00 = ruletable[n->nw],
-   t01 = ruletable[((n->nw << 2) & 0xcccc) | ((n->ne >> 2) & 0x3333)],
-   t02 = ruletable[n->ne],
-   t10 = ruletable[((n->nw << 8) & 0xff00) | ((n->sw >> 8) & 0x00ff)],
-   t11 = ruletable[((n->nw << 10) & 0xcc00) | ((n->ne << 6) & 0x3300) |
-                   ((n->sw >> 6) & 0x00cc) | ((n->se >> 10) & 0x0033)],
-   t12 = ruletable[((n->ne << 8) & 0xff00) | ((n->se >> 8) & 0x00ff)],
-   t20 = ruletable[n->sw],
-   t21 = ruletable[((n->sw << 2) & 0xcccc) | ((n->se >> 2) & 0x3333)],
-   t22 = ruletable[n->se] ;
-   n->res1 = combine9(t00,t01,t02,t10,t11,t12,t20,t21,t22) ;
-   n->res2 =
+   t00 = ruletable[nw],
+   t01 = ruletable[((nw << 2) & 0xcccc) | ((ne >> 2) & 0x3333)],
+   t02 = ruletable[ne],
+   t10 = ruletable[((nw << 8) & 0xff00) | ((sw >> 8) & 0x00ff)],
+   t11 = ruletable[((nw << 10) & 0xcc00) | ((ne << 6) & 0x3300) |
+                   ((sw >> 6) & 0x00cc) | ((se >> 10) & 0x0033)],
+   t12 = ruletable[((ne << 8) & 0xff00) | ((se >> 8) & 0x00ff)],
+   t20 = ruletable[sw],
+   t21 = ruletable[((sw << 2) & 0xcccc) | ((se >> 2) & 0x3333)],
+   t22 = ruletable[se] ;
+   res1 = combine9(t00,t01,t02,t10,t11,t12,t20,t21,t22) ;
+   res2 =
    (ruletable[(t00 << 10) | (t01 << 8) | (t10 << 2) | t11] << 10) |
    (ruletable[(t01 << 10) | (t02 << 8) | (t11 << 2) | t12] << 8) |
    (ruletable[(t10 << 10) | (t11 << 8) | (t20 << 2) | t21] << 2) |
     ruletable[(t11 << 10) | (t12 << 8) | (t21 << 2) | t22] ;
+}
+void hlifealgo::leafres(leaf *n) {
+   tableres(n->nw, n->ne, n->sw, n->se, n->res1, n->res2) ;
+   setleafpop(n) ;
+}
+void hlifealgo::setleafpop(leaf *n) {
+#ifdef COMPACTNODES
+   n->leafpop = (unsigned short)(shortpop[n->nw] + shortpop[n->ne] +
+                                 shortpop[n->sw] + shortpop[n->se]) ;
+#else
    n->leafpop = bigint((short)(shortpop[n->nw] + shortpop[n->ne] +
                                shortpop[n->sw] + shortpop[n->se])) ;
+#endif
+}
+/*
+ *   Compute the results of a lot of leaves at once, four at a time if
+ *   we can.
+ */
+void hlifealgo::leafbatch(leaf **leaves, int n) {
+   if (!slicedrule || !hasavx2()) {
+      for (int i=0; i<n; i++)
+         leafres(leaves[i]) ;
+      return ;
+   }
+   const int chunk = 256 ;
+   leafbits in[chunk], gen1[chunk] ;
+   for (int i=0; i<n; i+=chunk) {
+      int m = (n - i < chunk ? n - i : chunk) ;
+      for (int j=0; j<m; j++) {
+         leaf *p = leaves[i+j] ;
+         in[j] = slicepack(p->nw, p->ne, p->sw, p->se) ;
+      }
+      slicedres(in, gen1, in, m, 1) ;
+      for (int j=0; j<m; j++) {
+         leaf *p = leaves[i+j] ;
+         p->res1 = slicemiddle(gen1[j]) ;
+         p->res2 = slicemiddle(in[j]) ;
+         setleafpop(p) ;
+      }
+   }
+}
+/*
+ *   Time the table, the bit-sliced step, and the bit-sliced step four
+ *   leaves at a time on the same random leaves, and check that they
+ *   agree.
+ */
+const char *hlifealgo::benchmarkLeaves(int count) {
+   if (count < 4)
+      count = 4 ;
+   vector<unsigned short> quads(4 * (size_t)count), res(2 * (size_t)count) ;
+   vector<leafbits> in(count), gen1(count), gen2(count) ;
+   unsigned int x = 2463534242U ;
+   for (size_t i=0; i<quads.size(); i++) {
+      x ^= x << 13 ;
+      x ^= x >> 17 ;
+      x ^= x << 5 ;
+      quads[i] = (unsigned short)x ;
+   }
+   double start = gollySecondCount() ;
+   for (int i=0; i<count; i++) {
+      const unsigned short *q = &quads[4 * (size_t)i] ;
+      tableres(q[0], q[1], q[2], q[3], res[2*i], res[2*i+1]) ;
+   }
+   double tablesecs = gollySecondCount() - start ;
+   if (!slicedrule) {
+      sprintf(statusline, "Leaf results: table %g ns; rule %s can't be sliced.",
+              1e9 * tablesecs / count, hliferules.getrule()) ;
+      return statusline ;
+   }
+   double secs[2] ;
+   int mismatches = 0 ;
+   for (int avx2=0; avx2<2; avx2++) {
+      start = gollySecondCount() ;
+      for (int i=0; i<count; i++) {
+         const unsigned short *q = &quads[4 * (size_t)i] ;
+         in[i] = slicepack(q[0], q[1], q[2], q[3]) ;
+      }
+      slicedres(&in[0], &gen1[0], &gen2[0], count, avx2 && hasavx2()) ;
+      secs[avx2] = gollySecondCount() - start ;
+      for (int i=0; i<count; i++)
+         if (slicemiddle(gen1[i]) != res[2*i] ||
+             slicemiddle(gen2[i]) != res[2*i+1])
+            mismatches++ ;
+   }
+   sprintf(statusline,
+     "Leaf results: table %g ns, sliced %g ns, sliced %s %g ns; %d mismatches.",
+           1e9 * tablesecs / count, 1e9 * secs[0] / count,
+           hasavx2() ? "avx2" : "(no avx2)", 1e9 * secs[1] / count,
+           mismatches) ;
+   return statusline ;
 }
 /*
  *   We do now support garbage collection, but there are some routines we
  *   call frequently to help us.
+ *
+ *   The hash multiplies each child by its own large odd constant and
+ *   folds the high half of the sum down onto the low half, so every
+ *   bit of every child reaches the bits we index with; both the
+ *   chained and the open table use it.  Nodes allocated together tend
+ *   to be used together, and with small multipliers they would also
+ *   hash together.  Leaves get a full 64-bit mix of their cells.
+ *
+ *   With STOREHASH defined each node also keeps its hash (in a compact
+ *   build, the low 32 bits of it), so resizing the table and rebuilding
+ *   it in the gc just copy it instead of reading the children again.
  */
-#ifdef PRIMEMOD
-#define node_hash(a,b,c,d) (65537*(g_uintptr_t)(d)+257*(g_uintptr_t)(c)+17*(g_uintptr_t)(b)+5*(g_uintptr_t)(a))
+#if defined(STOREHASH) && defined(COMPACTNODES)
+#define KEPTHASH(h) ((unsigned int)(h))
 #else
-g_uintptr_t node_hash(void *a, void *b, void *c, void *d) {
-   g_uintptr_t r = (65537*(g_uintptr_t)(d)+257*(g_uintptr_t)(c)+17*(g_uintptr_t)(b)+5*(g_uintptr_t)(a)) ;
-   r += (r >> 11) ;
-   return r ;
+#define KEPTHASH(h) ((g_uintptr_t)(h))
+#endif
+static inline g_uintptr_t node_hash(node *a, node *b, node *c, node *d) {
+   unsigned long long h =
+      (unsigned long long)(g_uintptr_t)a * 0x9e3779b97f4a7c15ULL +
+      (unsigned long long)(g_uintptr_t)b * 0xc2b2ae3d27d4eb4fULL +
+      (unsigned long long)(g_uintptr_t)c * 0x165667b19e3779f9ULL +
+      (unsigned long long)(g_uintptr_t)d * 0xd6e8feb86659fd93ULL ;
+   return KEPTHASH(h ^ (h >> 32)) ;
+}
+static inline g_uintptr_t leaf_hash(unsigned short a, unsigned short b,
+                                    unsigned short c, unsigned short d) {
+   unsigned long long h = ((unsigned long long)a << 48) |
+                          ((unsigned long long)b << 32) |
+                          ((unsigned long long)c << 16) | d ;
+   h = (h ^ (h >> 31)) * 0x9e3779b97f4a7c15ULL ;
+   h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ULL ;
+   return KEPTHASH(h ^ (h >> 32)) ;
+}
+#ifdef STOREHASH
+#define sethash(p,h) ((p)->hashv = (h))
+#define nodehashof(n) ((g_uintptr_t)(n)->hashv)
+static inline g_uintptr_t hashof(node *p) {
+   return is_node(p) ? p->hashv : ((leaf *)p)->hashv ;
+}
+#else
+#define sethash(p,h)
+#define nodehashof(n) node_hash((n)->nw, (n)->ne, (n)->sw, (n)->se)
+static inline g_uintptr_t hashof(node *p) {
+   if (is_node(p))
+      return nodehashof(p) ;
+   leaf *l = (leaf *)p ;
+   return leaf_hash(l->nw, l->ne, l->sw, l->se) ;
 }
 #endif
-#define leaf_hash(a,b,c,d) (65537*(d)+257*(c)+17*(b)+5*(a))
+/*
+ *   When evicting results under memory pressure we keep a reference
+ *   bit in the res field, set when a cached result is used and
+ *   cleared by each gc that lets it stay; a res of just the bit means
+ *   the result was evicted.  Anything reading res as a node has to go
+ *   through resof().
+ */
+#ifdef COMPACTNODES
+#define RESREF (0x80000000U)
+static inline node *resof(node *n) {
+   unsigned int v = n->res.v & ~RESREF ;
+   return v ? nodearena + v : 0 ;
+}
+#define resref(n) ((n)->res.v & RESREF)
+#define setresref(n) ((n)->res.v |= RESREF)
+#define clearresref(n) ((n)->res.v &= ~RESREF)
+#define evictres(n) ((n)->res.v = RESREF)
+#else
+#define RESREF (4)
+#define resof(n) ((node *)(~(g_uintptr_t)RESREF & (g_uintptr_t)(n)->res))
+#define resref(n) (RESREF & (g_uintptr_t)(n)->res)
+#define setresref(n) ((n)->res = (node *)(RESREF | (g_uintptr_t)(n)->res))
+#define clearresref(n) ((n)->res = resof(n))
+#define evictres(n) ((n)->res = (node *)RESREF)
+#endif
+/*
+ *   Multithreaded evaluation.  When more than one thread is requested,
+ *   the first-level results of dorecurs() for nodes at depth pardepth
+ *   or deeper are handed out as tasks to a small work-stealing pool:
+ *   each thread pushes the subresults it needs onto its own queue,
+ *   works from the back of that queue itself, and idle threads steal
+ *   from the front of the others.  A thread waiting for its tasks keeps
+ *   running other tasks in the meantime, so nested forks cannot
+ *   deadlock.
+ *
+ *   The hash table is shared; chains are protected by an array of
+ *   locks indexed by bucket.  Every thread keeps its own root stack and
+ *   grabs free nodes a thousand at a time from the shared free list.
+ *   Garbage collection and hash resizing need the whole universe to
+ *   hold still, so a thread wanting one raises the stw flag and stops;
+ *   the others stop at their next newnode() or getres() (safe points,
+ *   since the single-threaded code may gc there too), and the main
+ *   thread then does the work and lets everyone go again.  Only the
+ *   main thread polls, reports status, or runs the gc, which keeps the
+ *   user interface code single-threaded.
+ *
+ *   With the open-addressing table (setOpenHash) no bucket locks are
+ *   needed:  a slot only ever goes from empty to holding a node, which
+ *   we do with a compare-and-swap, and nothing but the gc removes
+ *   nodes.  Growing the table doesn't stop the world either.  The
+ *   thread that notices the table is full allocates one twice the
+ *   size and hangs it off the old one; from then on every lookup
+ *   first copies a chunk of old slots across, marking each one as
+ *   forwarded (the low bit of the node pointer, or FORWARDEDEMPTY for
+ *   an empty slot).  A lookup that reaches a forwarded empty slot
+ *   knows the node isn't in the old table and carries on in the new
+ *   one.  Whoever copies the last chunk makes the new table current;
+ *   old tables may still be in use by other threads, so they are
+ *   only freed at the next point where everyone has stopped.
+ */
+struct hlifetask {
+   node *n, *res ;
+   int depth ;
+   int *pending ;       // decremented (under the pool lock) when done
+} ;
+struct hlifethread {
+   node **stack ;
+   int gsp, stacksize ;
+   node *freenodes ;
+   g_uintptr_t hashadds ; // nodes inserted but not yet added to hashpop
+   int halvesdone ;
+   int gcseen ;
+   int id ;             // 0 is the main thread
+   hperf perf ;
+   std::deque<hlifetask *> tasks ;
+   std::vector<node *> young, remembered ; // for the generational gc
+   g_uintptr_t cachehits, cachemisses, recomputes ;
+} ;
+const int NBUCKETLOCKS = 1024 ;
+struct hlifepool {
+   std::mutex m ;       // protects everything but the bucket locks
+   std::condition_variable cv ;
+   std::vector<std::thread> threads ;
+   hlifethread *ctx ;
+   int nctx ;
+   int running ;        // threads not stopped at a safe point
+   int shutdown, gcwanted, resizewanted ;
+   std::atomic<int> stw ;
+   std::atomic<g_uintptr_t> hashadds ;
+   std::mutex allocm ;  // protects freenodes, nodeblocks, retired
+   std::mutex locks[NBUCKETLOCKS] ;
+   std::atomic<hlifetable *> table ;     // for the open table only
+   std::vector<hlifetable *> retired ;
+} ;
+struct hlifetable {
+   std::atomic<node *> *slots ;
+   g_uintptr_t size ;
+   std::atomic<g_uintptr_t> limit ;
+   std::atomic<hlifetable *> next ;      // the table we are growing into
+   std::atomic<g_uintptr_t> claimed, copied ; // chunks of slots
+} ;
+const g_uintptr_t MIGRATECHUNK = 1024 ;
+#define FORWARDEDEMPTY ((node *)1)
+#define forwarded(p) (1 & (g_uintptr_t)(p))
+#define forwardof(p) ((node *)(1 | (g_uintptr_t)(p)))
+#define unforward(p) ((node *)(~(g_uintptr_t)1 & (g_uintptr_t)(p)))
+static thread_local hlifethread *curthread ;
+int hlifealgo::pardepth = 10 ;
+int hlifealgo::useopenhash = 0 ;
+int hlifealgo::usegengc = 0 ;
+int hlifealgo::useevict = 0 ;
+int hlifealgo::leafsize = 8 ;
+int hlifealgo::usehugepages = 0 ;
 /*
  *   Resize the hash.  The max load factor defined here does not actually
  *   yield the maximum load factor the hash will see, because when we
@@ -141,10 +609,16 @@ void hlifealgo::resize() {
 #endif
    g_uintptr_t i, nhashprime = nexthashsize(2 * hashprime) ;
    node *p, **nhashtab ;
-   if (hashprime > (totalthings >> 2)) {
+   /*
+    *   An open table can't be allowed to fill up, so past this point
+    *   we grow it even if that takes us over the memory limit.
+    */
+   g_uintptr_t hardlimit = hashprime - (hashprime >> 3) ;
+   if (hashprime > (totalthings >> 2) &&
+       (!openhash || hashpop <= hardlimit)) {
       if (alloced > maxmem ||
           nhashprime * sizeof(node *) > (maxmem - alloced)) {
-         hashlimit = G_MAX ;
+         hashlimit = openhash ? hardlimit : G_MAX ;
          return ;
       }
    }
@@ -153,10 +627,14 @@ void hlifealgo::resize() {
      lifestatus(statusline) ;
    }
    nhashtab = (node **)calloc(nhashprime, sizeof(node *)) ;
+   if (nhashtab && hugepages)
+      blockpool::hugehint(nhashtab, nhashprime * sizeof(node *)) ;
+   if (nhashtab == 0 && openhash && hashpop > hardlimit)
+     lifefatal("Out of memory; try reducing the hash memory limit.") ;
    if (nhashtab == 0) {
      lifewarning("Out of memory; running in a somewhat slower mode; "
                  "try reducing the hash memory limit after restarting.") ;
-     hashlimit = G_MAX ;
+     hashlimit = openhash ? hardlimit : G_MAX ;
      return ;
    }
    alloced += sizeof(node *) * (nhashprime - hashprime) ;
@@ -166,16 +644,18 @@ void hlifealgo::resize() {
    hashmask = hashprime - 1 ;
 #endif
    for (i=0; i<ohashprime; i++) {
+      if (openhash) {
+         if ((p=hashtab[i]) != 0) {
+            g_uintptr_t h = HASHMOD(hashof(p)) ;
+            while (nhashtab[h])
+               h = TABNEXT(h, hashprime) ;
+            nhashtab[h] = p ;
+         }
+         continue ;
+      }
       for (p=hashtab[i]; p;) {
          node *np = p->next ;
-         g_uintptr_t h ;
-         if (is_node(p)) {
-            h = node_hash(p->nw, p->ne, p->sw, p->se) ;
-         } else {
-            leaf *l = (leaf *)p ;
-            h = leaf_hash(l->nw, l->ne, l->sw, l->se) ;
-         }
-         h = HASHMOD(h) ;
+         g_uintptr_t h = HASHMOD(hashof(p)) ;
          p->next = nhashtab[h] ;
          nhashtab[h] = p ;
          p = np ;
@@ -189,6 +669,59 @@ void hlifealgo::resize() {
      lifestatus(statusline) ;
    }
 }
+/*
+ *   Describe how well the hash spreads the nodes:  the average number
+ *   of nodes we look at to find one that's there, against what a
+ *   perfectly random hash would give at this load.
+ */
+const char *hlifealgo::hashStats() {
+   g_uintptr_t i, nodes = 0, probes = 0, longest = 0 ;
+   for (i=0; i<hashprime; i++) {
+      node *p = hashtab[i] ;
+      if (p == 0)
+         continue ;
+      if (openhash) {
+         g_uintptr_t j = HASHMOD(hashof(p)) ;
+         g_uintptr_t d = (i >= j ? i - j : i + hashprime - j) + 1 ;
+         probes += d ;
+         if (d > longest)
+            longest = d ;
+         nodes++ ;
+      } else {
+         g_uintptr_t k = 0 ;
+         for (; p; p=p->next)
+            probes += ++k ;
+         if (k > longest)
+            longest = k ;
+         nodes += k ;
+      }
+   }
+   double load = (double)nodes / hashprime ;
+   double ideal = openhash ? 0.5 * (1 + 1 / (1 - load)) : 1 + load / 2 ;
+   sprintf(statusline, "Hash: %" PRIuPTR " nodes in %" PRIuPTR " %s, load %.3g;"
+           " average probe length %.4g (random hash %.4g), longest %" PRIuPTR ".",
+           nodes, hashprime, openhash ? "slots" : "buckets", load,
+           nodes ? (double)probes / nodes : 0.0, ideal, longest) ;
+   return statusline ;
+}
+/*
+ *   Remember new nodes, and nodes given a result, for the generational
+ *   gc.  While threads are running each keeps its own lists.
+ */
+void hlifealgo::noteyoung(node *n) {
+   if (gengc) {
+      if (mtactive)
+         curthread->young.push_back(n) ;
+      else
+         young.push_back(n) ;
+   }
+}
+void hlifealgo::noteres(node *n) {
+   if (mtactive)
+      curthread->remembered.push_back(n) ;
+   else
+      remembered.push_back(n) ;
+}
 /*
  *   These next two routines are (nearly) our only hash table access
  *   routines; we simply look up the passed in information.  If we
@@ -196,10 +729,15 @@ void hlifealgo::resize() {
  *   new node and store it in the hash table, and return that.
  */
 node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
+   if (mtactive)
+      return openhash ? find_node_lf(nw, ne, sw, se) :
+                        find_node_mt(nw, ne, sw, se) ;
+   if (openhash)
+      return find_node_oa(nw, ne, sw, se, node_hash(nw,ne,sw,se)) ;
    node *p ;
-   g_uintptr_t h = node_hash(nw,ne,sw,se) ;
+   g_uintptr_t k = node_hash(nw,ne,sw,se) ;
    node *pred = 0 ;
-   h = HASHMOD(h) ;
+   g_uintptr_t h = HASHMOD(k) ;
    for (p=hashtab[h]; p; p = p->next) { /* make sure to compare nw *first* */
       if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se) {
          if (pred) { /* move this one to the front */
@@ -217,9 +755,11 @@ node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
    p->sw = sw ;
    p->se = se ;
    p->res = 0 ;
+   sethash(p, k) ;
    p->next = hashtab[h] ;
    hashtab[h] = p ;
    hashpop++ ;
+   noteyoung(p) ;
    save(p) ;
    if (hashpop > hashlimit)
       resize() ;
@@ -227,11 +767,16 @@ node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
 }
 leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
                                   unsigned short sw, unsigned short se) {
+   if (mtactive)
+      return openhash ? find_leaf_lf(nw, ne, sw, se) :
+                        find_leaf_mt(nw, ne, sw, se) ;
+   if (openhash)
+      return find_leaf_oa(nw, ne, sw, se) ;
    leaf *p ;
    leaf *pred = 0 ;
-   g_uintptr_t h = leaf_hash(nw, ne, sw, se) ;
-   h = HASHMOD(h) ;
-   for (p=(leaf *)hashtab[h]; p; p = (leaf *)p->next) {
+   g_uintptr_t k = leaf_hash(nw, ne, sw, se) ;
+   g_uintptr_t h = HASHMOD(k) ;
+   for (p=(leaf *)hashtab[h]; p; p = (leaf *)(node *)p->next) {
       if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
           !is_node(p)) {
          if (pred) {
@@ -250,9 +795,75 @@ leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
    p->se = se ;
    leafres(p) ;
    p->isnode = 0 ;
+   sethash(p, k) ;
    p->next = hashtab[h] ;
    hashtab[h] = (node *)p ;
    hashpop++ ;
+   noteyoung((node *)p) ;
+   save((node *)p) ;
+   if (hashpop > hashlimit)
+      resize() ;
+   return p ;
+}
+/*
+ *   The same for the open-addressing table.  We probe linearly from
+ *   the home slot until we find the node or reach an empty slot, so a
+ *   lookup touches consecutive slots rather than following a chain,
+ *   and a hit never writes anything.  Only the gc removes nodes, and
+ *   it either rebuilds the whole table or closes up the gaps left
+ *   by the nodes it takes out, so we need no deleted markers; but that
+ *   also means that if allocating the new node ran the gc we have to
+ *   look for the empty slot again.
+ */
+node *hlifealgo::find_node_oa(node *nw, node *ne, node *sw, node *se,
+                              g_uintptr_t h) {
+   node *p ;
+   g_uintptr_t i ;
+   for (i=HASHMOD(h); (p=hashtab[i]) != 0; i=TABNEXT(i, hashprime))
+      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se)
+         return save(p) ;
+   int gcs = gccount ;
+   p = newnode() ;
+   p->nw = nw ;
+   p->ne = ne ;
+   p->sw = sw ;
+   p->se = se ;
+   p->res = 0 ;
+   sethash(p, h) ;
+   p->next = 0 ;
+   if (gcs != gccount)
+      for (i=HASHMOD(h); hashtab[i]; i=TABNEXT(i, hashprime)) ;
+   hashtab[i] = p ;
+   hashpop++ ;
+   noteyoung(p) ;
+   save(p) ;
+   if (hashpop > hashlimit)
+      resize() ;
+   return p ;
+}
+leaf *hlifealgo::find_leaf_oa(unsigned short nw, unsigned short ne,
+                              unsigned short sw, unsigned short se) {
+   leaf *p ;
+   g_uintptr_t h = leaf_hash(nw, ne, sw, se), i ;
+   for (i=HASHMOD(h); (p=(leaf *)hashtab[i]) != 0; i=TABNEXT(i, hashprime))
+      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+          !is_node(p))
+         return (leaf *)save((node *)p) ;
+   int gcs = gccount ;
+   p = newleaf() ;
+   p->nw = nw ;
+   p->ne = ne ;
+   p->sw = sw ;
+   p->se = se ;
+   leafres(p) ;
+   p->isnode = 0 ;
+   sethash(p, h) ;
+   p->next = 0 ;
+   if (gcs != gccount)
+      for (i=HASHMOD(h); hashtab[i]; i=TABNEXT(i, hashprime)) ;
+   hashtab[i] = (node *)p ;
+   hashpop++ ;
+   noteyoung((node *)p) ;
    save((node *)p) ;
    if (hashpop > hashlimit)
       resize() ;
@@ -267,9 +878,17 @@ leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
  *   stack pointer and garbage collection stuff.
  */
 node *hlifealgo::getres(node *n, int depth) {
-   if (n->res)
-     return n->res ;
-   node *res = 0 ;
+   node *res = resof(n) ;
+   if (res) {
+     if (mtactive) { // pairs with the release below
+       std::atomic_thread_fence(std::memory_order_acquire) ;
+       curthread->cachehits++ ;
+     } else
+       cachehits++ ;
+     if (evictcache && !resref(n))
+       setresref(n) ;
+     return res ;
+   }
    /**
     *   This routine be the only place we assign to res.  We use
     *   the fact that the poll routine is *sticky* to allow us to
@@ -281,28 +900,49 @@ node *hlifealgo::getres(node *n, int depth) {
     *   calls here, one to prevent us going deeper, and another
     *   to prevent us from destroying the cache field.
     */
-   if (poller->poll() || softinterrupt)
+   if ((mtactive ? mtpoll() : poller->poll()) || softinterrupt)
      return zeronode(depth-1) ;
-   int sp = gsp ;
-   if (running_hperf.fastinc(depth, ngens < depth))
+   if (mtactive) {
+     curthread->cachemisses++ ;
+     if (resref(n))
+       curthread->recomputes++ ;
+   } else {
+     cachemisses++ ;
+     if (resref(n))
+       recomputes++ ;
+   }
+   int sp = getsp() ;
+   if (evictcache) // so the gc knows whose results are in use
+     save(n) ;
+   if (mtactive && curthread->id != 0)
+      curthread->perf.fastinc(depth, ngens < depth) ;
+   else if (running_hperf.fastinc(depth, ngens < depth))
       running_hperf.report(inc_hperf, verbose) ;
    depth-- ;
-   if (ngens >= depth) {
+   if (depth + 1 <= widedepth && slicedrule) {
+     res = widestep(n, depth + 1) ;
+   } else if (ngens >= depth) {
      if (is_node(n->nw)) {
-       res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
+       if (mtactive && depth >= pardepth)
+         res = dorecurs_mt(n->nw, n->ne, n->sw, n->se, depth, 0) ;
+       else
+         res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
      } else {
-       res = (node *)dorecurs_leaf((leaf *)n->nw, (leaf *)n->ne,
-                                   (leaf *)n->sw, (leaf *)n->se) ;
+       res = (node *)dorecurs_leaf((leaf *)(node *)n->nw, (leaf *)(node *)n->ne,
+                                   (leaf *)(node *)n->sw, (leaf *)(node *)n->se) ;
      }
    } else {
      if (is_node(n->nw)) {
-       res = dorecurs_half(n->nw, n->ne, n->sw, n->se, depth) ;
+       if (mtactive && depth >= pardepth)
+         res = dorecurs_mt(n->nw, n->ne, n->sw, n->se, depth, 1) ;
+       else
+         res = dorecurs_half(n->nw, n->ne, n->sw, n->se, depth) ;
      } else if (ngens == 0) {
-       res = (node *)dorecurs_leaf_quarter((leaf *)n->nw, (leaf *)n->ne,
-                                           (leaf *)n->sw, (leaf *)n->se) ;
+       res = (node *)dorecurs_leaf_quarter((leaf *)(node *)n->nw, (leaf *)(node *)n->ne,
+                                           (leaf *)(node *)n->sw, (leaf *)(node *)n->se) ;
      } else {
-       res = (node *)dorecurs_leaf_half((leaf *)n->nw, (leaf *)n->ne,
-                                        (leaf *)n->sw, (leaf *)n->se) ;
+       res = (node *)dorecurs_leaf_half((leaf *)(node *)n->nw, (leaf *)(node *)n->ne,
+                                        (leaf *)(node *)n->sw, (leaf *)(node *)n->se) ;
      }
    }
    pop(sp) ;
@@ -310,9 +950,16 @@ node *hlifealgo::getres(node *n, int depth) {
        poller->isInterrupted()) // don't assign this to the cache field!
      res = zeronode(depth) ;
    else {
-     if (ngens < depth && halvesdone < 1000)
+     if (mtactive) {
+       if (ngens < depth)
+         curthread->halvesdone++ ;
+       // make the result visible to other threads before linking it in
+       std::atomic_thread_fence(std::memory_order_release) ;
+     } else if (ngens < depth && halvesdone < 1000)
        halvesdone++ ;
      n->res = res ;
+     if (gengc)
+       noteres(n) ;
    }
    return res ;
 }
@@ -326,6 +973,11 @@ void hlifealgo::setupprefetch(setup_t &su, node *nw, node *ne, node *sw, node *s
    su.prefetch(hashtab + HASHMOD(su.h)) ;
 }
 node *hlifealgo::find_node(setup_t &su) {
+   if (mtactive)
+      return openhash ? find_node_lf(su.nw, su.ne, su.sw, su.se) :
+                        find_node_mt(su.nw, su.ne, su.sw, su.se) ;
+   if (openhash)
+      return find_node_oa(su.nw, su.ne, su.sw, su.se, su.h) ;
    node *p ;
    node *pred = 0 ;
    g_uintptr_t h = HASHMOD(su.h) ;
@@ -346,16 +998,18 @@ node *hlifealgo::find_node(setup_t &su) {
    p->sw = su.sw ;
    p->se = su.se ;
    p->res = 0 ;
+   sethash(p, su.h) ;
    p->next = hashtab[h] ;
    hashtab[h] = p ;
    hashpop++ ;
+   noteyoung(p) ;
    save(p) ;
    if (hashpop > hashlimit)
       resize() ;
    return p ;
 }
 node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
-   int sp = gsp ;
+   int sp = getsp() ;
    setup_t su[5] ;
    setupprefetch(su[2], n->se, ne->sw, t->ne, e->nw) ;
    setupprefetch(su[0], n->ne, ne->nw, n->se, ne->sw) ;
@@ -399,7 +1053,7 @@ node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
  *   then put these together into a new n/2-square.  Simple, eh?
  */
 node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
-   int sp = gsp ;
+   int sp = getsp() ;
    node
    *t11 = getres(find_node(n->se, ne->sw, t->ne, e->nw), depth),
    *t00 = getres(n, depth),
@@ -424,7 +1078,7 @@ node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
  */
 node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
                                node *e, int depth) {
-   int sp = gsp ;
+   int sp = getsp() ;
    node
    *t00 = getres(n, depth),
    *t01 = getres(find_node(n->ne, ne->nw, n->se, ne->sw), depth),
@@ -468,6 +1122,8 @@ node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
  *   save/pop mumbo-jumbo.
  */
 leaf *hlifealgo::dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) {
+   if (slicedleaves)
+      return dorecurs_leaf_sliced(n, ne, t, e, 4) ;
    unsigned short
    t00 = n->res2,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res2,
@@ -489,6 +1145,8 @@ leaf *hlifealgo::dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) {
 #define combine4(t00,t01,t10,t11) (unsigned short)\
 ((((t00)<<10)&0xcc00)|(((t01)<<6)&0x3300)|(((t10)>>6)&0xcc)|(((t11)>>10)&0x33))
 leaf *hlifealgo::dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) {
+   if (slicedleaves)
+      return dorecurs_leaf_sliced(n, ne, t, e, 2) ;
    unsigned short
    t00 = n->res2,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res2,
@@ -509,6 +1167,8 @@ leaf *hlifealgo::dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) {
  */
 leaf *hlifealgo::dorecurs_leaf_quarter(leaf *n, leaf *ne,
                                    leaf *t, leaf *e) {
+   if (slicedleaves)
+      return dorecurs_leaf_sliced(n, ne, t, e, 1) ;
    unsigned short
    t00 = n->res1,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res1,
@@ -524,15 +1184,216 @@ leaf *hlifealgo::dorecurs_leaf_quarter(leaf *n, leaf *ne,
                     combine4(t10, t11, t20, t21),
                     combine4(t11, t12, t21, t22)) ;
 }
+/*
+ *   With a sliced rule and AVX2 it's cheaper to step the intermediate
+ *   leaves of the three routines above than to look them up, so we
+ *   don't build them at all:  we step the five in the middle together
+ *   with slicedres(), and for a full step then the four of the next
+ *   level.  Only the result leaf goes in the hash.  gens is 1, 2 or 4.
+ */
+leaf *hlifealgo::dorecurs_leaf_sliced(leaf *n, leaf *ne, leaf *t, leaf *e,
+                                      int gens) {
+   leafbits in[5], gen1[5], gen2[5] ;
+   in[0] = slicepack(n->ne, ne->nw, n->se, ne->sw) ;
+   in[1] = slicepack(n->sw, n->se, t->nw, t->ne) ;
+   in[2] = slicepack(n->se, ne->sw, t->ne, e->nw) ;
+   in[3] = slicepack(ne->sw, ne->se, e->nw, e->ne) ;
+   in[4] = slicepack(t->ne, e->nw, t->se, e->sw) ;
+   slicedres(in, gen1, gen2, 5, 1) ;
+   const leafbits *g = (gens == 1 ? gen1 : gen2) ;
+   unsigned short
+   t00 = (gens == 1 ? n->res1 : n->res2),
+   t01 = slicemiddle(g[0]),
+   t02 = (gens == 1 ? ne->res1 : ne->res2),
+   t10 = slicemiddle(g[1]),
+   t11 = slicemiddle(g[2]),
+   t12 = slicemiddle(g[3]),
+   t20 = (gens == 1 ? t->res1 : t->res2),
+   t21 = slicemiddle(g[4]),
+   t22 = (gens == 1 ? e->res1 : e->res2) ;
+   if (gens < 4)
+      return find_leaf(combine4(t00, t01, t10, t11),
+                       combine4(t01, t02, t11, t12),
+                       combine4(t10, t11, t20, t21),
+                       combine4(t11, t12, t21, t22)) ;
+   in[0] = slicepack(t00, t01, t10, t11) ;
+   in[1] = slicepack(t01, t02, t11, t12) ;
+   in[2] = slicepack(t10, t11, t20, t21) ;
+   in[3] = slicepack(t11, t12, t21, t22) ;
+   slicedres(in, gen1, gen2, 4, 1) ;
+   return find_leaf(slicemiddle(gen2[0]), slicemiddle(gen2[1]),
+                    slicemiddle(gen2[2]), slicemiddle(gen2[3])) ;
+}
+/*
+ *   Wide leaves.  With setLeafSize(16) or setLeafSize(32) we compute the
+ *   results of 16-squares (or 32-squares) directly:  we unpack their
+ *   leaves into one word per row, and step the rows with the same
+ *   bit-sliced rule as slicestep(), instead of building and hashing all
+ *   the intermediate leaves (and, for 32-squares, 16-squares) along the
+ *   way.  The squares are still made of ordinary 8-square leaves, so
+ *   nothing else (the macrocell writer in particular) needs to know.
+ *   Only rules setslicedrule() accepts can be done this way.
+ *
+ *   In the rows, column 0 is the top bit of a width-bit word.
+ */
+void hlifealgo::widerows(node *n, int depth, int r, int c, int width,
+                         leafbits *rows) {
+   if (depth == 2) {
+      leaf *l = (leaf *)n ;
+      unsigned int top, bot ;
+      unpack8x8(l->nw, l->ne, l->sw, l->se, &top, &bot) ;
+      for (int i=0; i<4; i++) {
+         rows[r+i] |= (leafbits)((top >> (24 - 8 * i)) & 0xff) << (width - 8 - c) ;
+         rows[r+4+i] |= (leafbits)((bot >> (24 - 8 * i)) & 0xff) << (width - 8 - c) ;
+      }
+   } else {
+      int half = 1 << depth ;
+      widerows(n->nw, depth-1, r, c, width, rows) ;
+      widerows(n->ne, depth-1, r, c+half, width, rows) ;
+      widerows(n->sw, depth-1, r+half, c, width, rows) ;
+      widerows(n->se, depth-1, r+half, c+half, width, rows) ;
+   }
+}
+/*
+ *   Make the leaf whose rows start at row r, column c.
+ */
+leaf *hlifealgo::wideleaf(const leafbits *rows, int r, int c, int width) {
+   unsigned short q[4] = { 0, 0, 0, 0 } ;
+   for (int i=0; i<8; i++) {
+      int bits = (int)(rows[r+i] >> (width - 8 - c)) & 0xff ;
+      q[(i >> 2) << 1] |= (unsigned short)((bits >> 4) << (12 - 4 * (i & 3))) ;
+      q[((i >> 2) << 1) + 1] |= (unsigned short)((bits & 0xf) << (12 - 4 * (i & 3))) ;
+   }
+   return find_leaf(q[0], q[1], q[2], q[3]) ;
+}
+/*
+ *   The result of a node at depth 3 (a 16-square, giving a leaf) or 4
+ *   (a 32-square, giving a node of four leaves), 2^ngens generations
+ *   on, or as far as the square allows.
+ */
+node *hlifealgo::widestep(node *n, int depth) {
+   leafbits rows[32] ;
+   int width = 1 << (depth + 1) ;
+   int gens = 1 << (ngens < depth - 1 ? ngens : depth - 1) ;
+   int r, g ;
+   for (r=0; r<width; r++)
+      rows[r] = 0 ;
+   widerows(n, depth, 0, 0, width, rows) ;
+   for (g=0; g<gens; g++) {
+      leafbits above = rows[g] ;
+      for (r=g+1; r+1+g<width; r++) {
+         leafbits b = rows[r], below = rows[r+1] ;
+         rows[r] = slicerule(b, above, below, b >> 1, b << 1,
+                             above >> 1, above << 1, below >> 1, below << 1,
+                             slicecounts, nslicecounts,
+                             birthmask, survivemask) ;
+         above = b ;
+      }
+   }
+   int q = width >> 2 ;
+   if (depth == 3)
+      return (node *)wideleaf(rows, q, q, width) ;
+   int sp = getsp() ;
+   node *nw = save((node *)wideleaf(rows, q, q, width)),
+        *ne = save((node *)wideleaf(rows, q, q+8, width)),
+        *sw = save((node *)wideleaf(rows, q+8, q, width)),
+        *se = save((node *)wideleaf(rows, q+8, q+8, width)) ;
+   n = find_node(nw, ne, sw, se) ;
+   pop(sp) ;
+   return save(n) ;
+}
+/*
+ *   Nodes come in blocks of 1001; the first node of each block links
+ *   the blocks together.  In the compact build the blocks are carved
+ *   out of an arena of address space reserved up front, so that every
+ *   node has a 32-bit index; the pages are only committed as the arena
+ *   fills.  Blocks freed by one universe are reused by the next.
+ *   Otherwise the blocks come from the universe's blockpool, and are
+ *   all freed with it.  With setHugePages, either way, we ask for the
+ *   memory to be backed by huge pages.
+ */
+#ifdef COMPACTNODES
+node *nodearena ;
+static g_uintptr_t arenasize, arenaused, arenacommitted ;
+static node *arenafree ;
+static std::mutex arenalock ;
+const g_uintptr_t ARENACOMMIT = 1 << 22 ; // bytes at a time
+static node *arenablock(int huge) {
+   std::lock_guard<std::mutex> lk(arenalock) ;
+   if (nodearena == 0) {
+      // the largest index must stay below RESREF (and so NODEYOUNG and NODEMARK)
+      for (arenasize = 0x7ffff000; arenasize >= (1 << 20); arenasize >>= 1) {
+#ifdef _WIN32
+         nodearena = (node *)VirtualAlloc(0, arenasize * sizeof(node),
+                                          MEM_RESERVE, PAGE_NOACCESS) ;
+#else
+         nodearena = (node *)mmap(0, arenasize * sizeof(node), PROT_NONE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) ;
+         if (nodearena == (node *)MAP_FAILED)
+            nodearena = 0 ;
+#endif
+         if (nodearena)
+            break ;
+      }
+      if (nodearena == 0)
+         return 0 ;
+      arenaused = 1 ; // index zero is the null node
+   }
+   node *b = arenafree ;
+   if (b) {
+      arenafree = b->next ;
+      memset(b, 0, 1001 * sizeof(node)) ;
+      return b ;
+   }
+   if (arenaused + 1001 > arenasize)
+      return 0 ;
+   b = nodearena + arenaused ;
+   arenaused += 1001 ;
+   g_uintptr_t need = arenaused * sizeof(node) ;
+   if (need > arenacommitted) {
+      g_uintptr_t add = (need - arenacommitted + ARENACOMMIT - 1) /
+                                                 ARENACOMMIT * ARENACOMMIT ;
+      if (arenacommitted + add > arenasize * sizeof(node))
+         add = arenasize * sizeof(node) - arenacommitted ;
+      char *base = (char *)nodearena + arenacommitted ;
+#ifdef _WIN32
+      if (VirtualAlloc(base, add, MEM_COMMIT, PAGE_READWRITE) == 0) {
+#else
+      if (mprotect(base, add, PROT_READ | PROT_WRITE) != 0) {
+#endif
+         arenaused -= 1001 ;
+         return 0 ;
+      }
+      if (huge)
+         blockpool::hugehint(base, add) ;
+      arenacommitted += add ;
+   }
+   return b ;
+}
+static void freeblock(node *b) {
+   std::lock_guard<std::mutex> lk(arenalock) ;
+   b->next = arenafree ;
+   arenafree = b ;
+}
+node *hlifealgo::newblock() {
+   return arenablock(hugepages) ;
+}
+#else
+node *hlifealgo::newblock() {
+   return (node *)blocks.alloc(1001 * sizeof(node)) ;
+}
+#endif
 /*
  *   We keep free nodes in a linked list for allocation, and we allocate
  *   them 1000 at a time.
  */
 node *hlifealgo::newnode() {
+   if (mtactive)
+      return newnode_mt() ;
    node *r ;
    if (freenodes == 0) {
       int i ;
-      freenodes = (node *)calloc(1001, sizeof(node)) ;
+      freenodes = newblock() ;
       if (freenodes == 0)
          lifefatal("Out of memory; try reducing the hash memory limit.") ;
       alloced += 1001 * sizeof(node) ;
@@ -546,7 +1407,7 @@ node *hlifealgo::newnode() {
    }
    if (freenodes->next == 0 && alloced + 1000 * sizeof(node) > maxmem &&
        okaytogc) {
-      do_gc(0) ;
+      collect() ;
    }
    r = freenodes ;
    freenodes = freenodes->next ;
@@ -557,7 +1418,9 @@ node *hlifealgo::newnode() {
  */
 leaf *hlifealgo::newleaf() {
    leaf *r = (leaf *)newnode() ;
+#ifndef COMPACTNODES
    new(&(r->leafpop))bigint ;
+#endif
    return r ;
 }
 /*
@@ -569,7 +1432,657 @@ node *hlifealgo::newclearednode() {
 }
 leaf *hlifealgo::newclearedleaf() {
    leaf *r = (leaf *)newclearednode() ;
+#ifndef COMPACTNODES
    new(&(r->leafpop))bigint ;
+#endif
+   return r ;
+}
+void hlifealgo::setNumThreads(int n) {
+   poller->bailIfCalculating() ;
+   lifealgo::setNumThreads(n) ;
+   killthreads() ; // the pool is rebuilt on the next step
+}
+void hlifealgo::killthreads() {
+   if (pool == 0)
+      return ;
+   {
+      std::lock_guard<std::mutex> lk(pool->m) ;
+      pool->shutdown = 1 ;
+      pool->cv.notify_all() ;
+   }
+   for (unsigned int i=0; i<pool->threads.size(); i++)
+      pool->threads[i].join() ;
+   for (int i=0; i<pool->nctx; i++)
+      free(pool->ctx[i].stack) ;
+   delete [] pool->ctx ;
+   delete pool ;
+   pool = 0 ;
+}
+void hlifealgo::startthreads() {
+   if (pool == 0) {
+      pool = new hlifepool ;
+      pool->nctx = numthreads ;
+      pool->ctx = new hlifethread[numthreads] ;
+      for (int i=0; i<numthreads; i++) {
+         hlifethread &t = pool->ctx[i] ;
+         t.stack = 0 ;
+         t.gsp = t.stacksize = 0 ;
+         t.freenodes = 0 ;
+         t.hashadds = 0 ;
+         t.cachehits = t.cachemisses = t.recomputes = 0 ;
+         t.halvesdone = 0 ;
+         t.gcseen = -1 ;
+         t.id = i ;
+         t.perf.clear() ;
+      }
+      pool->running = 0 ;
+      pool->shutdown = pool->gcwanted = pool->resizewanted = 0 ;
+      pool->stw = 0 ;
+      pool->hashadds = 0 ;
+      pool->table = 0 ;
+      for (int i=1; i<numthreads; i++)
+         pool->threads.push_back(std::thread(&hlifealgo::workerloop, this, i)) ;
+   }
+   if (openhash) {
+      hlifetable *t = new hlifetable ;
+      t->slots = (std::atomic<node *> *)hashtab ;
+      t->size = hashprime ;
+      t->limit = hashlimit ;
+      t->next = 0 ;
+      t->claimed = t->copied = 0 ;
+      pool->table = t ;
+   }
+   pool->running = 1 ;
+   curthread = pool->ctx ;
+   mtactive = 1 ;
+}
+/*
+ *   Fold the per-thread counts back in and return unused free nodes
+ *   to the shared list.  Only called when no other thread is running.
+ */
+void hlifealgo::foldthreads() {
+   hlifepool *p = pool ;
+   for (int i=0; i<p->nctx; i++) {
+      hlifethread &t = p->ctx[i] ;
+      hashpop += t.hashadds ;
+      t.hashadds = 0 ;
+      cachehits += t.cachehits ;
+      cachemisses += t.cachemisses ;
+      recomputes += t.recomputes ;
+      t.cachehits = t.cachemisses = t.recomputes = 0 ;
+      young.insert(young.end(), t.young.begin(), t.young.end()) ;
+      t.young.clear() ;
+      remembered.insert(remembered.end(), t.remembered.begin(),
+                        t.remembered.end()) ;
+      t.remembered.clear() ;
+      if (t.freenodes) {
+         node *q = t.freenodes ;
+         while (q->next)
+            q = q->next ;
+         q->next = freenodes ;
+         freenodes = t.freenodes ;
+         t.freenodes = 0 ;
+      }
+   }
+   p->hashadds = 0 ;
+}
+void hlifealgo::stopthreads() {
+   foldthreads() ;
+   if (openhash) {
+      finishmigration() ;
+      delete pool->table.load() ;
+      pool->table = 0 ;
+   }
+   for (int i=0; i<pool->nctx; i++) {
+      hlifethread &t = pool->ctx[i] ;
+      halvesdone += t.halvesdone ;
+      t.halvesdone = 0 ;
+      t.gsp = 0 ;
+      if (i) {
+         running_hperf.nodesCalculated += t.perf.fastNodeInc ;
+         running_hperf.depthSum += t.perf.depthSum ;
+         running_hperf.halfNodes += t.perf.halfNodes ;
+         t.perf.clear() ;
+      }
+   }
+   if (halvesdone > 1000)
+      halvesdone = 1000 ;
+   pool->running = 0 ;
+   mtactive = 0 ;
+   curthread = 0 ;
+}
+static hlifetask *grabtask(hlifepool *p, int id) {
+   hlifetask *t = 0 ;
+   std::deque<hlifetask *> &mine = p->ctx[id].tasks ;
+   if (!mine.empty()) {
+      t = mine.back() ;
+      mine.pop_back() ;
+      return t ;
+   }
+   for (int i=1; i<p->nctx; i++) {
+      std::deque<hlifetask *> &q = p->ctx[(id + i) % p->nctx].tasks ;
+      if (!q.empty()) {
+         t = q.front() ;
+         q.pop_front() ;
+         return t ;
+      }
+   }
+   return 0 ;
+}
+void hlifealgo::runtask(hlifetask *t) {
+   t->res = getres(t->n, t->depth) ;
+}
+void hlifealgo::workerloop(int id) {
+   hlifepool *p = pool ;
+   curthread = p->ctx + id ;
+   std::unique_lock<std::mutex> lk(p->m) ;
+   while (!p->shutdown) {
+      hlifetask *t = p->stw ? 0 : grabtask(p, id) ;
+      if (t == 0) {
+         p->cv.wait(lk) ;
+         continue ;
+      }
+      p->running++ ;
+      lk.unlock() ;
+      runtask(t) ;
+      lk.lock() ;
+      (*t->pending)-- ;
+      p->running-- ;
+      p->cv.notify_all() ;
+   }
+}
+/*
+ *   Called with the pool lock held when stw is set.  Workers simply
+ *   wait it out; the main thread waits for everyone else to stop and
+ *   then does whatever was asked for.
+ */
+void hlifealgo::parkorrun(std::unique_lock<std::mutex> &lk) {
+   hlifepool *p = pool ;
+   if (curthread->id != 0) {
+      p->running-- ;
+      p->cv.notify_all() ;
+      while (p->stw)
+         p->cv.wait(lk) ;
+      p->running++ ;
+      return ;
+   }
+   while (p->running > 1)
+      p->cv.wait(lk) ;
+   foldthreads() ;
+   if (openhash)
+      finishmigration() ;
+   if (p->gcwanted)
+      collect() ;
+   if (p->resizewanted && hashpop > hashlimit)
+      resize() ;
+   p->gcwanted = p->resizewanted = 0 ;
+   p->stw = 0 ;
+   p->cv.notify_all() ;
+}
+void hlifealgo::safepoint() {
+   if (pool->stw) {
+      std::unique_lock<std::mutex> lk(pool->m) ;
+      if (pool->stw)
+         parkorrun(lk) ;
+   }
+}
+void hlifealgo::requestsafe(int resizing) {
+   std::unique_lock<std::mutex> lk(pool->m) ;
+   if (resizing)
+      pool->resizewanted = 1 ;
+   else
+      pool->gcwanted = 1 ;
+   pool->stw = 1 ;
+   pool->cv.notify_all() ;
+   parkorrun(lk) ;
+}
+int hlifealgo::mtpoll() {
+   safepoint() ;
+   if (curthread->id == 0)
+      return poller->poll() ;
+   return poller->isInterrupted() ;
+}
+/*
+ *   Wait for the tasks we handed out, running any tasks we can find
+ *   while we wait.
+ */
+void hlifealgo::helpwait(int &pending) {
+   hlifepool *p = pool ;
+   hlifethread *me = curthread ;
+   std::unique_lock<std::mutex> lk(p->m) ;
+   while (pending > 0) {
+      if (p->stw) {
+         parkorrun(lk) ;
+         continue ;
+      }
+      hlifetask *t = grabtask(p, me->id) ;
+      if (t) {
+         lk.unlock() ;
+         runtask(t) ;
+         lk.lock() ;
+         (*t->pending)-- ;
+         p->cv.notify_all() ;
+      } else if (me->id == 0) {
+         // keep the user interface alive while the workers finish
+         p->cv.wait_for(lk, std::chrono::milliseconds(10)) ;
+         if (pending > 0 && !p->stw) {
+            lk.unlock() ;
+            poller->reset_countdown() ;
+            poller->poll() ;
+            lk.lock() ;
+         }
+      } else {
+         p->running-- ;
+         p->cv.notify_all() ;
+         p->cv.wait(lk) ;
+         while (p->stw)
+            p->cv.wait(lk) ;
+         p->running++ ;
+      }
+   }
+}
+/*
+ *   Compute res[i] = getres(n[i], depth) for up to nine nodes, in
+ *   parallel where the result isn't already cached.
+ */
+void hlifealgo::getres_mt(node **n, node **res, int cnt, int depth) {
+   hlifetask tasks[9] ;
+   int slot[9], ntasks = 0, pending = 0 ;
+   for (int i=0; i<cnt; i++) {
+      node *r = resof(n[i]) ;
+      if (r) {
+         std::atomic_thread_fence(std::memory_order_acquire) ;
+         curthread->cachehits++ ;
+         if (evictcache && !resref(n[i]))
+            setresref(n[i]) ;
+         res[i] = r ;
+      } else {
+         tasks[ntasks].n = n[i] ;
+         tasks[ntasks].res = 0 ;
+         tasks[ntasks].depth = depth ;
+         tasks[ntasks].pending = &pending ;
+         slot[ntasks++] = i ;
+      }
+   }
+   if (ntasks == 0)
+      return ;
+   if (ntasks > 1) {
+      std::lock_guard<std::mutex> lk(pool->m) ;
+      for (int i=1; i<ntasks; i++)
+         curthread->tasks.push_back(tasks + i) ;
+      pending = ntasks - 1 ;
+      pool->cv.notify_all() ;
+   }
+   runtask(tasks) ;
+   if (ntasks > 1)
+      helpwait(pending) ;
+   for (int i=0; i<ntasks; i++)
+      res[slot[i]] = tasks[i].res ;
+}
+/*
+ *   The same as dorecurs() and dorecurs_half() (for depth > 3), but
+ *   with each stage of subresults computed in parallel.
+ */
+node *hlifealgo::dorecurs_mt(node *n, node *ne, node *t, node *e, int depth,
+                             int half) {
+   int sp = getsp() ;
+   node *s[9], *r[9] ;
+   s[0] = n ;
+   s[1] = find_node(n->ne, ne->nw, n->se, ne->sw) ;
+   s[2] = ne ;
+   s[3] = find_node(n->sw, n->se, t->nw, t->ne) ;
+   s[4] = find_node(n->se, ne->sw, t->ne, e->nw) ;
+   s[5] = find_node(ne->sw, ne->se, e->nw, e->ne) ;
+   s[6] = t ;
+   s[7] = find_node(t->ne, e->nw, t->se, e->sw) ;
+   s[8] = e ;
+   getres_mt(s, r, 9, depth) ;
+   if (half) {
+      n = find_node(find_node(r[0]->se, r[1]->sw, r[3]->ne, r[4]->nw),
+                    find_node(r[1]->se, r[2]->sw, r[4]->ne, r[5]->nw),
+                    find_node(r[3]->se, r[4]->sw, r[6]->ne, r[7]->nw),
+                    find_node(r[4]->se, r[5]->sw, r[7]->ne, r[8]->nw)) ;
+   } else {
+      s[0] = find_node(r[0], r[1], r[3], r[4]) ;
+      s[1] = find_node(r[1], r[2], r[4], r[5]) ;
+      s[2] = find_node(r[3], r[4], r[6], r[7]) ;
+      s[3] = find_node(r[4], r[5], r[7], r[8]) ;
+      getres_mt(s, r, 4, depth) ;
+      n = find_node(r[0], r[1], r[2], r[3]) ;
+   }
+   pop(sp) ;
+   return save(n) ;
+}
+/*
+ *   Count an insertion, asking for a resize when the table gets full.
+ *   The new node must already be saved, since the resize may gc.
+ */
+void hlifealgo::countinsert() {
+   if ((++curthread->hashadds & 63) == 0) {
+      g_uintptr_t pop = hashpop + (pool->hashadds += 64) ;
+      if (openhash) {
+         hlifetable *t = pool->table.load(std::memory_order_acquire) ;
+         if (pop > t->limit && t->next.load() == 0)
+            growtable(t) ;
+      } else if (pop > hashlimit) {
+         requestsafe(1) ;
+      }
+   }
+}
+/*
+ *   Lookups for the multithreaded case.  We never hold a bucket lock
+ *   while allocating, because the allocation may stop for a gc or a
+ *   resize; so on a miss we allocate, then lock and look again in case
+ *   another thread got there first.
+ */
+node *hlifealgo::find_node_mt(node *nw, node *ne, node *sw, node *se) {
+   node *p ;
+   g_uintptr_t k = node_hash(nw,ne,sw,se), h = HASHMOD(k) ;
+   {
+      std::lock_guard<std::mutex> lk(pool->locks[h & (NBUCKETLOCKS-1)]) ;
+      for (p=hashtab[h]; p; p = p->next)
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se)
+            break ;
+   }
+   if (p)
+      return save(p) ;
+   node *r = newnode() ;
+   r->nw = nw ;
+   r->ne = ne ;
+   r->sw = sw ;
+   r->se = se ;
+   r->res = 0 ;
+   sethash(r, k) ;
+   h = HASHMOD(k) ;
+   {
+      std::lock_guard<std::mutex> lk(pool->locks[h & (NBUCKETLOCKS-1)]) ;
+      for (p=hashtab[h]; p; p = p->next)
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se)
+            break ;
+      if (p == 0) {
+         r->next = hashtab[h] ;
+         hashtab[h] = r ;
+      }
+   }
+   if (p) {
+      r->next = curthread->freenodes ;
+      curthread->freenodes = r ;
+      return save(p) ;
+   }
+   noteyoung(r) ;
+   save(r) ;
+   countinsert() ;
+   return r ;
+}
+leaf *hlifealgo::find_leaf_mt(unsigned short nw, unsigned short ne,
+                              unsigned short sw, unsigned short se) {
+   leaf *p ;
+   g_uintptr_t k = leaf_hash(nw, ne, sw, se), h = HASHMOD(k) ;
+   {
+      std::lock_guard<std::mutex> lk(pool->locks[h & (NBUCKETLOCKS-1)]) ;
+      for (p=(leaf *)hashtab[h]; p; p = (leaf *)(node *)p->next)
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+             !is_node(p))
+            break ;
+   }
+   if (p)
+      return (leaf *)save((node *)p) ;
+   leaf *r = newleaf() ;
+   r->nw = nw ;
+   r->ne = ne ;
+   r->sw = sw ;
+   r->se = se ;
+   leafres(r) ;
+   r->isnode = 0 ;
+   sethash(r, k) ;
+   h = HASHMOD(k) ;
+   {
+      std::lock_guard<std::mutex> lk(pool->locks[h & (NBUCKETLOCKS-1)]) ;
+      for (p=(leaf *)hashtab[h]; p; p = (leaf *)(node *)p->next)
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+             !is_node(p))
+            break ;
+      if (p == 0) {
+         r->next = hashtab[h] ;
+         hashtab[h] = (node *)r ;
+      }
+   }
+   if (p) {
+      r->next = curthread->freenodes ;
+      curthread->freenodes = (node *)r ;
+      return (leaf *)save((node *)p) ;
+   }
+   noteyoung((node *)r) ;
+   save((node *)r) ;
+   countinsert() ;
+   return r ;
+}
+/*
+ *   Lookups in the open table while threads are running.  As above we
+ *   allocate only after a miss, and then search again from the current
+ *   table, since the allocation may have stopped for a gc.
+ */
+node *hlifealgo::find_node_lf(node *nw, node *ne, node *sw, node *se) {
+   g_uintptr_t h = node_hash(nw,ne,sw,se) ;
+   node *r = 0 ;
+   hlifetable *t = pool->table.load(std::memory_order_acquire) ;
+   if (t->next.load(std::memory_order_relaxed))
+      helpmigrate(t) ;
+   g_uintptr_t i = TABMOD(h, t->size) ;
+   for (;;) {
+      node *p = t->slots[i].load(std::memory_order_acquire) ;
+      if (p == 0) {
+         if (r == 0) {
+            r = newnode() ;
+            r->nw = nw ;
+            r->ne = ne ;
+            r->sw = sw ;
+            r->se = se ;
+            r->res = 0 ;
+            sethash(r, h) ;
+            r->next = 0 ;
+            t = pool->table.load(std::memory_order_acquire) ;
+            i = TABMOD(h, t->size) ;
+         } else if (t->slots[i].compare_exchange_strong(p, r)) {
+            noteyoung(r) ;
+            save(r) ;
+            countinsert() ;
+            return r ;
+         }
+      } else if (p == FORWARDEDEMPTY) {
+         t = t->next.load(std::memory_order_acquire) ;
+         i = TABMOD(h, t->size) ;
+      } else {
+         p = unforward(p) ;
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se) {
+            if (r) {
+               r->next = curthread->freenodes ;
+               curthread->freenodes = r ;
+            }
+            return save(p) ;
+         }
+         i = TABNEXT(i, t->size) ;
+      }
+   }
+}
+leaf *hlifealgo::find_leaf_lf(unsigned short nw, unsigned short ne,
+                              unsigned short sw, unsigned short se) {
+   g_uintptr_t h = leaf_hash(nw, ne, sw, se) ;
+   leaf *r = 0 ;
+   hlifetable *t = pool->table.load(std::memory_order_acquire) ;
+   if (t->next.load(std::memory_order_relaxed))
+      helpmigrate(t) ;
+   g_uintptr_t i = TABMOD(h, t->size) ;
+   for (;;) {
+      node *p = t->slots[i].load(std::memory_order_acquire) ;
+      if (p == 0) {
+         if (r == 0) {
+            r = newleaf() ;
+            r->nw = nw ;
+            r->ne = ne ;
+            r->sw = sw ;
+            r->se = se ;
+            leafres(r) ;
+            r->isnode = 0 ;
+            sethash(r, h) ;
+            r->next = 0 ;
+            t = pool->table.load(std::memory_order_acquire) ;
+            i = TABMOD(h, t->size) ;
+         } else if (t->slots[i].compare_exchange_strong(p, (node *)r)) {
+            noteyoung((node *)r) ;
+            save((node *)r) ;
+            countinsert() ;
+            return r ;
+         }
+      } else if (p == FORWARDEDEMPTY) {
+         t = t->next.load(std::memory_order_acquire) ;
+         i = TABMOD(h, t->size) ;
+      } else {
+         leaf *l = (leaf *)unforward(p) ;
+         if (nw == l->nw && ne == l->ne && sw == l->sw && se == l->se &&
+             !is_node(l)) {
+            if (r) {
+               r->next = curthread->freenodes ;
+               curthread->freenodes = (node *)r ;
+            }
+            return (leaf *)save((node *)l) ;
+         }
+         i = TABNEXT(i, t->size) ;
+      }
+   }
+}
+/*
+ *   Start growing the open table.  This follows resize(), except that
+ *   we can't gc first, and we don't report progress from here since
+ *   we may not be on the main thread.
+ */
+void hlifealgo::growtable(hlifetable *t) {
+   std::lock_guard<std::mutex> lk(pool->allocm) ;
+   if (t->next.load() || pool->table.load() != t)
+      return ;
+   g_uintptr_t nsize = nexthashsize(2 * t->size) ;
+   g_uintptr_t hardlimit = t->size - (t->size >> 3) ;
+   g_uintptr_t pop = hashpop + pool->hashadds ;
+   if (t->size > (totalthings >> 2) && pop <= hardlimit &&
+       (alloced > maxmem || nsize * sizeof(node *) > (maxmem - alloced))) {
+      t->limit = hardlimit ;
+      return ;
+   }
+   hlifetable *nt = new hlifetable ;
+   nt->slots = (std::atomic<node *> *)calloc(nsize, sizeof(node *)) ;
+   if (nt->slots && hugepages)
+      blockpool::hugehint(nt->slots, nsize * sizeof(node *)) ;
+   if (nt->slots == 0) {
+      if (pop > hardlimit)
+         lifefatal("Out of memory; try reducing the hash memory limit.") ;
+      delete nt ;
+      t->limit = hardlimit ;
+      return ;
+   }
+   alloced += nsize * sizeof(node *) ;
+   nt->size = nsize ;
+   nt->limit = (g_uintptr_t)(maxloadfactor * nsize) ;
+   nt->next = 0 ;
+   nt->claimed = nt->copied = 0 ;
+   t->next.store(nt, std::memory_order_release) ;
+}
+/*
+ *   Copy one chunk of the old table into the new one.  The nodes we
+ *   copy can't be in the new table yet (anyone looking for them would
+ *   have found them here), so we just take the first empty slot.
+ */
+void hlifealgo::helpmigrate(hlifetable *t) {
+   hlifetable *nt = t->next.load(std::memory_order_acquire) ;
+   g_uintptr_t nchunks = (t->size + MIGRATECHUNK - 1) / MIGRATECHUNK ;
+   g_uintptr_t c = t->claimed++ ;
+   if (c >= nchunks)
+      return ;
+   g_uintptr_t lo = c * MIGRATECHUNK, hi = lo + MIGRATECHUNK ;
+   if (hi > t->size)
+      hi = t->size ;
+   for (g_uintptr_t i=lo; i<hi; i++) {
+      node *p = 0 ;
+      if (t->slots[i].compare_exchange_strong(p, FORWARDEDEMPTY))
+         continue ;
+      g_uintptr_t j = TABMOD(hashof(p), nt->size) ;
+      for (;;) {
+         node *q = 0 ;
+         if (nt->slots[j].compare_exchange_strong(q, p))
+            break ;
+         j = TABNEXT(j, nt->size) ;
+      }
+      t->slots[i].store(forwardof(p), std::memory_order_release) ;
+   }
+   if (++t->copied == nchunks) {
+      pool->table.store(nt, std::memory_order_release) ;
+      std::lock_guard<std::mutex> lk(pool->allocm) ;
+      pool->retired.push_back(t) ;
+   }
+}
+/*
+ *   With everyone else stopped, finish any growth in progress, free
+ *   the tables we've moved out of, and make the current table the one
+ *   the single-threaded code sees.
+ */
+void hlifealgo::finishmigration() {
+   hlifetable *t ;
+   while ((t = pool->table.load())->next.load())
+      helpmigrate(t) ;
+   for (unsigned int i=0; i<pool->retired.size(); i++) {
+      hlifetable *o = pool->retired[i] ;
+      if ((node **)o->slots != hashtab)
+         free(o->slots) ;
+      alloced -= o->size * sizeof(node *) ;
+      delete o ;
+   }
+   pool->retired.clear() ;
+   if ((node **)t->slots != hashtab) {
+      free(hashtab) ;
+      hashtab = (node **)t->slots ;
+   }
+   hashprime = t->size ;
+#ifndef PRIMEMOD
+   hashmask = hashprime - 1 ;
+#endif
+   hashlimit = t->limit ;
+}
+/*
+ *   Each thread takes free nodes from the shared list a thousand at a
+ *   time.  As in newnode(), when we run out and are at the memory
+ *   limit we gc; if that didn't find anything we allocate anyway.
+ */
+node *hlifealgo::newnode_mt() {
+   hlifethread *me = curthread ;
+   safepoint() ;
+   while (me->freenodes == 0) {
+      std::unique_lock<std::mutex> lk(pool->allocm) ;
+      if (freenodes) {
+         node *q = freenodes ;
+         for (int i=1; i<1000 && q->next; i++)
+            q = q->next ;
+         me->freenodes = freenodes ;
+         freenodes = q->next ;
+         q->next = 0 ;
+      } else if (alloced + 1001 * sizeof(node) > maxmem && okaytogc &&
+                 me->gcseen != gccount) {
+         lk.unlock() ;
+         requestsafe(0) ;
+         me->gcseen = gccount ;
+      } else {
+         node *b = newblock() ;
+         if (b == 0)
+            lifefatal("Out of memory; try reducing the hash memory limit.") ;
+         alloced += 1001 * sizeof(node) ;
+         b->next = nodeblocks ;
+         nodeblocks = b ;
+         for (int i=1; i<1000; i++)
+            b[i].next = b + i + 1 ;
+         me->freenodes = b + 1 ;
+         totalthings += 1000 ;
+      }
+   }
+   node *r = me->freenodes ;
+   me->freenodes = r->next ;
    return r ;
 }
 hlifealgo::hlifealgo() {
@@ -593,6 +2106,18 @@ hlifealgo::hlifealgo() {
    if (hashtab == 0)
      lifefatal("Out of memory (1).") ;
    alloced = hashprime * sizeof(node *) ;
+#ifdef COMPACTNODES
+   openhash = 1 ; // we need the next field for other things
+   if (leafpops[1] == 0)
+      for (i=1; i<65; i++)
+         leafpops[i] = i ;
+#else
+   openhash = useopenhash ;
+#endif
+   hugepages = usehugepages ;
+#ifndef COMPACTNODES
+   blocks.usehugepages(hugepages) ;
+#endif
    ngens = 0 ;
    stacksize = 0 ;
    halvesdone = 0 ;
@@ -606,6 +2131,9 @@ hlifealgo::hlifealgo() {
    nodeblocks = 0 ;
    zeronodea = 0 ;
    ruletable = hliferules.rule0 ;
+   slicedrule = 0 ;
+   slicedleaves = 0 ;
+   widedepth = (leafsize >= 32 ? 4 : leafsize >= 16 ? 3 : 0) ;
 /*
  *   We initialize our universe to be a 16-square.  We are in drawing
  *   mode at this point.
@@ -626,21 +2154,34 @@ hlifealgo::hlifealgo() {
    cacheinvalid = 0 ;
    gccount = 0 ;
    gcstep = 0 ;
+   gengc = usegengc ;
+   minorpoor = 0 ;
+   evictcache = useevict ;
+   evictdepth = 8 ;
+   cachehits = cachemisses = recomputes = 0 ;
    running_hperf.clear() ;
    inc_hperf = running_hperf ;
    step_hperf = running_hperf ;
    softinterrupt = 0 ;
+   pool = 0 ;
+   mtactive = 0 ;
 }
 /**
  *   Destructor frees memory.
  */
 hlifealgo::~hlifealgo() {
+   killthreads() ;
    free(hashtab) ;
+#ifdef COMPACTNODES
    while (nodeblocks) {
       node *r = nodeblocks ;
       nodeblocks = nodeblocks->next ;
-      free(r) ;
+      freeblock(r) ;
    }
+#else
+   nodeblocks = 0 ;
+   blocks.clear() ;
+#endif
    if (zeronodea)
       free(zeronodea) ;
    if (stack)
@@ -658,6 +2199,38 @@ void hlifealgo::setIncrement(bigint inc) {
       softinterrupt = 1 ;
    increment = inc ;
 }
+/**
+ *   Bring ngens, pow2step and nonpow2 up to date with the increment,
+ *   clearing the results that no longer agree (see new_ngens).
+ */
+void hlifealgo::takeincrement() {
+   int cleareddownto = 1000000000 ;
+   while (increment != setincrement) {
+      bigint pendingincrement = increment ;
+      int newpow2 = 0 ;
+      bigint t = pendingincrement ;
+      while (t > 0 && t.even()) {
+         newpow2++ ;
+         t.div2() ;
+      }
+      nonpow2 = t.low31() ;
+      if (t != nonpow2)
+         lifefatal("bad increment") ;
+      int downto = newpow2 ;
+      if (ngens < newpow2)
+         downto = ngens ;
+      if (newpow2 != ngens && cleareddownto > downto) {
+         new_ngens(newpow2) ;
+         cleareddownto = downto ;
+      } else {
+         ngens = newpow2 ;
+      }
+      setincrement = pendingincrement ;
+      pow2step = 1 ;
+      while (newpow2--)
+         pow2step += pow2step ;
+   }
+}
 /**
  *   Do a step.
  */
@@ -667,33 +2240,8 @@ void hlifealgo::step() {
    // doing the hashtable sweep; if that happens, we may need to sweep
    // again.
    while (1) {
-      int cleareddownto = 1000000000 ;
       softinterrupt = 0 ;
-      while (increment != setincrement) {
-         bigint pendingincrement = increment ;
-         int newpow2 = 0 ;
-         bigint t = pendingincrement ;
-         while (t > 0 && t.even()) {
-            newpow2++ ;
-            t.div2() ;
-         }
-         nonpow2 = t.low31() ;
-         if (t != nonpow2)
-            lifefatal("bad increment") ;
-         int downto = newpow2 ;
-         if (ngens < newpow2)
-            downto = ngens ;
-         if (newpow2 != ngens && cleareddownto > downto) {
-            new_ngens(newpow2) ;
-            cleareddownto = downto ;
-         } else {
-            ngens = newpow2 ;
-         }
-         setincrement = pendingincrement ;
-         pow2step = 1 ;
-         while (newpow2--)
-            pow2step += pow2step ;
-      }
+      takeincrement() ;
       gcstep = 0 ;
       running_hperf.genval = generation.todouble() ;
       for (int i=0; i<nonpow2; i++) {
@@ -889,7 +2437,7 @@ node *hlifealgo::gsetbit(node *n, int x, int y, int newstate, int depth) {
          wh = 1 << (depth - 1) ;
       }
       depth-- ;
-      node **nptr ;
+      noderef *nptr ;
       if (depth+1 == this->depth || depth < 31) {
          if (x < 0) {
             if (y < 0)
@@ -924,10 +2472,10 @@ node *hlifealgo::gsetbit(node *n, int x, int y, int newstate, int depth) {
       node *s = gsetbit(*nptr, (x & (w - 1)) - wh,
                                (y & (w - 1)) - wh, newstate, depth) ;
       if (hashed) {
-         node *nw = (nptr == &(n->nw) ? s : n->nw) ;
-         node *sw = (nptr == &(n->sw) ? s : n->sw) ;
-         node *ne = (nptr == &(n->ne) ? s : n->ne) ;
-         node *se = (nptr == &(n->se) ? s : n->se) ;
+         node *nw = (nptr == &(n->nw) ? s : (node *)n->nw) ;
+         node *sw = (nptr == &(n->sw) ? s : (node *)n->sw) ;
+         node *ne = (nptr == &(n->ne) ? s : (node *)n->ne) ;
+         node *se = (nptr == &(n->se) ? s : (node *)n->se) ;
          n = save(find_node(nw, ne, sw, se)) ;
       } else {
          *nptr = s ;
@@ -1050,6 +2598,132 @@ int hlifealgo::nextbit(node *n, int x, int y, int depth) {
       return -1 ;
    }
 }
+/*
+ *   Set the live cells of a block of states under n, visiting each
+ *   leaf once rather than walking down to it for every cell.  As in
+ *   gsetbit, coordinates are relative to the center of n with y up;
+ *   the block has been clipped to x0..x1-1 by y0..y1-1, and the cell
+ *   at x,y is cells[(top - y) * stride + x - left].  In an unhashed
+ *   universe n can be null, and we only allocate where cells are set;
+ *   in a hashed one we build new nodes bottom up.
+ */
+node *hlifealgo::setrect(node *n, int x0, int y0, int x1, int y1,
+                         const unsigned char *cells, int left, int top,
+                         int stride, int depth) {
+   if (depth == 2) {
+      unsigned short q[4] = { 0, 0, 0, 0 } ;   // nw, ne, sw, se
+      for (int y=y0; y<y1; y++) {
+         const unsigned char *row = cells + (size_t)(top - y) * stride ;
+         for (int x=x0; x<x1; x++)
+            if (row[x - left])
+               q[(x >= 0) + 2 * (y < 0)] |= 1 << (3 - (x & 3) + 4 * (y & 3)) ;
+      }
+      if ((q[0] | q[1] | q[2] | q[3]) == 0)
+         return n ;
+      leaf *l = (leaf *)n ;
+      if (hashed)
+         return save((node *)find_leaf(l->nw | q[0], l->ne | q[1],
+                                       l->sw | q[2], l->se | q[3])) ;
+      if (l == 0)
+         l = newclearedleaf() ;
+      l->nw |= q[0] ;
+      l->ne |= q[1] ;
+      l->sw |= q[2] ;
+      l->se |= q[3] ;
+      return (node *)l ;
+   }
+   int half = 1 << (depth - 1) ;
+   node *c[4] = { 0, 0, 0, 0 } ;   // nw, ne, sw, se
+   if (n) {
+      c[0] = (node *)n->nw ;
+      c[1] = (node *)n->ne ;
+      c[2] = (node *)n->sw ;
+      c[3] = (node *)n->se ;
+   }
+   int sp = gsp ;
+   int changed = 0 ;
+   for (int i=0; i<4; i++) {
+      int cx = (i & 1) ? half : -half ;
+      int cy = (i & 2) ? -half : half ;
+      int qx0 = x0 > cx - half ? x0 : cx - half ;
+      int qx1 = x1 < cx + half ? x1 : cx + half ;
+      int qy0 = y0 > cy - half ? y0 : cy - half ;
+      int qy1 = y1 < cy + half ? y1 : cy + half ;
+      if (qx0 >= qx1 || qy0 >= qy1)
+         continue ;
+      node *s = setrect(c[i], qx0 - cx, qy0 - cy, qx1 - cx, qy1 - cy,
+                        cells, left - cx, top - cy, stride, depth - 1) ;
+      if (s != c[i]) {
+         c[i] = s ;
+         changed = 1 ;
+      }
+   }
+   if (!changed)
+      return n ;
+   if (hashed) {
+      node *r = find_node(c[0], c[1], c[2], c[3]) ;
+      pop(sp) ;
+      return save(r) ;
+   }
+   if (n == 0)
+      n = newclearednode() ;
+   n->nw = c[0] ;
+   n->ne = c[1] ;
+   n->sw = c[2] ;
+   n->se = c[3] ;
+   return n ;
+}
+/*
+ *   Expand the universe until it holds x,y (with y already flipped).
+ */
+void hlifealgo::growroot(int x, int y) {
+   int sx = x ;
+   int sy = y ;
+   if (depth <= 31) {
+     sx >>= depth ;
+     sy >>= depth ;
+   } else {
+     sx >>= 31 ;
+     sy >>= 31 ;
+   }
+   while (sx > 0 || sx < -1 || sy > 0 || sy < -1) {
+      if (hashed) {
+         root = save(pushroot(root)) ;
+         depth++ ;
+      } else {
+         pushroot_1() ;
+      }
+      sx >>= 1 ;
+      sy >>= 1 ;
+   }
+}
+/*
+ *   Set a block of cells through setrect.  Universes too big for int
+ *   coordinates to reach the center of the root are left to setcell.
+ */
+int hlifealgo::setcells(int x, int y, int w, int h, const unsigned char *states) {
+   if (w <= 0 || h <= 0)
+      return 0 ;
+   for (size_t i=0; i<(size_t)w*h; i++)
+      if (states[i] & ~1)
+         return -1 ;
+   if (hashed) {
+      clearstack() ;
+      save(root) ;
+      okaytogc = 1 ;
+   }
+   inGC = 1 ;
+   growroot(x, -y) ;
+   growroot(x + w - 1, -(y + h - 1)) ;
+   if (depth <= 30)
+      root = setrect(root, x, 1 - y - h, x + w, 1 - y, states, x, -y, w, depth) ;
+   if (hashed) {
+      okaytogc = 0 ;
+   }
+   if (depth > 30)
+      return lifealgo::setcells(x, y, w, h, states) ;
+   return 0 ;
+}
 /*
  *   Our nonrecurse top-level bit setting routine simply expands the
  *   universe as necessary to encompass the passed-in coordinates, and
@@ -1067,25 +2741,7 @@ int hlifealgo::setcell(int x, int y, int newstate) {
    }
    inGC = 1 ;
    y = - y ;
-   int sx = x ;
-   int sy = y ;
-   if (depth <= 31) {
-     sx >>= depth ;
-     sy >>= depth ;
-   } else {
-     sx >>= 31 ;
-     sy >>= 31 ;
-   }
-   while (sx > 0 || sx < -1 || sy > 0 || sy < -1) {
-      if (hashed) {
-         root = save(pushroot(root)) ;
-         depth++ ;
-      } else {
-         pushroot_1() ;
-      }
-      sx >>= 1 ;
-      sy >>= 1 ;
-   }
+   growroot(x, y) ;
    root = gsetbit(root, x, y, newstate, depth) ;
    if (hashed) {
       okaytogc = 0 ;
@@ -1119,25 +2775,7 @@ int hlifealgo::getcell(int x, int y) {
 int hlifealgo::nextcell(int x, int y, int &v) {
    v = 1 ;
    y = - y ;
-   int sx = x ;
-   int sy = y ;
-   if (depth <= 31) {
-     sx >>= depth ;
-     sy >>= depth ;
-   } else {
-     sx >>= 31 ;
-     sy >>= 31 ;
-   }
-   while (sx > 0 || sx < -1 || sy > 0 || sy < -1) {
-      if (hashed) {
-         root = save(pushroot(root)) ;
-         depth++ ;
-      } else {
-         pushroot_1() ;
-      }
-      sx >>= 1 ;
-      sy >>= 1 ;
-   }
+   growroot(x, y) ;
    if (depth > 30) {
       struct node tnode = *root ;
       int mdepth = depth ;
@@ -1152,6 +2790,91 @@ int hlifealgo::nextcell(int x, int y, int &v) {
    }
    return nextbit(root, x, y, depth) ;
 }
+/*
+ *   Walk the universe a band of rows at a time.  bands[depth] holds
+ *   the nodes (with their left edges) that lie side by side from row
+ *   top, in order; we gather the live children of their north halves
+ *   into bands[depth-1] and go down, and then do the same for the
+ *   south halves, so each node is visited once and the leaves come
+ *   out row by row.  Empty nodes and those outside x0..x1-1 by
+ *   y0..y1-1 are left out.
+ */
+bool hlifealgo::visitband(vector<vector<pair<node *, long long> > > &bands,
+                          int depth, long long top, long long x0,
+                          long long y0, long long x1, long long y1,
+                          cellrow &row) {
+   vector<pair<node *, long long> > &band = bands[depth] ;
+   if (depth == 2) {
+      for (int r=0; r<8; r++) {
+         long long y = top + r ;
+         if (y < y0 || y >= y1)
+            continue ;
+         int sh = 4 * (3 - (r & 3)) ;
+         for (size_t i=0; i<band.size(); i++) {
+            leaf *l = (leaf *)band[i].first ;
+            int bits = r < 4 ?
+               (((l->nw >> sh) & 15) << 4) | ((l->ne >> sh) & 15) :
+               (((l->sw >> sh) & 15) << 4) | ((l->se >> sh) & 15) ;
+            for (int b=0; bits; b++, bits = (bits << 1) & 255)
+               if ((bits & 128) && band[i].second + b >= x0 &&
+                   band[i].second + b < x1)
+                  row.add((int)(band[i].second + b), (int)y, 1) ;
+         }
+         if (!row.flush())
+            return false ;
+      }
+      return true ;
+   }
+   long long half = 1LL << depth ;
+   node *z = zeronode(depth - 1) ;
+   vector<pair<node *, long long> > &sub = bands[depth - 1] ;
+   for (int south=0; south<2; south++) {
+      long long subtop = top + south * half ;
+      if (subtop + half <= y0 || subtop >= y1)
+         continue ;
+      sub.clear() ;
+      for (size_t i=0; i<band.size(); i++) {
+         node *n = band[i].first ;
+         node *w = south ? n->sw : n->nw ;
+         node *e = south ? n->se : n->ne ;
+         long long x = band[i].second ;
+         if (w != 0 && w != z && x + half > x0 && x < x1)
+            sub.push_back(make_pair(w, x)) ;
+         if (e != 0 && e != z && x + 2 * half > x0 && x + half < x1)
+            sub.push_back(make_pair(e, x + half)) ;
+      }
+      if (!sub.empty() &&
+          !visitband(bands, depth - 1, subtop, x0, y0, x1, y1, row))
+         return false ;
+   }
+   return true ;
+}
+/*
+ *   As in nextcell, only the middle of a universe too big for int
+ *   coordinates is walked.
+ */
+bool hlifealgo::visitcells(int x, int y, int w, int h, cellvisitor &v) {
+   if (w <= 0 || h <= 0 || root == 0 || root == zeronode(depth))
+      return true ;
+   struct node tnode = *root ;
+   node *n = root ;
+   int mdepth = depth ;
+   if (depth > 30) {
+      while (mdepth > 30) {
+         tnode.nw = tnode.nw->se ;
+         tnode.ne = tnode.ne->sw ;
+         tnode.sw = tnode.sw->ne ;
+         tnode.se = tnode.se->nw ;
+         mdepth-- ;
+      }
+      n = &tnode ;
+   }
+   vector<vector<pair<node *, long long> > > bands(mdepth + 1) ;
+   bands[mdepth].push_back(make_pair(n, -(1LL << mdepth))) ;
+   cellrow row(v) ;
+   return visitband(bands, mdepth, 1 - (1LL << mdepth), x, y,
+                    (long long)x + w, (long long)y + h, row) ;
+}
 /*
  *   Canonicalize a universe by filling in the null pointers and then
  *   invoking find_node on each node.  Drops the original universe on
@@ -1217,10 +2940,38 @@ node *hlifealgo::popzeros(node *n) {
  *   (or abusing) the cache (res) field, and the least significant bit of
  *   the hash next field (as a visited bit).
  */
+#ifdef COMPACTNODES
+/*
+ *   In the compact build an index has no spare bits, but the next field
+ *   of a hashed node is otherwise zero, so a mark is just a value no
+ *   free list link can have.  Likewise, rather than marking res, the
+ *   population and writing code treat a nonzero next as visited.
+ */
+#define NODEMARK (0xffffffffU)
+#define marked(n) ((n)->next.v == NODEMARK)
+#define mark(n) ((n)->next.v = NODEMARK)
+#define clearmark(n) ((n)->next.v == NODEMARK ? (n)->next.v = 0 : 0)
+#define clearmarkbit(p) ((node *)(p))
+#define marked2(n) ((n)->next.v != 0)
+#define mark2(n)
+#define clearmark2(n)
+#define NODEYOUNG (0xfffffffeU)
+#define setyoung(n) ((n)->next.v = NODEYOUNG)
+#define unmarkedyoung(n) ((n)->next.v == NODEYOUNG)
+#define isyoung(n) ((n)->next.v >= NODEYOUNG)
+#define clearyoung(n) ((n)->next.v = 0)
+#else
 #define marked(n) (1 & (g_uintptr_t)(n)->next)
 #define mark(n) ((n)->next = (node *)(1 | (g_uintptr_t)(n)->next))
 #define clearmark(n) ((n)->next = (node *)(~1 & (g_uintptr_t)(n)->next))
 #define clearmarkbit(p) ((node *)(~1 & (g_uintptr_t)(p)))
+/*
+ *   The minor gc flags the young nodes with the next bit up.
+ */
+#define setyoung(n) ((n)->next = (node *)(2 | (g_uintptr_t)(n)->next))
+#define unmarkedyoung(n) ((3 & (g_uintptr_t)(n)->next) == 2)
+#define isyoung(n) (2 & (g_uintptr_t)(n)->next)
+#define clearyoung(n) ((n)->next = (node *)(~3 & (g_uintptr_t)(n)->next))
 /*
  *   Sometimes we want to use *res* instead of next to mark.  You cannot
  *   do this to leaves, though.
@@ -1229,11 +2980,13 @@ node *hlifealgo::popzeros(node *n) {
 #define mark2(n) ((n)->res = (node *)(1 | (g_uintptr_t)(n)->res))
 #define mark2v(n,v) ((n)->res = (node *)(v | (g_uintptr_t)(n)->res))
 #define clearmark2(n) ((n)->res = (node *)(~3 & (g_uintptr_t)(n)->res))
+#endif
 void hlifealgo::unhash_node(node *n) {
+   if (openhash) // the open table doesn't use next, so leave it be
+      return ;
    node *p ;
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
+   g_uintptr_t h = HASHMOD(nodehashof(n)) ;
    node *pred = 0 ;
-   h = HASHMOD(h) ;
    for (p=hashtab[h]; (!is_node(p) || !marked2(p)) && p; p = p->next) {
       if (p == n) {
          if (pred)
@@ -1247,10 +3000,11 @@ void hlifealgo::unhash_node(node *n) {
    lifefatal("Didn't find node to unhash") ;
 }
 void hlifealgo::unhash_node2(node *n) {
+   if (openhash)
+      return ;
    node *p ;
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
+   g_uintptr_t h = HASHMOD(nodehashof(n)) ;
    node *pred = 0 ;
-   h = HASHMOD(h) ;
    for (p=hashtab[h]; p; p = p->next) {
       if (p == n) {
          if (pred)
@@ -1264,8 +3018,11 @@ void hlifealgo::unhash_node2(node *n) {
    lifefatal("Didn't find node to unhash 2") ;
 }
 void hlifealgo::rehash_node(node *n) {
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
-   h = HASHMOD(h) ;
+   if (openhash) {
+      n->next = 0 ;
+      return ;
+   }
+   g_uintptr_t h = HASHMOD(nodehashof(n)) ;
    n->next = hashtab[h] ;
    hashtab[h] = n ;
 }
@@ -1273,6 +3030,40 @@ void hlifealgo::rehash_node(node *n) {
  *   This recursive routine calculates the population by hanging the
  *   population on marked nodes.
  */
+#ifdef COMPACTNODES
+/*
+ *   A compact node has no room for a bigint, so we keep the counts in
+ *   a deque (which never moves its elements) and hang the index plus
+ *   one off next.
+ */
+static std::deque<bigint> popcache ;
+const bigint &hlifealgo::calcpop(node *root, int depth) {
+   if (root == zeronode(depth))
+      return bigint::zero ;
+   if (depth == 2)
+      return leafpops[((leaf *)root)->leafpop] ;
+   if (marked2(root))
+      return popcache[nodeval(root->next)-1] ;
+   depth-- ;
+   popcache.emplace_back(
+        calcpop(root->nw, depth), calcpop(root->ne, depth),
+        calcpop(root->sw, depth), calcpop(root->se, depth)) ;
+   setnodeval(root->next, popcache.size()) ;
+   return popcache.back() ;
+}
+void hlifealgo::aftercalcpop2(node *root, int depth) {
+   if (depth == 2 || root == zeronode(depth) || !marked2(root))
+      return ;
+   setnodeval(root->next, 0) ;
+   depth-- ;
+   if (depth > 2) {
+      aftercalcpop2(root->nw, depth) ;
+      aftercalcpop2(root->ne, depth) ;
+      aftercalcpop2(root->sw, depth) ;
+      aftercalcpop2(root->se, depth) ;
+   }
+}
+#else
 const bigint &hlifealgo::calcpop(node *root, int depth) {
    if (root == zeronode(depth))
       return bigint::zero ;
@@ -1320,6 +3111,7 @@ void hlifealgo::aftercalcpop2(node *root, int depth) {
          rehash_node(root) ;
    }
 }
+#endif
 /*
  *   Call this after writing macrocell.
  */
@@ -1349,6 +3141,9 @@ void hlifealgo::calcPopulation() {
    depth = node_depth(root) ;
    population = calcpop(root, depth) ;
    aftercalcpop2(root, depth) ;
+#ifdef COMPACTNODES
+   popcache.clear() ;
+#endif
 }
 /*
  *   Is the universe empty?
@@ -1361,6 +3156,18 @@ int hlifealgo::isEmpty() {
  *   This routine marks a node as needed to be saved.
  */
 node *hlifealgo::save(node *n) {
+   if (mtactive) {
+      hlifethread *me = curthread ;
+      if (me->gsp >= me->stacksize) {
+         int nstacksize = me->stacksize * 2 + 100 ;
+         me->stack = (node **)realloc(me->stack, nstacksize * sizeof(node *)) ;
+         if (me->stack == 0)
+           lifefatal("Out of memory (3).") ;
+         me->stacksize = nstacksize ;
+      }
+      me->stack[me->gsp++] = n ;
+      return n ;
+   }
    if (gsp >= stacksize) {
       int nstacksize = stacksize * 2 + 100 ;
       alloced += sizeof(node *)*(nstacksize-stacksize) ;
@@ -1376,7 +3183,16 @@ node *hlifealgo::save(node *n) {
  *   This routine pops the stack back to a previous depth.
  */
 void hlifealgo::pop(int n) {
-   gsp = n ;
+   if (mtactive)
+      curthread->gsp = n ;
+   else
+      gsp = n ;
+}
+/*
+ *   Return the current stack depth, for a later pop().
+ */
+int hlifealgo::getsp() {
+   return mtactive ? curthread->gsp : gsp ;
 }
 /*
  *   This routine clears the stack altogether.
@@ -1391,31 +3207,65 @@ void hlifealgo::clearstack() {
  *   the nodes from the hash to the freelist as appropriate.  Finally,
  *   walk the hash again, clearing the low order bits in the next pointers.
  */
-void hlifealgo::gc_mark(node *root, int invalidate) {
+void hlifealgo::gc_mark(node *root, int depth, int invalidate) {
    if (!marked(root)) {
       mark(root) ;
       if (is_node(root)) {
-         gc_mark(root->nw, invalidate) ;
-         gc_mark(root->ne, invalidate) ;
-         gc_mark(root->sw, invalidate) ;
-         gc_mark(root->se, invalidate) ;
-         if (root->res) {
-            if (invalidate)
-              root->res = 0 ;
-            else
-              gc_mark(root->res, invalidate) ;
+         depth-- ;
+         gc_mark(root->nw, depth, invalidate) ;
+         gc_mark(root->ne, depth, invalidate) ;
+         gc_mark(root->sw, depth, invalidate) ;
+         gc_mark(root->se, depth, invalidate) ;
+         node *r = resof(root) ;
+         if (invalidate) {
+            root->res = 0 ;
+         } else if (r) {
+            /*
+             *   When evicting, a result gets one gc's grace after each
+             *   use, and the deep ones, which are few and dear to
+             *   recompute, always stay.
+             */
+            if (evicting && !resref(root) && depth < evictdepth) {
+               evictres(root) ;
+               evictions++ ;
+            } else {
+               if (evicting)
+                  clearresref(root) ;
+               gc_mark(r, depth, invalidate) ;
+            }
          }
       }
    }
 }
+/*
+ *   The results of the nodes being computed, and of their children,
+ *   may be held in local variables higher up, so they must not be
+ *   evicted.  Every such node is on a stack; we just count them as
+ *   recently used.
+ */
+void hlifealgo::keepres(node *n) {
+   if (is_node(n)) {
+      if (resof(n))
+         setresref(n) ;
+      node *c[4] = { n->nw, n->ne, n->sw, n->se } ;
+      for (int i=0; i<4; i++)
+         if (is_node(c[i]) && resof(c[i]))
+            setresref(c[i]) ;
+   }
+}
 /**
  *   If the invalidate flag is set, we want to kill *all* cache entries
- *   and recalculate all leaves.
+ *   and recalculate all leaves.  If we are evicting and memory is full,
+ *   we drop the results that are cheap and not recently used, and then
+ *   adjust how deep the next such gc may go by how much this one got
+ *   back.
  */
 void hlifealgo::do_gc(int invalidate) {
    int i ;
    g_uintptr_t freed_nodes=0 ;
    node *p, *pp ;
+   vector<leaf *> stale ; // leaves whose results need recomputing
+   double gcstart = gollySecondCount() ;
    inGC = 1 ;
    gccount++ ;
    gcstep++ ;
@@ -1426,19 +3276,36 @@ void hlifealgo::do_gc(int invalidate) {
        sprintf(statusline, "GC #%d", gccount) ;
      lifestatus(statusline) ;
    }
+   evicting = evictcache && !invalidate &&
+               alloced + 1001 * sizeof(node) > maxmem ;
+   evictions = 0 ;
+   if (evicting) {
+      for (i=0; i<gsp; i++)
+         keepres(stack[i]) ;
+      if (mtactive)
+         for (int j=0; j<pool->nctx; j++)
+            for (i=0; i<pool->ctx[j].gsp; i++)
+               keepres(pool->ctx[j].stack[i]) ;
+   }
    for (i=nzeros-1; i>=0; i--)
       if (zeronodea[i] != 0)
          break ;
    if (i >= 0)
-      gc_mark(zeronodea[i], 0) ; // never invalidate zeronode
+      gc_mark(zeronodea[i], i, 0) ; // never invalidate zeronode
    if (root != 0)
-      gc_mark(root, invalidate) ; // pick up the root
+      gc_mark(root, node_depth(root), invalidate) ; // pick up the root
    for (i=0; i<gsp; i++) {
       poller->poll() ;
-      gc_mark(stack[i], invalidate) ;
+      gc_mark(stack[i], node_depth(stack[i]), invalidate) ;
    }
+   if (mtactive)
+      for (int j=0; j<pool->nctx; j++)
+         for (i=0; i<pool->ctx[j].gsp; i++)
+            gc_mark(pool->ctx[j].stack[i], node_depth(pool->ctx[j].stack[i]),
+                    invalidate) ;
    for (i=0; i<timeline.framecount; i++)
-      gc_mark((node *)timeline.frames[i], invalidate) ;
+      gc_mark((node *)timeline.frames[i],
+              node_depth((node *)timeline.frames[i]), invalidate) ;
    hashpop = 0 ;
    memset(hashtab, 0, sizeof(node *) * hashprime) ;
    freenodes = 0 ;
@@ -1446,16 +3313,15 @@ void hlifealgo::do_gc(int invalidate) {
       poller->poll() ;
       for (pp=p+1, i=1; i<1001; i++, pp++) {
          if (marked(pp)) {
-            g_uintptr_t h = 0 ;
-            if (pp->nw) { /* yes, it's a node */
-               h = HASHMOD(node_hash(pp->nw, pp->ne, pp->sw, pp->se)) ;
-            } else {
-               leaf *lp = (leaf *)pp ;
-               if (invalidate)
-                  leafres(lp) ;
-               h = HASHMOD(leaf_hash(lp->nw, lp->ne, lp->sw, lp->se)) ;
-            }
-            pp->next = hashtab[h] ;
+            if (invalidate && !is_node(pp))
+               stale.push_back((leaf *)pp) ;
+            g_uintptr_t h = HASHMOD(hashof(pp)) ;
+            if (openhash) {
+               while (hashtab[h])
+                  h = TABNEXT(h, hashprime) ;
+               pp->next = 0 ;
+            } else
+               pp->next = hashtab[h] ;
             hashtab[h] = pp ;
             hashpop++ ;
          } else {
@@ -1465,13 +3331,39 @@ void hlifealgo::do_gc(int invalidate) {
          }
       }
    }
+   if (stale.size())
+      leafbatch(&stale[0], (int)stale.size()) ;
+   young.clear() ;
+   remembered.clear() ;
+   minorpoor = 0 ;
+   if (evicting) {
+      if (freed_nodes < (totalthings >> 2))
+         evictdepth += 2 ;
+      else if (freed_nodes > (totalthings >> 1) && evictdepth > 4)
+         evictdepth-- ;
+   }
+   finishgc(gcstart, freed_nodes, evictions) ;
+}
+/*
+ *   Report on a gc, and the cache since the last one.
+ */
+void hlifealgo::finishgc(double gcstart, g_uintptr_t freed_nodes,
+                         g_uintptr_t evicted) {
    inGC = 0 ;
+   double pause = gollySecondCount() - gcstart ;
+   running_hperf.gcpause(pause) ;
    if (verbose) {
      double perc = (double)freed_nodes / (double)totalthings * 100.0 ;
-     sprintf(statusline+strlen(statusline), " freed %g percent (%" PRIuPTR ").",
-                                                   perc, freed_nodes) ;
+     sprintf(statusline+strlen(statusline), " freed %g percent (%" PRIuPTR ") in %g ms.",
+                                        perc, freed_nodes, 1000 * pause) ;
+     if (cachehits + cachemisses > 0)
+       sprintf(statusline+strlen(statusline),
+               " Hits %g percent, %" PRIuPTR " recomputed, %" PRIuPTR " evicted.",
+               100.0 * cachehits / (cachehits + cachemisses), recomputes,
+               evicted) ;
      lifestatus(statusline) ;
    }
+   cachehits = cachemisses = recomputes = 0 ;
    if (needPop) {
       calcPopulation() ;
       popValid = 1 ;
@@ -1479,6 +3371,172 @@ void hlifealgo::do_gc(int invalidate) {
       poller->updatePop() ;
    }
 }
+/*
+ *   The generational gc.  Most nodes die young; a node made in one
+ *   step is seldom needed again once the universe has moved on, while
+ *   the nodes that survived a gc tend to be the ones that get reused.
+ *   So the minor gc only looks at the nodes put in the hash since the
+ *   last gc.  Children are always older than their parents, so the
+ *   only way an older node can reach a young one is through a res set
+ *   since the last gc, and getres noted every such node for us.  We
+ *   mark from the roots and those results, stopping at older nodes,
+ *   and take the unmarked young nodes out of the hash.  Garbage among
+ *   the older nodes waits for the next full gc.
+ */
+void hlifealgo::gc_mark_young(node *root) {
+   if (unmarkedyoung(root)) {
+      mark(root) ;
+      if (is_node(root)) {
+         gc_mark_young(root->nw) ;
+         gc_mark_young(root->ne) ;
+         gc_mark_young(root->sw) ;
+         gc_mark_young(root->se) ;
+         if (resof(root))
+            gc_mark_young(resof(root)) ;
+      }
+   }
+}
+/*
+ *   Take a node out of the hash.  In the open table we only leave a
+ *   dead slot, so the runs stay whole while we look for the rest;
+ *   closeholes() then cleans up after all of them at once.
+ */
+#define DEADSLOT ((node *)2)
+void hlifealgo::dropnode(node *n) {
+   g_uintptr_t h = hashof(n) ;
+   if (openhash) {
+      g_uintptr_t i = HASHMOD(h) ;
+      while (hashtab[i] != n)
+         i = TABNEXT(i, hashprime) ;
+      hashtab[i] = DEADSLOT ;
+   } else {
+      node *p, *pred = 0 ;
+      h = HASHMOD(h) ;
+      for (p=hashtab[h]; p != n; p = p->next)
+         pred = p ;
+      if (pred)
+         pred->next = n->next ;
+      else
+         hashtab[h] = n->next ;
+   }
+}
+/*
+ *   Empty the dead slots, in one pass starting from an empty slot.
+ *   A node later in a run than a dead slot may have been pushed past
+ *   it, so we put each of those again; it always lands at or before
+ *   where it was.  Nodes in a run with no dead slot ahead of them
+ *   stay put.
+ */
+void hlifealgo::closeholes() {
+   g_uintptr_t i = 0, n ;
+   int moving = 0 ;
+   while (hashtab[i] != 0)
+      i++ ;
+   for (n=0; n<hashprime; n++) {
+      i = TABNEXT(i, hashprime) ;
+      node *p = hashtab[i] ;
+      if (p == 0) {
+         moving = 0 ;
+      } else if (p == DEADSLOT) {
+         hashtab[i] = 0 ;
+         moving = 1 ;
+      } else if (moving) {
+#ifdef USEPREFETCH
+         if (i + 16 < hashprime)
+            PREFETCH(hashtab[i+16]) ;
+#endif
+         hashtab[i] = 0 ;
+         g_uintptr_t j = HASHMOD(hashof(p)) ;
+         while (hashtab[j])
+            j = TABNEXT(j, hashprime) ;
+         hashtab[j] = p ;
+      }
+   }
+}
+void hlifealgo::minor_gc() {
+   int i ;
+   g_uintptr_t j, survivors=0, freed_nodes=0 ;
+   double gcstart = gollySecondCount() ;
+   inGC = 1 ;
+   gccount++ ;
+   gcstep++ ;
+   if (verbose) {
+     if (gcstep > 1)
+       sprintf(statusline, "GC #%d(%d) minor", gccount, gcstep) ;
+     else
+       sprintf(statusline, "GC #%d minor", gccount) ;
+     lifestatus(statusline) ;
+   }
+   for (j=0; j<young.size(); j++)
+      setyoung(young[j]) ;
+   for (i=0; i<nzeros; i++)
+      if (zeronodea[i] != 0)
+         gc_mark_young(zeronodea[i]) ;
+   if (root != 0)
+      gc_mark_young(root) ;
+   for (i=0; i<gsp; i++)
+      gc_mark_young(stack[i]) ;
+   if (mtactive)
+      for (int k=0; k<pool->nctx; k++)
+         for (i=0; i<pool->ctx[k].gsp; i++)
+            gc_mark_young(pool->ctx[k].stack[i]) ;
+   for (i=0; i<timeline.framecount; i++)
+      gc_mark_young((node *)timeline.frames[i]) ;
+   for (j=0; j<remembered.size(); j++) {
+      node *p = remembered[j] ;
+      if (!isyoung(p) && resof(p)) // young ones are handled by the marking
+         gc_mark_young(resof(p)) ;
+   }
+   poller->poll() ;
+   /*
+    *   Clear all the flags first, so the hash chains are whole again,
+    *   gathering the dead nodes at the front of the list.
+    */
+   for (j=0; j<young.size(); j++) {
+      node *p = young[j] ;
+      if (marked(p))
+         survivors++ ;
+      else
+         young[freed_nodes++] = p ;
+      clearyoung(p) ;
+   }
+   for (j=0; j<freed_nodes; j++) {
+      node *p = young[j] ;
+#ifdef USEPREFETCH
+      if (j + 8 < freed_nodes)
+         PREFETCH(young[j+8]) ;
+#endif
+      dropnode(p) ;
+      p->next = freenodes ;
+      freenodes = p ;
+   }
+   if (openhash && freed_nodes)
+      closeholes() ;
+   hashpop -= freed_nodes ;
+   /*
+    *   Old garbage builds up until a full gc; once it crowds the hash
+    *   (linear probing slows down well before chaining does) we would
+    *   rather pay for the full gc.
+    */
+   minorpoor = (freed_nodes < survivors || freed_nodes < (totalthings >> 4) ||
+                hashpop > (openhash ? 0.5 : maxloadfactor) * hashprime) ;
+   young.clear() ;
+   remembered.clear() ;
+   finishgc(gcstart, freed_nodes, 0) ;
+}
+/*
+ *   Called when we run out of memory.  Freeing a young node one at a
+ *   time costs several times what sweeping it does in a full gc, so a
+ *   minor gc only pays when at least half of memory holds older nodes,
+ *   that is, when the last gc found much of what it looked at still
+ *   alive; and only while the minor gcs keep getting back a fair share.
+ */
+void hlifealgo::collect() {
+   if (gengc && !minorpoor && young.size() <= (totalthings >> 1))
+      minor_gc() ;
+   else
+      do_gc(0) ;
+}
 /*
  *   Clear the cache bits down to the appropriate level, marking the
  *   nodes we've handled.
@@ -1493,8 +3551,8 @@ void hlifealgo::clearcache(node *n, int depth, int clearto) {
          clearcache(n->ne, depth, clearto) ;
          clearcache(n->sw, depth, clearto) ;
          clearcache(n->se, depth, clearto) ;
-         if (n->res)
-            clearcache(n->res, depth, clearto) ;
+         if (resof(n))
+            clearcache(resof(n), depth, clearto) ;
       }
       if (depth >= clearto)
          n->res = 0 ;
@@ -1535,7 +3593,7 @@ void hlifealgo::new_ngens(int newval) {
    ngens = newval ;
    inGC = 1 ;
    for (i=0; i<hashprime; i++)
-      for (p=hashtab[i]; p; p=clearmarkbit(p->next))
+      for (p=hashtab[i]; p; p=(openhash ? 0 : clearmarkbit(p->next)))
          if (is_node(p) && !marked(p))
             clearcache(p, node_depth(p), clearto) ;
    for (p=nodeblocks; p; p=p->next) {
@@ -1617,10 +3675,14 @@ node *hlifealgo::runpattern() {
    }
    save(zeronode(nzeros-1)) ;
    save(n) ;
+   if (numthreads > 1 && depth > pardepth)
+      startthreads() ;
    n2 = getres(n, depth) ;
+   if (mtactive)
+      stopthreads() ;
    okaytogc = 0 ;
    clearstack() ;
-   if (halvesdone == 1 && n->res != 0) {
+   if (halvesdone == 1 && resof(n) != 0) {
       n->res = 0 ;
       halvesdone = 0 ;
    }
@@ -1880,6 +3942,7 @@ const char *hlifealgo::setrule(const char *s) {
    if (!(hliferules.isHexagonal() || hliferules.isWolfram())) {
       fliprule(hliferules.rule0);
    }
+   setslicedrule() ;
 
    clearcache() ;
    
@@ -1914,11 +3977,11 @@ g_uintptr_t hlifealgo::writecell(std::ostream &os, node *root, int depth) {
    if (root == zeronode(depth))
       return 0 ;
    if (depth == 2) {
-      if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+      if (nodeval(root->nw) != 0)
+         return nodeval(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
+         return nodeval(root->next) ;
       unhash_node2(root) ;
       mark2(root) ;
    }
@@ -1927,7 +3990,7 @@ g_uintptr_t hlifealgo::writecell(std::ostream &os, node *root, int depth) {
       unsigned int top, bot ;
       leaf *n = (leaf *)root ;
       thiscell = ++cellcounter ;
-      root->nw = (node *)thiscell ;
+      setnodeval(root->nw, thiscell) ;
       unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
       for (j=7; (top | bot) && j>=0; j--) {
          int bits = (top >> 24) ;
@@ -1947,7 +4010,7 @@ g_uintptr_t hlifealgo::writecell(std::ostream &os, node *root, int depth) {
       g_uintptr_t sw = writecell(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell(os, root->se, depth-1) ;
       thiscell = ++cellcounter ;
-      root->next = (node *)thiscell ;
+      setnodeval(root->next, thiscell) ;
       os << depth+1 << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
    }
    return thiscell ;
@@ -1962,11 +4025,11 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
    if (root == zeronode(depth))
       return 0 ;
    if (depth == 2) {
-      if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+      if (nodeval(root->nw) != 0)
+         return nodeval(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
+         return nodeval(root->next) ;
       unhash_node2(root) ;
       mark2(root) ;
    }
@@ -1975,7 +4038,7 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->nw = (node *)thiscell ;
+      setnodeval(root->nw, thiscell) ;
    } else {
       writecell_2p1(root->nw, depth-1) ;
       writecell_2p1(root->ne, depth-1) ;
@@ -1985,7 +4048,7 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->next = (node *)thiscell ;
+      setnodeval(root->next, thiscell) ;
    }
    return thiscell ;
 }
@@ -1999,8 +4062,8 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
    if (root == zeronode(depth))
       return 0 ;
    if (depth == 2) {
-      if (cellcounter + 1 != (g_uintptr_t)(root->nw))
-         return (g_uintptr_t)(root->nw) ;
+      if (cellcounter + 1 != nodeval(root->nw))
+         return nodeval(root->nw) ;
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
          std::streampos siz = os.tellp();
@@ -2010,7 +4073,7 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
       int i, j ;
       unsigned int top, bot ;
       leaf *n = (leaf *)root ;
-      root->nw = (node *)thiscell ;
+      setnodeval(root->nw, thiscell) ;
       unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
       for (j=7; (top | bot) && j>=0; j--) {
          int bits = (top >> 24) ;
@@ -2025,16 +4088,16 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
       }
       os << '\n' ;
    } else {
-      if (cellcounter + 1 > (g_uintptr_t)(root->next) || isaborted())
-         return (g_uintptr_t)(root->next) ;
+      if (cellcounter + 1 > nodeval(root->next) || isaborted())
+         return nodeval(root->next) ;
       g_uintptr_t nw = writecell_2p2(os, root->nw, depth-1) ;
       g_uintptr_t ne = writecell_2p2(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell_2p2(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell_2p2(os, root->se, depth-1) ;
       if (!isaborted() &&
-          cellcounter + 1 != (g_uintptr_t)(root->next)) { // this should never happen
+          cellcounter + 1 != nodeval(root->next)) { // this should never happen
          lifefatal("Internal in writecell_2p2") ;
-         return (g_uintptr_t)(root->next) ;
+         return nodeval(root->next) ;
       }
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
@@ -2042,7 +4105,7 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
          sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
-      root->next = (node *)thiscell ;
+      setnodeval(root->next, thiscell) ;
       os << depth+1 << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
    }
    return thiscell ;
@@ -2115,7 +4178,7 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
      for (int i=0; i<timeline.framecount; i++) {
        node *frame = (node*)timeline.frames[i] ;
        writecell_2p2(os, frame, depths[i]) ;
-       os << "#FRAME " << i << ' ' << (g_uintptr_t)frame->next << '\n' ;
+       os << "#FRAME " << i << ' ' << nodeval(frame->next) << '\n' ;
      }
    }
    writecell_2p2(os, root, depth) ;
@@ -2130,6 +4193,471 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
    inGC = 0 ;
    return 0 ;
 }
+/*
+ *   The result cache file.  It holds hashed nodes along with their
+ *   results, so that a later run with the same rule can start out with
+ *   them.  After a header and the rule come the leaves, as four shorts
+ *   each, and then the nodes, as five ints (nw, ne, sw, se, res) each;
+ *   a node always comes after its children and its result.  References
+ *   count from 1 (0 is no result), with CACHELEAF set for leaves.  The
+ *   header records ngens, since the results of nodes deeper than that
+ *   are for a step of 2^ngens.  Reading maps the file and walks the
+ *   records where they lie; results are only taken where they agree
+ *   with our own ngens.  Saving merges: the records already in the
+ *   file are kept and only the nodes it lacks are added.
+ */
+struct cachehead {
+   char magic[8] ;
+   unsigned int headsize ; // guards against a different layout
+   unsigned int rulelen ;  // rule follows, padded to a multiple of four
+   unsigned int nleaves, nnodes ;
+   int ngens ;
+} ;
+static const char cachemagic[8] = { 'G', 'o', 'l', 'l', 'y', 'H', 'C', '1' } ;
+const unsigned int CACHELEAF = MCBLEAF ;
+/*
+ *   Check a mapped cache file's header and length and find the leaf
+ *   and node records.
+ */
+static const char *checkcache(const mappedfile &mf, const char *rule,
+                              const unsigned short *&lp,
+                              const unsigned int *&np) {
+   const cachehead *h = (const cachehead *)mf.data ;
+   size_t rulebytes = 0, need = sizeof(cachehead) ;
+   if (mf.len >= need && h->headsize == sizeof(cachehead)) {
+      rulebytes = (h->rulelen + 3) & ~(size_t)3 ;
+      need += rulebytes + sizeof(unsigned short) * 4 * (size_t)h->nleaves +
+              sizeof(unsigned int) * 5 * (size_t)h->nnodes ;
+   }
+   if (mf.len < sizeof(cachehead) ||
+       memcmp(h->magic, cachemagic, sizeof(h->magic)) != 0 ||
+       h->headsize != sizeof(cachehead) || mf.len < need ||
+       h->nleaves >= CACHELEAF || h->nnodes >= CACHELEAF)
+      return "Not a valid result cache file" ;
+   if (h->rulelen != strlen(rule) ||
+       memcmp(mf.data + sizeof(cachehead), rule, h->rulelen) != 0)
+      return "Result cache file is for a different rule" ;
+   lp = (const unsigned short *)(mf.data + sizeof(cachehead) + rulebytes) ;
+   np = (const unsigned int *)(lp + 4 * (size_t)h->nleaves) ;
+   return 0 ;
+}
+/*
+ *   The writer numbers the nodes in a little open-addressed table of
+ *   its own, since the next fields are busy holding the hash chains.
+ *   The binary macrocell format uses the same records, with or
+ *   without the results (refs is 5 or 4).  When merging into an old
+ *   cache its records come first, read where they lie in the mapped
+ *   file, and a second table finds them by content so that a node we
+ *   still have isn't written twice.
+ */
+struct cachewriter {
+   vector<node *> keys ;
+   vector<unsigned int> ids ;
+   vector<unsigned char> depths ;
+   g_uintptr_t mask ;
+   int refs ;
+   vector<unsigned short> leaves ;
+   vector<unsigned int> nodes ;
+   const unsigned short *oldleaves ;
+   const unsigned int *oldnodes ;
+   unsigned int noldleaves, noldnodes ;
+   vector<unsigned char> dropres ; // old results for a different step
+   vector<unsigned int> seen ;     // old records by content
+   g_uintptr_t seenmask ;
+   cachewriter(g_uintptr_t n, int nrefs) : refs(nrefs), oldleaves(0),
+      oldnodes(0), noldleaves(0), noldnodes(0), seenmask(0) {
+      for (mask=1023; mask < n + (n >> 1); mask += mask + 1) ;
+      keys.resize(mask + 1) ;
+      ids.resize(mask + 1) ;
+      depths.resize(mask + 1) ;
+   }
+   g_uintptr_t slot(node *n) {
+      g_uintptr_t h = (g_uintptr_t)n ;
+      h = (h ^ (h >> 17)) * 0x9e3779b1U ;
+      h = (h ^ (h >> 15)) & mask ;
+      while (keys[h] && keys[h] != n)
+         h = (h + 1) & mask ;
+      return h ;
+   }
+   int sameas(unsigned int id, const unsigned int *c, unsigned int leafbit) {
+      if ((id & CACHELEAF) != leafbit)
+         return 0 ;
+      if (leafbit) {
+         const unsigned short *l = oldleaves + 4 * (size_t)((id & ~CACHELEAF) - 1) ;
+         return l[0] == c[0] && l[1] == c[1] && l[2] == c[2] && l[3] == c[3] ;
+      }
+      const unsigned int *r = oldnodes + 5 * (size_t)(id - 1) ;
+      return r[0] == c[0] && r[1] == c[1] && r[2] == c[2] && r[3] == c[3] ;
+   }
+   g_uintptr_t seenslot(const unsigned int *c, unsigned int leafbit) {
+      g_uintptr_t h = leafbit ? 1 : 0 ;
+      for (int j=0; j<4; j++) {
+         h = (h ^ c[j]) * 0x9e3779b1U ;
+         h ^= h >> 15 ;
+      }
+      h &= seenmask ;
+      while (seen[h] && !sameas(seen[h], c, leafbit))
+         h = (h + 1) & seenmask ;
+      return h ;
+   }
+   // the id of an old record with this content, or 0
+   unsigned int findold(const unsigned int *c, unsigned int leafbit) {
+      return seen.empty() ? 0 : seen[seenslot(c, leafbit)] ;
+   }
+   int seed(const unsigned short *lp, unsigned int nleaves,
+            const unsigned int *np, unsigned int nnodes,
+            int fngens, int ngens) ;
+} ;
+/*
+ *   Start the writer off with the records of the cache we are about to
+ *   replace.  The header will carry our ngens, so old results for a
+ *   different step (see loadrecords) are dropped as they are written.
+ *   Returns 0 if the records are corrupt.
+ */
+int cachewriter::seed(const unsigned short *lp, unsigned int nleaves,
+                      const unsigned int *np, unsigned int nnodes,
+                      int fngens, int ngens) {
+   oldleaves = lp ;
+   oldnodes = np ;
+   noldleaves = nleaves ;
+   noldnodes = nnodes ;
+   g_uintptr_t n = (g_uintptr_t)nleaves + nnodes ;
+   for (seenmask=1023; seenmask < n + (n >> 1); seenmask += seenmask + 1) ;
+   seen.resize(seenmask + 1) ;
+   dropres.resize(nnodes) ;
+   unsigned int i, c[5] ;
+   for (i=0; i<nleaves; i++) {
+      for (int j=0; j<4; j++)
+         c[j] = lp[4 * (size_t)i + j] ;
+      g_uintptr_t h = seenslot(c, CACHELEAF) ;
+      if (!seen[h])
+         seen[h] = CACHELEAF | (i + 1) ;
+   }
+   vector<unsigned char> nodedepth(nnodes + 1) ;
+   int d[5] ;
+   for (i=0; i<nnodes; i++) {
+      for (int j=0; j<5; j++) {
+         unsigned int r = c[j] = np[5 * (size_t)i + j] ;
+         d[j] = 0 ;
+         if (r & CACHELEAF) {
+            r &= ~CACHELEAF ;
+            if (r >= 1 && r <= nleaves)
+               d[j] = 2 ;
+         } else if (r >= 1 && r <= i) {
+            d[j] = nodedepth[r] ;
+         }
+      }
+      if (d[0] == 0 || d[1] != d[0] || d[2] != d[0] || d[3] != d[0])
+         return 0 ;
+      nodedepth[i+1] = (unsigned char)(d[0] + 1) ;
+      if (c[4] && !(d[4] == d[0] &&
+                    (d[0] <= fngens ? d[0] <= ngens : ngens == fngens)))
+         dropres[i] = 1 ;
+      g_uintptr_t h = seenslot(c, 0) ;
+      if (!seen[h])
+         seen[h] = i + 1 ;
+   }
+   return 1 ;
+}
+static unsigned int cacheref(cachewriter &w, node *n, int &depth) {
+   g_uintptr_t h = w.slot(n) ;
+   if (w.keys[h]) {
+      depth = w.depths[h] ;
+      return w.ids[h] ;
+   }
+   unsigned int id ;
+   if (!is_node(n)) {
+      leaf *l = (leaf *)n ;
+      unsigned int c[4] = { l->nw, l->ne, l->sw, l->se } ;
+      id = w.findold(c, CACHELEAF) ;
+      if (id == 0) {
+         w.leaves.insert(w.leaves.end(), c, c+4) ;
+         id = CACHELEAF | (w.noldleaves + (unsigned int)(w.leaves.size() / 4)) ;
+      }
+      depth = 2 ;
+   } else {
+      unsigned int c[5] ;
+      c[0] = cacheref(w, n->nw, depth) ;
+      c[1] = cacheref(w, n->ne, depth) ;
+      c[2] = cacheref(w, n->sw, depth) ;
+      c[3] = cacheref(w, n->se, depth) ;
+      c[4] = 0 ;
+      id = w.findold(c, 0) ;
+      if (id == 0) {
+         node *r = w.refs > 4 ? resof(n) : 0 ;
+         if (r) {
+            int rdepth ;
+            c[4] = cacheref(w, r, rdepth) ;
+         }
+         w.nodes.insert(w.nodes.end(), c, c+w.refs) ;
+         id = w.noldnodes + (unsigned int)(w.nodes.size() / w.refs) ;
+      }
+      depth++ ;
+      h = w.slot(n) ; // the children may have taken our old slot
+   }
+   w.keys[h] = n ;
+   w.ids[h] = id ;
+   w.depths[h] = (unsigned char)depth ;
+   return id ;
+}
+/*
+ *   Canonicalize leaf and node records, as cacheref() writes them, in
+ *   the order they lie.  The vectors start out with an unused entry 0;
+ *   depths holds the depth of each node's children, as getres() sees
+ *   it.  Results (for a step of 2^fngens) are only taken where they
+ *   agree with our own ngens, and not at all if fngens is negative.
+ *   A cache (whole == 0) stops where memory runs out and a pattern
+ *   where the user aborts; what we have is still consistent.  Returns
+ *   0 if the records are corrupt.
+ */
+int hlifealgo::loadrecords(const unsigned short *lp, unsigned int nleaves,
+                           const unsigned int *np, unsigned int nnodes,
+                           int refs, int fngens, int whole,
+                           vector<node *> &leaves, vector<node *> &nodes,
+                           vector<unsigned char> &depths) {
+   unsigned int i ;
+   for (i=0; i<nleaves; i++, lp += 4) {
+      if (!whole && alloced + 1001 * sizeof(node) > maxmem)
+         return 1 ;
+      leaves.push_back((node *)find_leaf(lp[0], lp[1], lp[2], lp[3])) ;
+   }
+   node *c[5] ;
+   int d[5] ;
+   c[4] = 0 ;
+   d[4] = 0 ;
+   for (i=0; i<nnodes; i++, np += refs) {
+      if (whole) {
+         if ((i & 4095) == 0 && lifeabortprogress(i / (double)nnodes, ""))
+            break ;
+      } else if (alloced + 1001 * sizeof(node) > maxmem)
+         break ;
+      for (int j=0; j<refs; j++) {
+         unsigned int r = np[j] ;
+         c[j] = 0 ;
+         d[j] = 0 ;
+         if (r & CACHELEAF) {
+            r &= ~CACHELEAF ;
+            if (r < leaves.size()) {
+               c[j] = leaves[r] ;
+               d[j] = 2 ;
+            }
+         } else if (r < nodes.size()) {
+            c[j] = nodes[r] ;
+            d[j] = depths[r] + 1 ;
+         }
+      }
+      if (c[0] == 0 || c[1] == 0 || c[2] == 0 || c[3] == 0 ||
+          d[1] != d[0] || d[2] != d[0] || d[3] != d[0])
+         return 0 ;
+      node *n = find_node(c[0], c[1], c[2], c[3]) ;
+      if (c[4] && fngens >= 0 && d[4] == d[0] && !resof(n) &&
+          (d[0] <= fngens ? d[0] <= ngens : ngens == fngens)) {
+         n->res = c[4] ;
+         if (d[0] > ngens)
+            halvesdone = 1 ;
+         if (gengc)
+            noteres(n) ;
+      }
+      depths.push_back((unsigned char)d[0]) ;
+      nodes.push_back(n) ;
+   }
+   return 1 ;
+}
+const char *hlifealgo::saveResultCache(const char *filename) {
+   poller->bailIfCalculating() ;
+   ensure_hashed() ;
+   const char *rule = hliferules.getrule() ;
+   cachewriter w(hashpop, 5) ;
+   mappedfile old ;
+   if (old.open(filename)) {
+      // never replace somebody else's file or a cache for another rule
+      const unsigned short *lp ;
+      const unsigned int *np ;
+      const char *err = checkcache(old, rule, lp, np) ;
+      if (err)
+         return err ;
+      const cachehead *oh = (const cachehead *)old.data ;
+      if (!w.seed(lp, oh->nleaves, np, oh->nnodes, oh->ngens, ngens))
+         return "Result cache file is corrupt" ;
+   }
+   g_uintptr_t i ;
+   int depth ;
+   for (i=0; i<hashprime; i++)
+      for (node *p=hashtab[i]; p; p=(openhash ? 0 : clearmarkbit(p->next)))
+         cacheref(w, p, depth) ;
+   cachehead h ;
+   memcpy(h.magic, cachemagic, sizeof(h.magic)) ;
+   h.headsize = sizeof(cachehead) ;
+   h.rulelen = (unsigned int)strlen(rule) ;
+   h.nleaves = w.noldleaves + (unsigned int)(w.leaves.size() / 4) ;
+   h.nnodes = w.noldnodes + (unsigned int)(w.nodes.size() / 5) ;
+   h.ngens = ngens ;
+   // write a new file and move it into place, since the old one is
+   // still mapped
+   string tmpname = string(filename) + ".tmp" ;
+   FILE *f = fopen(tmpname.c_str(), "wb") ;
+   if (f == 0)
+      return "Can't create result cache file" ;
+   char pad[4] = { 0, 0, 0, 0 } ;
+   size_t padlen = (4 - (h.rulelen & 3)) & 3 ;
+   int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(rule, 1, h.rulelen, f) == h.rulelen &&
+            fwrite(pad, 1, padlen, f) == padlen &&
+            (w.noldleaves == 0 || fwrite(w.oldleaves, 4 * sizeof(unsigned short),
+               w.noldleaves, f) == w.noldleaves) &&
+            (w.leaves.size() == 0 || fwrite(&w.leaves[0],
+               sizeof(unsigned short), w.leaves.size(), f) == w.leaves.size()) ;
+   // the old nodes go out a block at a time, without the dropped results
+   unsigned int block[5 * 1024] ;
+   for (unsigned int j=0; ok && j<w.noldnodes; j+=1024) {
+      unsigned int n = w.noldnodes - j < 1024 ? w.noldnodes - j : 1024 ;
+      memcpy(block, w.oldnodes + 5 * (size_t)j, 5 * sizeof(unsigned int) * n) ;
+      for (unsigned int k=0; k<n; k++)
+         if (w.dropres[j+k])
+            block[5*k+4] = 0 ;
+      ok = fwrite(block, 5 * sizeof(unsigned int), n, f) == n ;
+   }
+   ok = ok && (w.nodes.size() == 0 || fwrite(&w.nodes[0],
+               sizeof(unsigned int), w.nodes.size(), f) == w.nodes.size()) ;
+   if (fclose(f) != 0 || !ok) {
+      remove(tmpname.c_str()) ;
+      return "Error writing result cache file" ;
+   }
+   old.close() ;
+#ifdef _WIN32
+   remove(filename) ; // rename won't replace a file here
+#endif
+   if (rename(tmpname.c_str(), filename) != 0) {
+      remove(tmpname.c_str()) ;
+      return "Can't replace result cache file" ;
+   }
+   if (verbose) {
+      sprintf(statusline, "Saved %u leaves and %u nodes to result cache (%u and %u new).",
+              h.nleaves, h.nnodes, h.nleaves - w.noldleaves, h.nnodes - w.noldnodes) ;
+      lifestatus(statusline) ;
+   }
+   return 0 ;
+}
+const char *hlifealgo::loadResultCache(const char *filename) {
+   poller->bailIfCalculating() ;
+   mappedfile mf ;
+   if (!mf.open(filename))
+      return "Can't map result cache file" ;
+   const char *rule = hliferules.getrule() ;
+   const unsigned short *lp ;
+   const unsigned int *np ;
+   const char *err = checkcache(mf, rule, lp, np) ;
+   if (err)
+      return err ;
+   const cachehead *h = (const cachehead *)mf.data ;
+   ensure_hashed() ;
+   /*
+    *   Settle ngens for the increment we have been given first, so
+    *   we take the results for the step we will actually make; the
+    *   ones for a different step are skipped.
+    */
+   takeincrement() ;
+   vector<node *> leaves(1), nodes(1) ;
+   vector<unsigned char> depths(1) ;
+   if (!loadrecords(lp, h->nleaves, np, h->nnodes, 5, h->ngens, 0,
+                    leaves, nodes, depths))
+      err = "Result cache file is corrupt" ;
+   unsigned int nl = (unsigned int)leaves.size() - 1 ;
+   unsigned int nn = (unsigned int)nodes.size() - 1 ;
+   if (verbose) {
+      sprintf(statusline, "Loaded %u leaves and %u nodes from result cache.",
+              nl, nn) ;
+      lifestatus(statusline) ;
+   }
+   return err ;
+}
+/*
+ *   The binary macrocell format (see mcbhead in lifealgo.h) holds the
+ *   same records as the result cache, but only those reachable from
+ *   the root, with the results optional.  The leaves are our four
+ *   shorts, which is to say one 64-bit bitmap.  The timeline and any
+ *   comments are not saved.
+ */
+const char *hlifealgo::readbinarymacrocell(const char *data, size_t len) {
+   const char *rule, *gen, *lp ;
+   const unsigned int *np ;
+   const char *err = checkmcb(data, len, 4 * sizeof(unsigned short),
+                              rule, gen, lp, np) ;
+   if (err)
+      return err ;
+   const mcbhead *h = (const mcbhead *)data ;
+   err = setrule(rule) ;
+   if (err)
+      return err ;
+   if (*gen)
+      generation = bigint(gen) ;
+   root = 0 ;
+   clearstack() ;
+   /*
+    *   The results are only of use if they are for the step we are set
+    *   up for; changing ngens here would leave it out of step with the
+    *   increment, so otherwise we just drop them.
+    */
+   int fngens = h->noderefs > 4 && h->ngens == ngens ? ngens : -1 ;
+   if (fngens >= 0 && cacheinvalid) {
+      // the results are for this rule, so drop the old ones now rather
+      // than in runpattern()
+      do_gc(1) ;
+      cacheinvalid = 0 ;
+   }
+   vector<node *> leaves(1), nodes(1) ;
+   vector<unsigned char> depths(1) ;
+   leaves.reserve(h->nleaves + 1) ;
+   nodes.reserve(h->nnodes + 1) ;
+   depths.reserve(h->nnodes + 1) ;
+   if (!loadrecords((const unsigned short *)lp, h->nleaves, np, h->nnodes,
+                    h->noderefs, fngens, 1, leaves, nodes, depths))
+      return "Binary macrocell file is corrupt." ;
+   unsigned int r = h->root ;
+   if (nodes.size() <= h->nnodes) // aborted; keep what we have
+      r = nodes.size() > 1 ? (unsigned int)nodes.size() - 1
+                           : CACHELEAF | (unsigned int)(leaves.size() - 1) ;
+   if (r & CACHELEAF) {
+      r &= ~CACHELEAF ;
+      if (r >= leaves.size())
+         return "Binary macrocell file is corrupt." ;
+      root = r ? leaves[r] : 0 ;
+      depth = 2 ;
+   } else {
+      if (r >= nodes.size())
+         return "Binary macrocell file is corrupt." ;
+      root = r ? nodes[r] : 0 ;
+      depth = depths[r] + 1 ;
+   }
+   if (root == 0) // empty, as with readmacrocell()
+      return 0 ;
+   if (depth < 3) {
+      root = make_internal_node(root) ;
+      depth = 3 ;
+   }
+   hashed = 1 ;
+   return 0 ;
+}
+const char *hlifealgo::writeBinaryFormat(std::ostream &os, int results) {
+   ensure_hashed() ;
+   cachewriter w(hashpop, results ? 5 : 4) ;
+   int d ;
+   mcbhead h ;
+   h.root = cacheref(w, root, d) ;
+   h.leafsize = 4 * sizeof(unsigned short) ;
+   h.noderefs = w.refs ;
+   h.nleaves = (unsigned int)(w.leaves.size() / 4) ;
+   h.nnodes = (unsigned int)(w.nodes.size() / w.refs) ;
+   h.ngens = ngens < MCBMAXNGENS ? ngens : MCBMAXNGENS ;
+   writemcbhead(os, h, hliferules.getrule(), generation.tostring('\0')) ;
+   if (w.leaves.size())
+      os.write((const char *)&w.leaves[0],
+               w.leaves.size() * sizeof(unsigned short)) ;
+   if (w.nodes.size())
+      os.write((const char *)&w.nodes[0],
+               w.nodes.size() * sizeof(unsigned int)) ;
+   return 0 ;
+}
 char hlifealgo::statusline[200] ;
 static lifealgo *creator() { return new hlifealgo() ; }
 void hlifealgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
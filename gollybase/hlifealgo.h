@@ -6,6 +6,8 @@
 #include "lifealgo.h"
 #include "liferules.h"
 #include "util.h"
+#include <mutex>
+#include <vector>
 /*
  *   Into instances of this node structure is where almost all of the
  *   memory allocated by this program goes.  Thus, it is imperative we
@@ -91,12 +93,53 @@
  *   together, we want a next pointer for the hash chain.  Put all of
  *   this together, and you get the following structure for the 16-squares
  *   and larger:
+ *
+ *   (On 64-bit machines the pointers are most of the size of a node.  If
+ *   COMPACTNODES is defined, all nodes instead live in one big arena,
+ *   shared by all universes, and refer to each other by 32-bit index,
+ *   which halves the size of a node.  A noderef converts to and from
+ *   an ordinary node pointer, so most of the code needn't care.  Index
+ *   zero is the null node.  The compact build always uses the open
+ *   hash table, so the next field is free for scratch use.)
+ *
+ *   (If STOREHASH is defined, nodes and leaves also keep their hash,
+ *   which makes them a little bigger but saves recomputing it whenever
+ *   the hash table is resized or rebuilt.)
  */
+#ifdef COMPACTNODES
+struct node ;
+extern node *nodearena ;
+struct noderef {
+   noderef() = default ;
+   noderef(node *p) ;
+   operator node *() const ;
+   node *operator->() const ;
+   unsigned int v ;
+} ;
+#define nodeval(f) ((g_uintptr_t)(f).v)
+#define setnodeval(f,x) ((f).v = (unsigned int)(x))
+#else
+typedef struct node *noderef ;
+#define nodeval(f) ((g_uintptr_t)(f))
+#define setnodeval(f,x) ((f) = (node *)(x))
+#endif
 struct node {
-   node *next ;              /* hash link */
-   node *nw, *ne, *sw, *se ; /* constant; nw != 0 means nonleaf */
-   node *res ;               /* cache */
+   noderef next ;              /* hash link */
+   noderef nw, ne, sw, se ;    /* constant; nw != 0 means nonleaf */
+   noderef res ;               /* cache */
+#ifdef STOREHASH
+#ifdef COMPACTNODES
+   unsigned int hashv ;        /* hash of the children, for rehashing */
+#else
+   g_uintptr_t hashv ;         /* hash of the children, for rehashing */
+#endif
+#endif
 } ;
+#ifdef COMPACTNODES
+inline noderef::noderef(node *p) : v(p ? (unsigned int)(p - nodearena) : 0) {}
+inline noderef::operator node *() const { return v ? nodearena + v : 0 ; }
+inline node *noderef::operator->() const { return nodearena + v ; }
+#endif
 /*
  *   For the 8-squares, we do not have `children', we have actual data
  *   values.  We still break up the 8-square into 4-squares, but the
@@ -121,11 +164,22 @@ struct node {
  *   so on.
  */
 struct leaf {
-   node *next ;              /* hash link */
-   node *isnode ;            /* must always be zero for leaves */
+   noderef next ;            /* hash link */
+   noderef isnode ;          /* must always be zero for leaves */
    unsigned short nw, ne, sw, se ;  /* constant */
+#ifdef COMPACTNODES
+   unsigned short leafpop ;  /* how many set bits */
+#else
    bigint leafpop ;         /* how many set bits */
+#endif
    unsigned short res1, res2 ;      /* constant */
+#ifdef STOREHASH
+#ifdef COMPACTNODES
+   unsigned int hashv ;      /* hash of the cells, for rehashing */
+#else
+   g_uintptr_t hashv ;       /* hash of the cells, for rehashing */
+#endif
+#endif
 } ;
 /*
  *   If it is a struct node, this returns a non-zero value, otherwise it
@@ -143,6 +197,13 @@ struct setup_t {
    void prefetch(node **addr) const { PREFETCH(addr) ; }
 } ;
 #endif
+/*
+ *   Worker threads (see setNumThreads) keep their own root stacks and
+ *   free lists; the details are private to hlifealgo.cpp.
+ */
+struct hlifepool ;
+struct hlifetask ;
+struct hlifetable ;
 /**
  *   Our hlifealgo class.
  */
@@ -151,8 +212,13 @@ public:
    hlifealgo() ;
    virtual ~hlifealgo() ;
    virtual int setcell(int x, int y, int newstate) ;
+   virtual int putrow(int x, int y, int n, const unsigned char *states) {
+      return setcells(x, y, n, 1, states) ;
+   }
+   virtual int setcells(int x, int y, int w, int h, const unsigned char *states) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &state) ;
+   virtual bool visitcells(int x, int y, int w, int h, cellvisitor &v) ;
    virtual void endofpattern() ;
    virtual void setIncrement(bigint inc) ;
    virtual void setIncrement(int inc) { setIncrement(bigint(inc)) ; }
@@ -178,6 +244,71 @@ public:
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) ;
    virtual const char *readmacrocell(char *line) ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) ;
+   virtual const char *readbinarymacrocell(const char *data, size_t len) ;
+   virtual const char *writeBinaryFormat(std::ostream &os, int results) ;
+   virtual void setNumThreads(int n) ;
+   /*
+    *   Save the cached results to a file, or seed the cache from one
+    *   written by an earlier run with the same rule.  Both return an
+    *   error message, or null on success.
+    */
+   const char *saveResultCache(const char *filename) ;
+   const char *loadResultCache(const char *filename) ;
+   /*
+    *   Compare the table and bit-sliced leaf evaluators on random
+    *   leaves; returns a line describing the timings.
+    */
+   const char *benchmarkLeaves(int count) ;
+   /*
+    *   Report the node hash's average probe length.
+    */
+   const char *hashStats() ;
+   /*
+    *   Results of nodes at this depth or deeper are computed in
+    *   parallel when more than one thread is in use.
+    */
+   static void setParallelDepth(int d) { pardepth = (d < 4 ? 4 : d) ; }
+   static int getParallelDepth() { return pardepth ; }
+   /*
+    *   Use an open-addressing node table instead of hash chains.
+    *   Lookups never modify it, so worker threads search, insert into,
+    *   and grow it without locks.  Applies to universes created after
+    *   the call.
+    */
+   static void setOpenHash(int v) { useopenhash = v ; }
+   static int getOpenHash() { return useopenhash ; }
+   /*
+    *   Collect garbage generationally:  when memory fills, first try
+    *   freeing only the nodes made since the last gc, and fall back to
+    *   a full gc when that doesn't free enough.  Applies to universes
+    *   created after the call.
+    */
+   static void setGenerationalGC(int v) { usegengc = v ; }
+   static int getGenerationalGC() { return usegengc ; }
+   /*
+    *   When memory is full, have the gc drop cached results that
+    *   haven't been used lately and are cheap to recompute, rather
+    *   than keeping everything they reach.  Applies to universes
+    *   created after the call.
+    */
+   static void setEvictCache(int v) { useevict = v ; }
+   static int getEvictCache() { return useevict ; }
+   /*
+    *   Compute the results of 16-squares or 32-squares directly with a
+    *   bit-parallel step, rather than memoizing everything down to the
+    *   8-square leaves.  Only for totalistic Moore rules; 8 (the
+    *   default) turns it off.  Applies to universes created after the
+    *   call.
+    */
+   static void setLeafSize(int v) { leafsize = v ; }
+   static int getLeafSize() { return leafsize ; }
+   /*
+    *   Ask for the nodes (and the hash table) to be backed by 2MB huge
+    *   pages where the system allows it.  Applies to universes created
+    *   after the call.
+    */
+   static void setHugePages(int v) { usehugepages = v ; }
+   static int getHugePages() { return usehugepages ; }
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
 private:
 /*
@@ -209,6 +340,8 @@ private:
 #endif
    static double maxloadfactor ;
    node **hashtab ;
+   int openhash ; // hashtab is an open-addressing table, not chains
+   static int useopenhash ;
    int halvesdone ;
    int gsp ;
    g_uintptr_t alloced, maxmem ;
@@ -217,6 +350,11 @@ private:
    g_uintptr_t totalthings ;
    node *nodeblocks ;
    char *ruletable ;
+   int slicedrule ; // the rule can be stepped by slicedres()
+   int slicedleaves ; // ... and dorecurs_leaf() should, with AVX2
+   unsigned long long birthmask[9], survivemask[9] ;
+   unsigned char slicecounts[9] ; // the counts that can give a live cell
+   int nslicecounts ;
    bigint population ;
    bigint setincrement ;
    bigint pow2step ; // greatest power of two in increment
@@ -238,11 +376,57 @@ private:
    g_uintptr_t writecells ; // how many to write
    int gccount ; // how many gcs total this pattern
    int gcstep ; // how many gcs this step
+/*
+ *   For the generational gc, the nodes put in the hash since the last
+ *   gc, and the nodes whose res was set since then (the only way an
+ *   older node can come to point at a younger one).
+ */
+   int gengc ;
+   static int usegengc ;
+   std::vector<node *> young, remembered ;
+   int minorpoor ; // the last minor gc freed too little
+/*
+ *   Result eviction.  Results of nodes shallower than evictdepth that
+ *   haven't been used since the last gc under pressure are dropped.
+ */
+   int evictcache, evictdepth ;
+   int evicting ; // this gc is evicting
+   g_uintptr_t evictions ;
+   static int useevict ;
+   int widedepth ; // compute results of nodes this deep and less directly
+   static int leafsize ;
+   int hugepages ;
+   static int usehugepages ;
+#ifndef COMPACTNODES
+   blockpool blocks ;
+#endif
+   g_uintptr_t cachehits, cachemisses, recomputes ;
    hperf running_hperf, step_hperf, inc_hperf ;
    int softinterrupt ;
    static char statusline[] ;
+/*
+ *   Multithreading.  While mtactive is set, every thread working on
+ *   the universe (including the main one) saves to its own stack and
+ *   allocates from its own free list; gc (and, for the chained table,
+ *   resize) only happens when all the workers have stopped at a safe
+ *   point.
+ */
+   hlifepool *pool ;
+   int mtactive ;
+   static int pardepth ;
 //
    void leafres(leaf *n) ;
+   void tableres(unsigned short nw, unsigned short ne, unsigned short sw,
+                 unsigned short se, unsigned short &res1, unsigned short &res2) ;
+   void setleafpop(leaf *n) ;
+   void leafbatch(leaf **leaves, int n) ;
+   void slicedres(const unsigned long long *in, unsigned long long *gen1,
+                  unsigned long long *gen2, int n, int avx2) ;
+   void setslicedrule() ;
+   void widerows(node *n, int depth, int r, int c, int width,
+                 unsigned long long *rows) ;
+   leaf *wideleaf(const unsigned long long *rows, int r, int c, int width) ;
+   node *widestep(node *n, int depth) ;
    void resize() ;
    node *find_node(node *nw, node *ne, node *sw, node *se) ;
 #ifdef USEPREFETCH
@@ -254,13 +438,32 @@ private:
    void rehash_node(node *n) ;
    leaf *find_leaf(unsigned short nw, unsigned short ne,
                    unsigned short sw, unsigned short se) ;
+   node *find_node_mt(node *nw, node *ne, node *sw, node *se) ;
+   leaf *find_leaf_mt(unsigned short nw, unsigned short ne,
+                      unsigned short sw, unsigned short se) ;
+   node *find_node_oa(node *nw, node *ne, node *sw, node *se,
+                      g_uintptr_t h) ;
+   leaf *find_leaf_oa(unsigned short nw, unsigned short ne,
+                      unsigned short sw, unsigned short se) ;
+   node *find_node_lf(node *nw, node *ne, node *sw, node *se) ;
+   leaf *find_leaf_lf(unsigned short nw, unsigned short ne,
+                      unsigned short sw, unsigned short se) ;
+   void growtable(hlifetable *t) ;
+   void helpmigrate(hlifetable *t) ;
+   void finishmigration() ;
    node *getres(node *n, int depth) ;
+   node *dorecurs_mt(node *n, node *ne, node *t, node *e, int depth,
+                     int half) ;
+   void getres_mt(node **n, node **res, int cnt, int depth) ;
    node *dorecurs(node *n, node *ne, node *t, node *e, int depth) ;
    node *dorecurs_half(node *n, node *ne, node *t, node *e, int depth) ;
    leaf *dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) ;
    leaf *dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) ;
    leaf *dorecurs_leaf_quarter(leaf *n, leaf *ne, leaf *t, leaf *e) ;
+   leaf *dorecurs_leaf_sliced(leaf *n, leaf *ne, leaf *t, leaf *e, int gens) ;
+   node *newblock() ;
    node *newnode() ;
+   node *newnode_mt() ;
    leaf *newleaf() ;
    node *newclearednode() ;
    leaf *newclearedleaf() ;
@@ -270,6 +473,13 @@ private:
    node *pushroot(node *n) ;
    node *make_internal_node(node *n);
    node *gsetbit(node *n, int x, int y, int newstate, int depth) ;
+   node *setrect(node *n, int x0, int y0, int x1, int y1,
+                 const unsigned char *cells, int left, int top, int stride,
+                 int depth) ;
+   void growroot(int x, int y) ;
+   bool visitband(vector<vector<pair<node *, long long> > > &bands, int depth,
+                  long long top, long long x0, long long y0, long long x1,
+                  long long y1, cellrow &row) ;
    int getbit(node *n, int x, int y, int depth) ;
    int nextbit(node *n, int x, int y, int depth) ;
    node *hashpattern(node *root, int depth) ;
@@ -280,14 +490,43 @@ private:
    void calcPopulation() ;
    node *save(node *n) ;
    void pop(int n) ;
+   int getsp() ;
    void clearstack() ;
+   void startthreads() ;
+   void stopthreads() ;
+   void killthreads() ;
+   void workerloop(int id) ;
+   void runtask(hlifetask *t) ;
+   void helpwait(int &pending) ;
+   int mtpoll() ;
+   void safepoint() ;
+   void requestsafe(int resizing) ;
+   void parkorrun(std::unique_lock<std::mutex> &lk) ;
+   void countinsert() ;
+   void foldthreads() ;
    void clearcache() ;
-   void gc_mark(node *root, int invalidate) ;
+   void gc_mark(node *root, int depth, int invalidate) ;
+   void keepres(node *n) ;
    void do_gc(int invalidate) ;
+   void finishgc(double gcstart, g_uintptr_t freed_nodes,
+                 g_uintptr_t evicted) ;
+   void gc_mark_young(node *root) ;
+   void minor_gc() ;
+   void collect() ;
+   void dropnode(node *n) ;
+   void closeholes() ;
+   void noteyoung(node *n) ;
+   void noteres(node *n) ;
    void clearcache(node *n, int depth, int clearto) ;
    void clearcache_p1(node *n, int depth, int clearto) ;
    void clearcache_p2(node *n, int depth, int clearto) ;
    void new_ngens(int newval) ;
+   void takeincrement() ;
+   int loadrecords(const unsigned short *lp, unsigned int nleaves,
+                   const unsigned int *np, unsigned int nnodes,
+                   int refs, int fngens, int whole,
+                   vector<node *> &leaves, vector<node *> &nodes,
+                   vector<unsigned char> &depths) ;
    int log2(unsigned int n) ;
    node *runpattern() ;
    void renderbm(int x, int y) ;
@@ -0,0 +1,111 @@
+// This file is part of Golly.
+// See docs/License.html for the copyright notice.
+
+#include "hltlalgo.h"
+#include <string.h>
+#include <stdio.h>
+
+using namespace std ;
+
+int hltlalgo::NumCellStates() {
+   return maxCellStates ;
+}
+
+const char* hltlalgo::DefaultRule() {
+   return stepper->DefaultRule() ;
+}
+
+const char* hltlalgo::getrule() {
+   return canonrule ;
+}
+
+/*
+ *   Every square is given to stepblock() whole (see setrange), so
+ *   nothing should ever ask for a single cell's next state.
+ */
+state hltlalgo::slowcalc(state, state, state, state, state,
+                         state, state, state, state) {
+   lifefatal("HashLtL: slowcalc should not be reached") ;
+   return 0 ;
+}
+
+/*
+ *   There is no transition function to time.
+ */
+const char *hltlalgo::benchmarkRule(int) {
+   return 0 ;
+}
+
+/*
+ *   The stepper's plane is as big as the widest block, and the cells
+ *   of a narrower one are at its left edge with nothing live
+ *   around them, so the middle always comes out right.  The left
+ *   column of a block has an even x and (as our y runs up) the top
+ *   row an odd y, which matters to triangular neighborhoods, so the
+ *   block goes in the plane's second row.
+ */
+void hltlalgo::stepblock(state *cells, int width, int gens, int) {
+   stepper->stepblock(cells, width, gens, 1) ;
+}
+
+/*
+ *   The rule is checked by a new ltlalgo, so a bad one leaves us as
+ *   we were.  Bounded grids and B0 rules are left to ltlalgo.
+ */
+const char* hltlalgo::setrule(const char* s) {
+   if (strchr(s, ':'))
+      return "HashLtL only supports an unbounded universe." ;
+   ltlalgo *t = new ltlalgo() ;
+   const char *err = t->setrule(s) ;
+   if (err == 0 && t->hasb0())
+      err = "HashLtL does not support B0." ;
+   if (err) {
+      delete t ;
+      return err ;
+   }
+   ghashbase::setrule(t->getrule()) ;
+   strcpy(canonrule, t->getrule()) ;
+   int width = setrange(t->getrange()) ;
+   char rule[MAXRULESIZE + 32] ;
+   sprintf(rule, "%s:P%d,%d", canonrule, width, width + 1) ;
+   err = t->setrule(rule) ;
+   if (err)
+      lifefatal(err) ;
+   maxCellStates = t->NumCellStates() ;
+   grid_type = t->getgridtype() ;
+   delete stepper ;
+   stepper = t ;
+   return 0 ;
+}
+
+static lifealgo *creator() { return new hltlalgo() ; }
+
+void hltlalgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
+   ghashbase::doInitializeAlgoInfo(ai) ;
+   ai.setAlgorithmName("HashLtL") ;
+   ai.setAlgorithmCreator(&creator) ;
+   ai.minstates = 2 ;
+   ai.maxstates = 256 ;
+   // init default color scheme
+   ai.defgradient = true ;              // use gradient
+   ai.defr1 = 255 ;                     // start color = yellow
+   ai.defg1 = 255 ;
+   ai.defb1 = 0 ;
+   ai.defr2 = 255 ;                     // end color = red
+   ai.defg2 = 0 ;
+   ai.defb2 = 0 ;
+   // if not using gradient then set all states to white
+   for (int i=0 ; i<256 ; i++) {
+      ai.defr[i] = ai.defg[i] = ai.defb[i] = 255 ;
+   }
+}
+
+hltlalgo::hltlalgo() {
+   canonrule[0] = 0 ;
+   stepper = new ltlalgo() ;
+   setrule(stepper->DefaultRule()) ;
+}
+
+hltlalgo::~hltlalgo() {
+   delete stepper ;
+}
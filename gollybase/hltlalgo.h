@@ -0,0 +1,38 @@
+// This file is part of Golly.
+// See docs/License.html for the copyright notice.
+
+#ifndef HLTLALGO_H
+#define HLTLALGO_H
+#include "ghashbase.h"
+#include "ltlalgo.h"
+/**
+ *   Larger than Life with hashlife.  The rules are the ones ltlalgo
+ *   takes, in an unbounded universe, and it is ltlalgo (set up with
+ *   a small bounded plane) that steps the blocks at the bottom of
+ *   the tree; everything above them is memoized as in any other
+ *   ghashbase algorithm, so periodic patterns can be run with huge
+ *   steps.
+ */
+class hltlalgo : public ghashbase {
+public:
+   hltlalgo() ;
+   virtual ~hltlalgo() ;
+   virtual state slowcalc(state nw, state n, state ne, state w, state c,
+                          state e, state sw, state s, state se) ;
+   virtual const char* setrule(const char* s) ;
+   virtual const char* getrule() ;
+   virtual const char* DefaultRule() ;
+   virtual int NumCellStates() ;
+   virtual int NumRandomizedCellStates() { return 2 ; }
+   virtual const char *benchmarkRule(int count) ;
+   static void doInitializeAlgoInfo(staticAlgoInfo &) ;
+
+protected:
+   virtual void stepblock(state *cells, int width, int gens, int margin) ;
+
+private:
+   char canonrule[MAXRULESIZE] ;      // canonical version of valid rule passed into setrule
+   ltlalgo *stepper ;                 // steps the blocks
+} ;
+
+#endif
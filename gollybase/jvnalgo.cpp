@@ -245,6 +245,11 @@ state jvnalgo::slowcalc(state, state n, state, state w, state c, state e,
    	return slowcalc_Hutton32(c,n,s,e,w);
 }
 
+void jvnalgo::steprow(const state *above, const state *here,
+                      const state *below, state *out, int count) {
+   steprowof(this, above, here, below, out, count) ;
+}
+
 // XPM data for the 31 7x7 icons used in JvN algo
 static const char* jvn7x7[] = {
 // width height ncolors chars_per_pixel
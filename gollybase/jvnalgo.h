@@ -13,6 +13,8 @@ public:
    virtual ~jvnalgo() ;
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
                           state e, state sw, state s, state se) ;
+   virtual void steprow(const state *above, const state *here,
+                        const state *below, state *out, int count) ;
    virtual const char* setrule(const char* s) ;
    virtual const char* getrule() ;
    virtual const char* DefaultRule() ;
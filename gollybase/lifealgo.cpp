@@ -3,6 +3,7 @@
 
 #include "lifealgo.h"
 #include "util.h"       // for lifestatus
+#include "liferules.h"  // for MAXRULESIZE
 #include "string.h"
 using namespace std ;
 lifealgo::~lifealgo() {
@@ -794,23 +795,28 @@ bool lifealgo::CreateBorderCells()
     return true;
 }
 
-void lifealgo::ClearRect(int top, int left, int bottom, int right)
-{
-    int cx, cy, v;
-    for ( cy = top; cy <= bottom; cy++ ) {
-        for ( cx = left; cx <= right; cx++ ) {
-            int skip = nextcell(cx, cy, v);
-            if (skip + cx > right)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell so delete it
-                cx += skip;
-                setcell(cx, cy, 0);
-            } else {
-                cx = right + 1;     // done this row
+// gathers the live cells handed to it as x,y pairs
+class cellgatherer : public cellvisitor {
+public:
+    virtual bool visit(int x, int y, int n, const unsigned char *states) {
+        for (int i = 0; i < n; i++) {
+            if (states[i]) {
+                cells.push_back(x + i);
+                cells.push_back(y);
             }
         }
+        return true;
     }
+    vector<int> cells;
+};
+
+void lifealgo::ClearRect(int top, int left, int bottom, int right)
+{
+    // find the live cells first, since they can't be deleted in the walk
+    cellgatherer g;
+    visitcells(left, top, right - left + 1, bottom - top + 1, g);
+    for (size_t i = 0; i < g.cells.size(); i += 2)
+        setcell(g.cells[i], g.cells[i+1], 0);
 }
 
 bool lifealgo::DeleteBorderCells()
@@ -884,6 +890,133 @@ void lifealgo::getcells(unsigned char *buf, int x, int y, int w, int h) {
    draw(vp, hsr) ;
 }
 
+int lifealgo::putrow(int x, int y, int n, const unsigned char *states) {
+   for (int i=0; i<n; i++)
+      if (states[i] && setcell(x+i, y, states[i]) < 0)
+         return -1 ;
+   return 0 ;
+}
+
+int lifealgo::setcells(int x, int y, int w, int h, const unsigned char *states) {
+   for (int j=0; j<h; j++)
+      if (putrow(x, y+j, w, states + (size_t)j * w) < 0)
+         return -1 ;
+   return 0 ;
+}
+
+/*
+ *   The default walks each row with nextcell.
+ */
+bool lifealgo::visitcells(int x, int y, int w, int h, cellvisitor &v) {
+   cellrow row(v) ;
+   int right = (long long)x + w - 1 > INT_MAX ? INT_MAX : x + w - 1 ;
+   int bottom = (long long)y + h - 1 > INT_MAX ? INT_MAX : y + h - 1 ;
+   for (long long cy=y; cy<=bottom; cy++) {
+      for (long long cx=x; cx<=right; cx++) {
+         int state ;
+         int skip = nextcell((int)cx, (int)cy, state) ;
+         if (skip < 0 || cx + skip > right)
+            break ;
+         cx += skip ;
+         row.add((int)cx, (int)cy, state) ;
+      }
+      if (!row.flush())
+         return false ;
+   }
+   return true ;
+}
+/*
+ *   Cells close together in a row are gathered up (with the dead cells
+ *   between them) and handed to putrow together.
+ */
+int lifealgo::putcells(const int *cells, int ncells, bool multistate) {
+   const int maxgap = 32 ;
+   int per = multistate ? 3 : 2 ;
+   vector<unsigned char> row ;
+   int rowx = 0, rowy = 0 ;
+   for (int i=0; i<ncells; i++) {
+      const int *c = cells + i * per ;
+      int newstate = multistate ? c[2] : 1 ;
+      if (newstate == 0)
+         continue ;
+      if (newstate < 0 || newstate > 255)
+         return -1 ;
+      if (row.empty() || c[1] != rowy || c[0] < rowx ||
+          c[0] - (rowx + (int)row.size()) > maxgap) {
+         if (!row.empty() && putrow(rowx, rowy, (int)row.size(), &row[0]) < 0)
+            return -1 ;
+         row.clear() ;
+         rowx = c[0] ;
+         rowy = c[1] ;
+      }
+      if (c[0] - rowx >= (int)row.size())
+         row.resize(c[0] - rowx + 1, 0) ;
+      row[c[0] - rowx] = (unsigned char)newstate ;
+   }
+   if (!row.empty() && putrow(rowx, rowy, (int)row.size(), &row[0]) < 0)
+      return -1 ;
+   return 0 ;
+}
+
+// -----------------------------------------------------------------------------
+
+static const char mcbmagic[8] = { 'G', 'o', 'l', 'l', 'y', 'M', 'B', '1' } ;
+
+bool ismcb(const char *data, size_t len) {
+   return len >= sizeof(mcbmagic) && memcmp(data, mcbmagic, sizeof(mcbmagic)) == 0 ;
+}
+
+// the strings are padded with at least one nul
+static size_t mcbpad(size_t len) {
+   return (len + 4) & ~(size_t)3 ;
+}
+
+const char *checkmcb(const char *data, size_t len, unsigned int leafsize,
+                     const char *&rule, const char *&gen,
+                     const char *&leaves, const unsigned int *&nodes) {
+   const mcbhead *h = (const mcbhead *)data ;
+   if (!ismcb(data, len))
+      return "Not a binary macrocell file." ;
+   if (len < sizeof(mcbhead) || h->headsize != sizeof(mcbhead))
+      return "Unsupported binary macrocell file." ;
+   if (h->order != 0x04030201U)
+      return "Binary macrocell file has the wrong byte order." ;
+   if (h->leafsize != leafsize)
+      return "Binary macrocell file is for a different algorithm." ;
+   if ((h->noderefs != 4 && h->noderefs != 5) || h->nnodes >= MCBLEAF ||
+       h->nleaves >= MCBLEAF ||
+       (h->noderefs == 5 && (h->ngens < 0 || h->ngens > MCBMAXNGENS)))
+      return "Invalid binary macrocell file." ;
+   size_t off = sizeof(mcbhead) ;
+   rule = data + off ;
+   off += mcbpad(h->rulelen) ;
+   gen = data + off ;
+   off += mcbpad(h->genlen) ;
+   leaves = data + off ;
+   off += (size_t)h->nleaves * leafsize ;
+   nodes = (const unsigned int *)(data + off) ;
+   off += (size_t)h->nnodes * h->noderefs * sizeof(unsigned int) ;
+   if (len < off || h->rulelen >= MAXRULESIZE ||
+       rule[h->rulelen] != 0 || gen[h->genlen] != 0)
+      return "Truncated binary macrocell file." ;
+   return 0 ;
+}
+
+void writemcbhead(std::ostream &os, mcbhead &h, const char *rule,
+                  const char *gen) {
+   static const char pad[4] = { 0, 0, 0, 0 } ;
+   memcpy(h.magic, mcbmagic, sizeof(h.magic)) ;
+   h.order = 0x04030201U ;
+   h.headsize = sizeof(mcbhead) ;
+   h.rulelen = (unsigned int)strlen(rule) ;
+   h.genlen = (unsigned int)strlen(gen) ;
+   os.write((const char *)&h, sizeof(h)) ;
+   os.write(rule, h.rulelen) ;
+   os.write(pad, mcbpad(h.rulelen) - h.rulelen) ;
+   os.write(gen, h.genlen) ;
+   os.write(pad, mcbpad(h.genlen) - h.genlen) ;
+}
+
 // -----------------------------------------------------------------------------
 
 int staticAlgoInfo::nextAlgoId = 0 ;
@@ -42,10 +42,93 @@ public:
    vector<void *> frames ;
 } ;
 
+/**
+ *   The binary macrocell format.  After the header come the rule and
+ *   the generation (each nul terminated and padded to a multiple of
+ *   four bytes), then the leaves (leafsize bytes each) and then the
+ *   nodes (noderefs ints each: nw, ne, sw, se and, if there are five,
+ *   the node's result).  Numbers are in the writer's byte order (in
+ *   practice little-endian; order catches the rest).  A node always
+ *   comes after its children and its result, so a reader can map the
+ *   file and canonicalize the records in the order they lie.
+ *   References count from 1 (0 is no result), with MCBLEAF set for
+ *   leaves; results are for a step of 2^ngens (see hlifealgo), which
+ *   is only meaningful when there are results.  Depths fit in a byte,
+ *   so an ngens above MCBMAXNGENS means no more than MCBMAXNGENS does.
+ */
+struct mcbhead {
+   char magic[8] ;
+   unsigned int order ;    // 0x04030201
+   unsigned int headsize ; // guards against a different layout
+   unsigned int rulelen, genlen ;
+   unsigned int leafsize, noderefs ;
+   unsigned int nleaves, nnodes ;
+   unsigned int root ;
+   int ngens ;
+} ;
+const unsigned int MCBLEAF = 0x80000000U ;
+const int MCBMAXNGENS = 255 ;
+bool ismcb(const char *data, size_t len) ;
+const char *checkmcb(const char *data, size_t len, unsigned int leafsize,
+                     const char *&rule, const char *&gen,
+                     const char *&leaves, const unsigned int *&nodes) ;
+// check the header and the length, and find the parts
+void writemcbhead(std::ostream &os, mcbhead &h, const char *rule,
+                  const char *gen) ;
+// fill in the rest of the header and write it along with the strings
+
+/**
+ *   The live cells of a rectangle are handed to a cellvisitor (see
+ *   lifealgo::visitcells) in row-major order: rows from top to bottom,
+ *   and each row from left to right.  Each call gets a piece of one
+ *   row, n states from x, that starts and ends with a live cell but
+ *   may have short runs of dead cells in between.  Returning false
+ *   stops the walk.
+ */
+class cellvisitor {
+public:
+   virtual ~cellvisitor() {}
+   virtual bool visit(int x, int y, int n, const unsigned char *states) = 0 ;
+} ;
+
+/**
+ *   Gathers live cells, given in row-major order, into the pieces a
+ *   cellvisitor is handed; cells more than maxgap apart are split.
+ */
+class cellrow {
+public:
+   cellrow(cellvisitor &v) : stopped(false), visitor(v), x(0), y(0) {}
+   void add(int cx, int cy, int state) {
+      if (!cells.empty() &&
+          (cy != y || (long long)cx - x - (long long)cells.size() > maxgap))
+         flush() ;
+      if (cells.empty()) {
+         x = cx ;
+         y = cy ;
+      }
+      cells.resize(cx - x, 0) ;
+      cells.push_back((unsigned char)state) ;
+   }
+   // hand over the cells gathered so far; returns false once stopped
+   bool flush() {
+      if (!cells.empty() && !stopped)
+         stopped = !visitor.visit(x, y, (int)cells.size(), &cells[0]) ;
+      cells.clear() ;
+      return !stopped ;
+   }
+   bool stopped ;
+private:
+   static const int maxgap = 32 ;
+   cellvisitor &visitor ;
+   vector<unsigned char> cells ;
+   int x, y ;
+} ;
+
 class lifealgo {
 public:
    lifealgo() : generation(0), increment(0), timeline(), grid_type(SQUARE_GRID)
       {  poller = &default_poller ;
+         numthreads = 1 ;
          gridwd = gridht = 0 ;      // default is an unbounded universe
          unbounded = true ;         // most algorithms use an unbounded universe
       }
@@ -55,6 +138,18 @@ public:
    virtual int getcell(int x, int y) = 0 ;
    virtual int nextcell(int x, int y, int &v) = 0 ;
    void getcells(unsigned char *buf, int x, int y, int w, int h) ;
+   // bulk versions of setcell: dead cells are skipped (not cleared),
+   // and they return <0 if error; putrow sets n cells in a row from x,
+   // setcells the w*h cells (row by row) with the top left at x,y,
+   // and putcells a cell list (x,y pairs, or x,y,state triples if
+   // multistate) whose cells are best sorted by y and then x
+   virtual int putrow(int x, int y, int n, const unsigned char *states) ;
+   virtual int setcells(int x, int y, int w, int h, const unsigned char *states) ;
+   int putcells(const int *cells, int ncells, bool multistate) ;
+   // bulk version of nextcell: hands the live cells of the w*h cells
+   // with the top left at x,y to v (see cellvisitor) in one walk of
+   // the universe; returns false if v stopped it
+   virtual bool visitcells(int x, int y, int w, int h, cellvisitor &v) ;
    // call after setcell calls
    virtual void endofpattern() = 0 ;
    virtual void setIncrement(bigint inc) = 0 ;
@@ -77,7 +172,19 @@ public:
    virtual void lowerRightPixel(bigint &x, bigint &y, int mag) = 0 ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) = 0 ;
    void setpoll(lifepoll *pollerarg) { poller = pollerarg ; }
+   // how many threads step() may use; algorithms that can spread the
+   // work of a step over several cores override this
+   virtual void setNumThreads(int n) { numthreads = (n < 1 ? 1 : n) ; }
+   int getNumThreads() { return numthreads ; }
    virtual const char *readmacrocell(char *) { return "Cannot read macrocell format." ; }
+   // the binary macrocell format (see mcbhead); the reader is handed
+   // the whole file, and the writer can add the results of the nodes
+   virtual const char *readbinarymacrocell(const char *, size_t) {
+      return "Cannot read binary macrocell format." ;
+   }
+   virtual const char *writeBinaryFormat(std::ostream &, int) {
+      return "No binary macrocell format for this algorithm." ;
+   }
    
    // Verbosity crosses algorithms.  We need to embed this sort of option
    // into some global shared thing or something rather than use static.
@@ -154,6 +261,7 @@ protected:
    bigint increment ;
    timeline_t timeline ;
    TGridType grid_type ;
+   int numthreads ;
 
 private:
    // following are called by CreateBorderCells() to join edges in various ways
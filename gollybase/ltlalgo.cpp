@@ -11,6 +11,9 @@
 #include <limits.h>     // for INT_MIN and INT_MAX
 #include <string.h>     // for memset and strchr
 #include <cstddef>      // for ptrdiff_t
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // -----------------------------------------------------------------------------
 
@@ -31,6 +34,16 @@ static const int MAXNCOLS = 2 * MAXRANGE + 1;
 // range is 1 or 2, similar when 5, but much faster when 10 or above
 #define SMALL_NN_RANGE 4
 
+// an unbounded universe is divided into square tiles (at least TILESIZE cells wide)
+// every SPLITGENS generations to find the clusters of live cells that can be
+// processed separately (see split_regions and do_unbounded_gen)
+#define TILESIZE 64
+#define SPLITGENS 64
+
+// rectangles with fewer cells than this are processed by a single thread
+// (waking the worker threads costs more than they would save)
+#define PARCELLS 32768
+
 // valid neighborhoods (upper case)
 static const char *VALIDNEIGHBORHOODS = "MNC+X*2HBD#@3ALGW";
 
@@ -39,6 +52,221 @@ static const char *HEXCHARACTERS = "0123456789ABCDEF";
 
 // -----------------------------------------------------------------------------
 
+// The faster_Moore_* routines spend most of their time adding rows of
+// colcounts together (when calculating the cumulative counts) and combining
+// the four corners of each cell's box (when calculating the final counts).
+// Where possible both are done a vector of ints at a time: 4 lanes with plain
+// GCC vectors (SSE2 on x86, NEON elsewhere) or 8 lanes in AVX2 code chosen at
+// run time.  Without vectors (kernel 0, or a compiler other than GCC/clang)
+// the cumulative counts are done a cell at a time and the corners of each box
+// are only combined when they're needed, as the original code did.
+
+#ifdef __GNUC__
+#define LTLVECTORS
+typedef int ltlvec __attribute__((vector_size(16)));
+#if defined(__x86_64__) || defined(__i386__)
+#define LTLAVX2
+typedef int ltlvec8 __attribute__((vector_size(32)));
+#endif
+#define LTLINLINE static inline __attribute__((always_inline))
+#else
+#define LTLINLINE static inline
+#endif
+
+template <class T>
+LTLINLINE void add_row(int* row, const int* prev, int n)
+{
+    // row[k] += prev[k] for 0 <= k < n
+    const int lanes = (int)(sizeof(T) / sizeof(int));
+    int k = 0;
+    for ( ; k + lanes <= n; k += lanes) {
+        T a, b;
+        memcpy(&a, row + k, sizeof(T));
+        memcpy(&b, prev + k, sizeof(T));
+        a += b;
+        memcpy(row + k, &a, sizeof(T));
+    }
+    for ( ; k < n; k++) row[k] += prev[k];
+}
+
+template <class T>
+LTLINLINE void prefix_row(const unsigned char* cells, const int* prev, int* out, int n)
+{
+    // out[k] = prev[k] + number of state-1 cells in cells[0..k] for 0 <= k < n
+    // (prev is NULL for the first row); 8 cell chunks with no live cells all get
+    // the same count so they are done a vector at a time
+    const int lanes = (int)(sizeof(T) / sizeof(int));
+    const unsigned long long ones = 0x0101010101010101ULL;
+    const unsigned long long low7 = 0x7f7f7f7f7f7f7f7fULL;
+    int rowcount = 0;
+    int k = 0;
+    for ( ; k + 8 <= n; k += 8) {
+        unsigned long long chunk;
+        memcpy(&chunk, cells + k, 8);
+        if (chunk) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            // set each byte to 1 if its cell is in state 1 (otherwise 0) and then
+            // multiplying by ones puts the running count of the chunk in each byte,
+            // so the counts don't depend on each other
+            unsigned long long notone = chunk ^ ones;
+            notone |= (notone & low7) + low7;
+            unsigned long long sums = ((~notone & ~low7) >> 7) * ones;
+            for (int m = 0; m < 8; m++) {
+                int count = rowcount + (int)((sums >> (8 * m)) & 0xff);
+                out[k+m] = prev ? prev[k+m] + count : count;
+            }
+            rowcount += (int)(sums >> 56);
+#else
+            for (int m = k; m < k + 8; m++) {
+                if (cells[m] == 1) rowcount++;
+                out[m] = prev ? prev[m] + rowcount : rowcount;
+            }
+#endif
+        } else {
+            T counts = T() + rowcount;
+            for (int m = k; m < k + 8; m += lanes) {
+                T v = counts;
+                if (prev) {
+                    T p;
+                    memcpy(&p, prev + m, sizeof(T));
+                    v += p;
+                }
+                memcpy(out + m, &v, sizeof(T));
+            }
+        }
+    }
+    for ( ; k < n; k++) {
+        if (cells[k] == 1) rowcount++;
+        out[k] = prev ? prev[k] + rowcount : rowcount;
+    }
+}
+
+template <class T>
+LTLINLINE void box_sums(const int* hirow, const int* lorow, int hi, int lo, int* out, int n)
+{
+    // out[k] is the number of state-1 cells in the box with corners at
+    // hirow[k+hi] and lorow[k+lo] (see faster_Moore_*)
+    const int lanes = (int)(sizeof(T) / sizeof(int));
+    int k = 0;
+    for ( ; k + lanes <= n; k += lanes) {
+        T a, b, c, d;
+        memcpy(&a, hirow + k + hi, sizeof(T));
+        memcpy(&b, lorow + k + lo, sizeof(T));
+        memcpy(&c, hirow + k + lo, sizeof(T));
+        memcpy(&d, lorow + k + hi, sizeof(T));
+        a = a + b - c - d;
+        memcpy(out + k, &a, sizeof(T));
+    }
+    for ( ; k < n; k++) out[k] = hirow[k+hi] + lorow[k+lo] - hirow[k+lo] - lorow[k+hi];
+}
+
+#ifdef LTLAVX2
+__attribute__((target("avx2")))
+static void add_row_avx2(int* row, const int* prev, int n)
+{
+    add_row<ltlvec8>(row, prev, n);
+}
+
+__attribute__((target("avx2")))
+static void prefix_row_avx2(const unsigned char* cells, const int* prev, int* out, int n)
+{
+    prefix_row<ltlvec8>(cells, prev, out, n);
+}
+
+__attribute__((target("avx2")))
+static void box_sums_avx2(const int* hirow, const int* lorow, int hi, int lo, int* out, int n)
+{
+    box_sums<ltlvec8>(hirow, lorow, hi, lo, out, n);
+}
+
+static int hasavx2() {
+    static int avx2 = -1;
+    if (avx2 < 0) avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return avx2;
+}
+#else
+static int hasavx2() { return 0; }
+#endif
+
+static void add_row(int kernel, int* row, const int* prev, int n)
+{
+#ifdef LTLAVX2
+    if (kernel > 1) { add_row_avx2(row, prev, n); return; }
+#endif
+#ifdef LTLVECTORS
+    if (kernel > 0) { add_row<ltlvec>(row, prev, n); return; }
+#endif
+    add_row<int>(row, prev, n);
+}
+
+static void prefix_row(int kernel, const unsigned char* cells, const int* prev, int* out, int n)
+{
+#ifdef LTLAVX2
+    if (kernel > 1) { prefix_row_avx2(cells, prev, out, n); return; }
+#endif
+#ifdef LTLVECTORS
+    if (kernel > 0) { prefix_row<ltlvec>(cells, prev, out, n); return; }
+#endif
+    // a cell at a time like the original code (skipping 8 cell chunks with
+    // no live cells), which beats the vector version run on plain ints
+    int rowcount = 0;
+    int k = 0;
+    if (prev) {
+        for ( ; k + 8 <= n; k += 8) {
+            unsigned long long chunk;
+            memcpy(&chunk, cells + k, 8);
+            if (chunk) {
+                for (int m = k; m < k + 8; m++) {
+                    rowcount += cells[m] == 1;
+                    out[m] = prev[m] + rowcount;
+                }
+            } else {
+                for (int m = k; m < k + 8; m++) out[m] = prev[m] + rowcount;
+            }
+        }
+        for ( ; k < n; k++) {
+            rowcount += cells[k] == 1;
+            out[k] = prev[k] + rowcount;
+        }
+    } else {
+        for ( ; k < n; k++) {
+            rowcount += cells[k] == 1;
+            out[k] = rowcount;
+        }
+    }
+}
+
+static void box_sums(int kernel, const int* hirow, const int* lorow, int hi, int lo, int* out, int n)
+{
+#ifdef LTLAVX2
+    if (kernel > 1) { box_sums_avx2(hirow, lorow, hi, lo, out, n); return; }
+#endif
+#ifdef LTLVECTORS
+    if (kernel > 0) { box_sums<ltlvec>(hirow, lorow, hi, lo, out, n); return; }
+#endif
+    box_sums<int>(hirow, lorow, hi, lo, out, n);
+}
+
+int ltlalgo::maxkernel = 2;
+
+// -----------------------------------------------------------------------------
+
+// The worker threads used by run_bands.  Bands are handed out in order to
+// whichever thread asks first (including the main thread).
+
+struct ltlpool {
+    std::mutex m;                       // protects everything below but threads
+    std::condition_variable cv;         // signals a new pass or a finished one
+    std::vector<std::thread> threads;
+    void (ltlalgo::*job)(int);          // routine to call for each band
+    int nextband;                       // next band to hand out
+    int nbands;                         // number of bands in the current pass
+    int pending;                        // bands not finished yet
+    bool shutdown;                      // tells the workers to exit
+};
+
+// -----------------------------------------------------------------------------
+
 // Create a new empty universe.
 
 ltlalgo::ltlalgo()
@@ -62,6 +290,12 @@ ltlalgo::ltlalgo()
     stateweights = NULL;
     customneighborhood = NULL;
     customlength = 0;
+    pool = NULL;
+    kernel = maxkernel < 0 ? 0 : maxkernel > 2 ? 2 : maxkernel;
+    if (kernel > 1 && !hasavx2()) kernel = 1;
+#ifndef LTLVECTORS
+    kernel = 0;
+#endif
 }
 
 // -----------------------------------------------------------------------------
@@ -83,6 +317,7 @@ static int bitcount(int v) {
 
 ltlalgo::~ltlalgo()
 {
+    killthreads();
     free(outergrid1);
     if (outergrid2) free(outergrid2);
     if (colcounts) free(colcounts);
@@ -176,6 +411,11 @@ void ltlalgo::create_grids(int wd, int ht)
     
     // init boundaries so next birth will change them
     empty_boundaries();
+
+    // active regions will be found in the next do_unbounded_gen call
+    regions.clear();
+    regionsvalid = false;
+    regionage = 0;
 }
 
 // -----------------------------------------------------------------------------
@@ -253,6 +493,13 @@ const char* ltlalgo::resize_grids(int up, int down, int left, int right)
         maxx += left;
         miny += up;
         maxy += up;
+        // and the active regions
+        for (size_t i = 0; i < regions.size(); i++) {
+            regions[i].minx += left;
+            regions[i].maxx += left;
+            regions[i].miny += up;
+            regions[i].maxy += up;
+        }
     }
     
     free(outergrid1);
@@ -294,12 +541,11 @@ const char* ltlalgo::resize_grids(int up, int down, int left, int right)
 
 // -----------------------------------------------------------------------------
 
-// Set the cell at the given location to the given state.
+// Make sure the given cell is inside the grid, resizing an unbounded universe
+// if need be.  Returns false if the cell can't be set.
 
-int ltlalgo::setcell(int x, int y, int newstate)
+bool ltlalgo::makeroom(int x, int y)
 {
-    if (newstate < 0 || newstate >= maxCellStates) return -1;
-    
     if (unbounded) {
         // check if universe needs to be expanded
         if (x < gleft || x > gright || y < gtop || y > gbottom) {
@@ -341,15 +587,26 @@ int ltlalgo::setcell(int x, int y, int newstate)
                     // (this avoids user having to close thousands of dialog boxes
                     // if they attempted to paste a large pattern)
                     show_warning = false;
-                    return -1;
+                    return false;
                 }
             }
         }
     } else {
         // check if x,y is outside bounded universe
-        if (x < gleft || x > gright) return -1;
-        if (y < gtop || y > gbottom) return -1;
+        if (x < gleft || x > gright) return false;
+        if (y < gtop || y > gbottom) return false;
     }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+// Set the cell at the given location to the given state.
+
+int ltlalgo::setcell(int x, int y, int newstate)
+{
+    if (newstate < 0 || newstate >= maxCellStates) return -1;
+    if (!makeroom(x, y)) return -1;
 
     // set x,y cell in currgrid
     int gx = x - gleft;
@@ -358,6 +615,7 @@ int ltlalgo::setcell(int x, int y, int newstate)
     int oldstate = *cellptr;
     if (newstate != oldstate) {
         *cellptr = (unsigned char)newstate;
+        regionsvalid = false;
         // population might change
         if (oldstate == 0 && newstate > 0) {
             population++;
@@ -376,6 +634,49 @@ int ltlalgo::setcell(int x, int y, int newstate)
 
 // -----------------------------------------------------------------------------
 
+// Set n cells in a row, skipping dead ones, with only one grid check.
+
+int ltlalgo::putrow(int x, int y, int n, const unsigned char* states)
+{
+    for (int i = 0; i < n; i++) {
+        if (states[i] >= maxCellStates) return -1;
+    }
+    // skip dead cells at both ends
+    while (n > 0 && states[n-1] == 0) n--;
+    while (n > 0 && states[0] == 0) {
+        x++;
+        states++;
+        n--;
+    }
+    if (n == 0) return 0;
+    if (!unbounded && (x < gleft || x + n - 1 > gright)) {
+        // let setcell clip the row to the bounded universe
+        return lifealgo::putrow(x, y, n, states);
+    }
+
+    // setting the first cell means an empty grid won't be re-centered
+    // when it's made big enough for the last one
+    if (setcell(x, y, states[0]) < 0) return -1;
+    if (!makeroom(x + n - 1, y)) return -1;
+
+    int gx = x - gleft;
+    int gy = y - gtop;
+    unsigned char* cellptr = currgrid + gy * outerwd + gx;
+    for (int i = 1; i < n; i++) {
+        if (states[i] == 0) continue;
+        if (cellptr[i] == 0) {
+            population++;
+            if (gx + i > maxx) maxx = gx + i;
+        }
+        cellptr[i] = states[i];
+    }
+    regionsvalid = false;
+    
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 // Get the state of the cell at the given location.
 
 int ltlalgo::getcell(int x, int y)
@@ -437,6 +738,37 @@ int ltlalgo::nextcell(int x, int y, int& v)
 
 // -----------------------------------------------------------------------------
 
+// Hand the live cells in the given rectangle to the visitor, scanning only
+// the part of the grid inside the boundary of live cells.
+
+bool ltlalgo::visitcells(int x, int y, int w, int h, cellvisitor& v)
+{
+    if (population == 0 || w <= 0 || h <= 0) return true;
+
+    // clip to the live cells (in grid coordinates)
+    long long left = (long long)x - gleft;
+    long long top = (long long)y - gtop;
+    long long right = left + w - 1;
+    long long bottom = top + h - 1;
+    if (left < minx) left = minx;
+    if (top < miny) top = miny;
+    if (right > maxx) right = maxx;
+    if (bottom > maxy) bottom = maxy;
+
+    cellrow row(v);
+    for (int gy = (int)top; gy <= bottom; gy++) {
+        unsigned char* cellptr = currgrid + gy * outerwd;
+        for (int gx = (int)left; gx <= right; gx++) {
+            if (cellptr[gx]) row.add(gx + gleft, gy + gtop, cellptr[gx]);
+        }
+        if (!row.flush()) return false;
+    }
+    
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
 static bigint bigpop;
 
 const bigint& ltlalgo::getPopulation()
@@ -554,6 +886,325 @@ void ltlalgo::update_next_grid(int x, int y, int xyoffset, int ncount)
 
 // -----------------------------------------------------------------------------
 
+// Return the new state of a cell with the given state and neighbor count
+// and add any change in population to popdelta (update_current_grid is the
+// same but changes population, so it can't be used in a worker thread).
+
+static inline unsigned char next_state(unsigned char state, int ncount,
+                                       const unsigned char* births,
+                                       const unsigned char* survivals,
+                                       int maxstates, int& popdelta)
+{
+    if (state == 0) {
+        if (births[ncount]) {
+            popdelta++;
+            return 1;
+        }
+    } else if (state == 1) {
+        if (!survivals[ncount]) {
+            if (maxstates > 2) return 2;
+            popdelta--;
+            return 0;
+        }
+    } else {
+        if (state + 1 < maxstates) return state + 1;
+        popdelta--;
+        return 0;
+    }
+    return state;
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::setNumThreads(int n)
+{
+    poller->bailIfCalculating();
+    lifealgo::setNumThreads(n);
+    killthreads();      // the pool is recreated by the next multithreaded pass
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::killthreads()
+{
+    if (pool == NULL) return;
+    {
+        std::lock_guard<std::mutex> lk(pool->m);
+        pool->shutdown = true;
+        pool->cv.notify_all();
+    }
+    for (size_t i = 0; i < pool->threads.size(); i++) pool->threads[i].join();
+    delete pool;
+    pool = NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::workerloop()
+{
+    ltlpool* p = pool;
+    std::unique_lock<std::mutex> lk(p->m);
+    while (!p->shutdown) {
+        if (p->nextband >= p->nbands) {
+            p->cv.wait(lk);
+            continue;
+        }
+        int b = p->nextband++;
+        lk.unlock();
+        (this->*(p->job))(b);
+        lk.lock();
+        if (--p->pending == 0) p->cv.notify_all();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::split_bands(int first, int last, int cellsperrow)
+{
+    // split the given rows into one band per thread, or a single band if there
+    // are too few cells to make using the worker threads worthwhile
+    int rows = last - first + 1;
+    int n = 1;
+    if (numthreads > 1 && (double)rows * cellsperrow >= PARCELLS) {
+        n = numthreads;
+        if (n > rows) n = rows;
+    }
+    bands.resize(n);
+    for (int b = 0; b < n; b++) {
+        ltlband& band = bands[b];
+        band.first = first + (int)((double)rows * b / n);
+        band.last = first + (int)((double)rows * (b + 1) / n) - 1;
+        band.popdelta = 0;
+        band.minx = INT_MAX;
+        band.miny = INT_MAX;
+        band.maxx = INT_MIN;
+        band.maxy = INT_MIN;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::run_bands(void (ltlalgo::*band)(int))
+{
+    // call the given routine for each band (in parallel if there is more than one)
+    // and wait until they have all finished
+    int n = (int)bands.size();
+    if (n == 1) {
+        (this->*band)(0);
+        return;
+    }
+    
+    if (pool == NULL) {
+        pool = new ltlpool;
+        pool->nextband = pool->nbands = pool->pending = 0;
+        pool->shutdown = false;
+        for (int i = 1; i < numthreads; i++) {
+            pool->threads.push_back(std::thread(&ltlalgo::workerloop, this));
+        }
+    }
+    ltlpool* p = pool;
+    std::unique_lock<std::mutex> lk(p->m);
+    p->job = band;
+    p->nextband = 0;
+    p->nbands = n;
+    p->pending = n;
+    p->cv.notify_all();
+    
+    // the main thread does bands too
+    while (p->nextband < n) {
+        int b = p->nextband++;
+        lk.unlock();
+        (this->*band)(b);
+        lk.lock();
+        p->pending--;
+    }
+    while (p->pending > 0) p->cv.wait(lk);
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::merge_bands()
+{
+    // the population and boundary are the same as if the bands had been done in
+    // order by a single thread: a band's live cells can only be killed by that
+    // band, so if the population ever dropped to 0 it stays 0 at the end
+    for (size_t b = 0; b < bands.size(); b++) {
+        ltlband& band = bands[b];
+        population += band.popdelta;
+        if (band.minx <= band.maxx) {
+            if (band.minx < minx) minx = band.minx;
+            if (band.maxx > maxx) maxx = band.maxx;
+            if (band.miny < miny) miny = band.miny;
+            if (band.maxy > maxy) maxy = band.maxy;
+        }
+    }
+    if (population == 0) empty_boundaries();
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::column_counts(int mincol, int minrow, int maxcol, int maxrow)
+{
+    // calculate cumulative counts of state-1 cells in the given rectangle of
+    // outergrid1 and store them in colcounts, so each entry is the number of
+    // state-1 cells in the rectangle above and to the left of it (inclusive);
+    // each band starts from zero and then the counts at the bottom of the
+    // bands above are added on
+    int width = maxcol - mincol + 1;
+    pass.mincol = mincol;
+    pass.maxcol = maxcol;
+    split_bands(minrow, maxrow, width);
+    run_bands(&ltlalgo::prefix_band);
+    if (bands.size() > 1) {
+        for (size_t b = 1; b < bands.size(); b++) {
+            int* lastrow = colcounts + bands[b].last * outerwd + mincol;
+            add_row(kernel, lastrow, colcounts + bands[b-1].last * outerwd + mincol, width);
+        }
+        run_bands(&ltlalgo::carry_band);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::prefix_band(int b)
+{
+    // calculate cumulative counts for the rows in this band
+    ltlband& band = bands[b];
+    int width = pass.maxcol - pass.mincol + 1;
+    for (int i = band.first; i <= band.last; i++) {
+        int* ccptr = colcounts + i * outerwd + pass.mincol;
+        prefix_row(kernel, outergrid1 + i * outerwd + pass.mincol,
+                   i > band.first ? ccptr - outerwd : NULL, ccptr, width);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::carry_band(int b)
+{
+    // add the counts in the bottom row of the band above (which column_counts
+    // has already completed) to the other rows in this band
+    if (b == 0) return;
+    ltlband& band = bands[b];
+    int width = pass.maxcol - pass.mincol + 1;
+    const int* carry = colcounts + bands[b-1].last * outerwd + pass.mincol;
+    for (int i = band.first; i < band.last; i++) {
+        add_row(kernel, colcounts + i * outerwd + pass.mincol, carry, width);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::moore_band(int b)
+{
+    // calculate final Moore neighborhood counts for the rows in this band using
+    // the values in colcounts and update the corresponding cells in currgrid
+    // (locals are used because stores into currgrid could alias any member)
+    ltlband& band = bands[b];
+    int width = pass.maxcol - pass.mincol + 1;
+    if ((int)band.counts.size() < width) band.counts.resize(width);
+    int* counts = &band.counts[0];
+    const unsigned char* born = births;
+    const unsigned char* survive = survivals;
+    int maxstates = maxCellStates;
+    int popdelta = 0;
+    for (int i = band.first; i <= band.last; i++) {
+        const int* hirow = colcounts + (i + pass.hi) * outerwd + pass.mincol;
+        const int* lorow = colcounts + (i + pass.lo) * outerwd + pass.mincol;
+        unsigned char* stateptr = currgrid + i * outerwd + pass.mincol;
+        int firstlive = -1;
+        int lastlive = -1;
+        if (kernel == 0 && maxstates == 2) {
+            // birth and survival flags are 0 or 1 so they are the new states;
+            // avoiding branches here matters because soups defeat prediction
+            // (without vectors a separate box_sums pass costs more than it
+            // saves, so each count is worked out as it's needed)
+            const unsigned char* flags[2] = { born, survive };
+            int hi = pass.hi;
+            int lo = pass.lo;
+            for (int k = 0; k < width; k++) {
+                unsigned char state = stateptr[k];
+                unsigned char newstate =
+                    flags[state][hirow[k+hi] + lorow[k+lo] - hirow[k+lo] - lorow[k+hi]];
+                stateptr[k] = newstate;
+                popdelta += newstate - state;
+                lastlive = newstate ? k : lastlive;
+                if (firstlive < 0) firstlive = lastlive;
+            }
+        } else if (maxstates == 2) {
+            // as above but with the counts done a vector at a time
+            box_sums(kernel, hirow, lorow, pass.hi, pass.lo, counts, width);
+            const unsigned char* flags[2] = { born, survive };
+            for (int k = 0; k < width; k++) {
+                unsigned char state = stateptr[k];
+                unsigned char newstate = flags[state][counts[k]];
+                stateptr[k] = newstate;
+                popdelta += newstate - state;
+                lastlive = newstate ? k : lastlive;
+                if (firstlive < 0) firstlive = lastlive;
+            }
+        } else {
+            box_sums(kernel, hirow, lorow, pass.hi, pass.lo, counts, width);
+            for (int k = 0; k < width; k++) {
+                unsigned char state = next_state(stateptr[k], counts[k], born, survive,
+                                                 maxstates, popdelta);
+                stateptr[k] = state;
+                if (state) {
+                    if (firstlive < 0) firstlive = k;
+                    lastlive = k;
+                }
+            }
+        }
+        if (firstlive >= 0) {
+            if (pass.mincol + firstlive < band.minx) band.minx = pass.mincol + firstlive;
+            if (pass.mincol + lastlive > band.maxx) band.maxx = pass.mincol + lastlive;
+            if (i < band.miny) band.miny = i;
+            band.maxy = i;
+        }
+    }
+    band.popdelta += popdelta;
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::neumann_band(int b)
+{
+    // calculate final von Neumann neighborhood counts for the rows in this band
+    // (see faster_Neumann_*) and update the corresponding cells in currgrid
+    ltlband& band = bands[b];
+    for (int i = band.first; i <= band.last; i++) {
+        int im1 = i - 1;
+        int ipr = i + range;
+        int iprm1 = ipr - 1;
+        int imrm1 = i - range - 1;
+        int imrm2 = imrm1 - 1;
+        int y = i + pass.rowoffset;
+        unsigned char* stateptr = currgrid + y*outerwd + pass.coloffset + pass.mincol;
+        bool rowchanged = false;
+        for (int j = pass.mincol; j <= pass.maxcol; j++) {
+            int jpr = j + range;
+            int jmr = j - range;
+            int n = getcount(ipr,j)   - getcount(im1,jpr+1) - getcount(im1,jmr-1) + getcount(imrm2,j) +
+                    getcount(iprm1,j) - getcount(im1,jpr)   - getcount(im1,jmr)   + getcount(imrm1,j);
+            unsigned char state = next_state(*stateptr, n, births, survivals,
+                                             maxCellStates, band.popdelta);
+            *stateptr++ = state;
+            if (state) {
+                int x = j + pass.coloffset;
+                if (x < band.minx) band.minx = x;
+                if (x > band.maxx) band.maxx = x;
+                rowchanged = true;
+            }
+        }
+        if (rowchanged) {
+            if (y < band.miny) band.miny = y;
+            band.maxy = y;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 void ltlalgo::faster_Moore_bounded(int mincol, int minrow, int maxcol, int maxrow)
 {
     // use Adam P. Goucher's algorithm to calculate Moore neighborhood counts
@@ -571,37 +1222,8 @@ void ltlalgo::faster_Moore_bounded(int mincol, int minrow, int maxcol, int maxro
     maxcol += bpr;
 
     // calculate cumulative counts for each column and store in colcounts
+    column_counts(mincol, minrow, maxcol, maxrow);
 
-    unsigned char* cellptr = outergrid1 + minrow * outerwd + mincol;
-    int* ccptr = colcounts + minrow * outerwd + mincol;
-    int *prevptr = NULL;
-    int width = (maxcol - mincol + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
-
-    for (int j = mincol; j <= maxcol; j++) {
-        if (*cellptr == 1) rowcount++;
-        *ccptr = rowcount;
-        cellptr++;
-        ccptr++;
-    }
-    cellptr += nextrow;
-    ccptr += nextrow;
-    prevptr = ccptr - outerwd;
-    for (int i = minrow + 1; i <= maxrow; i++) {
-        rowcount = 0;
-        for (int j = mincol; j <= maxcol; j++) {
-            if (*cellptr == 1) rowcount++;
-            *ccptr = *prevptr + rowcount;
-            cellptr++;
-            ccptr++;
-            prevptr++;
-        }
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
-    
     // restore given limits (necessary for update_current_grid calls)
     minrow -= bmr;
     mincol -= bmr;
@@ -612,7 +1234,7 @@ void ltlalgo::faster_Moore_bounded(int mincol, int minrow, int maxcol, int maxro
     // and update the corresponding cells in current grid
     
     int* colptr = colcounts + (minrow + bpr) * outerwd;
-    ccptr = colptr + mincol + bpr;
+    int* ccptr = colptr + mincol + bpr;
     unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
     unsigned char state = *stateptr;
     update_current_grid(state, *ccptr);
@@ -667,32 +1289,15 @@ void ltlalgo::faster_Moore_bounded(int mincol, int minrow, int maxcol, int maxro
         if (mincol > maxx) maxx = mincol;
     }
     
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i + bpr) * outerwd;
-        int* imrm1 = colcounts + (i + bmrm1) * outerwd;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (int j = mincol+1; j <= maxcol; j++) {
-            int jpr = j + bpr;
-            int jmrm1 = j + bmrm1;
-            int* ccptr1 = ipr + jpr;
-            int* ccptr2 = imrm1 + jmrm1;
-            int* ccptr3 = ipr + jmrm1;
-            int* ccptr4 = imrm1 + jpr;
-            state = *stateptr;
-            update_current_grid(state, *ccptr1 + *ccptr2 - *ccptr3 - *ccptr4);
-            *stateptr++ = state;
-            if (state) {
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+    // do the remaining rows and columns, possibly on several threads
+    if (minrow < maxrow && mincol < maxcol) {
+        pass.mincol = mincol+1;
+        pass.maxcol = maxcol;
+        pass.hi = bpr;
+        pass.lo = bmrm1;
+        split_bands(minrow+1, maxrow, maxcol - mincol);
+        run_bands(&ltlalgo::moore_band);
+        merge_bands();
     }
 }
 
@@ -715,113 +1320,8 @@ void ltlalgo::faster_Moore_bounded2(int mincol, int minrow, int maxcol, int maxr
     maxcol += bpr;
 
     // calculate cumulative counts for each column and store in colcounts
+    column_counts(mincol, minrow, maxcol, maxrow);
 
-    unsigned char* cellptr = outergrid1 + minrow * outerwd + mincol;
-    int* ccptr = colcounts + minrow * outerwd + mincol;
-    int *prevptr = NULL;
-    int width = (maxcol - mincol + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
-
-    // compute 4 cell offset
-    int offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-    if (offset > width) offset = width;
-
-    // process in 4 cell chunks
-    int chunks = (width - offset) >> 2;
-    int remainder = (width - offset) - (chunks << 2);
-    int j = 0;
-
-    // process cells in the first row
-
-    // process cells up to the first 4 cell chunk
-    for (j = 0; j < offset; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-
-    // process any 4 cell chunks
-    unsigned int *lcellptr = (unsigned int*)cellptr;
-    for (j = 0; j < chunks; j++) {
-        if (*lcellptr++) {
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-        } else {
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            cellptr += 4;
-        }
-    }
-
-    // process any remaining cells
-    for (j = 0; j < remainder; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-    cellptr += nextrow;
-    ccptr += nextrow;
-    prevptr = ccptr - outerwd;
-
-    // process the remaining rows of cells
-
-    for (int i = minrow + 1; i <= maxrow; i++) {
-        rowcount = 0;
-
-        // compute 4 cell offset
-        offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-        if (offset > width) offset = width;
-
-        // process in 4 cell chunks
-        chunks = (width - offset) >> 2;
-        remainder = (width - offset) - (chunks << 2);
-
-        // process cells up to the first 4 cell chunk
-        for (j = 0; j < offset; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        lcellptr = (unsigned int*)cellptr;
-
-        // process any 4 cell chunks
-        for (j = 0; j < chunks; j++) {
-            // check if any of the cells are alive
-            if (*lcellptr++) {
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-           } else {
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                cellptr += 4;
-            }
-        }
-
-        // process any remaining cells
-        for (j = 0; j < remainder; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        // next row
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
-    
     // restore given limits (necessary for update_current_grid calls)
     minrow -= bmr;
     mincol -= bmr;
@@ -832,7 +1332,7 @@ void ltlalgo::faster_Moore_bounded2(int mincol, int minrow, int maxcol, int maxr
     // and update the corresponding cells in current grid
     
     int* colptr = colcounts + (minrow + bpr) * outerwd;
-    ccptr = colptr + mincol + bpr;
+    int* ccptr = colptr + mincol + bpr;
     unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
     int ncount = *ccptr;
     if (*stateptr == 0) {
@@ -862,7 +1362,7 @@ void ltlalgo::faster_Moore_bounded2(int mincol, int minrow, int maxcol, int maxr
     stateptr = currgrid + minrow*outerwd + mincol+1;
     int* ccptr1 = colptr + (mincol+1 + bpr);
     int* ccptr2 = colptr + (mincol+1 + bmrm1);
-    for (j = mincol+1; j <= maxcol; j++) {
+    for (int j = mincol+1; j <= maxcol; j++) {
         // do i == minrow
         ncount = *ccptr1++ - *ccptr2++;
         if (*stateptr == 0) {
@@ -927,45 +1427,15 @@ void ltlalgo::faster_Moore_bounded2(int mincol, int minrow, int maxcol, int maxr
         if (mincol > maxx) maxx = mincol;
     }
     
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i + bpr) * outerwd;
-        int* imrm1 = colcounts + (i + bmrm1) * outerwd;
-        int jpr = mincol+1 + bpr;
-        int jmrm1 = mincol+1 + bmrm1;
-        ccptr1 = ipr + jpr;
-        ccptr2 = imrm1 + jmrm1;
-        int* ccptr3 = ipr + jmrm1;
-        int* ccptr4 = imrm1 + jpr;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (j = mincol+1; j <= maxcol; j++) {
-            ncount = *ccptr1++ + *ccptr2++ - *ccptr3++ - *ccptr4++;
-            if (*stateptr == 0) {
-                if (births[ncount]) {
-                    *stateptr = 1;
-                    population++;
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            } else {
-                if (!survivals[ncount]) {
-                    *stateptr = 0;
-                    population--;
-                }
-                else {
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            }
-            stateptr++;
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+    // do the remaining rows and columns, possibly on several threads
+    if (minrow < maxrow && mincol < maxcol) {
+        pass.mincol = mincol+1;
+        pass.maxcol = maxcol;
+        pass.hi = bpr;
+        pass.lo = bmrm1;
+        split_bands(minrow+1, maxrow, maxcol - mincol);
+        run_bands(&ltlalgo::moore_band);
+        merge_bands();
     }
     if (population == 0) empty_boundaries();
 }
@@ -1005,27 +1475,8 @@ void ltlalgo::faster_Moore_unbounded(int mincol, int minrow, int maxcol, int max
         }
     }
 
-    unsigned char* cellptr = currgrid + minrowpr2 * outerwd + mincolpr2;
-    int* ccptr = colcounts + minrowpr2 * outerwd + mincolpr2;
-    int* prevptr = ccptr - outerwd;
-    int width = (maxcol - mincolpr2 + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
-    int j = 0;
-
-    for (int i = minrowpr2; i <= maxrow; i++) {
-        rowcount = 0;
-        for (j = mincolpr2; j <= maxcol; j++) {
-            if (*cellptr == 1) rowcount++;
-            *ccptr = *prevptr + rowcount;
-            cellptr++;
-            ccptr++;
-            prevptr++;
-        }
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
+    // calculate cumulative counts for each column and store in colcounts
+    column_counts(mincolpr2, minrowpr2, maxcol, maxrow);
 
     // restore given limits
     minrow += range;
@@ -1037,7 +1488,7 @@ void ltlalgo::faster_Moore_unbounded(int mincol, int minrow, int maxcol, int max
     // and update the corresponding cells in current grid
     
     int* colptr = colcounts + (minrow + range) * outerwd;
-    ccptr = colptr + mincol + range;
+    int* ccptr = colptr + mincol + range;
     unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
     unsigned char state = *stateptr;
     update_current_grid(state, *ccptr);
@@ -1052,7 +1503,7 @@ void ltlalgo::faster_Moore_unbounded(int mincol, int minrow, int maxcol, int max
     bool rowchanged = false;
     int rangep1 = range + 1;
     stateptr = currgrid + minrow*outerwd + mincol+1;
-    for (j = mincol+1; j <= maxcol; j++) {
+    for (int j = mincol+1; j <= maxcol; j++) {
         // do i == minrow
         int* ccptr1 = colptr + (j+range);
         int* ccptr2 = colptr + (j-rangep1);
@@ -1092,32 +1543,15 @@ void ltlalgo::faster_Moore_unbounded(int mincol, int minrow, int maxcol, int max
         if (mincol > maxx) maxx = mincol;
     }
     
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i+range) * outerwd;
-        int* imrm1 = colcounts + (i-rangep1) * outerwd;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (j = mincol+1; j <= maxcol; j++) {
-            int jpr = j+range;
-            int jmrm1 = j-rangep1;
-            int* ccptr1 = ipr + jpr;
-            int* ccptr2 = imrm1 + jmrm1;
-            int* ccptr3 = ipr + jmrm1;
-            int* ccptr4 = imrm1 + jpr;
-            state = *stateptr;
-            update_current_grid(state, *ccptr1 + *ccptr2 - *ccptr3 - *ccptr4);
-            *stateptr++ = state;
-            if (state) {
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+    // do the remaining rows and columns, possibly on several threads
+    if (minrow < maxrow && mincol < maxcol) {
+        pass.mincol = mincol+1;
+        pass.maxcol = maxcol;
+        pass.hi = range;
+        pass.lo = -rangep1;
+        split_bands(minrow+1, maxrow, maxcol - mincol);
+        run_bands(&ltlalgo::moore_band);
+        merge_bands();
     }
 }
 
@@ -1157,112 +1591,7 @@ void ltlalgo::faster_Moore_unbounded2(int mincol, int minrow, int maxcol, int ma
     }
 
     // calculate cumulative counts for each column and store in colcounts
-
-    unsigned char* cellptr = currgrid + minrowpr2 * outerwd + mincolpr2;
-    int* ccptr = colcounts + minrowpr2 * outerwd + mincolpr2;
-    int* prevptr = ccptr - outerwd;
-    int width = (maxcol - mincolpr2 + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
-
-    // compute 4 cell offset
-    int offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-    if (offset > width) offset = width;
-
-    // process in 4 cell chunks
-    int chunks = (width - offset) >> 2;
-    int remainder = (width - offset) - (chunks << 2);
-    int j = 0;
-
-    // process cells in the first row
-
-    // process cells up to the first 4 cell chunk
-    for (j = 0; j < offset; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-
-    // process any 4 cell chunks
-    unsigned int *lcellptr = (unsigned int*)cellptr;
-    for (j = 0; j < chunks; j++) {
-        if (*lcellptr++) {
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-        } else {
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            cellptr += 4;
-        }
-    }
-
-    // process any remaining cells
-    for (j = 0; j < remainder; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-    cellptr += nextrow;
-    ccptr += nextrow;
-    prevptr = ccptr - outerwd;
-
-    // process the remaining rows of cells
-
-    for (int i = minrowpr2 + 1; i <= maxrow; i++) {
-        rowcount = 0;
-
-        // compute 4 cell offset
-        offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-        if (offset > width) offset = width;
-
-        // process in 4 cell chunks
-        chunks = (width - offset) >> 2;
-        remainder = (width - offset) - (chunks << 2);
-
-        // process cells up to the first 4 cell chunk
-        for (j = 0; j < offset; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        lcellptr = (unsigned int*)cellptr;
-
-        // process any 4 cell chunks
-        for (j = 0; j < chunks; j++) {
-            // check if any of the cells are alive
-            if (*lcellptr++) {
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-           } else {
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                cellptr += 4;
-            }
-        }
-
-        // process any remaining cells
-        for (j = 0; j < remainder; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        // next row
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
+    column_counts(mincolpr2, minrowpr2, maxcol, maxrow);
 
     // restore given limits
     minrow += range;
@@ -1274,7 +1603,7 @@ void ltlalgo::faster_Moore_unbounded2(int mincol, int minrow, int maxcol, int ma
     // and update the corresponding cells in current grid
     
     int* colptr = colcounts + (minrow + range) * outerwd;
-    ccptr = colptr + mincol + range;
+    int* ccptr = colptr + mincol + range;
     unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
     int ncount = *ccptr;
     if (*stateptr == 0) {
@@ -1304,7 +1633,7 @@ void ltlalgo::faster_Moore_unbounded2(int mincol, int minrow, int maxcol, int ma
     stateptr = currgrid + minrow*outerwd + mincol+1;
     int* ccptr1 = colptr + (mincol+1 + range);
     int* ccptr2 = colptr + (mincol+1 - rangep1);
-    for (j = mincol+1; j <= maxcol; j++) {
+    for (int j = mincol+1; j <= maxcol; j++) {
         // do i == minrow
         ncount = *ccptr1++ - *ccptr2++;
         if (*stateptr == 0) {
@@ -1369,45 +1698,15 @@ void ltlalgo::faster_Moore_unbounded2(int mincol, int minrow, int maxcol, int ma
         if (mincol > maxx) maxx = mincol;
     }
     
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i+range) * outerwd;
-        int* imrm1 = colcounts + (i-rangep1) * outerwd;
-        int jpr = mincol+1+range;
-        int jmrm1 = mincol+1-rangep1;
-        ccptr1 = ipr + jpr;
-        ccptr2 = imrm1 + jmrm1;
-        int* ccptr3 = ipr + jmrm1;
-        int* ccptr4 = imrm1 + jpr;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (j = mincol+1; j <= maxcol; j++) {
-            ncount = *ccptr1++ + *ccptr2++ - *ccptr3++ - *ccptr4++;
-            if (*stateptr == 0) {
-                if (births[ncount]) {
-                    *stateptr = 1;
-                    population++;
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            } else {
-                if (!survivals[ncount]) {
-                    *stateptr = 0;
-                    population--;
-                }
-                else {
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            }
-            stateptr++;
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+    // do the remaining rows and columns, possibly on several threads
+    if (minrow < maxrow && mincol < maxcol) {
+        pass.mincol = mincol+1;
+        pass.maxcol = maxcol;
+        pass.hi = range;
+        pass.lo = -rangep1;
+        split_bands(minrow+1, maxrow, maxcol - mincol);
+        run_bands(&ltlalgo::moore_band);
+        merge_bands();
     }
     if (population == 0) empty_boundaries();
 }
@@ -1635,35 +1934,15 @@ void ltlalgo::faster_Neumann_bounded(int mincol, int minrow, int maxcol, int max
     mincol -= border;
 
     // calculate final neighborhood counts and update the corresponding cells in the grid
-    bool rowchanged = false;
-    for (int i = range; i < nrows-range; i++) {
-        int im1 = i - 1;
-        int ipr = i + range;
-        int iprm1 = ipr - 1;
-        int imrm1 = i - range - 1;
-        int imrm2 = imrm1 - 1;
-        int ipminrow = i + minrow;
-        unsigned char* stateptr = currgrid + ipminrow*outerwd + range + mincol;
-        for (int j = range; j < ncols-range; j++) {
-            int jpr = j + range;
-            int jmr = j - range;
-            int n = getcount(ipr,j)   - getcount(im1,jpr+1) - getcount(im1,jmr-1) + getcount(imrm2,j) +
-                    getcount(iprm1,j) - getcount(im1,jpr)   - getcount(im1,jmr)   + getcount(imrm1,j);
-            unsigned char state = *stateptr;
-            update_current_grid(state, n);
-            *stateptr++ = state;
-            if (state) {
-                int jpmincol = j + mincol;
-                if (jpmincol < minx) minx = jpmincol;
-                if (jpmincol > maxx) maxx = jpmincol;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (ipminrow < miny) miny = ipminrow;
-            if (ipminrow > maxy) maxy = ipminrow;
-            rowchanged = false;
-        }
+    // (possibly on several threads)
+    if (range <= nrows-range-1 && range <= ncols-range-1) {
+        pass.mincol = range;
+        pass.maxcol = ncols-range-1;
+        pass.rowoffset = minrow;
+        pass.coloffset = mincol;
+        split_bands(range, nrows-range-1, ncols);
+        run_bands(&ltlalgo::neumann_band);
+        merge_bands();
     }
 }
 
@@ -1699,35 +1978,15 @@ void ltlalgo::faster_Neumann_unbounded(int mincol, int minrow, int maxcol, int m
     }
 
     // calculate final neighborhood counts and update the corresponding cells in the grid
-    bool rowchanged = false;
-    for (int i = 0; i < nrows; i++) {
-        int im1 = i - 1;
-        int ipr = i + range;
-        int iprm1 = ipr - 1;
-        int imrm1 = i - range - 1;
-        int imrm2 = imrm1 - 1;
-        int ipminrow = i + minrow;
-        unsigned char* stateptr = currgrid + ipminrow*outerwd + mincol;
-        for (int j = 0; j < ncols; j++) {
-            int jpr = j + range;
-            int jmr = j - range;
-            int n = getcount(ipr,j)   - getcount(im1,jpr+1) - getcount(im1,jmr-1) + getcount(imrm2,j) +
-                    getcount(iprm1,j) - getcount(im1,jpr)   - getcount(im1,jmr)   + getcount(imrm1,j);
-            unsigned char state = *stateptr;
-            update_current_grid(state, n);
-            *stateptr++ = state;
-            if (state) {
-                int jpmincol = j + mincol;
-                if (jpmincol < minx) minx = jpmincol;
-                if (jpmincol > maxx) maxx = jpmincol;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (ipminrow < miny) miny = ipminrow;
-            if (ipminrow > maxy) maxy = ipminrow;
-            rowchanged = false;
-        }
+    // (possibly on several threads)
+    if (0 <= nrows-1 && 0 <= ncols-1) {
+        pass.mincol = 0;
+        pass.maxcol = ncols-1;
+        pass.rowoffset = minrow;
+        pass.coloffset = mincol;
+        split_bands(0, nrows-1, ncols);
+        run_bands(&ltlalgo::neumann_band);
+        merge_bands();
     }
 }
 
@@ -2819,6 +3078,20 @@ void ltlalgo::do_bounded_gen()
 
 bool ltlalgo::do_unbounded_gen()
 {
+    if (!regionsvalid) {
+        // cells have been changed by setcell or the rule has changed, so start with
+        // one region containing the whole pattern
+        regions.clear();
+        ltlregion all = { minx, miny, maxx, maxy };
+        regions.push_back(all);
+        regionsvalid = true;
+        regionage = SPLITGENS;
+    }
+    if (regionage >= SPLITGENS) {
+        // clusters of live cells inside a region might have moved apart
+        split_regions();
+    }
+
     int mincol = minx - range;
     int minrow = miny - range;
     int maxcol = maxx + range;
@@ -2851,17 +3124,177 @@ bool ltlalgo::do_unbounded_gen()
         maxrow = maxy + range;
     }
         
-    // reset minx,miny,maxx,maxy for first birth or survivor in nextgrid
-    empty_boundaries();
+    // compute next generation in each active region based on neighborhood type;
+    // regions can't interact so each one can be done separately and its boundary
+    // replaced by the boundary of live cells in the next generation
+    int newminx = INT_MAX;
+    int newminy = INT_MAX;
+    int newmaxx = INT_MIN;
+    int newmaxy = INT_MIN;
+    size_t live = 0;
+    for (size_t i = 0; i < regions.size(); i++) {
+        ltlregion r = regions[i];
+
+        // reset minx,miny,maxx,maxy for first birth or survivor in region
+        empty_boundaries();
+        do_gen(r.minx - range, r.miny - range, r.maxx + range, r.maxy + range);
+
+        if (outergrid2) {
+            // kill the old cells in currgrid so it can be used as the next nextgrid
+            // (the live cells in other regions are too far away to be read)
+            int xbytes = r.maxx - r.minx + 1;
+            unsigned char* cellptr = currgrid + r.miny * outerwd + r.minx;
+            for (int row = r.miny; row <= r.maxy; row++) {
+                memset(cellptr, 0, xbytes);
+                cellptr += outerwd;
+            }
+        }
 
-    // compute next generation based on neighborhood type
-    do_gen(mincol, minrow, maxcol, maxrow);
+        if (minx <= maxx) {
+            if (minx < newminx) newminx = minx;
+            if (maxx > newmaxx) newmaxx = maxx;
+            if (miny < newminy) newminy = miny;
+            if (maxy > newmaxy) newmaxy = maxy;
+            r.minx = minx;
+            r.miny = miny;
+            r.maxx = maxx;
+            r.maxy = maxy;
+            regions[live++] = r;
+        }
+    }
+    regions.resize(live);
+    minx = newminx;
+    miny = newminy;
+    maxx = newmaxx;
+    maxy = newmaxy;
+
+    // regions might have grown close enough to interact in the next generation
+    merge_regions();
+    regionage++;
 
     return true;
 }
 
 // -----------------------------------------------------------------------------
 
+void ltlalgo::split_regions()
+{
+    // divide each region into square tiles that are wide enough to ensure live cells
+    // in tiles that aren't adjacent can't interact, then make each cluster of
+    // adjacent nonempty tiles a new region
+    int tilesize = TILESIZE;
+    while (tilesize <= 4 * range + 2) tilesize += TILESIZE;
+
+    vector<ltlregion> oldregions;
+    oldregions.swap(regions);
+    vector<ltlregion> tiles;
+    vector<int> stack;
+    for (size_t i = 0; i < oldregions.size(); i++) {
+        ltlregion area = oldregions[i];
+        int tileswd = (area.maxx - area.minx) / tilesize + 1;
+        int tilesht = (area.maxy - area.miny) / tilesize + 1;
+
+        // find the boundary of live cells in each tile (minx > maxx if tile is empty)
+        tiles.resize(tileswd * tilesht);
+        for (size_t t = 0; t < tiles.size(); t++) {
+            tiles[t].minx = INT_MAX;
+            tiles[t].miny = INT_MAX;
+            tiles[t].maxx = INT_MIN;
+            tiles[t].maxy = INT_MIN;
+        }
+        for (int y = area.miny; y <= area.maxy; y++) {
+            unsigned char* row = currgrid + y * outerwd;
+            ltlregion* tilerow = &tiles[((y - area.miny) / tilesize) * tileswd];
+            for (int tx = 0; tx < tileswd; tx++) {
+                int left = area.minx + tx * tilesize;
+                int right = left + tilesize - 1;
+                if (right > area.maxx) right = area.maxx;
+                int x = left;
+                while (x <= right && row[x] == 0) x++;
+                if (x > right) continue;
+                ltlregion& tile = tilerow[tx];
+                if (x < tile.minx) tile.minx = x;
+                x = right;
+                while (row[x] == 0) x--;
+                if (x > tile.maxx) tile.maxx = x;
+                if (y < tile.miny) tile.miny = y;
+                tile.maxy = y;
+            }
+        }
+
+        // flood fill each cluster of nonempty tiles (including diagonal neighbors),
+        // emptying tiles as they are added to the new region
+        for (int t = 0; t < tileswd * tilesht; t++) {
+            if (tiles[t].minx > tiles[t].maxx) continue;
+            ltlregion r = tiles[t];
+            tiles[t].minx = INT_MAX;
+            stack.push_back(t);
+            while (!stack.empty()) {
+                int tx = stack.back() % tileswd;
+                int ty = stack.back() / tileswd;
+                stack.pop_back();
+                for (int ny = ty - 1; ny <= ty + 1; ny++) {
+                    if (ny < 0 || ny >= tilesht) continue;
+                    for (int nx = tx - 1; nx <= tx + 1; nx++) {
+                        if (nx < 0 || nx >= tileswd) continue;
+                        ltlregion& tile = tiles[ny * tileswd + nx];
+                        if (tile.minx > tile.maxx) continue;
+                        if (tile.minx < r.minx) r.minx = tile.minx;
+                        if (tile.maxx > r.maxx) r.maxx = tile.maxx;
+                        if (tile.miny < r.miny) r.miny = tile.miny;
+                        if (tile.maxy > r.maxy) r.maxy = tile.maxy;
+                        tile.minx = INT_MAX;
+                        stack.push_back(ny * tileswd + nx);
+                    }
+                }
+            }
+            regions.push_back(r);
+        }
+    }
+
+    // boundaries of different clusters can still overlap (eg. if one surrounds another)
+    merge_regions();
+    regionage = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::merge_regions()
+{
+    // cells within range of a region can change in the next generation, and their
+    // new states depend on cells within range of them, so regions that are no more
+    // than about 4*range cells apart must be merged (we allow a bit extra for
+    // neighborhoods like the triangular one that are wider than they are high)
+    int gap = 4 * range + 2;
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < regions.size(); i++) {
+            ltlregion& r = regions[i];
+            size_t j = i + 1;
+            while (j < regions.size()) {
+                ltlregion& s = regions[j];
+                if (s.minx - r.maxx - 1 > gap || r.minx - s.maxx - 1 > gap ||
+                    s.miny - r.maxy - 1 > gap || r.miny - s.maxy - 1 > gap) {
+                    j++;
+                    continue;
+                }
+                if (s.minx < r.minx) r.minx = s.minx;
+                if (s.maxx > r.maxx) r.maxx = s.maxx;
+                if (s.miny < r.miny) r.miny = s.miny;
+                if (s.maxy > r.maxy) r.maxy = s.maxy;
+                regions[j] = regions.back();
+                regions.pop_back();
+                // r has grown so check the other regions again
+                j = i + 1;
+                merged = true;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 // Do increment generations.
 
 void ltlalgo::step()
@@ -2895,8 +3328,9 @@ void ltlalgo::step()
                 currgrid = nextgrid;
                 nextgrid = temp;
             
-                // kill all cells in outergrid2
-                if (prevpop > 0) memset(outergrid2, 0, outerbytes);
+                // kill all cells in outergrid2 (do_unbounded_gen only
+                // kills the cells in its active regions)
+                if (prevpop > 0 && !unbounded) memset(outergrid2, 0, outerbytes);
             }
         }
     
@@ -2913,6 +3347,48 @@ void ltlalgo::step()
 
 // -----------------------------------------------------------------------------
 
+void ltlalgo::stepblock(unsigned char* cells, int width, int gens, int top)
+{
+    // copy the block into the left edge of the (bounded) grid
+    memset(outergrid1, 0, outerbytes);
+    if (outergrid2) memset(outergrid2, 0, outerbytes);
+    population = 0;
+    empty_boundaries();
+    for (int y = top; y < top + width; y++) {
+        unsigned char* row = currgrid + y * outerwd;
+        memcpy(row, cells + (y - top) * width, width);
+        for (int x = 0; x < width; x++) {
+            if (row[x]) {
+                population++;
+                if (x < minx) minx = x;
+                if (x > maxx) maxx = x;
+                if (y < miny) miny = y;
+                if (y > maxy) maxy = y;
+            }
+        }
+    }
+
+    // same as step() but without the generation count and polling
+    for (int g = 0; g < gens && population > 0; g++) {
+        do_bounded_gen();
+        if (outergrid2) {
+            unsigned char* temp = outergrid1;
+            outergrid1 = outergrid2;
+            outergrid2 = temp;
+            temp = currgrid;
+            currgrid = nextgrid;
+            nextgrid = temp;
+            memset(outergrid2, 0, outerbytes);
+        }
+    }
+
+    for (int y = 0; y < width; y++) {
+        memcpy(cells + y * width, currgrid + (top + y) * outerwd, width);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 void ltlalgo::save_cells()
 {
     for (int y = miny; y <= maxy; y++) {
@@ -4077,6 +4553,9 @@ const char *ltlalgo::setrule(const char *s)
         setup_b0_emulation(maxn);
     }
 
+    // the range might have changed so find the active regions again
+    regionsvalid = false;
+
     // algos assume totalistic neighborhoods so if the middle cell was not specified
     // we need to adjust the survival list by + 1
     // exception is for Weighted where the middle cell specification is ignored since
@@ -15,8 +15,10 @@ public:
     ltlalgo();
     virtual ~ltlalgo();
     virtual int setcell(int x, int y, int newstate);
+    virtual int putrow(int x, int y, int n, const unsigned char* states);
     virtual int getcell(int x, int y);
     virtual int nextcell(int x, int y, int& v);
+    virtual bool visitcells(int x, int y, int w, int h, cellvisitor& v);
     virtual void endofpattern();
     virtual void setIncrement(bigint inc) { increment = inc; }
     virtual void setIncrement(int inc) { increment = inc; }
@@ -41,7 +43,19 @@ public:
     virtual const char* writeNativeFormat(std::ostream&, char*) {
         return "No native format for ltlalgo.";
     }
+    virtual void setNumThreads(int n);
     static void doInitializeAlgoInfo(staticAlgoInfo&);
+    static void setKernel(int k) { maxkernel = k; }
+    // limit the count kernel (0 = scalar, 1 = vector, 2 = AVX2) for comparison
+
+    // these are used by hltlalgo, which keeps an ltlalgo with a small bounded
+    // plane to step the blocks at the bottom of its quadtree
+    int getrange() { return range; }
+    bool hasb0() { return b0; }
+    void stepblock(unsigned char* cells, int width, int gens, int top);
+    // step the width*width cells (row by row) by gens generations, with
+    // the block's top row in the given row of the grid and dead cells
+    // all around it
 
 private:
     char canonrule[MAXRULESIZE];        // canonical version of valid rule passed into setrule
@@ -72,6 +86,37 @@ private:
     int ccht;                           // height of colcounts array when ntype = N
     int halfccwd;                       // half width of colcounts array when ntype = N
     int nrows, ncols;                   // size of rectangle being processed
+
+    // an unbounded universe is processed one active region at a time, where each
+    // region is the boundary of a cluster of live cells that is too far from the
+    // other clusters to interact with them; this means the cost of a generation
+    // depends on the live area rather than on the area of the whole pattern
+    struct ltlregion {
+        int minx, miny, maxx, maxy;     // boundary of live cells (in grid coordinates)
+    };
+    vector<ltlregion> regions;          // the active regions (only valid if regionsvalid)
+    bool regionsvalid;                  // false if regions must be found by split_regions
+    int regionage;                      // gens since split_regions was last called
+
+    // large rectangles are split into bands of rows that are processed by
+    // several threads; each band keeps its own population change and boundary
+    // so the results are identical to processing the whole rectangle at once
+    struct ltlband {
+        int first, last;                // rows in this band
+        int popdelta;                   // change in population
+        int minx, miny, maxx, maxy;     // boundary of live cells set by this band
+        vector<int> counts;             // neighborhood counts for one row
+    };
+    vector<ltlband> bands;              // the bands of the current pass
+    struct ltlpass {
+        int mincol, maxcol;             // columns processed by each band
+        int hi, lo;                     // offsets to the far and near corners of a
+                                        // cell's Moore neighborhood in colcounts
+        int rowoffset, coloffset;       // offsets from faster_Neumann_* i,j to grid
+    } pass;                             // parameters of the current pass
+    struct ltlpool* pool;               // worker threads (see ltlalgo.cpp)
+    int kernel;                         // count kernel (see setKernel)
+    static int maxkernel;
     
     // rule parameters (set by setrule)
     int range;                          // neighborhood radius
@@ -95,6 +140,7 @@ private:
     void setup_b0_emulation(int maxn);  // setup B0 emulation
     void create_grids(int wd, int ht);  // create a bounded universe of given width and height
     void allocate_colcounts();          // allocate the colcounts array
+    bool makeroom(int x, int y);        // make sure x,y is inside the grid
     void empty_boundaries();            // set minx, miny, maxx, maxy when population is 0
     void save_cells();                  // save current pattern in cell_list
     void restore_cells();               // restore pattern from cell_list
@@ -102,6 +148,20 @@ private:
     void do_bounded_gen();              // calculate the next generation in a bounded universe
     bool do_unbounded_gen();            // calculate the next generation in an unbounded universe
     int getcount(int i, int j);         // used in faster_Neumann_*
+    void split_regions();               // find clusters of nonempty tiles in each region
+    void merge_regions();               // merge any regions that are close enough to interact
+    void split_bands(int first, int last, int cellsperrow); // split rows into bands
+    void run_bands(void (ltlalgo::*band)(int)); // call given routine for each band
+    void merge_bands();                 // add each band's population change and boundary
+    void workerloop();                  // run bands in a worker thread
+    void killthreads();                 // stop the worker threads
+    void column_counts(int mincol, int minrow, int maxcol, int maxrow);
+    // calculate cumulative counts of state-1 cells in outergrid1 for faster_Moore_*
+    void prefix_band(int b);
+    void carry_band(int b);
+    void moore_band(int b);
+    void neumann_band(int b);
+    // these routines are called from run_bands to process one band of rows
 
     const char* resize_grids(int up, int down, int left, int right);
     // try to resize an unbounded universe by the given amounts (possibly -ve);
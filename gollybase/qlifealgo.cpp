@@ -12,6 +12,11 @@
 #include <string.h>
 #include <limits.h>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
 using namespace std ;
 /*
  *   The ai array is used to figure out the index number of the bit set in
@@ -29,6 +34,201 @@ static unsigned char ai[129] ;
  *   memory for small universes.
  */
 #define MEMCHUNK (8192-16)
+/*
+ *   For totalistic rules on the Moore neighborhood p01() and p10() can
+ *   also compute a whole brick at once, bit-sliced.  A slice already
+ *   holds a 4x8 block of cells, so shifting it (and pulling in the
+ *   columns of the slice next door and the rows of the slice below or
+ *   above) gives the words holding each of the eight neighbors of
+ *   every cell.  These are summed with full adders into a four-bit
+ *   count per cell; then for each count the rule cares about we pick
+ *   out the cells with that count and keep the ones the birth and
+ *   survival masks say to.  This is the same counter hlifealgo uses
+ *   for its leaves.
+ *
+ *   The eight slices of a brick are the eight 32-bit lanes of a 256-bit
+ *   vector, so with AVX2 a brick is about one slice's worth of
+ *   instructions; without it the compiler uses two 128-bit (SSE2)
+ *   halves.  The same template also runs a lane at a time on plain
+ *   ints, which is what setslicedrule() checks against the table.
+ */
+#ifdef __GNUC__
+#define SLICEBRICKS
+typedef unsigned int slicevec __attribute__((vector_size(16))) ;
+#if defined(__x86_64__) || defined(__i386__)
+#define SLICEAVX2
+typedef unsigned int slicevec8 __attribute__((vector_size(32))) ;
+#endif
+#define SLICEINLINE static inline __attribute__((always_inline))
+#else
+#define SLICEINLINE static inline
+#endif
+// vectors go by reference, since passing a slicevec8 by value outside
+// AVX2 code has a different calling convention
+template <class T>
+SLICEINLINE void slicecount(T &r, const T &b, const T &n, const T &s,
+                            const T &w, const T &e, const T &nw, const T &ne,
+                            const T &sw, const T &se, const slicemasks &m) {
+   T s1 = n ^ s ^ w, c1 = (n & s) | (w & (n ^ s)),
+     s2 = e ^ nw ^ ne, c2 = (e & nw) | (ne & (e ^ nw)),
+     s3 = sw ^ se, c3 = sw & se ;
+   T ones = s1 ^ s2 ^ s3, c4 = (s1 & s2) | (s3 & (s1 ^ s2)) ;
+   T t = c1 ^ c2 ^ c3, u = (c1 & c2) | (c3 & (c1 ^ c2)) ;
+   T twos = t ^ c4, v = t & c4 ;
+   T fours = u ^ v, eights = u & v ;
+   T low[4] ; // the four combinations of the ones and twos bits
+   low[0] = ~(ones | twos) ;
+   low[1] = ones & ~twos ;
+   low[2] = twos & ~ones ;
+   low[3] = ones & twos ;
+   T nb = ~b ;
+   r = b ^ b ;
+   for (int i=0; i<m.ncounts; i++) {
+      int k = m.counts[i] ;
+      T eq ;
+      if (k == 8)
+         eq = eights ;
+      else if (k & 4)
+         eq = low[k & 3] & fours ;
+      else
+         eq = low[k] & ~(fours | eights) ;
+      r |= eq & ((b & m.survive[k]) | (nb & m.birth[k])) ;
+   }
+}
+/*
+ *   Phase 0->1.  Zis[0..8] are the brick's even slices followed by the
+ *   first of the brick to the right; under[0..8] the same for the
+ *   bricks below.  New cell (x,y) is centered on old cell (x+1,y+1).
+ */
+template <class T>
+SLICEINLINE void slicebrick01(const unsigned int *zis, const unsigned int *under,
+                              unsigned int *out, const slicemasks &m) {
+   for (int i=0; i<8; i += (int)(sizeof(T) / sizeof(int))) {
+      T z, tr, u, tu ;
+      memcpy(&z, zis + i, sizeof(T)) ;
+      memcpy(&tr, zis + i + 1, sizeof(T)) ;
+      memcpy(&u, under + i, sizeof(T)) ;
+      memcpy(&tu, under + i + 1, sizeof(T)) ;
+      T z1 = ((z << 1) & 0xeeeeeeee) | ((tr >> 3) & 0x11111111),
+        z2 = ((z << 2) & 0xcccccccc) | ((tr >> 2) & 0x33333333),
+        u1 = ((u << 1) & 0xeeeeeeee) | ((tu >> 3) & 0x11111111),
+        u2 = ((u << 2) & 0xcccccccc) | ((tu >> 2) & 0x33333333) ;
+      T r ;
+      slicecount<T>(r, (z1 << 4) | (u1 >> 28), z1, (z1 << 8) | (u1 >> 24),
+                    (z << 4) | (u >> 28), (z2 << 4) | (u2 >> 28),
+                    z, z2, (z << 8) | (u >> 24), (z2 << 8) | (u2 >> 24), m) ;
+      memcpy(out + i, &r, sizeof(T)) ;
+   }
+}
+/*
+ *   Phase 1->0, the mirror.  Zis[1..8] are the brick's odd slices and
+ *   zis[0] the last of the brick to the left; over[0..8] the same for
+ *   the bricks above.
+ */
+template <class T>
+SLICEINLINE void slicebrick10(const unsigned int *zis, const unsigned int *over,
+                              unsigned int *out, const slicemasks &m) {
+   for (int i=0; i<8; i += (int)(sizeof(T) / sizeof(int))) {
+      T z, tr, o, to ;
+      memcpy(&z, zis + i + 1, sizeof(T)) ;
+      memcpy(&tr, zis + i, sizeof(T)) ;
+      memcpy(&o, over + i + 1, sizeof(T)) ;
+      memcpy(&to, over + i, sizeof(T)) ;
+      T z1 = ((z >> 1) & 0x77777777) | ((tr << 3) & 0x88888888),
+        z2 = ((z >> 2) & 0x33333333) | ((tr << 2) & 0xcccccccc),
+        o1 = ((o >> 1) & 0x77777777) | ((to << 3) & 0x88888888),
+        o2 = ((o >> 2) & 0x33333333) | ((to << 2) & 0xcccccccc) ;
+      T r ;
+      slicecount<T>(r, (z1 >> 4) | (o1 << 28), (z1 >> 8) | (o1 << 24), z1,
+                    (z2 >> 4) | (o2 << 28), (z >> 4) | (o << 28),
+                    (z2 >> 8) | (o2 << 24), (z >> 8) | (o << 24), z2, z, m) ;
+      memcpy(out + i, &r, sizeof(T)) ;
+   }
+}
+static void slicebricks(int odd, const unsigned int *zis,
+                        const unsigned int *next, unsigned int *out,
+                        const slicemasks &m) {
+   if (odd)
+      slicebrick10<unsigned int>(zis, next, out, m) ;
+   else
+      slicebrick01<unsigned int>(zis, next, out, m) ;
+}
+#ifdef SLICEBRICKS
+static void slicebricksvec(int odd, const unsigned int *zis,
+                           const unsigned int *next, unsigned int *out,
+                           const slicemasks &m) {
+   if (odd)
+      slicebrick10<slicevec>(zis, next, out, m) ;
+   else
+      slicebrick01<slicevec>(zis, next, out, m) ;
+}
+#endif
+#ifdef SLICEAVX2
+__attribute__((target("avx2")))
+static void slicebricksavx2(int odd, const unsigned int *zis,
+                            const unsigned int *next, unsigned int *out,
+                            const slicemasks &m) {
+   if (odd)
+      slicebrick10<slicevec8>(zis, next, out, m) ;
+   else
+      slicebrick01<slicevec8>(zis, next, out, m) ;
+}
+static int hasavx2() {
+   static int avx2 = -1 ;
+   if (avx2 < 0)
+      avx2 = __builtin_cpu_supports("avx2") ? 1 : 0 ;
+   return avx2 ;
+}
+#else
+static int hasavx2() { return 0 ; }
+#endif
+/*
+ *   A brick from the kernel costs about what four slices from the table
+ *   do with AVX2, and about six without, so we only use it when at
+ *   least that many of a brick's slices need recomputing.
+ */
+static const int slicemin[3] = { 9, 6, 4 } ;
+int qlifealgo::maxbrickkernel = 2 ;
+/*
+ *   Multithreaded generations (see pardogen).  The supertiles at
+ *   PARLEVEL are the tasks; the levels above are walked serially.
+ *   Each entry of the plan is either a task or one of those upper
+ *   supertiles, and remembers where its change bits go.
+ */
+const int PARLEVEL = 1 ;
+struct qlifetask {
+   supertile *zis, *edge, *par, *cor ;
+   int lev ;
+   int parent, shift ;   // or changes << shift into the parent's
+   int deps ;            // tasks that must finish before this one starts
+   int ndependents, dependents[3] ;
+   int changes ;
+} ;
+struct qlifepool {
+   std::mutex m ;        // protects everything but the tasks' results
+   std::condition_variable cv ;
+   std::vector<std::thread> threads ;
+   std::vector<qlifetask> tasks ;
+   std::unordered_map<supertile *, int> taskof ;
+   std::deque<int> ready ;
+   int remaining, odd, shutdown, busy ;
+   std::mutex allocm ;   // protects the free lists while busy
+} ;
+static thread_local int qlifeworker ;
+/*
+ *   While the workers are running, allocation takes the pool's lock.
+ */
+class qlifealloclock {
+public:
+   qlifealloclock(qlifepool *p) : m(p && p->busy ? &p->allocm : 0) {
+      if (m) m->lock() ;
+   }
+   ~qlifealloclock() {
+      if (m) m->unlock() ;
+   }
+private:
+   std::mutex *m ;
+} ;
 /*
  *   When we need a bunch more structures of a particular size, we call this.
  *   This code allocates the memory, adds it to our universe memory allocated
@@ -49,11 +249,13 @@ linkedmem *qlifealgo::filllist(int size) {
    usedmemory += MEMCHUNK ;
    if (maxmemory != 0 && usedmemory > maxmemory)
       lifefatal("exceeded user-specified memory limit") ;
-   linkedmem *p, *safep, *r = (linkedmem *)calloc(MEMCHUNK, 1) ;
+   linkedmem *p, *safep ;
+   memchunk *r = (memchunk *)calloc(MEMCHUNK, 1) ;
    int i = size & - size ;
    if (r == 0)
       lifefatal("No memory.") ;
    r->next = memused ;
+   r->size = size ;
    memused = r ;
    safep = p = (linkedmem *)((((g_uintptr_t)(r+1))+i-1)&-i) ;
    while (((g_uintptr_t)p) + 2 * size <= MEMCHUNK+(g_uintptr_t)r) {
@@ -73,6 +275,7 @@ static int bricks, tiles, supertiles, rcc, dq, ds, rccs, dqs, dss ;
  *   to be all zeros.
  */
 brick *qlifealgo::newbrick() {
+   qlifealloclock lk(pool) ;
    brick *r ;
    if (bricklist == 0)
       bricklist = filllist(sizeof(brick)) ;
@@ -87,6 +290,7 @@ brick *qlifealgo::newbrick() {
  *   appropriately, with all the pointers pointing to the empty brick.
  */
 tile *qlifealgo::newtile() {
+   qlifealloclock lk(pool) ;
    tile *r ;
    if (tilelist == 0)
       tilelist = filllist(sizeof(tile)) ;
@@ -95,6 +299,7 @@ tile *qlifealgo::newtile() {
    r->b[0] = r->b[1] = r->b[2] = r->b[3] = emptybrick ;
    r->flags = -1 ;
    r->localdeltaforward = 0 ;
+   r->epoch = snapepoch << 4 ;
    STAT(tiles++) ;
    return r ;
 }
@@ -103,6 +308,7 @@ tile *qlifealgo::newtile() {
  *   all the subtiles to point to the next level down's empty tile.
  */
 supertile *qlifealgo::newsupertile(int lev) {
+   qlifealloclock lk(pool) ;
    supertile *r ;
    if (supertilelist == 0)
       supertilelist = filllist(sizeof(supertile)) ;
@@ -110,6 +316,7 @@ supertile *qlifealgo::newsupertile(int lev) {
    supertilelist = supertilelist->next ;
    r->d[0] = r->d[1] = r->d[2] = r->d[3] = r->d[4] = r->d[5] =
                                  r->d[6] = r->d[7] = nullroots[lev-1] ;
+   r->epoch = snapepoch ;
    STAT(supertiles++) ;
    return r ;
 }
@@ -200,6 +407,7 @@ qlifealgo::qlifealgo() {
       lifefatal("bad platform for this program") ;
    memused = 0 ;
    maxmemory = 0 ;
+   snapepoch = 0 ;
    poller->bailIfCalculating() ;
    generation = 0 ;
    increment = 1 ;
@@ -217,6 +425,7 @@ qlifealgo::qlifealgo() {
    bmin = 0 ;
    bmax = 31 ;
    emptybrick = newbrick() ;
+   memset(nullroots, 0, sizeof(nullroots)) ;
    nullroots[0] = nullroot = root = (supertile *)(emptytile = newtile()) ;
    uproot() ;
    popValid = 0 ;
@@ -224,6 +433,10 @@ qlifealgo::qlifealgo() {
    llyb = 0 ;
    llbits = 0 ;
    llsize = 0 ;
+   pool = 0 ;
+   sliced[0] = sliced[1] = 0 ;
+   slicerule = 0 ;
+   brickkernel = 0 ;
    if (bc[255] == 0)
      for (int i=1; i<256; i++)
        bc[i] = bc[i & (i-1)] + 1 ;
@@ -232,8 +445,11 @@ qlifealgo::qlifealgo() {
  *   This subroutine frees a universe.
  */
 qlifealgo::~qlifealgo() {
+   killthreads() ;
+   for (unsigned int i=0; i<snaps.size(); i++)
+      delete snaps[i] ;
    while (memused) {
-      linkedmem *nu = memused->next ;
+      memchunk *nu = memused->next ;
       free(memused) ;
       memused = nu ;
    }
@@ -293,7 +509,8 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
  *   Note that the parallel and corner have already been recomputed so
  *   their changing bits are shifted up 10 positions in c.
  */
-   poller->poll() ;
+   if (!qlifeworker)
+      poller->poll() ;
    int changing = (zis->flags | (par->flags >> 19) |
                    (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
    int x, b, nchanging = (zis->flags & 0x3ff00) << 10 ;
@@ -333,6 +550,11 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
          if (zis->d[x] == nullroots[lev-1])
             p = zis->d[x] = (lev == 1 ? (supertile *)newtile() :
                                                       newsupertile(lev-1)) ;
+/*
+ *   If a snapshot still holds it, we need our own copy.
+ */
+         else if (snapepoch)
+            p = zis->d[x] = thaw(p, lev-1) ;
 /*
  *   If it's level 1, call the tile handler, else call the next level down of
  *   the supertile handler.  The return value is the changing indicators that
@@ -360,7 +582,8 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
  */
 int qlifealgo::doquad10(supertile *zis, supertile *edge,
                         supertile *par, supertile *cor, int lev) {
-   poller->poll() ;
+   if (!qlifeworker)
+      poller->poll() ;
    int changing = (zis->flags | (par->flags >> 19) |
                    (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
    int x, b, nchanging = (zis->flags & 0x3ff00) << 10 ;
@@ -384,6 +607,8 @@ int qlifealgo::doquad10(supertile *zis, supertile *edge,
          if (zis->d[x] == nullroots[lev-1])
             p = zis->d[x] = (lev == 1 ? (supertile *)newtile() :
                                                      newsupertile(lev-1)) ;
+         else if (snapepoch)
+            p = zis->d[x] = thaw(p, lev-1) ;
          if (lev == 1) {
             nchanging |= p10((tile *)pfu, (tile *)pu, (tile *)pf, (tile *)p)
                           << (7-x) ;
@@ -431,11 +656,25 @@ int qlifealgo::p01(tile *p, tile *pr, tile *pd, tile *prd) {
          int j, cdelta = 0, maska, maskb, maskprev = 0 ;
 /*
  *   If so, set the dirty bit.  Also, if this brick is the canonical empty
- *   brick, get a new one.
+ *   brick, or a snapshot's, get a new one.
  */
          p->flags |= 1 << i ;
-         if (b == emptybrick)
-            p->b[i] = b = newbrick() ;
+         if (b == emptybrick || !(p->epoch & (1 << i)))
+            b = ownbrick(p, i) ;
+/*
+ *   If the rule allows and enough slices need it, compute the whole
+ *   brick with the bit-sliced kernel up front.
+ */
+         unsigned int slices[8] ;
+         int usesliced = slicerule && bc[recomp] >= slicemin[brickkernel] ;
+         if (usesliced) {
+            unsigned int zis[9], under[9] ;
+            memcpy(zis, b->d, 8 * sizeof(int)) ;
+            zis[8] = rb->d[0] ;
+            memcpy(under, db->d, 8 * sizeof(int)) ;
+            under[8] = rdb->d[0] ;
+            slicebrick(0, zis, under, slices) ;
+         }
 /*
  *   If we need to recompute the end slice, now is a good time to get the
  *   right neighbor's data.
@@ -474,14 +713,18 @@ int qlifealgo::p01(tile *p, tile *pr, tile *pd, tile *prd) {
                                         ((traildata >> 2) & 0x33333333) ;
                unsigned int otherunderdata = ((underdata << 2) & 0xcccccccc) +
                                     ((trailunderdata >> 2) & 0x33333333) ;
-               int newv = (ruletable[zisdata >> 16] << 26) +
-                          (ruletable[underdata >> 16] << 18) +
-                          (ruletable[zisdata & 0xffff] << 10) +
-                          (ruletable[underdata & 0xffff] << 2) +
-                          (ruletable[otherdata >> 16] << 24) +
-                          (ruletable[otherunderdata >> 16] << 16) +
-                          (ruletable[otherdata & 0xffff] << 8) +
-                           ruletable[otherunderdata & 0xffff] ;
+               int newv ;
+               if (usesliced)
+                  newv = (int)slices[j] ;
+               else
+                  newv = (ruletable[zisdata >> 16] << 26) +
+                         (ruletable[underdata >> 16] << 18) +
+                         (ruletable[zisdata & 0xffff] << 10) +
+                         (ruletable[underdata & 0xffff] << 2) +
+                         (ruletable[otherdata >> 16] << 24) +
+                         (ruletable[otherunderdata >> 16] << 16) +
+                         (ruletable[otherdata & 0xffff] << 8) +
+                          ruletable[otherunderdata & 0xffff] ;
 /*
  *   Has anything changed?
  *   Keep track of what has changed in the entire cell, the rightmost
@@ -560,8 +803,18 @@ int qlifealgo::p10(tile *plu, tile *pu, tile *pl, tile *p) {
          int maska, maskprev = 0, j, cdelta = 0 ;
          unsigned int traildata, trailoverdata ;
          p->flags |= 1 << i ;
-         if (b == emptybrick)
-            p->b[i] = b = newbrick() ;
+         if (b == emptybrick || !(p->epoch & (1 << i)))
+            b = ownbrick(p, i) ;
+         unsigned int slices[8] ;
+         int usesliced = slicerule && bc[recomp] >= slicemin[brickkernel] ;
+         if (usesliced) {
+            unsigned int zis[9], over[9] ;
+            zis[0] = lb->d[15] ;
+            memcpy(zis + 1, b->d + 8, 8 * sizeof(int)) ;
+            over[0] = lub->d[15] ;
+            memcpy(over + 1, ub->d + 8, 8 * sizeof(int)) ;
+            slicebrick(1, zis, over, slices) ;
+         }
          if (recomp & 1) {
             j = 0 ;
             traildata = lb->d[15] ;
@@ -581,14 +834,18 @@ int qlifealgo::p10(tile *plu, tile *pu, tile *pl, tile *p) {
                                         ((traildata << 2) & 0xcccccccc) ;
                unsigned int otheroverdata = ((overdata >> 2) & 0x33333333) +
                                     ((trailoverdata << 2) & 0xcccccccc) ;
-               int newv = (ruletable[otheroverdata >> 16] << 26) +
-                          (ruletable[otherdata >> 16] << 18) +
-                          (ruletable[otheroverdata & 0xffff] << 10) +
-                          (ruletable[otherdata & 0xffff] << 2) +
-                          (ruletable[overdata >> 16] << 24) +
-                          (ruletable[zisdata >> 16] << 16) +
-                          (ruletable[overdata & 0xffff] << 8) +
-                           ruletable[zisdata & 0xffff] ;
+               int newv ;
+               if (usesliced)
+                  newv = (int)slices[j] ;
+               else
+                  newv = (ruletable[otheroverdata >> 16] << 26) +
+                         (ruletable[otherdata >> 16] << 18) +
+                         (ruletable[otheroverdata & 0xffff] << 10) +
+                         (ruletable[otherdata & 0xffff] << 2) +
+                         (ruletable[overdata >> 16] << 24) +
+                         (ruletable[zisdata >> 16] << 16) +
+                         (ruletable[overdata & 0xffff] << 8) +
+                          ruletable[zisdata & 0xffff] ;
                int delta = (b->d[j] ^ newv) | deltaforward | p->localdeltaforward ;
                STAT(rcc++) ;
                maska = cdelta | (delta & 0xcccccccc) ;
@@ -646,6 +903,12 @@ supertile *qlifealgo::markglobalchange(supertile *p, int lev, int &bits) {
         for (int i=0; i<4; i++)
           for (int j=0; j<16; j++)
             s |= pp->b[i]->d[j] ;
+        if ((pp->epoch >> 4) != (unsigned int)snapepoch) {
+          if (!s)
+            return (supertile *)emptytile ;   // a snapshot's; just drop it
+          p = thaw(p, lev) ;
+          pp = (tile *)p ;
+        }
         if (s) {
           pp->c[0] = pp->c[5] = 0x1ff ;
           pp->c[1] = pp->c[2] = pp->c[3] = pp->c[4] = 0x3ff ;
@@ -654,7 +917,7 @@ supertile *qlifealgo::markglobalchange(supertile *p, int lev, int &bits) {
         }
         bits = 0 ;
         for (int i=0; i<4; i++)
-           if (pp->b[i] != emptybrick) {
+           if (pp->b[i] != emptybrick && (pp->epoch & (1 << i))) {
                STAT(bricks--) ;
                ((linkedmem *)(pp->b[i]))->next = bricklist ;
                bricklist = (linkedmem *)(pp->b[i]) ;
@@ -670,6 +933,8 @@ supertile *qlifealgo::markglobalchange(supertile *p, int lev, int &bits) {
       if (p != nullroots[lev]) {
          int nchanging = 0 ;
          int nbits ;
+         if (snapepoch)
+            p = thaw(p, lev) ;
          if (generation.odd()) {
            for (i=0; i<8; i++) {
               p->d[i] = markglobalchange(p->d[i], lev-1, nbits) ;
@@ -681,7 +946,7 @@ supertile *qlifealgo::markglobalchange(supertile *p, int lev, int &bits) {
              nchanging |= nbits << (7-i) ;
            }
          }
-         if (nchanging != 0 || p == root) {
+         if (nchanging != 0 || lev == rootlev) {
             p->flags |= nchanging | 0xf0000000 ;
             bits = upchanging(nchanging) ;
             return p ;
@@ -698,35 +963,39 @@ supertile *qlifealgo::markglobalchange(supertile *p, int lev, int &bits) {
 }
 void qlifealgo::markglobalchange() {
    int bits = 0 ;
-   markglobalchange(root, rootlev, bits) ;
+   root = markglobalchange(root, rootlev, bits) ;
    deltaforward = 0xffffffff ;
 }
 /*
- *   This subroutine sets a bit at a particular location.
- *
- *   We walk down the tree to the particular bit, setting changing flags as
- *   we go.
+ *   Is any of the cells (see celltile) at the low edge (or on odd
+ *   generations, the high edge) of the block that mask picks out?
  */
-int qlifealgo::setcell(int x, int y, int newstate) {
-   if (newstate & ~1)
-      return -1 ;
-   y = - y ;
+static int atedge(const int *xc, int mask, int odd) {
+   int edge = (odd) ? mask : 0 ;
+   return (xc[0] & mask) == edge || (xc[1] & mask) == edge ||
+          (xc[2] & mask) == edge || (xc[3] & mask) == edge ;
+}
+/*
+ *   Walk down the tree to the tile holding cells x0 through x1 of row
+ *   y (which must all be in one tile), setting changing flags as we go.
+ *   Only the first two and last two cells of a tile can be at the edge
+ *   of a supertile, so those are the ones we check.
+ */
+tile *qlifealgo::celltile(int x0, int x1, int y, int odd) {
    supertile *b ;
-   tile *p ;
    int lev ;
-   int odd = generation.odd() ;
-   if (odd) {
-      x-- ;
-      y-- ;
-   }
-   while (x < min || x > max || y < min || y > max)
-      uproot() ;
-   int xdel = (x >> 5) - minlow32 ;
+   int xdel = (x0 >> 5) - minlow32 ;
    int ydel = (y >> 5) - minlow32 ;
-   int xc = x - (minlow32 << 5) ;
+   int xc[4] ;
+   xc[0] = x0 - (minlow32 << 5) ;
+   xc[1] = (x0 < x1 ? x0 + 1 : x0) - (minlow32 << 5) ;
+   xc[2] = (x0 < x1 ? x1 - 1 : x1) - (minlow32 << 5) ;
+   xc[3] = x1 - (minlow32 << 5) ;
    int yc = y - (minlow32 << 5) ;
    if (root == nullroot)
       root = newsupertile(rootlev) ;
+   else if (snapepoch)
+      root = thaw(root, rootlev) ;
    b = root ;
    lev = rootlev ;
    while (lev > 0) {
@@ -735,7 +1004,7 @@ int qlifealgo::setcell(int x, int y, int newstate) {
          int s = (lev >> 1) + lev - 1 ;
          i = (xdel >> s) & 7 ;
          s = (1 << (s + 5)) - 2 ;
-         if ((xc & s) == ((odd) ? s : 0))
+         if (atedge(xc, s, odd))
             d += 2 ;
          if ((yc & s) == ((odd) ? s : 0))
             d += d << 9 ;
@@ -746,7 +1015,7 @@ int qlifealgo::setcell(int x, int y, int newstate) {
          if ((yc & s) == ((odd) ? s : 0))
             d += 2 ;
          s |= s << 3 ;
-         if ((xc & s) == ((odd) ? s : 0))
+         if (atedge(xc, s, odd))
             d += d << 9 ;
       }
       if (odd)
@@ -756,14 +1025,37 @@ int qlifealgo::setcell(int x, int y, int newstate) {
       if (b->d[i] == nullroots[lev-1])
          b->d[i] = (lev==1 ? (supertile *)newtile() :
                                                       newsupertile(lev-1)) ;
+      else if (snapepoch)
+         b->d[i] = thaw(b->d[i], lev-1) ;
       lev -= 1 ;
       b = b->d[i] ;
    }
+   return (tile *)b ;
+}
+/*
+ *   This subroutine sets a bit at a particular location.
+ *
+ *   We walk down the tree to the particular bit, setting changing flags as
+ *   we go.
+ */
+int qlifealgo::setcell(int x, int y, int newstate) {
+   if (newstate & ~1)
+      return -1 ;
+   y = - y ;
+   tile *p ;
+   int odd = generation.odd() ;
+   if (odd) {
+      x-- ;
+      y-- ;
+   }
+   while (x < min || x > max || y < min || y > max)
+      uproot() ;
+   p = celltile(x, x, y, odd) ;
    x &= 31 ;
    y &= 31 ;
-   p = (tile *)b ;
-   if (p->b[(y >> 3) & 0x3] == emptybrick)
-      p->b[(y >> 3) & 0x3] = newbrick() ;
+   if (p->b[(y >> 3) & 0x3] == emptybrick ||
+       !(p->epoch & (1 << ((y >> 3) & 0x3))))
+      ownbrick(p, (y >> 3) & 0x3) ;
    if (odd) {
       int mor = ((x & 2) ? 3 : 1) << ((x >> 2) & 0x7) ;
       p->c[((y >> 3) & 0x3) + 1] |= mor ;
@@ -793,6 +1085,77 @@ int qlifealgo::setcell(int x, int y, int newstate) {
    }
    return 0 ;
 }
+/*
+ *   Set the live cells of a row a tile at a time, so we walk down the
+ *   tree and own the brick once for up to 32 cells.
+ */
+int qlifealgo::putrow(int x, int y, int n, const unsigned char *states) {
+   for (int i=0; i<n; i++)
+      if (states[i] & ~1)
+         return -1 ;
+   while (n > 0 && states[n-1] == 0)
+      n-- ;
+   while (n > 0 && states[0] == 0) {
+      x++ ;
+      states++ ;
+      n-- ;
+   }
+   if (n == 0)
+      return 0 ;
+   y = - y ;
+   int odd = generation.odd() ;
+   if (odd) {
+      x-- ;
+      y-- ;
+   }
+   while (x < min || x + n - 1 > max || y < min || y > max)
+      uproot() ;
+   int yy = y & 31 ;
+   int bi = (yy >> 3) & 0x3 ;
+   for (int i=0; i<n; ) {
+      // cells i through j-1 are in one tile
+      int j = ((x + i) | 31) - x + 1 ;
+      if (j > n)
+         j = n ;
+      int first = i, last = j - 1 ;
+      while (first <= last && states[first] == 0)
+         first++ ;
+      while (last > first && states[last] == 0)
+         last-- ;
+      if (first <= last) {
+         tile *p = celltile(x + first, x + last, y, odd) ;
+         if (p->b[bi] == emptybrick || !(p->epoch & (1 << bi)))
+            ownbrick(p, bi) ;
+         unsigned int *d = p->b[bi]->d + (odd ? 8 : 0) ;
+         int mor = 0 ;
+         int delta = 0 ;
+         for (int k=first; k<=last; k++) {
+            if (states[k] == 0)
+               continue ;
+            int xx = (x + k) & 31 ;
+            int bit = 1 << (31 - (yy & 7) * 4 - (xx & 3)) ;
+            d[(xx >> 2) & 0x7] |= bit ;
+            delta |= bit ;
+            if (odd)
+               mor |= ((xx & 2) ? 3 : 1) << ((xx >> 2) & 0x7) ;
+            else
+               mor |= ((xx & 2) ? 1 : 3) << (7 - ((xx >> 2) & 0x7)) ;
+         }
+         p->c[bi + 1] |= mor ;
+         if (odd) {
+            if ((yy & 6) == 6)
+               p->c[bi + 2] |= mor ;
+         } else {
+            if ((yy & 6) == 0)
+               p->c[bi] |= mor ;
+         }
+         p->flags = -1 ;
+         p->localdeltaforward |= delta ;
+      }
+      i = j ;
+   }
+   return 0 ;
+}
 /*
  *   This subroutine gets a bit at a particular location.
  */
@@ -923,6 +1286,88 @@ int qlifealgo::nextcell(int x, int y, supertile *n, int lev) {
    }
    return -1 ;
 }
+/*
+ *   Walk the universe a band of rows at a time.  Here y runs down the
+ *   tree and up the page, so the walk goes through the tree bottom
+ *   up.  bands[lev] holds the supertiles (with their left edges) that
+ *   lie side by side over the rows from bottom; an odd level is split
+ *   into its subtiles in place, and an even one gathers each row of
+ *   its subtiles into bands[lev-1] in turn, so each supertile is
+ *   visited once.  Everything is in our coordinates (flipped and, on
+ *   odd generations, shifted), and x0..x1-1 by y0..y1-1 is the part
+ *   asked for.
+ */
+bool qlifealgo::visitband(vector<vector<pair<supertile *, long long> > > &bands,
+                          int lev, long long bottom, long long x0,
+                          long long y0, long long x1, long long y1,
+                          cellrow &row) {
+   vector<pair<supertile *, long long> > &band = bands[lev] ;
+   int odd = generation.odd() ;
+   if (lev == 0) {
+      for (int y=31; y>=0; y--) {
+         if (bottom + y < y0 || bottom + y >= y1)
+            continue ;
+         int sh = (7 - (y & 7)) * 4 ;
+         int ey = (int)(-(bottom + y) - odd) ;
+         for (size_t i=0; i<band.size(); i++) {
+            brick *br = ((tile *)band[i].first)->b[y >> 3] ;
+            if (br == emptybrick)
+               continue ;
+            for (int j=0; j<8; j++) {
+               int t = (br->d[j + 8 * odd] >> sh) & 15 ;
+               for (int k=0; t; k++, t = (t << 1) & 15) {
+                  long long x = band[i].second + 4 * j + k ;
+                  if ((t & 8) && x >= x0 && x < x1)
+                     row.add((int)(x + odd), ey, 1) ;
+               }
+            }
+         }
+         if (!row.flush())
+            return false ;
+      }
+      return true ;
+   }
+   vector<pair<supertile *, long long> > &sub = bands[lev - 1] ;
+   long long wd = 32LL << (3 * (lev >> 1)) ;   // subtile width, height
+   long long ht = 32LL << (3 * ((lev - 1) >> 1)) ;
+   supertile *z = nullroots[lev - 1] ;
+   if (lev & 1) {
+      sub.clear() ;
+      for (size_t i=0; i<band.size(); i++)
+         for (int j=0; j<8; j++) {
+            long long x = band[i].second + j * wd ;
+            if (band[i].first->d[j] != z && x + wd > x0 && x < x1)
+               sub.push_back(make_pair(band[i].first->d[j], x)) ;
+         }
+      return sub.empty() ||
+             visitband(bands, lev - 1, bottom, x0, y0, x1, y1, row) ;
+   }
+   for (int j=7; j>=0; j--) {
+      long long subbottom = bottom + j * ht ;
+      if (subbottom + ht <= y0 || subbottom >= y1)
+         continue ;
+      sub.clear() ;
+      for (size_t i=0; i<band.size(); i++)
+         if (band[i].first->d[j] != z)
+            sub.push_back(make_pair(band[i].first->d[j], band[i].second)) ;
+      if (!sub.empty() &&
+          !visitband(bands, lev - 1, subbottom, x0, y0, x1, y1, row))
+         return false ;
+   }
+   return true ;
+}
+bool qlifealgo::visitcells(int x, int y, int w, int h, cellvisitor &v) {
+   if (w <= 0 || h <= 0 || root == nullroot)
+      return true ;
+   int odd = generation.odd() ;
+   long long origin = (long long)minlow32 << 5 ;
+   vector<vector<pair<supertile *, long long> > > bands(rootlev + 1) ;
+   bands[rootlev].push_back(make_pair(root, origin)) ;
+   cellrow row(v) ;
+   return visitband(bands, rootlev, origin, (long long)x - odd,
+                    1 - ((long long)y + h) - odd, (long long)x + w - odd,
+                    1 - (long long)y - odd, row) ;
+}
 /*
  *   This subroutine calculates the population count of the universe.  It
  *   uses dirty bits number 1 and 2 of supertiles.
@@ -1019,6 +1464,8 @@ supertile *qlifealgo::mdelete(supertile *p, int lev) {
    int i ;
    if (lev == 0) {
       tile *pp = (tile *)p ;
+      if ((pp->epoch >> 4) != (unsigned int)snapepoch)
+         return p ;   // a snapshot's; leave it alone
       if (pp->flags & 0xf) {
          int seen = 0 ;
          for (i=0; i<4; i++) {
@@ -1031,10 +1478,13 @@ supertile *qlifealgo::mdelete(supertile *p, int lev) {
                       b->d[15]) {
                      seen++ ;
                   } else {
-                     STAT(bricks--) ;
-                     ((linkedmem *)b)->next = bricklist ;
-                     bricklist = (linkedmem *)b ;
+                     if (pp->epoch & (1 << i)) {
+                        STAT(bricks--) ;
+                        ((linkedmem *)b)->next = bricklist ;
+                        bricklist = (linkedmem *)b ;
+                     }
                      pp->b[i] = emptybrick ;
+                     pp->epoch &= ~(1 << i) ;
                   }
                } else
                   seen++ ;
@@ -1052,6 +1502,8 @@ supertile *qlifealgo::mdelete(supertile *p, int lev) {
          }
       }
    } else {
+      if (p->epoch != snapepoch)
+         return p ;
       if (p->flags & 0x10000000) {
          int keep = 0 ;
          for (i=0; i<8; i++)
@@ -1102,6 +1554,184 @@ int qlifealgo::uproot_needed() {
          return 1 ;
    return 0 ;
 }
+/*
+ *   Multithreaded generations.  In the stagger step a tile looks at
+ *   the tiles after it in the walk (right and below for 0->1, left
+ *   and above for 1->0) only once they have been recomputed, through
+ *   the copies of their old change bits they keep for exactly that.
+ *   So we can't just hand whole subtrees to threads.  Instead
+ *   planquad() walks the levels above PARLEVEL just as doquad01() and
+ *   doquad10() would, and makes each PARLEVEL supertile that needs
+ *   recomputing a task that waits for the tasks of its edge, parallel
+ *   and corner neighbors.  A task runs the usual doquad code, so every
+ *   tile sees what it would have seen in the serial walk, and the
+ *   result is identical.  Tasks that don't depend on each other (a
+ *   wavefront running diagonally across the universe) run at once.
+ *
+ *   The upper levels work out which subtiles change from their
+ *   neighbors' old change bits alone, so planquad() can store those
+ *   right away; the new bits are folded in once all the tasks are
+ *   done.  Only the main thread polls.
+ */
+int qlifealgo::planquad(supertile *zis, supertile *edge, supertile *par,
+                        supertile *cor, int lev, int odd) {
+   qlifepool *p = pool ;
+   int me = (int)p->tasks.size() ;
+   p->tasks.push_back(qlifetask()) ;
+   qlifetask *t = &p->tasks[me] ;
+   t->zis = zis ;
+   t->edge = edge ;
+   t->par = par ;
+   t->cor = cor ;
+   t->lev = lev ;
+   t->parent = -1 ;
+   t->shift = 0 ;
+   t->deps = 0 ;
+   t->ndependents = 0 ;
+   t->changes = 0 ;
+   if (lev == PARLEVEL) {
+      supertile *after[3] = { edge, par, cor } ;
+      for (int i=0; i<3; i++) {
+         unordered_map<supertile *, int>::iterator it = p->taskof.find(after[i]) ;
+         if (it != p->taskof.end()) {
+            qlifetask &a = p->tasks[it->second] ;
+            a.dependents[a.ndependents++] = me ;
+            t->deps++ ;
+         }
+      }
+      p->taskof[zis] = me ;
+      if (t->deps == 0)
+         p->ready.push_back(me) ;
+      p->remaining++ ;
+      return me ;
+   }
+   int changing = (zis->flags | (par->flags >> 19) |
+                   (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
+   int x, b ;
+   supertile *q, *pf, *pu, *pfu ;
+   zis->flags = ((zis->flags & 0x3ff00) << 10) | 0xf0000000 ;
+   if (changing & 1) {
+      x = odd ? 0 : 7 ;
+      b = 1 ;
+      pf = edge->d[7-x] ;
+      pfu = cor->d[7-x] ;
+   } else {
+      b = (changing & - changing) ;
+      x = odd ? ai[b] : 7 - ai[b] ;
+      pf = zis->d[odd ? x - 1 : x + 1] ;
+      pfu = par->d[odd ? x - 1 : x + 1] ;
+   }
+   for (;;) {
+      q = zis->d[x] ;
+      pu = par->d[x] ;
+      if (changing & b) {
+         if (zis->d[x] == nullroots[lev-1])
+            q = zis->d[x] = newsupertile(lev-1) ;
+         else if (snapepoch)
+            q = zis->d[x] = thaw(q, lev-1) ;
+         int sub = planquad(q, pu, pf, pfu, lev-1, odd) ;
+         p->tasks[sub].parent = me ;
+         p->tasks[sub].shift = odd ? 7 - x : x ;
+         changing -= b ;
+      } else if (changing == 0)
+         break ;
+      b <<= 1 ;
+      x += odd ? 1 : -1 ;
+      pfu = pu ;
+      pf = q ;
+   }
+   return me ;
+}
+/*
+ *   Run ready tasks until there are none left; the workers then wait
+ *   for the next generation, the main thread returns.  Workers only
+ *   look at the queue while busy is set, since the main thread builds
+ *   the plan without holding the lock.
+ */
+void qlifealgo::runtasks(int worker) {
+   qlifepool *p = pool ;
+   std::unique_lock<std::mutex> lk(p->m) ;
+   for (;;) {
+      if (!p->busy || p->ready.empty()) {
+         if (worker && p->shutdown)
+            return ;
+         if (!worker && p->remaining == 0) {
+            p->busy = 0 ;
+            return ;
+         }
+         p->cv.wait(lk) ;
+         continue ;
+      }
+      int i = p->ready.front() ;
+      p->ready.pop_front() ;
+      lk.unlock() ;
+      qlifetask &t = p->tasks[i] ;
+      if (p->odd)
+         t.changes = doquad10(t.zis, t.edge, t.par, t.cor, t.lev) ;
+      else
+         t.changes = doquad01(t.zis, t.edge, t.par, t.cor, t.lev) ;
+      lk.lock() ;
+      for (int j=0; j<t.ndependents; j++)
+         if (--p->tasks[t.dependents[j]].deps == 0)
+            p->ready.push_back(t.dependents[j]) ;
+      p->remaining-- ;
+      p->cv.notify_all() ;
+   }
+}
+void qlifealgo::workerloop() {
+   qlifeworker = 1 ;
+   runtasks(1) ;
+}
+void qlifealgo::pardogen() {
+   if (pool == 0) {
+      pool = new qlifepool ;
+      pool->remaining = pool->odd = pool->shutdown = pool->busy = 0 ;
+      for (int i=1; i<numthreads; i++)
+         pool->threads.push_back(std::thread(&qlifealgo::workerloop, this)) ;
+   }
+   qlifepool *p = pool ;
+   p->tasks.clear() ;
+   p->taskof.clear() ;
+   p->ready.clear() ;
+   p->remaining = 0 ;
+   int odd = generation.odd() ;
+   planquad(root, nullroot, nullroot, nullroot, rootlev, odd) ;
+   {
+      std::lock_guard<std::mutex> lk(p->m) ;
+      p->odd = odd ;
+      p->busy = 1 ;
+      p->cv.notify_all() ;
+   }
+   runtasks(0) ;
+   for (int i=(int)p->tasks.size()-1; i>=0; i--) {
+      qlifetask &t = p->tasks[i] ;
+      int r = t.changes ;
+      if (t.lev > PARLEVEL) {
+         t.zis->flags |= r ;
+         r = upchanging(r) ;
+      }
+      if (t.parent >= 0)
+         p->tasks[t.parent].changes |= r << t.shift ;
+   }
+}
+void qlifealgo::killthreads() {
+   if (pool == 0)
+      return ;
+   {
+      std::lock_guard<std::mutex> lk(pool->m) ;
+      pool->shutdown = 1 ;
+      pool->cv.notify_all() ;
+   }
+   for (unsigned int i=0; i<pool->threads.size(); i++)
+      pool->threads[i].join() ;
+   delete pool ;
+   pool = 0 ;
+}
+void qlifealgo::setNumThreads(int n) {
+   poller->bailIfCalculating() ;
+   lifealgo::setNumThreads(n) ;
+   killthreads() ; // the pool is rebuilt on the next parallel step
+}
 /*
  *   The new generation code is simple.  We uproot if needed.  Then, we call
  *   the appropriate top-level slice code depending on the generation number.
@@ -1122,7 +1752,11 @@ void qlifealgo::dogen() {
       while (uproot_needed())
          uproot() ;
    }
-   if (generation.odd())
+   if (snapepoch)
+      root = thaw(root, rootlev) ;
+   if (numthreads > 1 && rootlev > PARLEVEL)
+      pardogen() ;
+   else if (generation.odd())
       doquad10(root, nullroot, nullroot, nullroot, rootlev) ;
    else
       doquad01(root, nullroot, nullroot, nullroot, rootlev) ;
@@ -1132,11 +1766,186 @@ void qlifealgo::dogen() {
    if (--cleandowncounter == 0) {
       cleandowncounter = 63 ;
       mdelete(root, rootlev) ;
+      if (snaps.size() > timeline.frames.size())
+         collectsnapshots() ;
    }
 #ifdef STATS
    dss += ds ; dqs += dq ; rccs += rcc ;
 #endif
 }
+/*
+ *   Snapshots.  getcurrentstate() just records the root (and the few
+ *   other things that say where it sits) and bumps the epoch; every
+ *   tile, supertile and brick that exists at that point now belongs to
+ *   the snapshot as well as to us, and is never written again.  When
+ *   the generation code, setcell() or setrule() needs to write to one,
+ *   thaw() makes a copy for us instead and we hook the copy in where
+ *   the old one was.  Since we only ever change things from the root
+ *   down, the parent is always ours already.  Bricks are copied the same
+ *   way by ownbrick(); their tile keeps track of which ones are its own.
+ *   So a snapshot costs nothing to take and only what changes after it
+ *   costs memory, and going back to one with setcurrentstate() is just
+ *   as cheap.
+ *
+ *   mdelete() leaves snapshots' structures alone; and we can't free
+ *   them anyway, since they might be shared.  Instead, once the timeline
+ *   drops some of its frames, collectsnapshots() marks what the
+ *   universe and the remaining frames can still reach and puts
+ *   everything else back on the free lists.  As with HashLife, a state
+ *   only stays valid while the timeline holds it.
+ */
+supertile *qlifealgo::thaw(supertile *p, int lev) {
+   if (lev == 0) {
+      tile *t = (tile *)p ;
+      if ((t->epoch >> 4) == (unsigned int)snapepoch)
+         return p ;
+      tile *r = newtile() ;
+      memcpy(r, t, sizeof(tile)) ;
+      r->epoch = snapepoch << 4 ;
+      return (supertile *)r ;
+   }
+   if (p->epoch == snapepoch)
+      return p ;
+   supertile *r = newsupertile(lev) ;
+   memcpy(r, p, sizeof(supertile)) ;
+   r->epoch = snapepoch ;
+   return r ;
+}
+brick *qlifealgo::ownbrick(tile *p, int i) {
+   brick *r = newbrick() ;
+   if (p->b[i] != emptybrick)
+      memcpy(r, p->b[i], sizeof(brick)) ;
+   p->b[i] = r ;
+   p->epoch |= 1 << i ;
+   return r ;
+}
+/*
+ *   Free what's ours (and so in no snapshot) below p.
+ */
+void qlifealgo::freeowned(supertile *p, int lev) {
+   if (lev == 0) {
+      tile *pp = (tile *)p ;
+      if (pp == emptytile || (pp->epoch >> 4) != (unsigned int)snapepoch)
+         return ;
+      for (int i=0; i<4; i++)
+         if (pp->b[i] != emptybrick && (pp->epoch & (1 << i))) {
+            STAT(bricks--) ;
+            ((linkedmem *)(pp->b[i]))->next = bricklist ;
+            bricklist = (linkedmem *)(pp->b[i]) ;
+         }
+      STAT(tiles--) ;
+      memset(pp, 0, sizeof(tile)) ;
+      ((linkedmem *)pp)->next = tilelist ;
+      tilelist = (linkedmem *)pp ;
+      return ;
+   }
+   if (p->epoch != snapepoch || p == nullroots[lev])
+      return ;
+   for (int i=0; i<8; i++)
+      freeowned(p->d[i], lev-1) ;
+   STAT(supertiles--) ;
+   memset(p, 0, sizeof(supertile)) ;
+   ((linkedmem *)p)->next = supertilelist ;
+   supertilelist = (linkedmem *)p ;
+}
+void *qlifealgo::getcurrentstate() {
+   qlifesnap *s = new qlifesnap ;
+   s->root = root ;
+   memcpy(s->nullroots, nullroots, sizeof(nullroots)) ;
+   s->rootlev = rootlev ;
+   s->min = min ;
+   s->max = max ;
+   s->minlow32 = minlow32 ;
+   s->deltaforward = deltaforward ;
+   s->bmin = bmin ;
+   s->bmax = bmax ;
+   snaps.push_back(s) ;
+   snapepoch++ ;
+   return s ;
+}
+void qlifealgo::setcurrentstate(void *n) {
+   qlifesnap *s = (qlifesnap *)n ;
+   if (root == s->root)
+      return ;
+   freeowned(root, rootlev) ;
+   for (int lev=1; lev<=rootlev; lev++)
+      if (nullroots[lev] != s->nullroots[lev] &&
+          nullroots[lev]->epoch == snapepoch) {
+         memset(nullroots[lev], 0, sizeof(supertile)) ;
+         ((linkedmem *)nullroots[lev])->next = supertilelist ;
+         supertilelist = (linkedmem *)nullroots[lev] ;
+      }
+   root = s->root ;
+   memcpy(nullroots, s->nullroots, sizeof(nullroots)) ;
+   rootlev = s->rootlev ;
+   nullroot = nullroots[rootlev] ;
+   min = s->min ;
+   max = s->max ;
+   minlow32 = s->minlow32 ;
+   deltaforward = s->deltaforward ;
+   bmin = s->bmin ;
+   bmax = s->bmax ;
+   popValid = 0 ;
+}
+void qlifealgo::marklive(supertile *p, int lev, unordered_set<void *> &live) {
+   if (!live.insert(p).second)
+      return ;
+   if (lev == 0) {
+      for (int i=0; i<4; i++)
+         live.insert(((tile *)p)->b[i]) ;
+   } else {
+      for (int i=0; i<8; i++)
+         marklive(p->d[i], lev-1, live) ;
+   }
+}
+/*
+ *   Forget the snapshots the timeline no longer holds, and rebuild the
+ *   free lists from what nothing can reach any more.
+ */
+void qlifealgo::collectsnapshots() {
+   unordered_set<void *> frames(timeline.frames.begin(), timeline.frames.end()) ;
+   unsigned int i, kept = 0 ;
+   for (i=0; i<snaps.size(); i++)
+      if (frames.count(snaps[i]))
+         snaps[kept++] = snaps[i] ;
+      else
+         delete snaps[i] ;
+   if (kept == snaps.size())
+      return ;
+   snaps.resize(kept) ;
+   unordered_set<void *> live ;
+   live.insert(emptybrick) ;
+   for (int lev=0; lev<=rootlev; lev++)
+      marklive(nullroots[lev], lev, live) ;
+   marklive(root, rootlev, live) ;
+   for (i=0; i<snaps.size(); i++) {
+      for (int lev=0; lev<=snaps[i]->rootlev; lev++)
+         marklive(snaps[i]->nullroots[lev], lev, live) ;
+      marklive(snaps[i]->root, snaps[i]->rootlev, live) ;
+   }
+   bricklist = tilelist = supertilelist = 0 ;
+   for (memchunk *m=memused; m; m=m->next) {
+      int size = m->size ;
+      g_uintptr_t p = (((g_uintptr_t)(m+1)) + (size & - size) - 1) & - (size & - size) ;
+      for (; p + size <= MEMCHUNK + (g_uintptr_t)m; p += size) {
+         if (live.count((void *)p))
+            continue ;
+         linkedmem *q = (linkedmem *)p ;
+         if (size == (int)sizeof(brick)) {
+            q->next = bricklist ;
+            bricklist = q ;
+         } else if (size == (int)sizeof(tile)) {
+            memset(q, 0, size) ;
+            q->next = tilelist ;
+            tilelist = q ;
+         } else {
+            memset(q, 0, size) ;
+            q->next = supertilelist ;
+            supertilelist = q ;
+         }
+      }
+   }
+}
 /**
  *   Step.  Do increment generations.
  */
@@ -1146,12 +1955,12 @@ void qlifealgo::step() {
    while (t != 0) {
       if (qliferules.alternate_rules) {
          // emulate B0-not-Smax rule by changing rule table depending on gen parity
-         if (generation.odd())
-            ruletable = qliferules.rule1 ;
-         else
-            ruletable = qliferules.rule0 ;
+         int k = generation.odd() ? 1 : 0 ;
+         ruletable = k ? qliferules.rule1 : qliferules.rule0 ;
+         slicerule = (brickkernel && sliced[k]) ? &slicerules[k] : 0 ;
       } else {
          ruletable = qliferules.rule0 ;
+         slicerule = (brickkernel && sliced[0]) ? &slicerules[0] : 0 ;
       }
       dogen() ;
       if (poller->isInterrupted())
@@ -1180,6 +1989,137 @@ static void fliprule(char *rptr) {
    }
 }
 
+/*
+ *   See whether a rule table is a totalistic Moore rule, and if so set
+ *   up its masks for the brick kernel.  We read the masks off the table
+ *   for the middle cell of a 3-square, then check them against every
+ *   entry.
+ */
+int qlifealgo::setslicedrule(const char *table, slicemasks &m) {
+   static const int around[8] = { 15, 14, 13, 11, 9, 7, 6, 5 } ;
+   int i, k ;
+   m.ncounts = 0 ;
+   for (k=0; k<9; k++) {
+      int nbhd = 0 ;
+      for (i=0; i<k; i++)
+         nbhd |= 1 << around[i] ;
+      m.birth[k] = (table[nbhd] & 0x20) ? ~0U : 0 ;
+      m.survive[k] = (table[nbhd | (1 << 10)] & 0x20) ? ~0U : 0 ;
+      if (m.birth[k] | m.survive[k])
+         m.counts[m.ncounts++] = (unsigned char)k ;
+   }
+   unsigned int zis[9], under[9], out[8] ;
+   memset(zis, 0, sizeof(zis)) ;
+   memset(under, 0, sizeof(under)) ;
+   for (i=0; i<65536; i++) {
+      zis[0] = (unsigned int)i << 16 ;
+      slicebricks(0, zis, under, out, m) ;
+      if ((int)((out[0] >> 26) & 0x33) != table[i])
+         return 0 ;
+   }
+   return 1 ;
+}
+/*
+ *   Compute all eight slices of a brick with the kernel setrule chose.
+ */
+void qlifealgo::slicebrick(int odd, const unsigned int *zis,
+                           const unsigned int *next, unsigned int *out) {
+#ifdef SLICEAVX2
+   if (brickkernel == 2) {
+      slicebricksavx2(odd, zis, next, out, *slicerule) ;
+      return ;
+   }
+#endif
+#ifdef SLICEBRICKS
+   slicebricksvec(odd, zis, next, out, *slicerule) ;
+#else
+   slicebricks(odd, zis, next, out, *slicerule) ;
+#endif
+}
+/*
+ *   Time the table and each bit-sliced kernel on the same random
+ *   bricks, and check that they agree.
+ */
+const char *qlifealgo::benchmarkBricks(int count) {
+   static char statusline[200] ;
+   if (count < 1)
+      count = 1 ;
+   vector<unsigned int> in(18 * (size_t)count), res(8 * (size_t)count),
+                        out(8 * (size_t)count) ;
+   unsigned int x = 2463534242U ;
+   for (size_t i=0; i<in.size(); i++) {
+      x ^= x << 13 ;
+      x ^= x >> 17 ;
+      x ^= x << 5 ;
+      in[i] = x ;
+   }
+   const char *rt = qliferules.rule0 ;
+   double start = gollySecondCount() ;
+   for (int i=0; i<count; i++) {
+      const unsigned int *zis = &in[18 * (size_t)i], *under = zis + 9 ;
+      for (int j=0; j<8; j++) {
+         unsigned int zisdata = zis[j], traildata = zis[j+1] ;
+         unsigned int underdata = (zisdata << 8) + (under[j] >> 24) ;
+         unsigned int trailunderdata = (traildata << 8) + (under[j+1] >> 24) ;
+         unsigned int otherdata = ((zisdata << 2) & 0xcccccccc) +
+                                  ((traildata >> 2) & 0x33333333) ;
+         unsigned int otherunderdata = ((underdata << 2) & 0xcccccccc) +
+                                  ((trailunderdata >> 2) & 0x33333333) ;
+         res[8*i+j] = (rt[zisdata >> 16] << 26) +
+                      (rt[underdata >> 16] << 18) +
+                      (rt[zisdata & 0xffff] << 10) +
+                      (rt[underdata & 0xffff] << 2) +
+                      (rt[otherdata >> 16] << 24) +
+                      (rt[otherunderdata >> 16] << 16) +
+                      (rt[otherdata & 0xffff] << 8) +
+                       rt[otherunderdata & 0xffff] ;
+      }
+   }
+   double tablesecs = gollySecondCount() - start ;
+   if (!sliced[0]) {
+      sprintf(statusline, "Brick results: table %g ns; rule %s can't be sliced.",
+              1e9 * tablesecs / count, qliferules.getrule()) ;
+      return statusline ;
+   }
+   double secs[3] = { 0, 0, 0 } ;
+   int mismatches = 0 ;
+   for (int kernel=0; kernel<3; kernel++) {
+      start = gollySecondCount() ;
+      for (int i=0; i<count; i++) {
+         const unsigned int *zis = &in[18 * (size_t)i] ;
+         unsigned int *o = &out[8 * (size_t)i] ;
+         if (kernel == 0)
+            slicebricks(0, zis, zis + 9, o, slicerules[0]) ;
+#ifdef SLICEBRICKS
+         else if (kernel == 1)
+            slicebricksvec(0, zis, zis + 9, o, slicerules[0]) ;
+#endif
+#ifdef SLICEAVX2
+         else if (hasavx2())
+            slicebricksavx2(0, zis, zis + 9, o, slicerules[0]) ;
+#endif
+         else
+            slicebricks(0, zis, zis + 9, o, slicerules[0]) ;
+      }
+      secs[kernel] = gollySecondCount() - start ;
+      for (size_t i=0; i<res.size(); i++)
+         if (out[i] != res[i])
+            mismatches++ ;
+   }
+   sprintf(statusline,
+     "Brick results: table %g ns, sliced %g ns, sliced %s %g ns, "
+     "sliced %s %g ns; %d mismatches.",
+           1e9 * tablesecs / count, 1e9 * secs[0] / count,
+#ifdef SLICEBRICKS
+           "vector",
+#else
+           "(no vector)",
+#endif
+           1e9 * secs[1] / count,
+           hasavx2() ? "avx2" : "(no avx2)", 1e9 * secs[2] / count,
+           mismatches) ;
+   return statusline ;
+}
 /**
  *   If we change the rule we need to mark everything dirty.
  */
@@ -1204,6 +2144,15 @@ const char *qlifealgo::setrule(const char *s) {
    
    // ruletable is set in step(), but play safe
    ruletable = qliferules.rule0 ;
+
+   // see whether p01() and p10() can use the bit-sliced brick kernel
+   sliced[0] = setslicedrule(qliferules.rule0, slicerules[0]) ;
+   sliced[1] = qliferules.alternate_rules &&
+               setslicedrule(qliferules.rule1, slicerules[1]) ;
+   brickkernel = maxbrickkernel < 0 ? 0 : maxbrickkernel > 2 ? 2 : maxbrickkernel ;
+   if (brickkernel > 1 && !hasavx2())
+      brickkernel = 1 ;
+   slicerule = (brickkernel && sliced[0]) ? &slicerules[0] : 0 ;
    
    if (qliferules.isHexagonal())
       grid_type = HEX_GRID;
@@ -9,6 +9,7 @@
 #include "lifealgo.h"
 #include "liferules.h"
 #include <vector>
+#include <unordered_set>
 /*
  *   The smallest unit of the universe is the `slice', which is a
  *   4 (horizontal) by 8 (vertical) chunk of the world.  Each slice
@@ -84,13 +85,18 @@ struct brick { /* 64 bytes */
  *
  *   Tiles are numbered as level `0' of the universe tree.
  *
- *   The tiles are 32 bytes each; they can hold up to four bricks, so the
+ *   The epoch is the snapshot epoch the tile was made in (see
+ *   getcurrentstate()) times 16, plus one bit for each of its bricks the
+ *   tile made itself in that epoch and so may write to.
+ *
+ *   The tiles are 36 bytes each; they can hold up to four bricks, so the
  *   memory consumption of the tiles tends to be small.
  */
-struct tile { /* 32 bytes */
+struct tile { /* 36 bytes */
    struct brick *b[4] ;
    short c[6] ;
    int flags, localdeltaforward ;
+   unsigned int epoch ;
 } ;
 /*
  *   Supertiles hold pointers to eight subtiles, which can either be 
@@ -138,14 +144,17 @@ struct tile { /* 32 bytes */
  *   we can easily build a universe with elements separated by 2^200
  *   pixels.
  *
- *   The supertiles are 44 bytes each; they correspond to at least a
+ *   The epoch is the snapshot epoch the supertile was made in.
+ *
+ *   The supertiles are 48 bytes each; they correspond to at least a
  *   256x32 chunk of the universe, so the total memory consumption due to
  *   supertiles tends to be small.
  */
-struct supertile { /* 44 bytes */
+struct supertile { /* 48 bytes */
    struct supertile *d[8] ;
    int flags ;
    int pop[2] ;
+   int epoch ;
 } ;
 /*
  *   This is a common header for chunks of memory linked together.
@@ -153,6 +162,37 @@ struct supertile { /* 44 bytes */
 struct linkedmem {
    struct linkedmem *next ;
 } ;
+/*
+ *   Each block of memory we allocate starts with one of these; the size
+ *   of the structures in it lets collectsnapshots() walk them.
+ */
+struct memchunk {
+   struct memchunk *next ;
+   int size ;
+} ;
+/*
+ *   For the multithreaded step; see qlifealgo.cpp.
+ */
+struct qlifepool ;
+/*
+ *   A snapshot of the universe, as handed out by getcurrentstate().
+ */
+struct qlifesnap {
+   supertile *root, *nullroots[40] ;
+   int rootlev, min, max, minlow32, deltaforward ;
+   bigint bmin, bmax ;
+} ;
+/*
+ *   A totalistic Moore rule as masks for the bit-sliced brick kernel:
+ *   for each neighbor count, all ones if a dead cell is born (birth) or
+ *   a live cell survives (survive), else zero.  Counts lists the counts
+ *   with either mask set.
+ */
+struct slicemasks {
+   unsigned int birth[9], survive[9] ;
+   unsigned char counts[9] ;
+   int ncounts ;
+} ;
 /*
  *   This structure contains all of our variables that pertain to a
  *   particular universe.  (Thus, we support multiple universes.)
@@ -191,8 +231,10 @@ public:
    qlifealgo() ;
    virtual ~qlifealgo() ;
    virtual int setcell(int x, int y, int newstate) ;
+   virtual int putrow(int x, int y, int n, const unsigned char *states) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &v) ;
+   virtual bool visitcells(int x, int y, int w, int h, cellvisitor &v) ;
    // call after setcell calls
    virtual void endofpattern() {
      poller->bailIfCalculating() ;
@@ -210,8 +252,8 @@ public:
    virtual const char *setrule(const char *s) ;
    virtual const char *getrule() { return qliferules.getrule() ; }
    virtual void step() ;
-   virtual void* getcurrentstate() { return 0 ; }
-   virtual void setcurrentstate(void *) {}
+   virtual void* getcurrentstate() ;
+   virtual void setcurrentstate(void *) ;
    virtual void draw(viewport &view, liferender &renderer) ;
    virtual void fit(viewport &view, int force) ;
    virtual void lowerRightPixel(bigint &x, bigint &y, int mag) ;
@@ -220,12 +262,26 @@ public:
       return "No native format for qlifealgo yet." ;
    }
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
+   virtual void setNumThreads(int n) ;
+   /*
+    *   Which brick kernel p01() and p10() may use for totalistic rules
+    *   set after this call: 0 for the rule table only, 1 for the
+    *   bit-sliced kernel with plain vectors (SSE2 on x86), 2 for AVX2
+    *   where the CPU has it (the default).
+    */
+   static void setBrickKernel(int k) { maxbrickkernel = k ; }
+   /*
+    *   Compare the table and the bit-sliced kernels on random bricks;
+    *   returns a line describing the timings.
+    */
+   const char *benchmarkBricks(int count) ;
 private:
    linkedmem *filllist(int size) ;
    brick *newbrick() ;
    tile *newtile() ;
    supertile *newsupertile(int lev) ;
    void uproot() ;
+   tile *celltile(int x0, int x1, int y, int odd) ;
    int doquad01(supertile *zis, supertile *edge,
                 supertile *par, supertile *cor, int lev) ;
    int doquad10(supertile *zis, supertile *edge,
@@ -238,11 +294,20 @@ private:
    G_INT64 popcount() ;
    int uproot_needed() ;
    void dogen() ;
+   int planquad(supertile *zis, supertile *edge, supertile *par,
+                supertile *cor, int lev, int odd) ;
+   void pardogen() ;
+   void runtasks(int worker) ;
+   void workerloop() ;
+   void killthreads() ;
    void renderbm(int x, int y) ;
    void renderbm(int x, int y, int xsize, int ysize) ;
    void BlitCells(supertile *p, int xoff, int yoff, int wd, int ht, int lev) ;
    void ShrinkCells(supertile *p, int xoff, int yoff, int wd, int ht, int lev) ;
    int nextcell(int x, int y, supertile *n, int lev) ;
+   bool visitband(vector<vector<pair<supertile *, long long> > > &bands,
+                  int lev, long long bottom, long long x0, long long y0,
+                  long long x1, long long y1, cellrow &row) ;
    void fill_ll(int d) ;
    int lowsub(vector<supertile*> &src, vector<supertile*> &dst, int lev) ;
    int highsub(vector<supertile*> &src, vector<supertile*> &dst, int lev) ;
@@ -251,6 +316,14 @@ private:
    int getvbitsfromleaves(vector<supertile *> v) ;
    supertile *markglobalchange(supertile *, int, int &) ;
    void markglobalchange() ; // call if the rule changes
+   supertile *thaw(supertile *p, int lev) ;
+   brick *ownbrick(tile *p, int i) ;
+   void freeowned(supertile *p, int lev) ;
+   void marklive(supertile *p, int lev, std::unordered_set<void *> &live) ;
+   void collectsnapshots() ;
+   int setslicedrule(const char *table, slicemasks &m) ;
+   void slicebrick(int odd, const unsigned int *zis,
+                   const unsigned int *next, unsigned int *out) ;
    /* data elements */
    int min, max, rootlev ;
    int minlow32 ;
@@ -258,13 +331,18 @@ private:
    bigint population ;
    int popValid ;
    linkedmem *tilelist, *supertilelist, *bricklist ;
-   linkedmem *memused ;
+   memchunk *memused ;
    brick *emptybrick ;
    tile *emptytile ;
    supertile *root, *nullroot, *nullroots[40] ;
    int cleandowncounter ;
    g_uintptr_t maxmemory, usedmemory ;
    char *ruletable ;
+   slicemasks slicerules[2] ;       // for rule0 and rule1
+   const slicemasks *slicerule ;    // for ruletable, if it can be sliced
+   int sliced[2] ;                  // which of rule0 and rule1 can be
+   int brickkernel ;                // chosen by setrule
+   static int maxbrickkernel ;
    // when drawing, these are used
    liferender *renderer ;
    viewport *view ;
@@ -275,5 +353,8 @@ private:
    int llbits, llsize ;
    char *llxb, *llyb ;
    liferules qliferules ;
+   qlifepool *pool ;
+   int snapepoch ;                  // bumped by getcurrentstate()
+   vector<qlifesnap *> snaps ;      // every snapshot we've handed out
 } ;
 #endif
@@ -11,6 +11,16 @@
 #endif
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define LINESIZE 20000
 #define CR 13
@@ -36,27 +46,145 @@ int buffpos, bytesread, prevchar;
 
 long filesize;             // length of file in bytes
 
+#ifdef ZLIB
+// how far through the compressed file we are
+static double zfilepos() {
+   #if ZLIB_VERNUM >= 0x1240
+      // gzoffset is only available in zlib 1.2.4 or later
+      return gzoffset(zinstream);
+   #else
+      // use an approximation of file position if file is compressed
+      double filepos = gztell(zinstream);
+      if (filepos > 0 && gzdirect(zinstream) == 0) filepos /= 4;
+      return filepos;
+   #endif
+}
+
+// With several threads, a compressed file is inflated on a thread of its
+// own, a few blocks ahead of the parser, so the two overlap.  Only that
+// thread touches zinstream while it runs.
+
+#define ZBLOCK (1 << 20)      // bytes inflated at a time
+#define ZBLOCKS 4             // blocks inflated ahead of the parser
+
+struct zahead {
+   zahead() : data((size_t)ZBLOCK * ZBLOCKS), filled(0), taken(0), at(0),
+              lastpos(0), done(false), stop(false) {
+      thread = std::thread(&zahead::run, this);
+   }
+   ~zahead() {
+      {
+         std::lock_guard<std::mutex> lk(lock);
+         stop = true;
+      }
+      cond.notify_all();
+      thread.join();
+   }
+   void run();
+   int read(char *buf, int len, double &filepos);
+
+   std::thread thread;
+   std::mutex lock;
+   std::condition_variable cond;
+   vector<char> data;
+   int len[ZBLOCKS];          // bytes in each block
+   double pos[ZBLOCKS];       // file position after each block
+   long filled, taken;        // blocks inflated and used up
+   int at;                    // bytes used of block taken
+   double lastpos;            // file position of the bytes last used
+   bool done, stop;
+};
+
+static zahead *ahead;         // non-null while reading ahead
+
+void zahead::run() {
+   std::unique_lock<std::mutex> lk(lock);
+   while (!stop) {
+      if (filled - taken == ZBLOCKS) {
+         cond.wait(lk);
+         continue;
+      }
+      int i = (int)(filled % ZBLOCKS);
+      lk.unlock();
+      int got = gzread(zinstream, &data[(size_t)i * ZBLOCK], ZBLOCK);
+      double filepos = zfilepos();
+      lk.lock();
+      if (got <= 0) {
+         done = true;
+      } else {
+         len[i] = got;
+         pos[i] = filepos;
+         filled++;
+      }
+      cond.notify_all();
+      if (done) break;
+   }
+}
+
+int zahead::read(char *buf, int want, double &filepos) {
+   std::unique_lock<std::mutex> lk(lock);
+   int got = 0;
+   while (got < want) {
+      if (taken == filled) {
+         if (done) break;
+         cond.wait(lk);
+         continue;
+      }
+      int i = (int)(taken % ZBLOCKS);
+      int n = std::min(want - got, len[i] - at);
+      lk.unlock();
+      memcpy(buf + got, &data[(size_t)i * ZBLOCK + at], n);
+      lk.lock();
+      got += n;
+      at += n;
+      lastpos = pos[i];
+      if (at == len[i]) {
+         taken++;
+         at = 0;
+         cond.notify_all();
+      }
+   }
+   filepos = lastpos;
+   return got;
+}
+
+// start reading ahead if it's worth it
+static void startahead(lifealgo &imp) {
+   if (imp.getNumThreads() > 1 && gzdirect(zinstream) == 0)
+      ahead = new zahead();
+}
+
+static void stopahead() {
+   delete ahead;
+   ahead = 0;
+}
+#endif
+
+// read up to len bytes from the pattern file and update the progress bar
+static int readfile(char *buf, int len) {
+   int got;
+   double filepos = 0;
+   #ifdef ZLIB
+      if (ahead) {
+         got = ahead->read(buf, len, filepos);
+      } else {
+         got = gzread(zinstream, buf, len);
+         filepos = zfilepos();
+      }
+   #else
+      got = fread(buf, 1, len, pattfile);
+      filepos = ftell(pattfile);
+   #endif
+   lifeabortprogress(filepos / filesize, "");
+   return got;
+}
+
 // use buffered getchar instead of slow fgetc
 // don't override the "getchar" name which is likely to be a macro
 int mgetchar() {
    if (buffpos == BUFFSIZE) {
-      double filepos;
-      #ifdef ZLIB
-         bytesread = gzread(zinstream, filebuff, BUFFSIZE);
-         #if ZLIB_VERNUM >= 0x1240
-            // gzoffset is only available in zlib 1.2.4 or later
-            filepos = gzoffset(zinstream);
-         #else
-            // use an approximation of file position if file is compressed
-            filepos = gztell(zinstream);
-            if (filepos > 0 && gzdirect(zinstream) == 0) filepos /= 4;
-         #endif
-      #else
-         bytesread = fread(filebuff, 1, BUFFSIZE, pattfile);
-         filepos = ftell(pattfile);
-      #endif
+      bytesread = readfile(filebuff, BUFFSIZE);
       buffpos = 0;
-      lifeabortprogress(filepos / filesize, "");
    }
    if (buffpos >= bytesread) return EOF;
    return filebuff[buffpos++];
@@ -163,6 +291,290 @@ void ParseXRLELine(char *line, int *xoff, int *yoff, bool *sawpos, bigint &gen)
    }
 }
 
+/*
+ *   The body of a big RLE file is read in large blocks rather than line
+ *   by line.  An rledecoder turns a block into runs of cells, and can
+ *   stop anywhere and carry on with the next block.  The cells are put
+ *   into the algorithm a row at a time (see lifealgo::putrow), with
+ *   short gaps of dead cells kept in the row rather than starting a new
+ *   one.  If we have several threads, each block is cut just after '$'
+ *   chars and the pieces are decoded at the same time; a piece starts
+ *   at the beginning of a row, so only its rows need to be offset.
+ */
+static bool fastrle = true;
+
+void setfastrle(bool fast) {
+   fastrle = fast;
+}
+
+#define RLEBLOCK (4 << 20)    // bytes decoded by each thread at a time
+#define RLEGAP 32             // dead cells that may be kept in a row
+
+struct rlerow {
+   int x, y, len;             // where the row is, and how many cells
+   size_t start;              // where its states are in rledecoder::cells
+};
+
+struct rledecoder {
+   int n, x, y;               // count in progress, and the position
+   int pend, pendn;           // first char of a two-char state, and its count
+   bool linestart, comment;   // at the start of a line, or in a comment?
+   bool done;                 // seen the '!'?
+   const char *err;
+   int gwd;                   // cells at or past this x are dropped
+   vector<rlerow> rows;       // the runs found so far
+   vector<unsigned char> cells;
+   size_t used;               // how much of cells is in use
+   bool open;                 // can the last row be extended?
+
+   rledecoder(int w) : n(0), x(0), y(0), pend(0), pendn(0), linestart(false),
+                       comment(false), done(false), err(0), gwd(w), used(0),
+                       open(false) {}
+   void run(int x, int y, int count, int state);
+   void decode(const char *p, const char *end);
+   void finish();
+};
+
+inline void rledecoder::run(int x, int y, int count, int state) {
+   if (gwd > 0 && x + count > gwd) count = x < gwd ? gwd - x : 0;
+   if (count <= 0) return;
+   int gap = 0;
+   if (open && x - (rows.back().x + rows.back().len) <= RLEGAP) {
+      rlerow &r = rows.back();
+      gap = x - (r.x + r.len);
+      r.len = x + count - r.x;
+   } else {
+      rlerow row = { x, y, count, used };
+      rows.push_back(row);
+      open = true;
+   }
+   // cells keeps its size from block to block, and most runs are short
+   if (used + gap + count > cells.size())
+      cells.resize(std::max(2 * cells.size(), used + gap + count));
+   unsigned char *q = &cells[used];
+   used += gap + count;
+   while (gap-- > 0) *q++ = 0;
+   while (count-- > 0) *q++ = (unsigned char)state;
+}
+
+// this follows the rules of the line-by-line reader below; the position
+// is kept in locals while we go, as run() writes through a char pointer
+void rledecoder::decode(const char *p, const char *end) {
+   int n = this->n, x = this->x, y = this->y;
+   if (done || err) return;
+   while (p < end) {
+      char c = *p++;
+      // the rare cases come first so the common ones are one switch
+      if (linestart || comment || pend) {
+         if (c == '\n' || c == '\r') {
+            comment = false;
+         } else if (comment) {
+            continue;
+         } else if (linestart) {
+            if (c == ' ' || c == '\t') continue;
+            linestart = false;
+            if (c == '#') {
+               comment = true;
+               continue;
+            }
+         }
+         if (pend) {
+            int state = pend;
+            pend = 0;
+            if ('A' <= c && c <= 'X') {
+               run(x, y, pendn, state + c - 'A' + 1);
+               x += pendn;
+               continue;
+            }
+            // be forgiving, as below
+            run(x, y, pendn, 1);
+            x += pendn;
+         }
+      }
+      switch (c) {
+         case 'b': case '.':
+            x += n ? n : 1;
+            n = 0;
+            break;
+         case 'o':
+            if (n == 0) n = 1;
+            run(x, y, n, 1);
+            x += n;
+            n = 0;
+            break;
+         case '$':
+            x = 0;
+            y += n ? n : 1;
+            n = 0;
+            open = false;
+            break;
+         case '0':
+            if (n == 0) {
+               err = "Leading zero in count";
+               goto stop;
+            }
+            n *= 10;
+            break;
+         case '1': case '2': case '3': case '4': case '5':
+         case '6': case '7': case '8': case '9':
+            n = n * 10 + c - '0';
+            break;
+         case '\n': case '\r':
+            if (n > 0) {
+               err = "Illegal whitespace after count";
+               goto stop;
+            }
+            linestart = true;
+            break;
+         case ' ': case '\t':
+            if (n != 0) {
+               err = "Illegal whitespace after count";
+               goto stop;
+            }
+            break;
+         case '!':
+            done = true;
+            goto stop;
+         default:
+            if (n == 0) n = 1;
+            if ('A' <= c && c <= 'X') {
+               run(x, y, n, c - 'A' + 1);
+               x += n;
+            } else if ('p' <= c && c <= 'y') {
+               pend = 24 * (c - 'p' + 1);
+               pendn = n;
+            }
+            n = 0;
+            break;
+      }
+   }
+stop:
+   this->n = n;
+   this->x = x;
+   this->y = y;
+}
+
+// the end of the file ends the last line
+void rledecoder::finish() {
+   if (!done) decode("\n", "\n" + 1);
+}
+
+// give the decoded rows to imp; the decoder's rows start at row y0
+static const char *putrows(lifealgo &imp, rledecoder &d, int xoff, int yoff, int y0) {
+   int ght = (int)imp.gridht;
+   for (size_t i = 0; i < d.rows.size(); i++) {
+      rlerow &r = d.rows[i];
+      int y = y0 + r.y;
+      if (ght > 0 && y >= ght) continue;
+      if (imp.putrow(xoff + r.x, yoff + y, r.len, &d.cells[r.start]) < 0)
+         return "Cell state out of range for this algorithm";
+   }
+   d.rows.clear();
+   d.used = 0;
+   d.open = false;
+   return 0;
+}
+
+// Find the first '$' in [p,end) that isn't in a comment and return the
+// char after it, or 0 if there isn't one.  A '$' with no line start
+// before it (back to from) is safe if from is; safe says if it is.
+static const char *rlesplit(const char *p, const char *end, const char *from, bool safe) {
+   for (; p < end; p++) {
+      if (*p != '$') continue;
+      const char *q = p;
+      while (q > from && q[-1] != '\n' && q[-1] != '\r') q--;
+      if (q == from) {
+         if (safe) return p + 1;
+         continue;
+      }
+      while (*q == ' ' || *q == '\t') q++;
+      if (*q != '#') return p + 1;
+   }
+   return 0;
+}
+
+// read the rest of the body, starting with the given line
+static const char *readrlebody(lifealgo &imp, const char *line, int xoff, int yoff) {
+   int nthreads = imp.getNumThreads();
+   const char *err;
+   vector<rledecoder> d(nthreads, rledecoder((int)imp.gridwd));
+   d[0].decode(line, line + strlen(line));
+   d[0].decode("\n", "\n" + 1);
+   vector<char> buf((size_t)RLEBLOCK * nthreads);
+   vector<const char *> cut(nthreads + 1);
+   vector<std::thread> threads;
+   int len = 0;
+   while (!d[0].done && !d[0].err) {
+      // use up what getline left in filebuff, then read straight into buf
+      if (buffpos < bytesread) {
+         len = bytesread - buffpos;
+         memcpy(&buf[0], filebuff + buffpos, len);
+         buffpos = bytesread;
+      } else {
+         len = 0;
+      }
+      while (len < (int)buf.size()) {
+         int got = readfile(&buf[len], (int)buf.size() - len);
+         if (isaborted()) return 0;
+         if (got <= 0) break;
+         len += got;
+      }
+      if (len == 0) break;
+      const char *start = &buf[0];
+      const char *end = start + len;
+      // a cut at the start of the block is safe if we're not in a comment
+      // (or at the start of a line that is one)
+      bool safe = !d[0].comment;
+      if (d[0].linestart) {
+         const char *q = start;
+         while (q < end && (*q == ' ' || *q == '\t')) q++;
+         if (q < end && *q == '#') safe = false;
+      }
+      int pieces = 1;
+      cut[0] = start;
+      for (int i = 1; i < nthreads; i++) {
+         const char *from = cut[pieces - 1];
+         const char *p = rlesplit(std::max(from, start + (size_t)len * i / nthreads), end,
+                                  from, pieces == 1 ? safe : true);
+         if (p == 0) break;
+         cut[pieces++] = p;
+      }
+      cut[pieces] = end;
+      for (int i = 1; i < pieces; i++)
+         threads.push_back(std::thread(&rledecoder::decode, &d[i], cut[i], cut[i+1]));
+      d[0].decode(cut[0], cut[1]);
+      for (size_t i = 0; i < threads.size(); i++)
+         threads[i].join();
+      threads.clear();
+      // put the rows in order; the first decoder's y is already absolute
+      int y0 = 0;
+      for (int i = 0; i < pieces; i++) {
+         err = putrows(imp, d[i], xoff, yoff, y0);
+         if (err == 0) err = d[i].err;
+         if (err || d[i].done) return err;
+         y0 += d[i].y;
+      }
+      // carry on from where the last piece stopped
+      if (pieces > 1) {
+         rledecoder &last = d[pieces - 1];
+         d[0].n = last.n;
+         d[0].x = last.x;
+         d[0].y = y0;
+         d[0].pend = last.pend;
+         d[0].pendn = last.pendn;
+         d[0].linestart = last.linestart;
+         d[0].comment = last.comment;
+         for (int i = 1; i < pieces; i++) {
+            d[i].n = d[i].x = d[i].y = d[i].pend = 0;
+            d[i].linestart = d[i].comment = false;
+         }
+      }
+   }
+   d[0].finish();
+   err = putrows(imp, d[0], xoff, yoff, 0);
+   return err ? err : d[0].err;
+}
+
 /*
  *   Read an RLE pattern into given life algorithm implementation.
  */
@@ -268,6 +680,8 @@ const char *readrle(lifealgo &imp, char *line, size_t nwsindex) {
             right = xoff + wd - 1;
          }
       } else {
+         // blank lines can come before the header
+         if (fastrle && line[0]) return readrlebody(imp, line, xoff, yoff);
          int gwd = (int)imp.gridwd;
          int ght = (int)imp.gridht;
          for (p=line; *p; p++) {
@@ -806,8 +1220,110 @@ const char *build_err_str(const char *filename) {
    return file_err_str;
 }
 
+// Read a binary macrocell file (see mcbhead in lifealgo.h), setting found
+// if it is one.  An uncompressed file is mapped rather than read, so the
+// algorithm canonicalizes the records straight out of the page cache.
+static const char *readbinarymacrocell(const char *filename, lifealgo &imp,
+                                       bool &found) {
+   unsigned char magic[8];
+   FILE *f = fopen(filename, "rb");
+   if (f == 0) return 0;
+   size_t n = fread(magic, 1, sizeof(magic), f);
+   fclose(f);
+   char *data = 0;
+   size_t len = 0;
+#ifndef _WIN32
+   bool mapped = false;
+#endif
+   if (ismcb((const char *)magic, n)) {
+#ifdef _WIN32
+      // no mapping here; just read it in
+      f = fopen(filename, "rb");
+      if (f == 0) return build_err_str(filename);
+      fseek(f, 0, SEEK_END);
+      len = (size_t)ftell(f);
+      fseek(f, 0, SEEK_SET);
+      data = (char *)malloc(len);
+      if (data == 0 || fread(data, 1, len, f) != len) {
+         fclose(f);
+         free(data);
+         return "Can't read binary macrocell file.";
+      }
+      fclose(f);
+#else
+      int fd = open(filename, O_RDONLY);
+      if (fd < 0) return build_err_str(filename);
+      struct stat st;
+      void *m = MAP_FAILED;
+      if (fstat(fd, &st) == 0) {
+         len = (size_t)st.st_size;
+         m = mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+      }
+      close(fd);
+      if (m == MAP_FAILED) return "Can't map binary macrocell file.";
+      madvise(m, len, MADV_SEQUENTIAL);
+      data = (char *)m;
+      mapped = true;
+#endif
+   }
+#ifdef ZLIB
+   else if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+      // a compressed file has to be inflated into memory
+      gzFile z = gzopen(filename, "rb");
+      if (z == 0) return 0;
+      n = gzread(z, magic, sizeof(magic));
+      if (ismcb((const char *)magic, n)) {
+         size_t cap = 4 * (size_t)filesize + sizeof(magic);
+         data = (char *)malloc(cap);
+         if (data) memcpy(data, magic, n);
+         len = n;
+         int got = 1;
+         while (data && got > 0) {
+            if (len == cap) {
+               cap += cap;
+               char *bigger = (char *)realloc(data, cap);
+               if (bigger == 0) {
+                  free(data);
+                  data = 0;
+                  break;
+               }
+               data = bigger;
+            }
+            size_t want = cap - len;
+            if (want > (1U << 30)) want = 1U << 30;
+            got = gzread(z, data + len, (unsigned)want);
+            if (got > 0) len += got;
+         }
+         if (data == 0 || got < 0) {
+            gzclose(z);
+            free(data);
+            return "Can't read binary macrocell file.";
+         }
+      }
+      gzclose(z);
+   }
+#endif
+   if (data == 0) return 0;
+   found = true;
+   lifebeginprogress("Reading pattern file");
+   const char *errmsg = imp.readbinarymacrocell(data, len);
+   if (errmsg == 0) imp.endofpattern();
+   lifeendprogress();
+#ifndef _WIN32
+   if (mapped) {
+      munmap(data, len);
+      return errmsg;
+   }
+#endif
+   free(data);
+   return errmsg;
+}
+
 const char *readpattern(const char *filename, lifealgo &imp) {
    filesize = getfilesize(filename);
+   bool binary = false;
+   const char *binerr = readbinarymacrocell(filename, imp, binary);
+   if (binary) return binerr;
 #ifdef ZLIB
    zinstream = gzopen(filename, "rb") ;      // rb needed on Windows
    if (zinstream == 0)
@@ -819,8 +1335,12 @@ const char *readpattern(const char *filename, lifealgo &imp) {
 #endif
    buffpos = BUFFSIZE;                       // for 1st getchar call
    prevchar = 0;                             // for 1st getline call
+#ifdef ZLIB
+   startahead(imp) ;
+#endif
    const char *errmsg = loadpattern(imp) ;
 #ifdef ZLIB
+   stopahead() ;
    gzclose(zinstream) ;
 #else
    fclose(pattfile) ;
@@ -848,7 +1368,13 @@ const char *readclipboard(const char *filename, lifealgo &imp,
    bottom = 0;
    right = 0;
    getedges = true;
+#ifdef ZLIB
+   startahead(imp);
+#endif
    const char *errmsg = loadpattern(imp);
+#ifdef ZLIB
+   stopahead();
+#endif
    getedges = false;
    *t = top;
    *l = left;
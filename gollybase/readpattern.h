@@ -15,6 +15,12 @@ const int maxcommlen = 1024 * 1024;
  */
 const char *readpattern(const char *filename, lifealgo &imp) ;
 
+/*
+ *   Read the body of an RLE file in big blocks (using the algorithm's
+ *   threads) rather than line by line; on by default.
+ */
+void setfastrle(bool fast) ;
+
 /*
  *   Get next line from current pattern file.
  */
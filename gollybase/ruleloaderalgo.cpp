@@ -193,6 +193,39 @@ state ruleloaderalgo::slowcalc(state nw, state n, state ne, state w, state c,
         return LocalRuleTree->slowcalc(nw, n, ne, w, c, e, sw, s, se);
 }
 
+void ruleloaderalgo::steprow(const state *above, const state *here,
+                             const state *below, state *out, int count)
+{
+    if (rule_type == TABLE)
+        LocalRuleTable->steprow(above, here, below, out, count);
+    else // rule_type == TREE
+        LocalRuleTree->steprow(above, here, below, out, count);
+}
+
+const char* ruleloaderalgo::benchmarkRule(int count)
+{
+    if (rule_type == TABLE)
+        return LocalRuleTable->benchmarkRule(count);
+    else // rule_type == TREE
+        return LocalRuleTree->benchmarkRule(count);
+}
+
+const char* ruleloaderalgo::transitionStats()
+{
+    if (rule_type == TABLE)
+        return LocalRuleTable->transitionStats();
+    else // rule_type == TREE
+        return LocalRuleTree->transitionStats();
+}
+
+void ruleloaderalgo::setMaxMemory(int m)
+{
+    // the memos live in the local algos, which size them from this
+    ghashbase::setMaxMemory(m);
+    LocalRuleTable->setMaxMemory(m);
+    LocalRuleTree->setMaxMemory(m);
+}
+
 static lifealgo* creator()
 {
     return new ruleloaderalgo();
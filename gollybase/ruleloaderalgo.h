@@ -17,6 +17,11 @@ public:
     virtual ~ruleloaderalgo();
     virtual state slowcalc(state nw, state n, state ne, state w, state c,
                            state e, state sw, state s, state se);
+    virtual void steprow(const state *above, const state *here,
+                         const state *below, state *out, int count) ;
+    virtual const char* benchmarkRule(int count);
+    virtual const char* transitionStats();
+    virtual void setMaxMemory(int m);
     virtual const char* setrule(const char* s);
     virtual const char* getrule();
     virtual const char* DefaultRule();
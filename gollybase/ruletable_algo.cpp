@@ -83,6 +83,7 @@ const char* ruletable_algo::setrule(const char* s)
    }
    
    maxCellStates = this->n_states;
+   makedense(this->neighborhood == vonNeumann);
    ghashbase::setrule(rule_name.c_str());
    return NULL;
 }
@@ -779,6 +780,16 @@ state ruletable_algo::slowcalc(state nw, state n, state ne, state w, state c, st
    return c; // default: no change
 }
 
+void ruletable_algo::steprow(const state *above, const state *here,
+                             const state *below, state *out, int count) {
+   if (dense)
+      densestep(above, here, below, out, count) ;
+   else if (memo)
+      memostep(this, above, here, below, out, count) ;
+   else
+      steprowof(this, above, here, below, out, count) ;
+}
+
 static lifealgo *creator() { return new ruletable_algo(); }
 
 void ruletable_algo::doInitializeAlgoInfo(staticAlgoInfo &ai) 
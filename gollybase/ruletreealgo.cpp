@@ -179,6 +179,7 @@ const char* ruletreealgo::setrule(const char* s) {
    b = nb ;
    base = noff[noff.size()-1] ;
    maxCellStates = num_states ;
+   makedense(num_neighbors == 4) ;
    ghashbase::setrule(rule_name.c_str()) ;
    
    // set canonical rule string returned by getrule()
@@ -228,6 +229,35 @@ state ruletreealgo::slowcalc(state nw, state n, state ne, state w, state c, stat
      return b[a[a[a[a[a[a[a[a[base+nw]+ne]+sw]+se]+n]+w]+e]+s]+c] ;
 }
 
+/*
+ *   Same walk as slowcalc(), but with the tree held in locals for
+ *   the whole row.
+ */
+void ruletreealgo::steprow(const state *above, const state *here,
+                           const state *below, state *out, int count) {
+   if (dense) {
+      densestep(above, here, below, out, count) ;
+      return ;
+   }
+   if (memo) {
+      memostep(this, above, here, below, out, count) ;
+      return ;
+   }
+   const int *ta = a ;
+   const state *tb = b ;
+   int tbase = base ;
+   if (num_neighbors == 4) {
+      for (int i=0; i<count; i++)
+         out[i] = tb[ta[ta[ta[ta[tbase+above[i]]+here[i-1]]+here[i+1]]
+                      +below[i]]+here[i]] ;
+   } else {
+      for (int i=0; i<count; i++)
+         out[i] = tb[ta[ta[ta[ta[ta[ta[ta[ta[tbase+above[i-1]]+above[i+1]]
+                      +below[i-1]]+below[i+1]]+above[i]]+here[i-1]]
+                      +here[i+1]]+below[i]]+here[i]] ;
+   }
+}
+
 static lifealgo *creator() { return new ruletreealgo() ; }
 
 void ruletreealgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
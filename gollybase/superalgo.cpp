@@ -1775,6 +1775,11 @@ state superalgo::slowcalc(state nw, state n, state ne, state w, state c,
    return result ;
 }
 
+void superalgo::steprow(const state *above, const state *here,
+                        const state *below, state *out, int count) {
+   steprowof(this, above, here, below, out, count) ;
+}
+
 static lifealgo *creator() { return new superalgo() ; }
 
 void superalgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
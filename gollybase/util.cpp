@@ -4,11 +4,16 @@
 #include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 /**
@@ -182,6 +187,179 @@ double gollySecondCount() {
 }
 #endif
 
+#ifdef _WIN32
+int mappedfile::open(const char *filename) {
+   close() ;
+   HANDLE f = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0) ;
+   if (f == INVALID_HANDLE_VALUE)
+      return 0 ;
+   LARGE_INTEGER size ;
+   HANDLE m = 0 ;
+   if (GetFileSizeEx(f, &size) && size.QuadPart > 0 &&
+       (unsigned long long)size.QuadPart <= (size_t)-1)
+      m = CreateFileMappingA(f, 0, PAGE_READONLY, 0, 0, 0) ;
+   CloseHandle(f) ;
+   if (m == 0)
+      return 0 ;
+   // the view keeps the mapping (and the file) open
+   data = (const char *)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) ;
+   CloseHandle(m) ;
+   if (data == 0)
+      return 0 ;
+   len = (size_t)size.QuadPart ;
+   return 1 ;
+}
+void mappedfile::close() {
+   if (data)
+      UnmapViewOfFile(data) ;
+   data = 0 ;
+   len = 0 ;
+}
+#else
+int mappedfile::open(const char *filename) {
+   close() ;
+   int fd = ::open(filename, O_RDONLY) ;
+   if (fd < 0)
+      return 0 ;
+   struct stat st ;
+   void *m = MAP_FAILED ;
+   if (fstat(fd, &st) == 0 && st.st_size > 0)
+      m = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+   ::close(fd) ;
+   if (m == MAP_FAILED)
+      return 0 ;
+   data = (const char *)m ;
+   len = (size_t)st.st_size ;
+   return 1 ;
+}
+void mappedfile::close() {
+   if (data)
+      munmap((void *)data, len) ;
+   data = 0 ;
+   len = 0 ;
+}
+#endif
+
+/*
+ *   Huge pages, for blockpool.  Only Linux lets us ask for them without
+ *   special privileges, so elsewhere the pool is just calloc.  A region
+ *   holds several huge pages; once reserving explicit huge pages fails
+ *   (usually because none were set aside) we stop trying them.
+ */
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+#define HUGEPAGES
+#endif
+const size_t HUGEPAGESIZE = 2 << 20 ;
+const size_t REGIONSIZE = 8 * HUGEPAGESIZE ;
+#ifdef HUGEPAGES
+static int explicithuge = 1 ;
+#endif
+int blockpool::remember(void *p, size_t size) {
+   if (nchunks == maxchunks) {
+      size_t n = maxchunks ? 2 * maxchunks : 64 ;
+      chunk *c = (chunk *)realloc(chunks, n * sizeof(chunk)) ;
+      if (c == 0)
+         return 0 ;
+      chunks = c ;
+      maxchunks = n ;
+   }
+   chunks[nchunks].p = p ;
+   chunks[nchunks].size = size ;
+   nchunks++ ;
+   return 1 ;
+}
+char *blockpool::newregion() {
+#ifdef HUGEPAGES
+   char *p = (char *)MAP_FAILED ;
+#ifdef MAP_HUGETLB
+   if (explicithuge) {
+      p = (char *)mmap(0, REGIONSIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) ;
+      if (p == (char *)MAP_FAILED)
+         explicithuge = 0 ;
+   }
+#endif
+   if (p == (char *)MAP_FAILED) {
+      // transparent huge pages need the region aligned to 2MB
+      char *q = (char *)mmap(0, REGIONSIZE + HUGEPAGESIZE,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+      if (q == (char *)MAP_FAILED)
+         return 0 ;
+      size_t skip = (HUGEPAGESIZE - ((size_t)q & (HUGEPAGESIZE - 1))) &
+                                                         (HUGEPAGESIZE - 1) ;
+      if (skip)
+         munmap(q, skip) ;
+      munmap(q + skip + REGIONSIZE, HUGEPAGESIZE - skip) ;
+      p = q + skip ;
+      hugehint(p, REGIONSIZE) ;
+   }
+   if (!remember(p, REGIONSIZE)) {
+      munmap(p, REGIONSIZE) ;
+      return 0 ;
+   }
+   return p ;
+#else
+   return 0 ;
+#endif
+}
+void *blockpool::alloc(size_t size) {
+   size = (size + 63) & ~(size_t)63 ;
+   if (huge && size <= REGIONSIZE) {
+      if (size > regionleft) {
+         char *r = newregion() ;
+         if (r) {
+            region = r ;
+            regionleft = REGIONSIZE ;
+         }
+      }
+      if (size <= regionleft) {
+         void *p = region ;
+         region += size ;
+         regionleft -= size ;
+         return p ; // fresh mapped memory is already zero
+      }
+   }
+   void *p = calloc(1, size) ;
+   if (p && !remember(p, 0)) {
+      free(p) ;
+      return 0 ;
+   }
+   return p ;
+}
+void blockpool::clear() {
+   for (size_t i=0; i<nchunks; i++) {
+#ifdef HUGEPAGES
+      if (chunks[i].size) {
+         munmap(chunks[i].p, chunks[i].size) ;
+         continue ;
+      }
+#endif
+      free(chunks[i].p) ;
+   }
+   free(chunks) ;
+   chunks = 0 ;
+   nchunks = maxchunks = 0 ;
+   region = 0 ;
+   regionleft = 0 ;
+}
+/*
+ *   Ask for transparent huge pages for the whole pages inside some
+ *   memory, such as a big hash table.
+ */
+void blockpool::hugehint(void *p, size_t size) {
+#ifdef HUGEPAGES
+   size_t lo = ((size_t)p + 4095) & ~(size_t)4095 ;
+   size_t hi = ((size_t)p + size) & ~(size_t)4095 ;
+   if (hi > lo)
+      madvise((void *)lo, hi - lo, MADV_HUGEPAGE) ;
+#else
+   (void)p ;
+   (void)size ;
+#endif
+}
+
 /*
  *   Reporting.
  *   The node count listed here wants to be big to reduce the number
@@ -201,6 +379,14 @@ double hperf::reportInterval = 2 ; // time between reports
  *   Static buffer for status updates.
  */
 char perfstatusline[200] ;
+/*
+ *   Algorithms that report their gc pauses get them added to the end.
+ */
+static void addgc(char *line, double gctime, double maxpause) {
+   if (gctime > 0)
+      sprintf(line+strlen(line), " gc %g ms max %g ms",
+              1000 * gctime, 1000 * maxpause) ;
+}
 void hperf::report(hperf &mark, int verbose) {
    double ts = gollySecondCount() ;
    double elapsed = ts - mark.timeStamp ;
@@ -217,6 +403,7 @@ void hperf::report(hperf &mark, int verbose) {
       double depthDelta = depthSum - mark.depthSum ;
       sprintf(perfstatusline, "RATE noderate %g depth %g half %g",
                        nodeCount/elapsed, 1+depthDelta/nodeCount, halfFrac) ;
+      addgc(perfstatusline, gcTime - mark.gcTime, gcMaxPause) ;
       lifestatus(perfstatusline) ;
    }
    mark = *this ;
@@ -245,8 +432,10 @@ void hperf::reportStep(hperf &mark, hperf &ratemark, double newGen, int verbose)
           "PERF gps %g nps %g fps %g depth %g half %g npg %g nodes %g",
           genspersec, nodeCount/elapsed, fps, 1+depthDelta/nodeCount, halfFrac,
           nodespergen, nodeCount) ;
+      addgc(perfstatusline, gcTime - mark.gcTime, gcMaxPause) ;
       lifestatus(perfstatusline) ;
    }
+   gcMaxPause = 0 ;
    genval = newGen ;
    mark = *this ;
    ratemark = *this ;
@@ -69,6 +69,52 @@ public:
  *   point, as a double.
  */
 double gollySecondCount() ;
+/*
+ *   Memory for the node blocks of the hashing algorithms.  Normally
+ *   each block is just calloc'ed.  With huge pages turned on, blocks
+ *   are instead cut from 2MB-aligned regions that we ask the kernel
+ *   to back with 2MB pages, explicit (MAP_HUGETLB) ones if any have
+ *   been reserved and transparent ones otherwise, so that walking a
+ *   great many nodes costs far fewer TLB misses.  Where huge pages
+ *   aren't available we quietly fall back to calloc.  Blocks are never
+ *   freed one at a time; clear() (or the destructor) frees them all.
+ */
+class blockpool {
+public:
+   blockpool() : huge(0), nchunks(0), maxchunks(0), chunks(0),
+                 region(0), regionleft(0) {}
+   ~blockpool() { clear() ; }
+   void usehugepages(int v) { huge = v ; }
+   void *alloc(size_t size) ;   // zeroed, or 0 if out of memory
+   void clear() ;
+   static void hugehint(void *p, size_t size) ;
+private:
+   struct chunk {
+      void *p ;
+      size_t size ;    // 0 for calloc'ed blocks
+   } ;
+   int remember(void *p, size_t size) ;
+   char *newregion() ;
+   int huge ;
+   size_t nchunks, maxchunks ;
+   chunk *chunks ;
+   char *region ;
+   size_t regionleft ;
+} ;
+/*
+ *   A file mapped read-only into memory, so that big files can be
+ *   walked straight out of the page cache rather than copied in.
+ *   open() returns 0 if the file is missing, empty or can't be mapped.
+ */
+class mappedfile {
+public:
+   mappedfile() : data(0), len(0) {}
+   ~mappedfile() { close() ; }
+   int open(const char *filename) ;
+   void close() ;
+   const char *data ;
+   size_t len ;
+} ;
 /*
  *   Performance data.  We keep running values here.  We can copy this
  *   to "mark" variables, and then report performance for deltas.
@@ -82,9 +128,16 @@ struct hperf {
       genval = 0 ;
       frames = 0 ;
       halfNodes = 0 ;
+      gcTime = 0 ;
+      gcMaxPause = 0 ;
    }
    void report(hperf&, int verbose) ;
    void reportStep(hperf&, hperf&, double genval, int verbose) ;
+   void gcpause(double secs) {
+      gcTime += secs ;
+      if (secs > gcMaxPause)
+         gcMaxPause = secs ;
+   }
    int fastinc(int depth, int half) {
       depthSum += depth ;
       if (half)
@@ -107,6 +160,8 @@ struct hperf {
    double depthSum ;
    double timeStamp ;
    double genval ;
+   double gcTime ;      // total seconds spent in gc
+   double gcMaxPause ;  // longest gc since the last step report
    static int reportMask ;
    static double reportInterval ;
 } ;
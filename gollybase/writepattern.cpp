@@ -11,6 +11,8 @@
 #ifdef ZLIB
 #include <zlib.h>
 #include <streambuf>
+#include <thread>
+#include <vector>
 #endif
 
 #ifdef __APPLE__
@@ -83,6 +85,86 @@ void AddRun(std::ostream &f,
    run = 0;                           // reset run count
 }
 
+// the live cells come from lifealgo::visitcells in row-major order;
+// runs of dead cells and of $ are counted from the gaps between them
+class rlewriter : public cellvisitor {
+public:
+   rlewriter(std::ostream &f, lifealgo &imp, int top, int l, unsigned int ht)
+      : linelen(0), multistate(imp.NumCellStates() > 2), os(f),
+        orun(0), dollrun(0), laststate(WRLE_NONE), cy(top), cx(l),
+        left(l), currcount(0), accumcount(0)
+   {
+      // for showing accurate progress we need to add pattern height to pop count
+      // in case this is a huge pattern with many blank rows
+      maxcount = imp.getPopulation().todouble() + ht;
+   }
+
+   virtual bool visit(int x, int y, int n, const unsigned char *states) {
+      if (y != cy) {
+         // rows between the last one and this one are empty
+         endrow();
+         dollrun += y - cy;
+         currcount += y - cy;
+         cy = y;
+         cx = left;
+      }
+      for (int i = 0; i < n; i++) {
+         int v = states[i];
+         if (v == 0) continue;
+         unsigned int brun = x + i - cx;
+         cx = x + i + 1;
+         if (brun > 0 && orun > 0) {
+            // output current run of live cells
+            AddRun(os, laststate, multistate, orun, linelen);
+            laststate = 0;
+         }
+         if (laststate == v) {
+            orun++;
+         } else {
+            if (dollrun > 0)
+               // output current run of $ chars
+               AddRun(os, WRLE_NEWLINE, multistate, dollrun, linelen);
+            if (brun > 0)
+               // output current run of dead cells
+               AddRun(os, 0, multistate, brun, linelen);
+            if (orun > 0)
+               AddRun(os, laststate, multistate, orun, linelen) ;
+            laststate = v ;
+            orun = 1;
+         }
+         currcount++;
+      }
+      if (currcount > 1024) {
+         char msg[128];
+         accumcount += currcount;
+         currcount = 0;
+         sprintf(msg, "File size: %.2f MB", os.tellp() / 1048576.0);
+         if (lifeabortprogress(accumcount / maxcount, msg)) return false;
+      }
+      return true;
+   }
+
+   // end of current row
+   void endrow() {
+      if (orun > 0)
+         // output current run of live cells
+         AddRun(os, laststate, multistate, orun, linelen);
+      laststate = WRLE_NONE;
+   }
+
+   unsigned int linelen;
+   int multistate;
+private:
+   std::ostream &os;
+   unsigned int orun;
+   unsigned int dollrun;
+   int laststate;
+   int cy, cx;             // current row, and the column after the last live cell
+   int left;
+   int currcount;
+   double accumcount, maxcount;
+};
+
 // write current pattern to file using extended RLE format
 const char *writerle(std::ostream &os, char *comments, lifealgo &imp,
                      int top, int left, int bottom, int right,
@@ -128,84 +210,13 @@ const char *writerle(std::ostream &os, char *comments, lifealgo &imp,
       outpos = strlen(outbuff);
 
       // do RLE data
-      unsigned int linelen = 0;
-      unsigned int brun = 0;
-      unsigned int orun = 0;
-      unsigned int dollrun = 0;
-      int laststate = WRLE_NONE ;
-      int multistate = imp.NumCellStates() > 2 ;
-      int cx, cy;
-      
-      // for showing accurate progress we need to add pattern height to pop count
-      // in case this is a huge pattern with many blank rows
-      double maxcount = imp.getPopulation().todouble() + ht;
-      double accumcount = 0;
-      int currcount = 0;
-      int v = 0 ;
-      for ( cy=top; cy<=bottom; cy++ ) {
-         // set lastchar to anything except 'o' or 'b'
-         laststate = WRLE_NONE ;
-         currcount++;
-         for ( cx=left; cx<=right; cx++ ) {
-            int skip = imp.nextcell(cx, cy, v);
-            if (skip + cx > right)
-               skip = -1;           // pretend we found no more live cells
-            if (skip > 0) {
-               // have exactly "skip" dead cells here
-               if (laststate == 0) {
-                  brun += skip;
-               } else {
-                  if (orun > 0) {
-                     // output current run of live cells
-                     AddRun(os, laststate, multistate, orun, linelen);
-                  }
-                  laststate = 0 ;
-                  brun = skip;
-               }
-            }
-            if (skip >= 0) {
-               // found next live cell in this row
-               cx += skip;
-               if (laststate == v) {
-                  orun++;
-               } else {
-                  if (dollrun > 0)
-                     // output current run of $ chars
-                     AddRun(os, WRLE_NEWLINE, multistate, dollrun, linelen);
-                  if (brun > 0)
-                     // output current run of dead cells
-                     AddRun(os, 0, multistate, brun, linelen);
-                  if (orun > 0)
-                     AddRun(os, laststate, multistate, orun, linelen) ;
-                  laststate = v ;
-                  orun = 1;
-               }
-               currcount++;
-            } else {
-               cx = right + 1;  // done this row
-            }
-            if (currcount > 1024) {
-               char msg[128];
-               accumcount += currcount;
-               currcount = 0;
-               sprintf(msg, "File size: %.2f MB", os.tellp() / 1048576.0);
-               if (lifeabortprogress(accumcount / maxcount, msg)) break;
-            }
-         }
-         // end of current row
-         if (isaborted()) break;
-         if (laststate == 0)
-            // forget dead cells at end of row
-            brun = 0;
-         else if (laststate >= 0)
-            // output current run of live cells
-            AddRun(os, laststate, multistate, orun, linelen);
-         dollrun++;
-      }
+      rlewriter rle(os, imp, top, left, ht);
+      imp.visitcells(left, top, wd, ht, rle);
+      rle.endrow();
       
       // terminate RLE data
-      dollrun = 1;
-      AddRun(os, WRLE_EOP, multistate, dollrun, linelen);
+      unsigned int dollrun = 1;
+      AddRun(os, WRLE_EOP, rle.multistate, dollrun, rle.linelen);
       putchar('\n', os);
 
       // flush outbuff
@@ -290,6 +301,188 @@ public:
 private:
    gzFile file;
 };
+
+// With several threads, gzip output is compressed the way pigz does it:
+// the data is cut into blocks that are deflated on their own threads (each
+// primed with the end of the block before, so little is lost) and ended
+// with a sync flush, so the pieces join up into one ordinary gzip stream.
+// The blocks are deflated a batch at a time while the next batch fills.
+
+#define GZBLOCK (1 << 20)     // bytes of input in each block
+#define GZDICT 32768          // size of deflate's window
+
+struct gzblock {
+   std::vector<char> in, dict, out;
+   size_t len;                // bytes of input
+   uLong crc;                 // crc32 of the input
+   bool last;
+   bool ok;
+};
+
+static void deflateblock(gzblock *b)
+{
+   z_stream z;
+   memset(&z, 0, sizeof(z));
+   b->ok = false;
+   b->crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)&b->in[0], (uInt)b->len);
+   if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK)
+      return;
+   if (!b->dict.empty())
+      deflateSetDictionary(&z, (const Bytef *)&b->dict[0], (uInt)b->dict.size());
+   b->out.resize(deflateBound(&z, (uLong)b->len) + 64);
+   z.next_in = (Bytef *)&b->in[0];
+   z.avail_in = (uInt)b->len;
+   z.next_out = (Bytef *)&b->out[0];
+   z.avail_out = (uInt)b->out.size();
+   int res = deflate(&z, b->last ? Z_FINISH : Z_SYNC_FLUSH);
+   b->out.resize(z.total_out);
+   b->ok = b->last ? res == Z_STREAM_END : res == Z_OK && z.avail_in == 0;
+   deflateEnd(&z);
+}
+
+class pgzbuf : public std::streambuf
+{
+public:
+   pgzbuf(int nthreads) : file(NULL), n(nthreads), filling(0), count(0),
+                          crc(crc32(0L, Z_NULL, 0)), total(0), written(0),
+                          bad(false)
+   {
+      for (int i = 0; i < 2; i++) {
+         batch[i].resize(n);
+         running[i] = 0;
+      }
+   }
+   ~pgzbuf() { close(); }
+
+   pgzbuf *open(const char *path)
+   {
+      if (file) return NULL;
+      file = fopen(path, "wb");
+      if (!file) return NULL;
+      // gzip header: deflate, no name, no time, Unix
+      static const unsigned char head[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+      put((const char *)head, sizeof(head));
+      startblock();
+      return this;
+   }
+
+   pgzbuf *close()
+   {
+      if (!file) return NULL;
+      // the block being filled is the last (even if it's empty)
+      endblock(true);
+      launch(filling, count + 1);
+      finish(filling);
+      unsigned char tail[8];
+      for (int i = 0; i < 4; i++) {
+         tail[i] = (unsigned char)(crc >> (8 * i));
+         tail[i + 4] = (unsigned char)(total >> (8 * i));
+      }
+      put((const char *)tail, sizeof(tail));
+      if (fclose(file) != 0) bad = true;
+      file = NULL;
+      return bad ? NULL : this;
+   }
+
+   int overflow(int c=EOF)
+   {
+      if (!file || bad) return EOF;
+      endblock(false);
+      if (c != EOF) {
+         *pptr() = (char)c;
+         pbump(1);
+      }
+      return c == EOF ? 0 : c;
+   }
+
+   int sync()
+   {
+      return bad ? -1 : 0;
+   }
+
+   pos_type seekoff(off_type off, std::ios_base::seekdir way, std::ios_base::openmode which)
+   {
+      if (file && off == 0 && way == std::ios_base::cur && which == std::ios_base::out)
+         // the bytes written so far (only used in progress dialog)
+         return pos_type(off_type(written));
+      return pos_type(off_type(-1));
+   }
+
+private:
+   // fill the next block of the current batch through the put area
+   void startblock()
+   {
+      gzblock &b = batch[filling][count];
+      b.in.resize(GZBLOCK);
+      setp(&b.in[0], &b.in[0] + GZBLOCK);
+   }
+
+   // finish filling the current block; a full batch starts deflating
+   void endblock(bool last)
+   {
+      gzblock &b = batch[filling][count];
+      b.len = pptr() - pbase();
+      b.last = last;
+      if (last) return;
+      count++;
+      if (count == n) {
+         launch(filling, n);
+         filling ^= 1;
+         count = 0;
+      }
+      startblock();
+   }
+
+   // start deflating the first m blocks of batch i, after writing out
+   // the batch before it (which also frees that one to be filled)
+   void launch(int i, int m)
+   {
+      finish(i ^ 1);
+      for (int j = 0; j < m; j++) {
+         gzblock &b = batch[i][j];
+         b.dict = dict;
+         size_t keep = b.len < GZDICT ? b.len : GZDICT;
+         dict.assign(b.in.begin() + (b.len - keep), b.in.begin() + b.len);
+         threads[i].push_back(std::thread(deflateblock, &b));
+      }
+      running[i] = m;
+   }
+
+   // wait for batch i and write it out in order
+   void finish(int i)
+   {
+      for (size_t t = 0; t < threads[i].size(); t++)
+         threads[i][t].join();
+      threads[i].clear();
+      for (int j = 0; j < running[i]; j++) {
+         gzblock &b = batch[i][j];
+         if (!b.ok) bad = true;
+         crc = crc32_combine(crc, b.crc, (z_off_t)b.len);
+         total += b.len;
+         put(&b.out[0], b.out.size());
+      }
+      running[i] = 0;
+   }
+
+   void put(const char *data, size_t len)
+   {
+      if (len > 0 && !bad && fwrite(data, 1, len, file) != len) bad = true;
+      written += len;
+   }
+
+   FILE *file;
+   int n;                                // blocks in a batch (one per thread)
+   std::vector<gzblock> batch[2];
+   std::vector<std::thread> threads[2];
+   int running[2];                       // blocks of each batch being deflated
+   int filling;                          // batch being filled
+   int count;                            // block being filled
+   std::vector<char> dict;               // end of the last block launched
+   uLong crc;
+   size_t total, written;
+   bool bad;
+};
 #endif
 
 const char *writepattern(const char *filename, lifealgo &imp,
@@ -322,17 +515,25 @@ const char *writepattern(const char *filename, lifealgo &imp,
    std::filebuf filebuf;
 #ifdef ZLIB
    gzbuf gzbuf;
+   pgzbuf pgzbuf(imp.getNumThreads());
 #endif
 
+   std::ios_base::openmode mode = std::ios_base::out;
+   if (format == MCB_format || format == MCBR_format)
+      mode |= std::ios_base::binary;
+
    switch (compression)
    {
    default:  /* no output compression */
-      streambuf = filebuf.open(filename, std::ios_base::out);
+      streambuf = filebuf.open(filename, mode);
       break;
 
    case gzip_compression:
 #ifdef ZLIB
-      streambuf = gzbuf.open(filename);
+      if (imp.getNumThreads() > 1)
+         streambuf = pgzbuf.open(filename);
+      else
+         streambuf = gzbuf.open(filename);
       break;
 #else
       if (commptr) free(commptr);
@@ -362,12 +563,23 @@ const char *writepattern(const char *filename, lifealgo &imp,
          errmsg = writemacrocell(os, comments, imp);
          break;
 
+      case MCB_format:
+      case MCBR_format:
+         // so does binary macrocell, and it has no comments
+         errmsg = imp.writeBinaryFormat(os, format == MCBR_format);
+         break;
+
       default:
          errmsg = "Unsupported pattern format!";
    }
 
    if (errmsg == NULL && !os.flush())
       errmsg = "Error occurred writing file; maybe disk is full?";
+#ifdef ZLIB
+   // most of the output of the threaded compressor is written on closing
+   if (streambuf == &pgzbuf && !pgzbuf.close() && errmsg == NULL)
+      errmsg = "Error occurred writing file; maybe disk is full?";
+#endif
 
    lifeendprogress();
 
@@ -8,7 +8,9 @@ class lifealgo;
 typedef enum {
    RLE_format,          // run length encoded
    XRLE_format,         // extended RLE
-   MC_format            // macrocell (native hashlife format)
+   MC_format,           // macrocell (native hashlife format)
+   MCB_format,          // binary macrocell
+   MCBR_format          // binary macrocell with the step results
 } pattern_format;
 
 typedef enum {
@@ -14,6 +14,7 @@
 #include "hlifealgo.h"
 #include "generationsalgo.h"
 #include "ltlalgo.h"
+#include "hltlalgo.h"
 #include "jvnalgo.h"
 #include "superalgo.h"
 #include "ruleloaderalgo.h"
@@ -740,6 +741,7 @@ void InitAlgorithms()
     // these algos can be in any order
     generationsalgo::doInitializeAlgoInfo(AlgoData::tick());
     ltlalgo::doInitializeAlgoInfo(AlgoData::tick());
+    hltlalgo::doInitializeAlgoInfo(AlgoData::tick());
     jvnalgo::doInitializeAlgoInfo(AlgoData::tick());
     superalgo::doInitializeAlgoInfo(AlgoData::tick());
     
@@ -878,3 +880,99 @@ int NumAlgos()
 {
     return staticAlgoInfo::getNumAlgos();
 }
+
+// -----------------------------------------------------------------------------
+
+CellWalker::CellWalker(int top, int left, int wd, int ht)
+    : aborted(false), top(top), left(left), wd(wd), cntr(0)
+{
+    maxcount = (double)wd * (double)ht;
+}
+
+// -----------------------------------------------------------------------------
+
+bool CellWalker::visit(int x, int y, int n, const unsigned char* states)
+{
+    for (int i = 0; i < n; i++) {
+        if (states[i]) cell(x + i, y, states[i]);
+    }
+    return progress(x, y, n);
+}
+
+// -----------------------------------------------------------------------------
+
+bool CellWalker::progress(int x, int y, int n)
+{
+    if (maxcount > 0) {
+        cntr += n;
+        if (cntr >= 4096) {
+            cntr = 0;
+            double prog = ((y - top) * (double)wd + (x - left)) / maxcount;
+            aborted = AbortProgress(prog, wxEmptyString);
+        }
+    }
+    return !aborted;
+}
+
+// -----------------------------------------------------------------------------
+
+CellCopier::CellCopier(lifealgo* srcalgo, lifealgo* destalgo, bool erasesrc,
+                       int top, int left, int wd, int ht)
+    : CellWalker(top, left, wd, ht), srcalgo(srcalgo), destalgo(destalgo),
+      erasesrc(erasesrc), identity(true), xx(1), xy(0), yx(0), yy(1), dx(0), dy(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+
+void CellCopier::SetTransform(int xx, int xy, int yx, int yy, int dx, int dy)
+{
+    this->xx = xx;
+    this->xy = xy;
+    this->yx = yx;
+    this->yy = yy;
+    this->dx = dx;
+    this->dy = dy;
+    identity = xx == 1 && xy == 0 && yx == 0 && yy == 1 && dx == 0 && dy == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+bool CellCopier::visit(int x, int y, int n, const unsigned char* states)
+{
+    if (identity) {
+        // dead cells are skipped so the whole piece can be put in one go
+        destalgo->putrow(x, y, n, states);
+    } else {
+        for (int i = 0; i < n; i++) {
+            if (states[i]) {
+                int cx = x + i;
+                destalgo->setcell(dx + xx * cx + xy * y, dy + yx * cx + yy * y, states[i]);
+            }
+        }
+    }
+    if (erasesrc) {
+        // srcalgo can't be changed during the walk so remember the cells to kill
+        for (int i = 0; i < n; i++) {
+            if (states[i]) {
+                copied.push_back(x + i);
+                copied.push_back(y);
+            }
+        }
+    }
+    return progress(x, y, n);
+}
+
+// -----------------------------------------------------------------------------
+
+void CellCopier::Finish()
+{
+    if (erasesrc) {
+        for (size_t i = 0; i < copied.size(); i += 2) {
+            srcalgo->setcell(copied[i], copied[i+1], 0);
+        }
+        copied.clear();
+        srcalgo->endofpattern();
+    }
+    destalgo->endofpattern();
+}
@@ -102,4 +102,61 @@ wxBitmap** ScaleIconBitmaps(wxBitmap** srcicons, int size);
 void FreeIconBitmaps(wxBitmap** icons);
 // Delete the given icon bitmaps.
 
+// A cellvisitor for walking the live cells in a rectangle with
+// lifealgo::visitcells.  By default visit calls cell for each live cell.
+// If given the rectangle being walked then AbortProgress is called every
+// so often and the walk stops (with aborted set) if the user cancels it
+// (the caller must call BeginProgress and EndProgress).
+class CellWalker : public cellvisitor {
+public:
+    CellWalker(int top = 0, int left = 0, int wd = 0, int ht = 0);
+    virtual bool visit(int x, int y, int n, const unsigned char* states);
+    virtual void cell(int, int, int) {}
+    bool aborted;
+protected:
+    bool progress(int x, int y, int n);
+    // count n more cells walked; returns false if the user cancelled
+private:
+    int top, left, wd;
+    double maxcount;
+    int cntr;
+};
+
+// A CellWalker that collects the live cells as x,y,state triples in
+// row order.  Cells can't be changed during the walk, so code that
+// changes them gathers them first.
+class CellGatherer : public CellWalker {
+public:
+    CellGatherer(int top = 0, int left = 0, int wd = 0, int ht = 0)
+        : CellWalker(top, left, wd, ht) {}
+    virtual void cell(int x, int y, int state) {
+        cells.push_back(x);
+        cells.push_back(y);
+        cells.push_back(state);
+    }
+    std::vector<int> cells;
+};
+
+// A CellWalker that copies the live cells it walks in srcalgo to destalgo
+// (which must be a different universe), optionally moving each cell x,y to
+// newx = dx + xx*x + xy*y, newy = dy + yx*x + yy*y.  If erasesrc is true
+// then Finish kills the copied cells in srcalgo.
+class CellCopier : public CellWalker {
+public:
+    CellCopier(lifealgo* srcalgo, lifealgo* destalgo, bool erasesrc,
+               int top = 0, int left = 0, int wd = 0, int ht = 0);
+    void SetTransform(int xx, int xy, int yx, int yy, int dx, int dy);
+    virtual bool visit(int x, int y, int n, const unsigned char* states);
+    void Finish();
+    // erase the copied cells if requested and call endofpattern;
+    // must be called after the walk, even if it was aborted
+private:
+    lifealgo* srcalgo;
+    lifealgo* destalgo;
+    bool erasesrc;
+    bool identity;
+    int xx, xy, yx, yy, dx, dy;
+    std::vector<int> copied;
+};
+
 #endif
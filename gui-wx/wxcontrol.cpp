@@ -1140,6 +1140,28 @@ void MainFrame::ToggleShowPopulation()
 
 // -----------------------------------------------------------------------------
 
+// ClearOutsideGrid uses this to gather the live cells outside the given
+// grid edges (they can't be cleared until the walk is done)
+
+class OutsideGridGatherer : public CellGatherer {
+public:
+    OutsideGridGatherer(int gtop, int gleft, int gbottom, int gright,
+                        int top, int left, int wd, int ht)
+        : CellGatherer(top, left, wd, ht),
+          gtop(gtop), gleft(gleft), gbottom(gbottom), gright(gright) {}
+    
+    virtual void cell(int x, int y, int state)
+    {
+        if (x < gleft || x > gright || y < gtop || y > gbottom)
+            CellGatherer::cell(x, y, state);
+    }
+    
+private:
+    int gtop, gleft, gbottom, gright;
+};
+
+// -----------------------------------------------------------------------------
+
 void MainFrame::ClearOutsideGrid()
 {
     // check current pattern and clear any live cells outside bounded grid
@@ -1168,7 +1190,7 @@ void MainFrame::ClearOutsideGrid()
         // algo uses an unbounded grid
         if (currlayer->algo->isEmpty()) return;
         
-        // check if current pattern is too big to use nextcell/setcell
+        // check if current pattern is too big to use visitcells/setcell
         bigint top, left, bottom, right;
         currlayer->algo->findedges(&top, &left, &bottom, &right);
         if ( viewptr->OutsideLimits(top, left, bottom, right) ) {
@@ -1200,44 +1222,20 @@ void MainFrame::ClearOutsideGrid()
             return;
         }
         
+        int wd = iright - ileft + 1;
         int ht = ibottom - itop + 1;
-        int cx, cy;
-        
-        // for showing accurate progress we need to add pattern height to pop count
-        // in case this is a huge pattern with many blank rows
-        double maxcount = currlayer->algo->getPopulation().todouble() + ht;
-        double accumcount = 0;
-        int currcount = 0;
-        bool abort = false;
-        int v = 0;
         BeginProgress(_("Checking cells outside grid"));
         
         lifealgo* curralgo = currlayer->algo;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            currcount++;
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (cx < gleft || cx > gright || cy < gtop || cy > gbottom) {
-                        // clear cell outside grid
-                        if (savechanges) currlayer->undoredo->SaveCellChange(cx, cy, v, 0);
-                        curralgo->setcell(cx, cy, 0);
-                        patternchanged = true;
-                    }
-                    currcount++;
-                } else {
-                    cx = iright;  // done this row
-                }
-                if (currcount > 1024) {
-                    accumcount += currcount;
-                    currcount = 0;
-                    abort = AbortProgress(accumcount / maxcount, wxEmptyString);
-                    if (abort) break;
-                }
-            }
-            if (abort) break;
+        OutsideGridGatherer outside(gtop, gleft, gbottom, gright, itop, ileft, wd, ht);
+        curralgo->visitcells(ileft, itop, wd, ht, outside);
+        for (size_t i = 0; i < outside.cells.size(); i += 3) {
+            // clear cell outside grid
+            int cx = outside.cells[i];
+            int cy = outside.cells[i+1];
+            if (savechanges) currlayer->undoredo->SaveCellChange(cx, cy, outside.cells[i+2], 0);
+            curralgo->setcell(cx, cy, 0);
+            patternchanged = true;
         }
         
         curralgo->endofpattern();
@@ -1251,13 +1249,32 @@ void MainFrame::ClearOutsideGrid()
 
 // -----------------------------------------------------------------------------
 
+// ReduceCellStates uses this to gather the live cells with states above
+// the given maximum (they can't be changed until the walk is done)
+
+class HighStateGatherer : public CellGatherer {
+public:
+    HighStateGatherer(int maxstate, int top, int left, int wd, int ht)
+        : CellGatherer(top, left, wd, ht), maxstate(maxstate) {}
+    
+    virtual void cell(int x, int y, int state)
+    {
+        if (state > maxstate) CellGatherer::cell(x, y, state);
+    }
+    
+private:
+    int maxstate;
+};
+
+// -----------------------------------------------------------------------------
+
 void MainFrame::ReduceCellStates(int newmaxstate)
 {
     // check current pattern and reduce any cell states > newmaxstate
     bool patternchanged = false;
     bool savechanges = allowundo && !currlayer->stayclean;
     
-    // check if current pattern is too big to use nextcell/setcell
+    // check if current pattern is too big to use visitcells/setcell
     bigint top, left, bottom, right;
     currlayer->algo->findedges(&top, &left, &bottom, &right);
     if ( viewptr->OutsideLimits(top, left, bottom, right) ) {
@@ -1269,44 +1286,20 @@ void MainFrame::ReduceCellStates(int newmaxstate)
     int ileft = left.toint();
     int ibottom = bottom.toint();
     int iright = right.toint();
+    int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    int cx, cy;
-    
-    // for showing accurate progress we need to add pattern height to pop count
-    // in case this is a huge pattern with many blank rows
-    double maxcount = currlayer->algo->getPopulation().todouble() + ht;
-    double accumcount = 0;
-    int currcount = 0;
-    bool abort = false;
-    int v = 0;
     BeginProgress(_("Checking cell states"));
     
     lifealgo* curralgo = currlayer->algo;
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        currcount++;
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip >= 0) {
-                // found next live cell in this row
-                cx += skip;
-                if (v > newmaxstate) {
-                    // reduce cell's current state to largest state
-                    if (savechanges) currlayer->undoredo->SaveCellChange(cx, cy, v, newmaxstate);
-                    curralgo->setcell(cx, cy, newmaxstate);
-                    patternchanged = true;
-                }
-                currcount++;
-            } else {
-                cx = iright;  // done this row
-            }
-            if (currcount > 1024) {
-                accumcount += currcount;
-                currcount = 0;
-                abort = AbortProgress(accumcount / maxcount, wxEmptyString);
-                if (abort) break;
-            }
-        }
-        if (abort) break;
+    HighStateGatherer high(newmaxstate, itop, ileft, wd, ht);
+    curralgo->visitcells(ileft, itop, wd, ht, high);
+    for (size_t i = 0; i < high.cells.size(); i += 3) {
+        // reduce cell's current state to largest state
+        int cx = high.cells[i];
+        int cy = high.cells[i+1];
+        if (savechanges) currlayer->undoredo->SaveCellChange(cx, cy, high.cells[i+2], newmaxstate);
+        curralgo->setcell(cx, cy, newmaxstate);
+        patternchanged = true;
     }
     
     curralgo->endofpattern();
@@ -1391,11 +1384,55 @@ void MainFrame::ShowRuleDialog()
 
 // -----------------------------------------------------------------------------
 
+// ChangeAlgorithm uses this to copy the live cells to a universe of the new
+// algorithm, dropping cells outside its grid and reducing states it lacks
+
+class AlgoConverter : public CellWalker {
+public:
+    AlgoConverter(lifealgo* newalgo, bool savechanges,
+                  int gtop, int gleft, int gbottom, int gright,
+                  int top, int left, int wd, int ht)
+        : CellWalker(top, left, wd, ht), patternchanged(false),
+          newalgo(newalgo), savechanges(savechanges),
+          gtop(gtop), gleft(gleft), gbottom(gbottom), gright(gright)
+    {
+        newmaxstate = newalgo->NumCellStates() - 1;
+    }
+    
+    virtual void cell(int x, int y, int state)
+    {
+        if (x < gleft || x > gright || y < gtop || y > gbottom) {
+            // x,y is outside grid
+            if (savechanges) currlayer->undoredo->SaveCellChange(x, y, state, 0);
+            // no need to clear cell from old universe (it will soon be deleted)
+            patternchanged = true;
+        } else {
+            if (state > newmaxstate) {
+                // reduce state to largest state in new algo
+                if (savechanges) currlayer->undoredo->SaveCellChange(x, y, state, newmaxstate);
+                state = newmaxstate;
+                patternchanged = true;
+            }
+            newalgo->setcell(x, y, state);
+        }
+    }
+    
+    bool patternchanged;
+    
+private:
+    lifealgo* newalgo;
+    bool savechanges;
+    int gtop, gleft, gbottom, gright;
+    int newmaxstate;
+};
+
+// -----------------------------------------------------------------------------
+
 void MainFrame::ChangeAlgorithm(algo_type newalgotype, const wxString& newrule, bool inundoredo)
 {
     if (newalgotype == currlayer->algtype) return;
     
-    // check if current pattern is too big to use nextcell/setcell
+    // check if current pattern is too big to use visitcells/setcell
     bigint top, left, bottom, right;
     if ( !currlayer->algo->isEmpty() ) {
         currlayer->algo->findedges(&top, &left, &bottom, &right);
@@ -1482,16 +1519,8 @@ void MainFrame::ChangeAlgorithm(algo_type newalgotype, const wxString& newrule,
         int ileft = left.toint();
         int ibottom = bottom.toint();
         int iright = right.toint();
+        int wd = iright - ileft + 1;
         int ht = ibottom - itop + 1;
-        int cx, cy;
-        
-        // for showing accurate progress we need to add pattern height to pop count
-        // in case this is a huge pattern with many blank rows
-        double maxcount = currlayer->algo->getPopulation().todouble() + ht;
-        double accumcount = 0;
-        int currcount = 0;
-        bool abort = false;
-        int v = 0;
         BeginProgress(_("Converting pattern"));
         
         // set newalgo's grid edges so we can save cells that are outside grid
@@ -1511,43 +1540,10 @@ void MainFrame::ChangeAlgorithm(algo_type newalgotype, const wxString& newrule,
         }
         
         // need to check for state change if new algo has fewer states than old algo
-        int newmaxstate = newalgo->NumCellStates() - 1;
-        
-        lifealgo* curralgo = currlayer->algo;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            currcount++;
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (cx < gleft || cx > gright || cy < gtop || cy > gbottom) {
-                        // cx,cy is outside grid
-                        if (savechanges) currlayer->undoredo->SaveCellChange(cx, cy, v, 0);
-                        // no need to clear cell from curralgo (that universe will soon be deleted)
-                        patternchanged = true;
-                    } else {
-                        if (v > newmaxstate) {
-                            // reduce v to largest state in new algo
-                            if (savechanges) currlayer->undoredo->SaveCellChange(cx, cy, v, newmaxstate);
-                            v = newmaxstate;
-                            patternchanged = true;
-                        }
-                        newalgo->setcell(cx, cy, v);
-                    }
-                    currcount++;
-                } else {
-                    cx = iright;  // done this row
-                }
-                if (currcount > 1024) {
-                    accumcount += currcount;
-                    currcount = 0;
-                    abort = AbortProgress(accumcount / maxcount, wxEmptyString);
-                    if (abort) break;
-                }
-            }
-            if (abort) break;
-        }
+        AlgoConverter converter(newalgo, savechanges, gtop, gleft, gbottom, gright,
+                                itop, ileft, wd, ht);
+        currlayer->algo->visitcells(ileft, itop, wd, ht, converter);
+        if (converter.patternchanged) patternchanged = true;
         
         newalgo->endofpattern();
         EndProgress();
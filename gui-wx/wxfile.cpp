@@ -948,6 +948,7 @@ void MainFrame::OpenPattern()
     filetypes +=         _("|RLE (*.rle)|*.rle");
     filetypes +=         _("|RLE3 (*.rle3)|*.rle3");
     filetypes +=         _("|Macrocell (*.mc)|*.mc");
+    filetypes +=         _("|Binary Macrocell (*.mcb)|*.mcb");
     filetypes +=         _("|Gzip (*.gz)|*.gz");
     filetypes +=         _("|Life 1.05/1.06 (*.lif)|*.lif");
     filetypes +=         _("|dblife (*.l)|*.l");
@@ -255,6 +255,39 @@ static int g_savedialog(lua_State* L)
 
 // -----------------------------------------------------------------------------
 
+// ExtractCellArray, g_getcells and g_getclip use this to append the live cells
+// of a universe to the cell array on top of the Lua stack, with dx,dy subtracted
+// from each cell's coordinates
+
+class CellArrayWalker : public cellvisitor {
+public:
+    CellArrayWalker(lua_State* L, int dx, int dy, bool multistate)
+        : arraylen(0), L(L), dx(dx), dy(dy), multistate(multistate) {}
+    
+    virtual bool visit(int x, int y, int n, const unsigned char* states)
+    {
+        for (int i = 0; i < n; i++) {
+            if (states[i]) {
+                lua_pushinteger(L, x + i - dx); lua_rawseti(L, -2, ++arraylen);
+                lua_pushinteger(L, y - dy); lua_rawseti(L, -2, ++arraylen);
+                if (multistate) {
+                    lua_pushinteger(L, states[i]); lua_rawseti(L, -2, ++arraylen);
+                }
+            }
+        }
+        return true;
+    }
+    
+    int arraylen;
+    
+private:
+    lua_State* L;
+    int dx, dy;
+    bool multistate;
+};
+
+// -----------------------------------------------------------------------------
+
 static const char* ExtractCellArray(lua_State* L, lifealgo* universe, bool shift = false)
 {
     // extract cell array from given universe
@@ -270,31 +303,10 @@ static const char* ExtractCellArray(lua_State* L, lifealgo* universe, bool shift
         int ileft = left.toint();
         int ibottom = bottom.toint();
         int iright = right.toint();
-        int cx, cy;
-        int v = 0;
-        int arraylen = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = universe->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (shift) {
-                        // shift cells so that top left cell of bounding box is at 0,0
-                        lua_pushinteger(L, cx - ileft); lua_rawseti(L, -2, ++arraylen);
-                        lua_pushinteger(L, cy - itop ); lua_rawseti(L, -2, ++arraylen);
-                    } else {
-                        lua_pushinteger(L, cx); lua_rawseti(L, -2, ++arraylen);
-                        lua_pushinteger(L, cy); lua_rawseti(L, -2, ++arraylen);
-                    }
-                    if (multistate) {
-                        lua_pushinteger(L, v); lua_rawseti(L, -2, ++arraylen);
-                    }
-                } else {
-                    cx = iright;  // done this row
-                }
-            }
-        }
+        // if shift is true then shift cells so that top left cell of bounding box is at 0,0
+        CellArrayWalker walker(L, shift ? ileft : 0, shift ? itop : 0, multistate);
+        universe->visitcells(ileft, itop, iright - ileft + 1, ibottom - itop + 1, walker);
+        int arraylen = walker.arraylen;
         if (multistate && arraylen > 0 && (arraylen & 1) == 0) {
             // add padding zero so the cell array has an odd number of ints
             // (this is how we distinguish multi-state arrays from one-state arrays;
@@ -307,6 +319,38 @@ static const char* ExtractCellArray(lua_State* L, lifealgo* universe, bool shift
 
 // -----------------------------------------------------------------------------
 
+static const char* PutCellArray(lua_State* L, lifealgo* universe, int len, const char* badstate)
+{
+    // copy the cell array at stack index 1 into given universe (one putcells call
+    // sets all the cells) and return an error message if there's a problem
+    bool multistate = (len & 1) == 1;
+    int ints_per_cell = multistate ? 3 : 2;
+    int num_cells = len / ints_per_cell;
+    std::vector<int> cells;
+    cells.reserve(num_cells * ints_per_cell);
+    for (int n = 0; n < num_cells; n++) {
+        int item = ints_per_cell * n;
+        lua_rawgeti(L, 1, item+1); int x = lua_tointeger(L,-1); lua_pop(L,1);
+        lua_rawgeti(L, 1, item+2); int y = lua_tointeger(L,-1); lua_pop(L,1);
+        
+        // check if x,y is outside bounded grid
+        const char* err = GSF_checkpos(universe, x, y);
+        if (err) return err;
+        
+        cells.push_back(x);
+        cells.push_back(y);
+        if (multistate) {
+            lua_rawgeti(L, 1, item+3); cells.push_back(lua_tointeger(L,-1)); lua_pop(L,1);
+        }
+    }
+    if (num_cells > 0 && universe->putcells(&cells[0], num_cells, multistate) < 0) {
+        return badstate;
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
 static int g_load(lua_State* L)
 {
     AUTORELEASE_POOL
@@ -369,33 +413,12 @@ static int g_store(lua_State* L)
     }
     
     // copy cell array into temporary universe
-    bool multistate = (len & 1) == 1;
-    int ints_per_cell = multistate ? 3 : 2;
-    int num_cells = len / ints_per_cell;
-    for (int n = 0; n < num_cells; n++) {
-        int item = ints_per_cell * n;
-        lua_rawgeti(L, 1, item+1); int x = lua_tointeger(L,-1); lua_pop(L,1);
-        lua_rawgeti(L, 1, item+2); int y = lua_tointeger(L,-1); lua_pop(L,1);
-        
-        // check if x,y is outside bounded grid
-        err = GSF_checkpos(tempalgo, x, y);
-        if (err) {
-            delete tempalgo;
-            GollyError(L, err);
-        }
-        
-        if (multistate) {
-            lua_rawgeti(L, 1, item+3); int state = lua_tointeger(L,-1); lua_pop(L,1);
-            if (tempalgo->setcell(x, y, state) < 0) {
-                tempalgo->endofpattern();
-                delete tempalgo;
-                GollyError(L, "store error: state value is out of range.");
-            }
-        } else {
-            tempalgo->setcell(x, y, 1);
-        }
-    }
+    err = PutCellArray(L, tempalgo, len, "store error: state value is out of range.");
     tempalgo->endofpattern();
+    if (err) {
+        delete tempalgo;
+        GollyError(L, err);
+    }
     
     // write pattern to given file in RLE/XRLE format
     bigint top, left, bottom, right;
@@ -866,31 +889,12 @@ static int g_evolve(lua_State* L)
     if (err) tempalgo->setrule(tempalgo->DefaultRule());
     
     // copy cell array into temporary universe
-    bool multistate = (luaL_len(L, 1) & 1) == 1;
-    int ints_per_cell = multistate ? 3 : 2;
-    int num_cells = luaL_len(L, 1) / ints_per_cell;
-    for (int n = 0; n < num_cells; n++) {
-        int item = ints_per_cell * n;
-        lua_rawgeti(L, 1, item+1); int x = lua_tointeger(L,-1); lua_pop(L,1);
-        lua_rawgeti(L, 1, item+2); int y = lua_tointeger(L,-1); lua_pop(L,1);
-        // check if x,y is outside bounded grid
-        err = GSF_checkpos(tempalgo, x, y);
-        if (err) {
-            delete tempalgo;
-            GollyError(L, err);
-        }
-        if (multistate) {
-            lua_rawgeti(L, 1, item+3); int state = lua_tointeger(L,-1); lua_pop(L,1);
-            if (tempalgo->setcell(x, y, state) < 0) {
-                tempalgo->endofpattern();
-                delete tempalgo;
-                GollyError(L, "evolve error: state value is out of range.");
-            }
-        } else {
-            tempalgo->setcell(x, y, 1);
-        }
-    }
+    err = PutCellArray(L, tempalgo, luaL_len(L, 1), "evolve error: state value is out of range.");
     tempalgo->endofpattern();
+    if (err) {
+        delete tempalgo;
+        GollyError(L, err);
+    }
     
     // advance pattern by ngens
     mainptr->generating = true;
@@ -1049,6 +1053,10 @@ static int g_putcells(lua_State* L)
         bool ormode = modestr.IsSameAs(wxT("or"), false);
         int newstate = notmode ? 0 : 1;
         int maxstate = curralgo->NumCellStates() - 1;
+        // the live cells of a one-state array are gathered up and set by one
+        // putcells call (setting the same cell twice does no harm)
+        bool gather = !multistate && !notmode;
+        std::vector<int> cells;
         for (int n = 0; n < num_cells; n++) {
             int item = ints_per_cell * n;
             lua_rawgeti(L, 1, item+1); int x = lua_tointeger(L,-1); lua_pop(L,1);
@@ -1067,7 +1075,10 @@ static int g_putcells(lua_State* L)
             }
             if (newstate != oldstate) {
                 // paste (possibly transformed) cell into current universe
-                if (curralgo->setcell(newx, newy, newstate) < 0) {
+                if (gather) {
+                    cells.push_back(newx);
+                    cells.push_back(newy);
+                } else if (curralgo->setcell(newx, newy, newstate) < 0) {
                     err = BAD_STATE;
                     break;
                 }
@@ -1075,6 +1086,9 @@ static int g_putcells(lua_State* L)
                 pattchanged = true;
             }
         }
+        if (!cells.empty() && curralgo->putcells(&cells[0], (int)cells.size() / 2, false) < 0) {
+            if (!err) err = BAD_STATE;
+        }
     }
     
     if (pattchanged) {
@@ -1112,30 +1126,11 @@ static int g_getcells(lua_State* L)
         const char* err = GSF_checkrect(ileft, itop, wd, ht);
         if (err) GollyError(L, err);
         
-        int iright = ileft + wd - 1;
-        int ibottom = itop + ht - 1;
-        int cx, cy;
-        int v = 0;
         lifealgo* curralgo = currlayer->algo;
         bool multistate = curralgo->NumCellStates() > 2;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (cx <= iright) {
-                        lua_pushinteger(L, cx); lua_rawseti(L, -2, ++arraylen);
-                        lua_pushinteger(L, cy); lua_rawseti(L, -2, ++arraylen);
-                        if (multistate) {
-                            lua_pushinteger(L, v); lua_rawseti(L, -2, ++arraylen);
-                        }
-                    }
-                } else {
-                    cx = iright;  // done this row
-                }
-            }
-        }
+        CellArrayWalker walker(L, 0, 0, multistate);
+        curralgo->visitcells(ileft, itop, wd, ht, walker);
+        arraylen = walker.arraylen;
         if (multistate && arraylen > 0 && (arraylen & 1) == 0) {
             // add padding zero
             lua_pushinteger(L, 0); lua_rawseti(L, -2, ++arraylen);
@@ -1358,32 +1353,14 @@ static int g_getclip(lua_State* L)
         
         // now push cell array
         lua_newtable(L);
-        int arraylen = 0;
         
-        // extract cells from templayer
+        // extract cells from templayer, shifting them so that top left cell
+        // of bounding box is at 0,0
         lifealgo* tempalgo = templayer->algo;
         bool multistate = tempalgo->NumCellStates() > 2;
-        int cx, cy;
-        int v = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = tempalgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-
-                    // shift cells so that top left cell of bounding box is at 0,0
-                    lua_pushinteger(L, cx - ileft); lua_rawseti(L, -2, ++arraylen);
-                    lua_pushinteger(L, cy - itop ); lua_rawseti(L, -2, ++arraylen);
-
-                    if (multistate) {
-                        lua_pushinteger(L, v); lua_rawseti(L, -2, ++arraylen);
-                    }
-                } else {
-                    cx = iright;  // done this row
-                }
-            }
-        }
+        CellArrayWalker walker(L, ileft, itop, multistate);
+        tempalgo->visitcells(ileft, itop, wd, ht, walker);
+        int arraylen = walker.arraylen;
         // if no live cells then return {wd,ht} rather than {wd,ht,0}
         if (multistate && arraylen > 2 && (arraylen & 1) == 0) {
             // add padding zero
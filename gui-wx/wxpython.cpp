@@ -404,6 +404,40 @@ static void AddCellColor(PyObject* list, long s, long r, long g, long b)
 
 // -----------------------------------------------------------------------------
 
+// ExtractCellList, py_getcells and py_getclip use this to append the live cells
+// of a universe to the given cell list, with dx,dy subtracted from each cell's
+// coordinates; the walk stops early if the user aborts the script
+
+class CellListWalker : public cellvisitor {
+public:
+    CellListWalker(PyObject* list, int dx, int dy, bool multistate)
+        : list(list), dx(dx), dy(dy), multistate(multistate), cntr(0) {}
+    
+    virtual bool visit(int x, int y, int n, const unsigned char* states)
+    {
+        for (int i = 0; i < n; i++) {
+            if (states[i]) {
+                AddTwoInts(list, x + i - dx, y - dy);
+                if (multistate) AddState(list, states[i]);
+            }
+        }
+        cntr += n;
+        if (cntr >= 4096) {
+            cntr = 0;
+            if (PythonScriptAborted()) return false;
+        }
+        return true;
+    }
+    
+private:
+    PyObject* list;
+    int dx, dy;
+    bool multistate;
+    int cntr;
+};
+
+// -----------------------------------------------------------------------------
+
 static bool ExtractCellList(PyObject* list, lifealgo* universe, bool shift = false)
 {
     // extract cell list from given universe
@@ -419,34 +453,47 @@ static bool ExtractCellList(PyObject* list, lifealgo* universe, bool shift = fal
         int ileft = left.toint();
         int ibottom = bottom.toint();
         int iright = right.toint();
-        int cx, cy;
-        int v = 0;
-        int cntr = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = universe->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (shift) {
-                        // shift cells so that top left cell of bounding box is at 0,0
-                        AddTwoInts(list, cx - ileft, cy - itop);
-                    } else {
-                        AddTwoInts(list, cx, cy);
-                    }
-                    if (multistate) AddState(list, v);
-                } else {
-                    cx = iright;  // done this row
-                }
-                cntr++;
-                if ((cntr % 4096) == 0 && PythonScriptAborted()) return false;
-            }
-        }
+        // if shift is true then shift cells so that top left cell of bounding box is at 0,0
+        CellListWalker walker(list, shift ? ileft : 0, shift ? itop : 0, multistate);
+        if ( !universe->visitcells(ileft, itop, iright - ileft + 1, ibottom - itop + 1, walker) )
+            return false;
         if (multistate) AddPadding(list);
     }
     return true;
 }
 
+// -----------------------------------------------------------------------------
+
+static bool PutCellList(PyObject* list, lifealgo* universe, const char* badstate)
+{
+    // copy given cell list into given universe (one putcells call sets all the cells)
+    bool multistate = (G_PyList_Size(list) & 1) == 1;
+    int ints_per_cell = multistate ? 3 : 2;
+    int num_cells = G_PyList_Size(list) / ints_per_cell;
+    std::vector<int> cells;
+    cells.reserve(num_cells * ints_per_cell);
+    for (int n = 0; n < num_cells; n++) {
+        int item = ints_per_cell * n;
+        long x = G_PyLong_AsLong( G_PyList_GetItem(list, item) );
+        long y = G_PyLong_AsLong( G_PyList_GetItem(list, item + 1) );
+        // check if x,y is outside bounded grid
+        const char* err = GSF_checkpos(universe, x, y);
+        if (err) {
+            G_PyErr_SetString(G_PyExc_RuntimeError, err);
+            return false;
+        }
+        cells.push_back(x);
+        cells.push_back(y);
+        if (multistate) cells.push_back(G_PyLong_AsLong( G_PyList_GetItem(list, item + 2) ));
+        if ((n % 4096) == 0 && PythonScriptAborted()) return false;
+    }
+    if (num_cells > 0 && universe->putcells(&cells[0], num_cells, multistate) < 0) {
+        G_PyErr_SetString(G_PyExc_RuntimeError, badstate);
+        return false;
+    }
+    return true;
+}
+
 // =============================================================================
 
 // The following py_* routines can be called from Python scripts; some are
@@ -635,33 +682,12 @@ static PyObject* py_store(PyObject* self, PyObject* args)
     }
     
     // copy cell list into temporary universe
-    bool multistate = (G_PyList_Size(inlist) & 1) == 1;
-    int ints_per_cell = multistate ? 3 : 2;
-    int num_cells = G_PyList_Size(inlist) / ints_per_cell;
-    for (int n = 0; n < num_cells; n++) {
-        int item = ints_per_cell * n;
-        long x = G_PyLong_AsLong( G_PyList_GetItem(inlist, item) );
-        long y = G_PyLong_AsLong( G_PyList_GetItem(inlist, item + 1) );
-        // check if x,y is outside bounded grid
-        const char* err = GSF_checkpos(tempalgo, x, y);
-        if (err) { delete tempalgo; PYTHON_ERROR(err); }
-        if (multistate) {
-            long state = G_PyLong_AsLong( G_PyList_GetItem(inlist, item + 2) );
-            if (tempalgo->setcell(x, y, state) < 0) {
-                tempalgo->endofpattern();
-                delete tempalgo;
-                PYTHON_ERROR("store error: state value is out of range.");
-            }
-        } else {
-            tempalgo->setcell(x, y, 1);
-        }
-        if ((n % 4096) == 0 && PythonScriptAborted()) {
-            tempalgo->endofpattern();
-            delete tempalgo;
-            return NULL;
-        }
-    }
+    bool done = PutCellList(inlist, tempalgo, "store error: state value is out of range.");
     tempalgo->endofpattern();
+    if (!done) {
+        delete tempalgo;
+        return NULL;
+    }
     
     // write pattern to given file in RLE/XRLE format
     bigint top, left, bottom, right;
@@ -1103,33 +1129,12 @@ static PyObject* py_evolve(PyObject* self, PyObject* args)
     if (err) tempalgo->setrule(tempalgo->DefaultRule());
     
     // copy cell list into temporary universe
-    bool multistate = (G_PyList_Size(inlist) & 1) == 1;
-    int ints_per_cell = multistate ? 3 : 2;
-    int num_cells = G_PyList_Size(inlist) / ints_per_cell;
-    for (int n = 0; n < num_cells; n++) {
-        int item = ints_per_cell * n;
-        long x = G_PyLong_AsLong( G_PyList_GetItem(inlist, item) );
-        long y = G_PyLong_AsLong( G_PyList_GetItem(inlist, item + 1) );
-        // check if x,y is outside bounded grid
-        const char* err = GSF_checkpos(tempalgo, x, y);
-        if (err) { delete tempalgo; PYTHON_ERROR(err); }
-        if (multistate) {
-            long state = G_PyLong_AsLong( G_PyList_GetItem(inlist, item + 2) );
-            if (tempalgo->setcell(x, y, state) < 0) {
-                tempalgo->endofpattern();
-                delete tempalgo;
-                PYTHON_ERROR("evolve error: state value is out of range.");
-            }
-        } else {
-            tempalgo->setcell(x, y, 1);
-        }
-        if ((n % 4096) == 0 && PythonScriptAborted()) {
-            tempalgo->endofpattern();
-            delete tempalgo;
-            return NULL;
-        }
-    }
+    bool done = PutCellList(inlist, tempalgo, "evolve error: state value is out of range.");
     tempalgo->endofpattern();
+    if (!done) {
+        delete tempalgo;
+        return NULL;
+    }
     
     // advance pattern by ngens
     mainptr->generating = true;
@@ -1156,7 +1161,7 @@ static PyObject* py_evolve(PyObject* self, PyObject* args)
     
     // convert new pattern into a new cell list
     PyObject* outlist = G_PyList_New(0);
-    bool done = ExtractCellList(outlist, tempalgo);
+    done = ExtractCellList(outlist, tempalgo);
     delete tempalgo;
     if (!done) {
         G_Py_DecRef(outlist);
@@ -1304,6 +1309,10 @@ static PyObject* py_putcells(PyObject* self, PyObject* args)
         bool ormode = modestr.IsSameAs(wxT("or"), false);
         int newstate = notmode ? 0 : 1;
         int maxstate = curralgo->NumCellStates() - 1;
+        // the live cells of a one-state list are gathered up and set by one
+        // putcells call (setting the same cell twice does no harm)
+        bool gather = !multistate && !notmode;
+        std::vector<int> cells;
         for (int n = 0; n < num_cells; n++) {
             int item = ints_per_cell * n;
             long x = G_PyLong_AsLong( G_PyList_GetItem(list, item) );
@@ -1322,7 +1331,10 @@ static PyObject* py_putcells(PyObject* self, PyObject* args)
             }
             if (newstate != oldstate) {
                 // paste (possibly transformed) cell into current universe
-                if (curralgo->setcell(newx, newy, newstate) < 0) {
+                if (gather) {
+                    cells.push_back(newx);
+                    cells.push_back(newy);
+                } else if (curralgo->setcell(newx, newy, newstate) < 0) {
                     G_PyErr_SetString(G_PyExc_RuntimeError, BAD_STATE);
                     abort = true;
                     break;
@@ -1335,6 +1347,12 @@ static PyObject* py_putcells(PyObject* self, PyObject* args)
                 break;
             }
         }
+        if (!cells.empty() && curralgo->putcells(&cells[0], (int)cells.size() / 2, false) < 0) {
+            if (!err && !abort) {
+                G_PyErr_SetString(G_PyExc_RuntimeError, BAD_STATE);
+                abort = true;
+            }
+        }
     }
     
     if (pattchanged) {
@@ -1376,32 +1394,12 @@ static PyObject* py_getcells(PyObject* self, PyObject* args)
             G_Py_DecRef(outlist);
             PYTHON_ERROR(err);
         }
-        int iright = ileft + wd - 1;
-        int ibottom = itop + ht - 1;
-        int cx, cy;
-        int v = 0;
-        int cntr = 0;
         lifealgo* curralgo = currlayer->algo;
         bool multistate = curralgo->NumCellStates() > 2;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (cx <= iright) {
-                        AddTwoInts(outlist, cx, cy);
-                        if (multistate) AddState(outlist, v);
-                    }
-                } else {
-                    cx = iright;  // done this row
-                }
-                cntr++;
-                if ((cntr % 4096) == 0 && PythonScriptAborted()) {
-                    G_Py_DecRef(outlist);
-                    return NULL;
-                }
-            }
+        CellListWalker walker(outlist, 0, 0, multistate);
+        if ( !curralgo->visitcells(ileft, itop, wd, ht, walker) ) {
+            G_Py_DecRef(outlist);
+            return NULL;
         }
         if (multistate) AddPadding(outlist);
     } else {
@@ -1551,28 +1549,12 @@ static PyObject* py_getclip(PyObject* self, PyObject* args)
         // extract cells from templayer
         lifealgo* tempalgo = templayer->algo;
         bool multistate = tempalgo->NumCellStates() > 2;
-        int cx, cy;
-        int cntr = 0;
-        int v = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = tempalgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    // shift cells so that top left cell of bounding box is at 0,0
-                    AddTwoInts(outlist, cx - ileft, cy - itop);
-                    if (multistate) AddState(outlist, v);
-                } else {
-                    cx = iright;  // done this row
-                }
-                cntr++;
-                if ((cntr % 4096) == 0 && PythonScriptAborted()) {
-                    delete templayer;
-                    G_Py_DecRef(outlist);
-                    return NULL;
-                }
-            }
+        // shift cells so that top left cell of bounding box is at 0,0
+        CellListWalker walker(outlist, ileft, itop, multistate);
+        if ( !tempalgo->visitcells(ileft, itop, wd, ht, walker) ) {
+            delete templayer;
+            G_Py_DecRef(outlist);
+            return NULL;
         }
         // if no live cells then return [wd,ht] rather than [wd,ht,0]
         if (multistate && G_PyList_Size(outlist) > 2) {
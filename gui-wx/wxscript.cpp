@@ -640,37 +640,42 @@ const char* GSF_checkrect(int x, int y, int wd, int ht)
 
 // -----------------------------------------------------------------------------
 
-int GSF_hash(int x, int y, int wd, int ht)
-{
-    // calculate a hash value for pattern in given rect
-    int hash = 31415962;
-    int right = x + wd - 1;
-    int bottom = y + ht - 1;
-    int cx, cy;
-    int v = 0;
-    lifealgo* curralgo = currlayer->algo;
-    bool multistate = curralgo->NumCellStates() > 2;
-
-    for ( cy=y; cy<=bottom; cy++ ) {
-        int yshift = cy - y;
-        for ( cx=x; cx<=right; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip >= 0) {
-                // found next live cell in this row (v is >= 1 if multistate)
-                cx += skip;
-                if (cx <= right) {
-                    // need to use a good hash function for patterns like AlienCounter.rle
-                    hash = (hash * 1000003) ^ yshift;
-                    hash = (hash * 1000003) ^ (cx - x);
-                    if (multistate) hash = (hash * 1000003) ^ v;
-                }
-            } else {
-                cx = right;  // done this row
+// GSF_hash uses this to hash the live cells in a rectangle
+
+class HashWalker : public cellvisitor {
+public:
+    HashWalker(int x, int y, bool multistate)
+        : hash(31415962), x(x), y(y), multistate(multistate) {}
+    
+    virtual bool visit(int cx, int cy, int n, const unsigned char* states)
+    {
+        for (int i = 0; i < n; i++) {
+            if (states[i]) {
+                // need to use a good hash function for patterns like AlienCounter.rle
+                hash = (hash * 1000003) ^ (cy - y);
+                hash = (hash * 1000003) ^ (cx + i - x);
+                if (multistate) hash = (hash * 1000003) ^ states[i];
             }
         }
+        return true;
     }
+    
+    int hash;
+    
+private:
+    int x, y;
+    bool multistate;
+};
 
-    return hash;
+// -----------------------------------------------------------------------------
+
+int GSF_hash(int x, int y, int wd, int ht)
+{
+    // calculate a hash value for pattern in given rect
+    lifealgo* curralgo = currlayer->algo;
+    HashWalker hasher(x, y, curralgo->NumCellStates() > 2);
+    curralgo->visitcells(x, y, wd, ht, hasher);
+    return hasher.hash;
 }
 
 // -----------------------------------------------------------------------------
@@ -18,7 +18,7 @@
 #include "wxscript.h"      // for inscript
 #include "wxview.h"        // for viewptr->...
 #include "wxundo.h"        // for currlayer->undoredo->...
-#include "wxalgos.h"       // for *_ALGO, CreateNewUniverse
+#include "wxalgos.h"       // for *_ALGO, CreateNewUniverse, CellCopier, etc
 #include "wxlayer.h"       // for currlayer, MarkLayerDirty, etc
 #include "wxselect.h"
 
@@ -99,6 +99,37 @@ bool Selection::TooBig()
 
 // -----------------------------------------------------------------------------
 
+// CalculatePopulation uses this to count the live cells in each state;
+// the walk stops if a new row is reached after the given time
+
+class PopCounter : public cellvisitor {
+public:
+    PopCounter(int* selpop, long maxtime)
+        : selpop(selpop), maxtime(maxtime), lasty(0), started(false) {}
+
+    virtual bool visit(int x, int y, int n, const unsigned char* states)
+    {
+        if (!started || y != lasty) {
+            // bail out if calculation time exceeded
+            if (started && stopwatch->Time() > maxtime) return false;
+            started = true;
+            lasty = y;
+        }
+        for (int i = 0; i < n; i++) {
+            if (states[i]) selpop[states[i]]++;
+        }
+        return true;
+    }
+
+private:
+    int* selpop;
+    long maxtime;
+    int lasty;
+    bool started;
+};
+
+// -----------------------------------------------------------------------------
+
 bool Selection::CalculatePopulation(long timeout)
 {
     // compute selection population
@@ -108,7 +139,6 @@ bool Selection::CalculatePopulation(long timeout)
     int topy = seltop.toint();
     lifealgo* curralgo = currlayer->algo;
     int nstates = curralgo->NumCellStates();
-    int v = 0;
 
     // bail out if population count takes longer than supplied timeout (in milliseconds)
     long starttime = stopwatch->Time();
@@ -120,26 +150,12 @@ bool Selection::CalculatePopulation(long timeout)
     }
 
     // count live cells
-    for (int cy = topy; cy <= bottomy; cy++) {
-        for (int cx = leftx; cx <= rightx; cx++) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip + cx > rightx)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                selpop[v]++;
-            } else {
-                cx = rightx + 1;     // done this row
-            }
-        }
-
-        // bail out if calculation time exceeded
-        if (stopwatch->Time() > maxtime) return false;
-    }
+    PopCounter counter(selpop, maxtime);
+    if (!curralgo->visitcells(leftx, topy, rightx - leftx + 1, bottomy - topy + 1, counter))
+        return false;
 
     // calculation completed successfully on time
-    return true;
+    return stopwatch->Time() <= maxtime;
 }
 
 // -----------------------------------------------------------------------------
@@ -478,6 +494,29 @@ void Selection::Advance()
 
 // -----------------------------------------------------------------------------
 
+// AdvanceOutside uses this to copy the live cells outside the given
+// selection edges to another universe
+
+class OutsideCopier : public CellWalker {
+public:
+    OutsideCopier(lifealgo* destalgo, int stop, int sleft, int sbottom, int sright,
+                  int top, int left, int wd, int ht)
+        : CellWalker(top, left, wd, ht), destalgo(destalgo),
+          stop(stop), sleft(sleft), sbottom(sbottom), sright(sright) {}
+
+    virtual void cell(int x, int y, int state)
+    {
+        if (x < sleft || x > sright || y < stop || y > sbottom)
+            destalgo->setcell(x, y, state);
+    }
+
+private:
+    lifealgo* destalgo;
+    int stop, sleft, sbottom, sright;
+};
+
+// -----------------------------------------------------------------------------
+
 void Selection::AdvanceOutside()
 {
     if (insideYield > 0) return; // avoid recursion
@@ -602,46 +641,15 @@ void Selection::AdvanceOutside()
         int ileft = l.toint();
         int ibottom = b.toint();
         int iright = r.toint();
+        int wd = iright - ileft + 1;
         int ht = ibottom - itop + 1;
-        int cx, cy;
-
-        // for showing accurate progress we need to add pattern height to pop count
-        // in case this is a huge pattern with many blank rows
-        double maxcount = currlayer->algo->getPopulation().todouble() + ht;
-        double accumcount = 0;
-        int currcount = 0;
-        int v = 0;
-        bool abort = false;
         BeginProgress(_("Copying advanced pattern"));
 
-        lifealgo* curralgo = currlayer->algo;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            currcount++;
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-
-                    // only copy cell if outside selection
-                    if ( cx < iselleft || cx > iselright ||
-                        cy < iseltop || cy > iselbottom ) {
-                        newalgo->setcell(cx, cy, v);
-                    }
-
-                    currcount++;
-                } else {
-                    cx = iright;  // done this row
-                }
-                if (currcount > 1024) {
-                    accumcount += currcount;
-                    currcount = 0;
-                    abort = AbortProgress(accumcount / maxcount, wxEmptyString);
-                    if (abort) break;
-                }
-            }
-            if (abort) break;
-        }
+        // only copy cells outside selection
+        OutsideCopier copier(newalgo, iseltop, iselleft, iselbottom, iselright,
+                             itop, ileft, wd, ht);
+        currlayer->algo->visitcells(ileft, itop, wd, ht, copier);
+        bool abort = copier.aborted;
 
         newalgo->endofpattern();
         EndProgress();
@@ -1116,37 +1124,20 @@ void Selection::Clear()
     int iright = right.toint();
     int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    int cx, cy;
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    int v = 0;
-    bool abort = false;
     bool selchanged = false;
     BeginProgress(_("Clearing selection"));
     lifealgo* curralgo = currlayer->algo;
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                curralgo->setcell(cx, cy, 0);
-                selchanged = true;
-                if (savecells) currlayer->undoredo->SaveCellChange(cx, cy, v, 0);
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-        }
-        if (abort) break;
+
+    // gather the live cells first because they can't be killed during the walk;
+    // if the user aborts then only the cells found so far are cleared
+    CellGatherer live(itop, ileft, wd, ht);
+    curralgo->visitcells(ileft, itop, wd, ht, live);
+    for (size_t i = 0; i < live.cells.size(); i += 3) {
+        int cx = live.cells[i];
+        int cy = live.cells[i+1];
+        curralgo->setcell(cx, cy, 0);
+        selchanged = true;
+        if (savecells) currlayer->undoredo->SaveCellChange(cx, cy, live.cells[i+2], 0);
     }
     if (selchanged) curralgo->endofpattern();
     EndProgress();
@@ -1160,6 +1151,31 @@ void Selection::Clear()
 
 // -----------------------------------------------------------------------------
 
+// SaveOutside uses this to remember the live cells outside the given
+// selection edges as changes to dead cells
+
+class OutsideSaver : public CellWalker {
+public:
+    OutsideSaver(bool saveall, int stop, int sleft, int sbottom, int sright,
+                 int top, int left, int wd, int ht)
+        : CellWalker(top, left, wd, ht), saveall(saveall),
+          stop(stop), sleft(sleft), sbottom(sbottom), sright(sright) {}
+
+    virtual void cell(int x, int y, int state)
+    {
+        if (saveall || x < sleft || x > sright || y < stop || y > sbottom) {
+            // cell is outside selection edges
+            currlayer->undoredo->SaveCellChange(x, y, state, 0);
+        }
+    }
+
+private:
+    bool saveall;
+    int stop, sleft, sbottom, sright;
+};
+
+// -----------------------------------------------------------------------------
+
 bool Selection::SaveOutside(bigint& t, bigint& l, bigint& b, bigint& r)
 {
     if ( viewptr->OutsideLimits(t, l, b, r) ) {
@@ -1189,38 +1205,10 @@ bool Selection::SaveOutside(bigint& t, bigint& l, bigint& b, bigint& r)
 
     int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    int cx, cy;
-    int v = 0;
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    bool abort = false;
     BeginProgress(_("Saving outside selection"));
-    lifealgo* curralgo = currlayer->algo;
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                if (saveall || cx < sleft || cx > sright || cy < stop || cy > sbottom) {
-                    // cell is outside selection edges
-                    currlayer->undoredo->SaveCellChange(cx, cy, v, 0);
-                }
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-        }
-        if (abort) break;
-    }
+    OutsideSaver saver(saveall, stop, sleft, sbottom, sright, itop, ileft, wd, ht);
+    currlayer->algo->visitcells(ileft, itop, wd, ht, saver);
+    bool abort = saver.aborted;
     EndProgress();
 
     if (abort) currlayer->undoredo->ForgetCellChanges();
@@ -1309,7 +1297,7 @@ void Selection::ClearOutside()
 
 // -----------------------------------------------------------------------------
 
-void Selection::AddEOL(char* &chptr)
+static void AddEOL(char* &chptr)
 {
 #ifdef __WXMSW__
     // use DOS line ending (CR+LF) on Windows
@@ -1330,11 +1318,11 @@ const int WRLE_NONE = -3;
 const int WRLE_EOP = -2;
 const int WRLE_NEWLINE = -1;
 
-void Selection::AddRun(int state,                // in: state of cell to write
-                       int multistate,           // true if #cell states > 2
-                       unsigned int &run,        // in and out
-                       unsigned int &linelen,    // ditto
-                       char* &chptr)             // ditto
+static void AddRun(int state,                // in: state of cell to write
+                   int multistate,           // true if #cell states > 2
+                   unsigned int &run,        // in and out
+                   unsigned int &linelen,    // ditto
+                   char* &chptr)             // ditto
 {
     // output of RLE pattern data is channelled thru here to make it easier to
     // ensure all lines have <= maxrleline characters
@@ -1381,173 +1369,236 @@ void Selection::AddRun(int state,                // in: state of cell to write
 
 // -----------------------------------------------------------------------------
 
-void Selection::CopyToClipboard(bool cut)
-{
-    if (insideYield > 0) return; // avoid recursion
+// CopyToClipboard uses this to convert live cells, given in row order,
+// to RLE data.  When copying it's passed straight to visitcells; when
+// cutting the cells are gathered first (they can't be killed during the
+// walk) and then passed to cell one at a time.
 
-    // can only use getcell/setcell in limited domain
-    if (TooBig()) {
-        statusptr->ErrorMessage(selection_too_big);
-        return;
-    }
+class RLEWriter : public CellWalker {
+public:
+    RLEWriter(int multistate, int top, int left, int wd, int ht)
+        : CellWalker(top, left, wd, ht), textptr(NULL), livecount(0),
+          multistate(multistate), rowtop(top), rowleft(left),
+          width(wd), height(ht) {}
+    ~RLEWriter() { free(textptr); }
 
-    int itop = seltop.toint();
-    int ileft = selleft.toint();
-    int ibottom = selbottom.toint();
-    int iright = selright.toint();
-    unsigned int wd = iright - ileft + 1;
-    unsigned int ht = ibottom - itop + 1;
+    bool Start(const char* rule);
+    // allocate the RLE data and add the header line;
+    // returns false if there isn't enough memory
+
+    virtual void cell(int x, int y, int state);
+
+    void Finish(bool abort);
+    // terminate the RLE data; if abort is true then the current row
+    // wasn't finished (the walk was cut short)
 
-    // convert cells in selection to RLE data in textptr
     char* textptr;
+    unsigned int livecount;
+
+private:
+    void EndRow();
+
+    int multistate;
+    int rowtop, rowleft;
+    unsigned int width, height;
     char* etextptr;
-    int cursize = 4096;
+    char* chptr;
+    int cursize;
+    int datastart;
+    unsigned int linelen, brun, orun, dollrun;
+    int laststate;
+    int cx, cy;
+};
 
+// -----------------------------------------------------------------------------
+
+bool RLEWriter::Start(const char* rule)
+{
+    cursize = 4096;
     textptr = (char*)malloc(cursize);
     if (textptr == NULL) {
         statusptr->ErrorMessage(_("Not enough memory for clipboard data!"));
-        return;
+        return false;
     }
     etextptr = textptr + cursize;
 
     // add RLE header line
-    sprintf(textptr, "x = %u, y = %u, rule = %s", wd, ht, currlayer->algo->getrule());
-    char* chptr = textptr;
+    sprintf(textptr, "x = %u, y = %u, rule = %s", width, height, rule);
+    chptr = textptr;
     chptr += strlen(textptr);
     AddEOL(chptr);
     // save start of data in case livecount is zero
-    int datastart = chptr - textptr;
-
-    // add RLE pattern data
-    unsigned int livecount = 0;
-    unsigned int linelen = 0;
-    unsigned int brun = 0;
-    unsigned int orun = 0;
-    unsigned int dollrun = 0;
-    int laststate;
-    int cx, cy;
-    int v = 0;
+    datastart = chptr - textptr;
+
+    linelen = 0;
+    brun = 0;
+    orun = 0;
+    dollrun = 0;
+    laststate = WRLE_NONE;
+    cx = rowleft;                // next cell to write in this row
+    cy = rowtop;
+    return true;
+}
 
-    // save cell changes if undo/redo is enabled and script isn't constructing a pattern
-    bool savecells = allowundo && !currlayer->stayclean;
-    if (savecells && inscript) SavePendingChanges();
+// -----------------------------------------------------------------------------
 
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    bool abort = false;
-    if (cut)
-        BeginProgress(_("Cutting selection"));
-    else
-        BeginProgress(_("Copying selection"));
+void RLEWriter::EndRow()
+{
+    if (laststate == 0)
+        // forget dead cells at end of row
+        brun = 0;
+    else if (laststate >= 0)
+        // output current run of live cells
+        AddRun(laststate, multistate, orun, linelen, chptr);
+    dollrun++;
+    laststate = WRLE_NONE;
+    cx = rowleft;
+}
 
-    lifealgo* curralgo = currlayer->algo;
-    int multistate = curralgo->NumCellStates() > 2;
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        laststate = WRLE_NONE;
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip > 0) {
-                // have exactly "skip" empty cells here
-                if (laststate == 0) {
-                    brun += skip;
-                } else {
-                    if (orun > 0) {
-                        // output current run of live cells
-                        AddRun(laststate, multistate, orun, linelen, chptr);
-                    }
-                    laststate = 0;
-                    brun = skip;
-                }
-            }
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                livecount++;
-                if (cut) {
-                    curralgo->setcell(cx, cy, 0);
-                    if (savecells) currlayer->undoredo->SaveCellChange(cx, cy, v, 0);
-                }
-                if (laststate == v) {
-                    orun++;
-                } else {
-                    if (dollrun > 0)
-                        // output current run of $ chars
-                        AddRun(WRLE_NEWLINE, multistate, dollrun, linelen, chptr);
-                    if (brun > 0)
-                        // output current run of dead cells
-                        AddRun(0, multistate, brun, linelen, chptr);
-                    if (orun > 0)
-                        // output current run of other live cells
-                        AddRun(laststate, multistate, orun, linelen, chptr);
-                    laststate = v;
-                    orun = 1;
-                }
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-            if (chptr + 60 >= etextptr) {
-                // nearly out of space; try to increase allocation
-                ptrdiff_t delta = chptr - textptr;
-                char* ntxtptr = (char*) realloc(textptr, 2*cursize);
-                if (ntxtptr == 0) {
-                    statusptr->ErrorMessage(_("No more memory for clipboard data!"));
-                    // don't return here -- best to set abort flag and break so that
-                    // partially cut/copied portion gets saved to clipboard
-                    abort = true;
-                    break;
-                }
-                chptr = ntxtptr + delta;
-                cursize *= 2;
-                etextptr = ntxtptr + cursize;
-                textptr = ntxtptr;
+// -----------------------------------------------------------------------------
+
+void RLEWriter::cell(int x, int y, int state)
+{
+    if (aborted) return;
+    if (y > cy) {
+        // finish this row and count any empty rows in between
+        EndRow();
+        dollrun += y - cy - 1;
+        cy = y;
+    }
+    int skip = x - cx;
+    if (skip > 0) {
+        // have exactly "skip" empty cells here
+        if (laststate == 0) {
+            brun += skip;
+        } else {
+            if (orun > 0) {
+                // output current run of live cells
+                AddRun(laststate, multistate, orun, linelen, chptr);
             }
+            laststate = 0;
+            brun = skip;
         }
-        if (abort) break;
-        // end of current row
-        if (laststate == 0)
-            // forget dead cells at end of row
-            brun = 0;
-        else if (laststate >= 0)
-            // output current run of live cells
+    }
+    livecount++;
+    if (laststate == state) {
+        orun++;
+    } else {
+        if (dollrun > 0)
+            // output current run of $ chars
+            AddRun(WRLE_NEWLINE, multistate, dollrun, linelen, chptr);
+        if (brun > 0)
+            // output current run of dead cells
+            AddRun(0, multistate, brun, linelen, chptr);
+        if (orun > 0)
+            // output current run of other live cells
             AddRun(laststate, multistate, orun, linelen, chptr);
-        dollrun++;
+        laststate = state;
+        orun = 1;
+    }
+    cx = x + 1;
+    if (chptr + 60 >= etextptr) {
+        // nearly out of space; try to increase allocation
+        ptrdiff_t delta = chptr - textptr;
+        char* ntxtptr = (char*) realloc(textptr, 2*cursize);
+        if (ntxtptr == 0) {
+            statusptr->ErrorMessage(_("No more memory for clipboard data!"));
+            // stop the walk so that the partially cut/copied portion
+            // gets saved to clipboard
+            aborted = true;
+            return;
+        }
+        chptr = ntxtptr + delta;
+        cursize *= 2;
+        etextptr = ntxtptr + cursize;
+        textptr = ntxtptr;
     }
+}
+
+// -----------------------------------------------------------------------------
 
+void RLEWriter::Finish(bool abort)
+{
     if (livecount == 0) {
         // no live cells in selection so simplify RLE data to "!"
         chptr = textptr + datastart;
         *chptr = '!';
         chptr++;
     } else {
+        if (!abort) EndRow();
         // terminate RLE data
         dollrun = 1;
         AddRun(WRLE_EOP, multistate, dollrun, linelen, chptr);
-        if (cut) currlayer->algo->endofpattern();
     }
     AddEOL(chptr);
     *chptr = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void Selection::CopyToClipboard(bool cut)
+{
+    if (insideYield > 0) return; // avoid recursion
+
+    // can only use getcell/setcell in limited domain
+    if (TooBig()) {
+        statusptr->ErrorMessage(selection_too_big);
+        return;
+    }
+
+    int itop = seltop.toint();
+    int ileft = selleft.toint();
+    int ibottom = selbottom.toint();
+    int iright = selright.toint();
+    unsigned int wd = iright - ileft + 1;
+    unsigned int ht = ibottom - itop + 1;
+
+    // convert cells in selection to RLE data in writer.textptr
+    lifealgo* curralgo = currlayer->algo;
+    RLEWriter writer(curralgo->NumCellStates() > 2, itop, ileft, wd, ht);
+    if (!writer.Start(curralgo->getrule())) return;
+
+    // save cell changes if undo/redo is enabled and script isn't constructing a pattern
+    bool savecells = allowundo && !currlayer->stayclean;
+    if (savecells && inscript) SavePendingChanges();
+
+    bool abort;
+    if (cut) {
+        BeginProgress(_("Cutting selection"));
+        // gather the live cells first because they can't be killed during the walk;
+        // if the user aborts then only the cells found so far are cut
+        CellGatherer live(itop, ileft, wd, ht);
+        curralgo->visitcells(ileft, itop, wd, ht, live);
+        size_t ncells = live.cells.size();
+        for (size_t i = 0; i < ncells && !writer.aborted; i += 3) {
+            int x = live.cells[i];
+            int y = live.cells[i+1];
+            int v = live.cells[i+2];
+            writer.cell(x, y, v);
+            curralgo->setcell(x, y, 0);
+            if (savecells) currlayer->undoredo->SaveCellChange(x, y, v, 0);
+        }
+        abort = live.aborted || writer.aborted;
+    } else {
+        BeginProgress(_("Copying selection"));
+        // write the live cells as they're found
+        curralgo->visitcells(ileft, itop, wd, ht, writer);
+        abort = writer.aborted;
+    }
+    writer.Finish(abort);
+    if (cut && writer.livecount > 0) curralgo->endofpattern();
 
     EndProgress();
 
-    if (cut && livecount > 0) {
+    if (cut && writer.livecount > 0) {
         if (savecells) currlayer->undoredo->RememberCellChanges(_("Cut"), currlayer->dirty);
         // update currlayer->dirty AFTER RememberCellChanges
         MarkLayerDirty();
         mainptr->UpdatePatternAndStatus();
     }
 
-    wxString text = wxString(textptr,wxConvLocal);
+    wxString text = wxString(writer.textptr,wxConvLocal);
     mainptr->CopyTextToClipboard(text);
-    free(textptr);
 }
 
 // -----------------------------------------------------------------------------
@@ -1624,39 +1675,43 @@ void Selection::RandomFill()
     lifealgo* curralgo = currlayer->algo;
     int livestates = curralgo->NumRandomizedCellStates() - 1;    // don't count dead state
 
+    // find the live cells first (in row order) so we know which cells to kill
+    // and their old states without calling getcell for every cell
+    CellGatherer live;
+    if (killcells) curralgo->visitcells(ileft, itop, wd, ht, live);
+    size_t next = 0;
+
+    // each row's new live cells are set by one putrow call
+    std::vector<unsigned char> oldrow(wd);
+    std::vector<unsigned char> newrow(wd);
     for ( cy=itop; cy<=ibottom; cy++ ) {
+        oldrow.assign(wd, 0);
+        for ( ; next < live.cells.size() && live.cells[next+1] == cy; next += 3) {
+            oldrow[live.cells[next] - ileft] = live.cells[next+2];
+        }
         for ( cx=ileft; cx<=iright; cx++ ) {
             // randomfill is from 1..100
-            if (savecells) {
+            int oldstate = oldrow[cx - ileft];
+            int newstate = 0;
+            if ((rand() % 100) < randomfill) {
+                newstate = livestates < 2 ? 1 : 1 + (rand() % livestates);
                 // remember cell change only if state changes
-                int oldstate = curralgo->getcell(cx, cy);
-                if ((rand() % 100) < randomfill) {
-                    int newstate = livestates < 2 ? 1 : 1 + (rand() % livestates);
-                    if (oldstate != newstate) {
-                        curralgo->setcell(cx, cy, newstate);
-                        currlayer->undoredo->SaveCellChange(cx, cy, oldstate, newstate);
-                    }
-                } else if (killcells && oldstate > 0) {
-                    curralgo->setcell(cx, cy, 0);
-                    currlayer->undoredo->SaveCellChange(cx, cy, oldstate, 0);
-                }
-            } else {
-                if ((rand() % 100) < randomfill) {
-                    if (livestates < 2) {
-                        curralgo->setcell(cx, cy, 1);
-                    } else {
-                        curralgo->setcell(cx, cy, 1 + (rand() % livestates));
-                    }
-                } else if (killcells) {
-                    curralgo->setcell(cx, cy, 0);
+                if (savecells && oldstate != newstate) {
+                    currlayer->undoredo->SaveCellChange(cx, cy, oldstate, newstate);
                 }
+            } else if (oldstate > 0) {
+                curralgo->setcell(cx, cy, 0);
+                if (savecells) currlayer->undoredo->SaveCellChange(cx, cy, oldstate, 0);
             }
+            newrow[cx - ileft] = newstate;
             cntr++;
             if ((cntr % 4096) == 0) {
                 abort = AbortProgress((double)cntr / maxcount, wxEmptyString);
                 if (abort) break;
             }
         }
+        // if aborted then cx is the last cell done
+        curralgo->putrow(ileft, cy, abort ? cx - ileft + 1 : wd, &newrow[0]);
         if (abort) break;
     }
 
@@ -1678,57 +1733,21 @@ bool Selection::FlipRect(bool topbottom, lifealgo* srcalgo, lifealgo* destalgo,
 {
     int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    bool abort = false;
-    int v = 0;
-    int cx, cy, newx, newy, newxinc, newyinc;
+    CellCopier copier(srcalgo, destalgo, erasesrc, itop, ileft, wd, ht);
 
     if (topbottom) {
         BeginProgress(_("Flipping top-bottom"));
-        newy = ibottom;
-        newyinc = -1;
-        newxinc = 1;
+        copier.SetTransform(1, 0, 0, -1, 0, itop + ibottom);
     } else {
         BeginProgress(_("Flipping left-right"));
-        newy = itop;
-        newyinc = 1;
-        newxinc = -1;
-    }
-
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        newx = topbottom ? ileft : iright;
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = srcalgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                if (erasesrc) srcalgo->setcell(cx, cy, 0);
-                newx += newxinc * skip;
-                destalgo->setcell(newx, newy, v);
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-            newx += newxinc;
-        }
-        if (abort) break;
-        newy += newyinc;
+        copier.SetTransform(-1, 0, 0, 1, ileft + iright, 0);
     }
 
-    if (erasesrc) srcalgo->endofpattern();
-    destalgo->endofpattern();
+    srcalgo->visitcells(ileft, itop, wd, ht, copier);
+    copier.Finish();
     EndProgress();
 
-    return !abort;
+    return !copier.aborted;
 }
 
 // -----------------------------------------------------------------------------
@@ -1880,56 +1899,23 @@ bool Selection::RotateRect(bool clockwise,
 {
     int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    bool abort = false;
-    int cx, cy, newx, newy, newxinc, newyinc, v=0;
+    CellCopier copier(srcalgo, destalgo, erasesrc, itop, ileft, wd, ht);
 
     if (clockwise) {
         BeginProgress(rotate_clockwise);
-        newx = nright;
-        newyinc = 1;
-        newxinc = -1;
+        // x,y moves to nright-(y-itop), ntop+(x-ileft)
+        copier.SetTransform(0, -1, 1, 0, nright + itop, ntop - ileft);
     } else {
         BeginProgress(rotate_anticlockwise);
-        newx = nleft;
-        newyinc = -1;
-        newxinc = 1;
+        // x,y moves to nleft+(y-itop), nbottom-(x-ileft)
+        copier.SetTransform(0, 1, -1, 0, nleft - itop, nbottom + ileft);
     }
 
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        newy = clockwise ? ntop : nbottom;
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = srcalgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                if (erasesrc) srcalgo->setcell(cx, cy, 0);
-                newy += newyinc * skip;
-                destalgo->setcell(newx, newy, v);
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-            newy += newyinc;
-        }
-        if (abort) break;
-        newx += newxinc;
-    }
-
-    if (erasesrc) srcalgo->endofpattern();
-    destalgo->endofpattern();
+    srcalgo->visitcells(ileft, itop, wd, ht, copier);
+    copier.Finish();
     EndProgress();
 
-    return !abort;
+    return !copier.aborted;
 }
 
 // -----------------------------------------------------------------------------
@@ -1955,55 +1941,22 @@ bool Selection::RotatePattern(bool clockwise,
     int iright  = selright.toint();
     int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    bool abort = false;
-    int cx, cy, newx, newy, newxinc, newyinc, firstnewy, v=0;
+    CellCopier copier(currlayer->algo, newalgo, false, itop, ileft, wd, ht);
 
     if (clockwise) {
         BeginProgress(rotate_clockwise);
-        firstnewy = newtop.toint();
-        newx = newright.toint();
-        newyinc = 1;
-        newxinc = -1;
+        // x,y moves to newright-(y-itop), newtop+(x-ileft)
+        copier.SetTransform(0, -1, 1, 0, newright.toint() + itop, newtop.toint() - ileft);
     } else {
         BeginProgress(rotate_anticlockwise);
-        firstnewy = newbottom.toint();
-        newx = newleft.toint();
-        newyinc = -1;
-        newxinc = 1;
-    }
-
-    lifealgo* curralgo = currlayer->algo;
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        newy = firstnewy;
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                newy += newyinc * skip;
-                newalgo->setcell(newx, newy, v);
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-            newy += newyinc;
-        }
-        if (abort) break;
-        newx += newxinc;
+        // x,y moves to newleft+(y-itop), newbottom-(x-ileft)
+        copier.SetTransform(0, 1, -1, 0, newleft.toint() - itop, newbottom.toint() + ileft);
     }
 
-    newalgo->endofpattern();
+    currlayer->algo->visitcells(ileft, itop, wd, ht, copier);
+    copier.Finish();
     EndProgress();
+    bool abort = copier.aborted;
 
     if (abort) {
         delete newalgo;
@@ -2102,7 +2055,7 @@ bool Selection::Rotate(bool clockwise, bool inundoredo)
         return true;
     }
 
-    // can only use nextcell/getcell/setcell in limited domain
+    // can only use visitcells/getcell/setcell in limited domain
     if (TooBig()) {
         statusptr->ErrorMessage(selection_too_big);
         return false;
@@ -2197,7 +2150,7 @@ bool Selection::Rotate(bool clockwise, bool inundoredo)
     // check if new selection rect is outside modified pattern edges
     currlayer->algo->findedges(&top, &left, &bottom, &right);
     if ( newtop > bottom || newbottom < top || newleft > right || newright < left ) {
-        // safe to use fast nextcell calls
+        // safe to use fast visitcells walk
         viewptr->CopyRect(ntop, nleft, nbottom, nright,
                           tempalgo, currlayer->algo, false, _("Adding rotated selection"));
     } else {
@@ -115,12 +115,6 @@ private:
     void EmptyUniverse();
     // kill all cells by creating a new, empty universe
     
-    void AddRun(int state, int multistate, unsigned int &run,
-                unsigned int &linelen, char* &chptr);
-    
-    void AddEOL(char* &chptr);
-    // these routines are used by CopyToClipboard to create RLE data
-    
     bool SaveDifferences(lifealgo* oldalgo, lifealgo* newalgo,
                          int itop, int ileft, int ibottom, int iright);
     // compare same rectangle in the given universes and remember the differences
@@ -474,7 +474,7 @@ bool AbortProgress(double fraction_done, const wxString& newmsg)
         }
     } else {
         // note that fraction_done is not always an accurate estimator for how long
-        // the task will take, especially when we use nextcell for cut/copy
+        // the task will take, especially when we use visitcells for cut/copy
         if ( (msecs > 1000 && fraction_done < 0.3) || msecs > 2500 ) {
             // task is probably going to take a while so create progress dialog
             // (note that non-empty message avoids dialog height being too small on Windows)
@@ -126,43 +126,16 @@ bool PatternView::CopyRect(int itop, int ileft, int ibottom, int iright,
 {
     int wd = iright - ileft + 1;
     int ht = ibottom - itop + 1;
-    int cx, cy;
-    double maxcount = (double)wd * (double)ht;
-    int cntr = 0;
-    int v = 0;
-    bool abort = false;
     
     // copy (and erase if requested) live cells from given rect
     // in source universe to same rect in destination universe
     BeginProgress(progmsg);
-    for ( cy=itop; cy<=ibottom; cy++ ) {
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = srcalgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                destalgo->setcell(cx, cy, v);
-                if (erasesrc) srcalgo->setcell(cx, cy, 0);
-            } else {
-                cx = iright + 1;     // done this row
-            }
-            cntr++;
-            if ((cntr % 4096) == 0) {
-                double prog = ((cy - itop) * (double)(iright - ileft + 1) +
-                               (cx - ileft)) / maxcount;
-                abort = AbortProgress(prog, wxEmptyString);
-                if (abort) break;
-            }
-        }
-        if (abort) break;
-    }
-    if (erasesrc) srcalgo->endofpattern();
-    destalgo->endofpattern();
+    CellCopier copier(srcalgo, destalgo, erasesrc, itop, ileft, wd, ht);
+    srcalgo->visitcells(ileft, itop, wd, ht, copier);
+    copier.Finish();
     EndProgress();
     
-    return !abort;
+    return !copier.aborted;
 }
 
 // -----------------------------------------------------------------------------
@@ -359,6 +332,65 @@ void PatternView::SetPasteRect(wxRect& rect, bigint& wd, bigint& ht)
 
 // -----------------------------------------------------------------------------
 
+// PasteTemporaryToCurrent uses this to paste the live cells in the paste
+// pattern into the current pattern a row piece at a time
+
+class PasteWalker : public CellWalker {
+public:
+    PasteWalker(lifealgo* algo, int dx, int dy, int gtop, int gleft, int gbottom, int gright,
+                bool savecells, int itop, int ileft, int wd, int ht)
+        : CellWalker(itop, ileft, wd, ht), pattchanged(false), reduced(false),
+          curralgo(algo), dx(dx), dy(dy), gtop(gtop), gleft(gleft), gbottom(gbottom), gright(gright),
+          savecells(savecells)
+    {
+        maxstate = algo->NumCellStates() - 1;
+    }
+    
+    virtual bool visit(int x, int y, int n, const unsigned char* states)
+    {
+        // x,y is in the paste pattern and cx,cy is the same cell in the current
+        // pattern; only cells that change state are put into row
+        int cx = x + dx;
+        int cy = y + dy;
+        bool changed = false;
+        row.assign(n, 0);
+        if (cy >= gtop && cy <= gbottom) {
+            for (int i = 0; i < n; i++) {
+                int newstate = states[i];
+                if (newstate == 0 || cx + i < gleft || cx + i > gright) continue;
+                int currstate = curralgo->getcell(cx + i, cy);
+                if (currstate != newstate) {
+                    if (newstate > maxstate) {
+                        newstate = maxstate;
+                        reduced = true;
+                    }
+                    row[i] = newstate;
+                    changed = true;
+                    if (savecells) currlayer->undoredo->SaveCellChange(cx + i, cy, currstate, newstate);
+                }
+            }
+        }
+        if (changed) {
+            curralgo->putrow(cx, cy, n, &row[0]);
+            pattchanged = true;
+        }
+        return progress(x, y, n);
+    }
+    
+    bool pattchanged;
+    bool reduced;
+    
+private:
+    lifealgo* curralgo;
+    int dx, dy;
+    int gtop, gleft, gbottom, gright;
+    int maxstate;
+    bool savecells;
+    std::vector<unsigned char> row;
+};
+
+// -----------------------------------------------------------------------------
+
 void PatternView::PasteTemporaryToCurrent(bool toselection,
                                           bigint top, bigint left, bigint bottom, bigint right)
 {
@@ -585,62 +617,31 @@ void PatternView::PasteTemporaryToCurrent(bool toselection,
     
     BeginProgress(_("Pasting pattern"));
     
-    // we can speed up pasting sparse patterns by using nextcell in these cases:
+    // we can speed up pasting sparse patterns by using visitcells in these cases:
     // - if using Or mode
     // - if current universe is empty
     // - if paste rect is outside current pattern edges
-    bool usenextcell;
+    bool usevisitcells;
     if ( pmode == Or || curralgo->isEmpty() ) {
-        usenextcell = true;
+        usevisitcells = true;
     } else {
         bigint ctop, cleft, cbottom, cright;
         curralgo->findedges(&ctop, &cleft, &cbottom, &cright);
-        usenextcell = top > cbottom || bottom < ctop || left > cright || right < cleft;
+        usevisitcells = top > cbottom || bottom < ctop || left > cright || right < cleft;
     }
     
-    if ( usenextcell && pmode == And ) {
+    if ( usevisitcells && pmode == And ) {
         // current universe is empty or paste rect is outside current pattern edges
         // so don't change any cells
-    } else if ( usenextcell ) {
-        int newstate = 0;
-        cy = pastey;
-        for ( ty=itop; ty<=ibottom; ty++ ) {
-            cx = pastex;
-            for ( tx=ileft; tx<=iright; tx++ ) {
-                int skip = pastealgo->nextcell(tx, ty, newstate);
-                if (skip + tx > iright)
-                    skip = -1;           // pretend we found no more live cells
-                if (skip >= 0) {
-                    // found next live cell so paste it into current universe
-                    tx += skip;
-                    cx += skip;
-                    if (cx >= gleft && cx <= gright && cy >= gtop && cy <= gbottom) {
-                        int currstate = curralgo->getcell(cx, cy);
-                        if (currstate != newstate) {
-                            if (newstate > maxstate) {
-                                newstate = maxstate;
-                                reduced = true;
-                            }
-                            curralgo->setcell(cx, cy, newstate);
-                            pattchanged = true;
-                            if (savecells) currlayer->undoredo->SaveCellChange(cx, cy, currstate, newstate);
-                        }
-                    }
-                    cx++;
-                } else {
-                    tx = iright + 1;     // done this row
-                }
-                cntr++;
-                if ((cntr % 4096) == 0) {
-                    double prog = ((ty - itop) * (double)(iright - ileft + 1) +
-                                   (tx - ileft)) / maxcount;
-                    abort = AbortProgress(prog, wxEmptyString);
-                    if (abort) break;
-                }
-            }
-            if (abort) break;
-            cy++;
-        }
+    } else if ( usevisitcells ) {
+        int pwd = iright - ileft + 1;
+        int pht = ibottom - itop + 1;
+        PasteWalker paster(curralgo, pastex - ileft, pastey - itop, gtop, gleft, gbottom, gright,
+                           savecells, itop, ileft, pwd, pht);
+        pastealgo->visitcells(ileft, itop, pwd, pht, paster);
+        pattchanged = paster.pattchanged;
+        reduced = paster.reduced;
+        abort = paster.aborted;
     } else {
         // have to use slower getcell/setcell calls
         int tempstate, currstate;
@@ -672,7 +673,7 @@ void PatternView::PasteTemporaryToCurrent(bool toselection,
                             }
                             break;
                         case Or:
-                            // Or mode is done using above nextcell loop;
+                            // Or mode is done using above visitcells walk;
                             // we only include this case to avoid compiler warning
                             break;
                         case Xor: